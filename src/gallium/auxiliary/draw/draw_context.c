@@ -1031,6 +1031,20 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns the number of indexed vertices found in the vertex cache (and
+ * thus not fetched and shaded again), and the number of those which
+ * weren't, since the context was created.  Unlike the pipeline statistics
+ * these are always collected, as they cost nothing per vertex.
+ */
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            uint64_t *hits, uint64_t *misses)
+{
+   *hits = draw->vcache_stats.hits;
+   *misses = draw->vcache_stats.misses;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
@@ -68,6 +68,7 @@ struct vbuf_render;
 struct tgsi_exec_machine;
 struct tgsi_sampler;
 struct draw_pt_front_end;
+struct draw_pt_middle_end;
 struct draw_assembler;
 
 
@@ -104,6 +105,12 @@ struct vertex_header {
 /* maximum number of shader variants we can cache */
 #define DRAW_MAX_SHADER_VARIANTS 128
 
+/* maximum number of vertex shading threads */
+#define DRAW_MAX_THREADS 8
+
+/* smallest chunk worth handing to a vertex shading thread */
+#define DRAW_PT_THREADS_MIN_VERTICES 64
+
 /**
  * Private context for the drawing module.
  */
@@ -170,6 +177,12 @@ struct draw_context
          struct draw_pt_front_end *vsplit;
       } front;
 
+      /** Vertex shading threads, created by the first draw which can use
+       * them (see draw_pt_threads.c); num_threads is 0 if disabled.
+       */
+      struct pt_threads *threads;
+      unsigned num_threads;
+
       struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_buffers;
 
@@ -335,6 +348,12 @@ struct draw_context
    struct pipe_query_data_pipeline_statistics statistics;
    boolean collect_statistics;
 
+   /** vsplit vertex cache counters, see draw_get_vertex_cache_stats() */
+   struct {
+      uint64_t hits;
+      uint64_t misses;
+   } vcache_stats;
+
    struct draw_assembler *ia;
 
    void *driver_private;
@@ -421,6 +440,53 @@ void draw_pt_reset_vertex_ids( struct draw_context *draw );
 void draw_pt_flush( struct draw_context *draw, unsigned flags );
 
 
+/*******************************************************************************
+ * Threaded vertex shading (see draw_pt_threads.c):
+ */
+struct pt_threads;
+
+/**
+ * One vsplit chunk queued by a middle end.  shade() runs on any thread
+ * and may only read draw state; finish() runs on the drawing thread, in
+ * the order the jobs were queued.
+ */
+struct pt_job {
+   struct draw_pt_middle_end *middle;
+
+   void (*shade)(struct pt_job *job, struct tgsi_exec_machine *machine);
+   void (*finish)(struct pt_job *job);
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info vert_info;
+   unsigned instance_id;
+   unsigned clipped;
+
+   /* private to draw_pt_threads.c */
+   unsigned state;
+   unsigned *fetch_elts;
+   unsigned max_fetch_elts;
+   ushort *draw_elts;
+   unsigned max_draw_elts;
+};
+
+struct pt_threads *draw_pt_threads_create(struct draw_context *draw,
+                                          unsigned num_threads);
+void draw_pt_threads_destroy(struct pt_threads *threads);
+unsigned draw_pt_threads_default_count(void);
+struct pt_threads *draw_pt_threads_get(struct draw_context *draw,
+                                       boolean exec);
+
+struct pt_job *draw_pt_threads_alloc_job(struct pt_threads *threads,
+                                         struct draw_pt_middle_end *middle,
+                                         const struct draw_fetch_info *fetch_info,
+                                         const struct draw_prim_info *prim_info);
+void draw_pt_threads_submit(struct pt_threads *threads, struct pt_job *job);
+void draw_pt_threads_flush(struct pt_threads *threads);
+void draw_pt_threads_release_shader(struct pt_threads *threads,
+                                    const struct tgsi_token *tokens);
+
+
 /*******************************************************************************
  * Primitive processing (pipeline) code: 
  */
@@ -148,6 +148,12 @@ draw_pt_arrays(struct draw_context *draw,
 
    frontend->run( frontend, start, count );
 
+   /* Queued chunks may reference the user buffers and state of this
+    * draw, so finish them before returning.
+    */
+   if (draw->pt.threads)
+      draw_pt_threads_flush(draw->pt.threads);
+
    return TRUE;
 }
 
@@ -175,6 +181,10 @@ boolean draw_pt_init( struct draw_context *draw )
    draw->pt.test_fse = debug_get_option_draw_fse();
    draw->pt.no_fse = debug_get_option_draw_no_fse();
 
+   /* the threads themselves are only created when first needed */
+   draw->pt.num_threads = MIN2(draw_pt_threads_default_count(),
+                               DRAW_MAX_THREADS);
+
    draw->pt.front.vsplit = draw_pt_vsplit(draw);
    if (!draw->pt.front.vsplit)
       return FALSE;
@@ -202,6 +212,11 @@ boolean draw_pt_init( struct draw_context *draw )
 
 void draw_pt_destroy( struct draw_context *draw )
 {
+   if (draw->pt.threads) {
+      draw_pt_threads_destroy( draw->pt.threads );
+      draw->pt.threads = NULL;
+   }
+
    if (draw->pt.middle.llvm) {
       draw->pt.middle.llvm->destroy( draw->pt.middle.llvm );
       draw->pt.middle.llvm = NULL;
@@ -226,66 +226,58 @@ draw_vertex_shader_run(struct draw_vertex_shader *vshader,
 }
 
 
+/**
+ * Run the vertex shader of a queued chunk on the given interpreter.
+ * Called on any thread.
+ */
 static void
-fetch_pipeline_generic(struct draw_pt_middle_end *middle,
-                       const struct draw_fetch_info *fetch_info,
-                       const struct draw_prim_info *in_prim_info)
+fetch_pipeline_shade_job(struct pt_job *job,
+                         struct tgsi_exec_machine *machine)
+{
+   struct fetch_pipeline_middle_end *fpme = fetch_pipeline_middle_end(job->middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+   struct vertex_header *fetched = job->vert_info.verts;
+
+   job->vert_info.verts =
+      (struct vertex_header *)MALLOC(job->vert_info.vertex_size *
+                                     align(job->vert_info.count, 4));
+   if (job->vert_info.verts) {
+      vshader->run_linear_machine(vshader, machine,
+                                  (const float (*)[4])fetched->data,
+                                  (      float (*)[4])job->vert_info.verts->data,
+                                  draw->pt.user.vs_constants,
+                                  draw->pt.user.vs_constants_size,
+                                  job->vert_info.count,
+                                  job->vert_info.vertex_size,
+                                  job->vert_info.vertex_size,
+                                  job->instance_id);
+   }
+
+   FREE(fetched);
+}
+
+
+/**
+ * Run everything after the vertex shader: geometry shader or primitive
+ * assembly, stream output, clipping and the pipeline or emit.
+ * Consumes vert_info->verts.
+ */
+static void
+fetch_pipeline_process(struct fetch_pipeline_middle_end *fpme,
+                       struct draw_vertex_info *vert_info,
+                       const struct draw_prim_info *prim_info)
 {
-   struct fetch_pipeline_middle_end *fpme = fetch_pipeline_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info fetched_vert_info;
-   struct draw_vertex_info vs_vert_info;
    struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
    struct draw_prim_info ia_prim_info;
    struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
    boolean free_prim_info = FALSE;
    unsigned opt = fpme->opt;
 
-   fetched_vert_info.count = fetch_info->count;
-   fetched_vert_info.vertex_size = fpme->vertex_size;
-   fetched_vert_info.stride = fpme->vertex_size;
-   fetched_vert_info.verts =
-      (struct vertex_header *)MALLOC(fpme->vertex_size *
-                                     align(fetch_info->count,  4));
-   if (!fetched_vert_info.verts) {
-      assert(0);
-      return;
-   }
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
-   /* Fetch into our vertex buffer.
-    */
-   fetch( fpme->fetch, fetch_info, (char *)fetched_vert_info.verts );
-
-   /* Finished with fetch:
-    */
-   fetch_info = NULL;
-   vert_info = &fetched_vert_info;
-
-   /* Run the shader, note that this overwrites the data[] parts of
-    * the pipeline verts.
-    */
-   if (fpme->opt & PT_SHADE) {
-      draw_vertex_shader_run(vshader,
-                             draw->pt.user.vs_constants,
-                             draw->pt.user.vs_constants_size,
-                             vert_info,
-                             &vs_vert_info);
-
-      FREE(vert_info->verts);
-      vert_info = &vs_vert_info;
-   }
-
    if ((fpme->opt & PT_SHADE) && gshader) {
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
@@ -359,6 +351,120 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+fetch_pipeline_finish_job(struct pt_job *job)
+{
+   struct fetch_pipeline_middle_end *fpme = fetch_pipeline_middle_end(job->middle);
+
+   if (!job->vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   fetch_pipeline_process(fpme, &job->vert_info, &job->prim_info);
+}
+
+
+/**
+ * Whether to queue a chunk for the vertex shading threads.  Shaders
+ * which sample textures aren't, as the tgsi samplers aren't thread-safe.
+ */
+static boolean
+fetch_pipeline_use_threads(const struct fetch_pipeline_middle_end *fpme,
+                           unsigned count)
+{
+   const struct draw_context *draw = fpme->draw;
+   const struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+
+   return draw->pt.num_threads &&
+          (fpme->opt & PT_SHADE) &&
+          count >= DRAW_PT_THREADS_MIN_VERTICES &&
+          vshader->run_linear_machine &&
+          vshader->info.file_max[TGSI_FILE_SAMPLER] < 0 &&
+          vshader->info.file_max[TGSI_FILE_SAMPLER_VIEW] < 0;
+}
+
+
+static void
+fetch_pipeline_generic(struct draw_pt_middle_end *middle,
+                       const struct draw_fetch_info *fetch_info,
+                       const struct draw_prim_info *prim_info)
+{
+   struct fetch_pipeline_middle_end *fpme = fetch_pipeline_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+   struct draw_vertex_info fetched_vert_info;
+   struct draw_vertex_info vs_vert_info;
+   struct draw_vertex_info *vert_info;
+   struct pt_job *job = NULL;
+
+   if (fetch_pipeline_use_threads(fpme, fetch_info->count)) {
+      struct pt_threads *threads = draw_pt_threads_get(draw, TRUE);
+
+      if (threads)
+         job = draw_pt_threads_alloc_job(threads, middle,
+                                         fetch_info, prim_info);
+   }
+   if (!job && draw->pt.threads) {
+      /* keep the chunks in order */
+      draw_pt_threads_flush(draw->pt.threads);
+   }
+
+   fetched_vert_info.count = fetch_info->count;
+   fetched_vert_info.vertex_size = fpme->vertex_size;
+   fetched_vert_info.stride = fpme->vertex_size;
+   fetched_vert_info.verts =
+      (struct vertex_header *)MALLOC(fpme->vertex_size *
+                                     align(fetch_info->count,  4));
+   if (!fetched_vert_info.verts) {
+      assert(0);
+      return;
+   }
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   /* Fetch into our vertex buffer.
+    */
+   fetch( fpme->fetch, fetch_info, (char *)fetched_vert_info.verts );
+
+   /* Finished with fetch:
+    */
+   fetch_info = NULL;
+   vert_info = &fetched_vert_info;
+
+   if (job) {
+      /* Shade on whichever thread gets to it first, and do the rest
+       * when the job's turn comes.
+       */
+      job->vert_info = fetched_vert_info;
+      job->shade = fetch_pipeline_shade_job;
+      job->finish = fetch_pipeline_finish_job;
+      draw_pt_threads_submit(draw->pt.threads, job);
+      return;
+   }
+
+   /* Run the shader, note that this overwrites the data[] parts of
+    * the pipeline verts.
+    */
+   if (fpme->opt & PT_SHADE) {
+      draw_vertex_shader_run(vshader,
+                             draw->pt.user.vs_constants,
+                             draw->pt.user.vs_constants_size,
+                             vert_info,
+                             &vs_vert_info);
+
+      FREE(vert_info->verts);
+      vert_info = &vs_vert_info;
+   }
+
+   fetch_pipeline_process(fpme, vert_info, prim_info);
+}
+
+
 static void
 fetch_pipeline_run(struct draw_pt_middle_end *middle,
                    const unsigned *fetch_elts,
@@ -341,69 +341,77 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Fetch and shade vertices with the generated code.
+ * \return non-zero if any vertex was clipped
+ */
+static unsigned
+llvm_pipeline_shade(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    struct vertex_header *verts,
+                    unsigned instance_id)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   unsigned clipped = 0;
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
 
    if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
+      return fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       verts,
                                        draw->pt.user.vbuffer,
                                        fetch_info->start,
                                        fetch_info->count,
                                        fpme->vertex_size,
                                        draw->pt.vertex_buffer,
-                                       draw->instance_id,
+                                       instance_id,
                                        draw->start_index);
    else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
+      return fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            verts,
                                             draw->pt.user.vbuffer,
                                             fetch_info->elts,
                                             draw->pt.user.eltMax,
                                             fetch_info->count,
                                             fpme->vertex_size,
                                             draw->pt.vertex_buffer,
-                                            draw->instance_id,
+                                            instance_id,
                                             draw->pt.user.eltBias);
+}
 
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+
+/**
+ * Shade a queued chunk.  Called on any thread; the generated code only
+ * reads the jit context and vertex buffers.
+ */
+static void
+llvm_pipeline_shade_job(struct pt_job *job,
+                        struct tgsi_exec_machine *machine)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(job->middle);
+
+   job->clipped = llvm_pipeline_shade(fpme, &job->fetch_info,
+                                      job->vert_info.verts,
+                                      job->instance_id);
+}
+
+
+/**
+ * Run everything after the vertex shader: geometry shader or primitive
+ * assembly, stream output, clipping and the pipeline or emit.
+ * Consumes vert_info->verts.
+ */
+static void
+llvm_pipeline_process(struct llvm_middle_end *fpme,
+                      struct draw_vertex_info *vert_info,
+                      const struct draw_prim_info *prim_info,
+                      unsigned clipped)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_prim_info gs_prim_info;
+   struct draw_vertex_info gs_vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -475,6 +483,74 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_pipeline_finish_job(struct pt_job *job)
+{
+   llvm_pipeline_process(llvm_middle_end(job->middle), &job->vert_info,
+                         &job->prim_info, job->clipped);
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_info llvm_vert_info;
+   struct pt_job *job = NULL;
+   unsigned clipped;
+
+   if (draw->pt.num_threads &&
+       fetch_info->count >= DRAW_PT_THREADS_MIN_VERTICES) {
+      struct pt_threads *threads = draw_pt_threads_get(draw, FALSE);
+
+      if (threads)
+         job = draw_pt_threads_alloc_job(threads, middle,
+                                         fetch_info, prim_info);
+   }
+   if (!job && draw->pt.threads) {
+      /* keep the chunks in order */
+      draw_pt_threads_flush(draw->pt.threads);
+   }
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+   llvm_vert_info.verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(fetch_info->count, lp_native_vector_width / 32));
+   if (!llvm_vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   if (job) {
+      /* Fetch and shade on whichever thread gets to it first, and do
+       * the rest when the job's turn comes.
+       */
+      job->vert_info = llvm_vert_info;
+      job->shade = llvm_pipeline_shade_job;
+      job->finish = llvm_pipeline_finish_job;
+      draw_pt_threads_submit(draw->pt.threads, job);
+      return;
+   }
+
+   clipped = llvm_pipeline_shade(fpme, fetch_info, llvm_vert_info.verts,
+                                 draw->instance_id);
+
+   llvm_pipeline_process(fpme, &llvm_vert_info, prim_info, clipped);
+}
+
+
 static void
 llvm_middle_end_run(struct draw_pt_middle_end *middle,
                     const unsigned *fetch_elts,
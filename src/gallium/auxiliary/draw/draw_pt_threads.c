@@ -0,0 +1,417 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Threaded vertex shading (DRAW_NUM_THREADS).
+ *
+ * Middle ends split each vsplit chunk of a draw into a shade step, which
+ * fetches and shades the chunk's vertices and only reads draw state, and
+ * a finish step which runs the geometry shader, stream output, clipping
+ * and the pipeline or emit.  Chunks are queued in a small ring; worker
+ * threads pick up the shade steps in order while the drawing thread keeps
+ * splitting, and the drawing thread runs the finish steps strictly in
+ * queue order, so the backend (lp_setup_vbuf, sp_prim_vbuf, ...) sees the
+ * primitives in the same order as without threads.
+ *
+ * The queue is drained at the end of every draw_pt_arrays() call, so jobs
+ * never outlive the user buffers or state of the draw that queued them.
+ *
+ * The threads are only started by the first chunk which can use them, and
+ * their interpreters by the first one shaded by the interpreter, so that
+ * contexts which never draw large enough chunks don't pay for them.
+ */
+
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "os/os_thread.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "draw/draw_private.h"
+#include "draw/draw_vs.h"
+
+
+enum pt_job_state {
+   PT_JOB_QUEUED,
+   PT_JOB_SHADING,
+   PT_JOB_SHADED
+};
+
+
+struct pt_thread {
+   struct pt_threads *threads;
+   pipe_thread thread;
+
+   /** Interpreter for exec vertex shaders, NULL until needed */
+   struct tgsi_exec_machine *machine;
+};
+
+
+struct pt_threads {
+   struct draw_context *draw;
+
+   unsigned num_threads;
+   struct pt_thread thread[DRAW_MAX_THREADS];
+   boolean have_machines;
+
+   /** Ring of jobs; head <= next_shade <= tail */
+   struct pt_job *jobs;
+   unsigned num_jobs;
+   unsigned head;         /**< oldest job not finished yet */
+   unsigned next_shade;   /**< oldest job no thread has picked up */
+   unsigned tail;         /**< next job to queue */
+
+   pipe_mutex mutex;
+   pipe_condvar work_cond;   /**< a job was queued, or exit_flag set */
+   pipe_condvar done_cond;   /**< a job was shaded */
+   boolean exit_flag;
+};
+
+
+static PIPE_THREAD_ROUTINE( pt_thread_function, init_data )
+{
+   struct pt_thread *thread = (struct pt_thread *) init_data;
+   struct pt_threads *threads = thread->threads;
+
+   /* as draw_vbo() does for the drawing thread */
+   util_fpstate_set_denorms_to_zero(util_fpstate_get());
+
+   pipe_mutex_lock(threads->mutex);
+
+   while (1) {
+      struct tgsi_exec_machine *machine;
+      struct pt_job *job;
+
+      while (!threads->exit_flag && threads->next_shade == threads->tail)
+         pipe_condvar_wait(threads->work_cond, threads->mutex);
+
+      if (threads->exit_flag)
+         break;
+
+      job = &threads->jobs[threads->next_shade++ % threads->num_jobs];
+      job->state = PT_JOB_SHADING;
+      machine = thread->machine;
+      pipe_mutex_unlock(threads->mutex);
+
+      job->shade(job, machine);
+
+      pipe_mutex_lock(threads->mutex);
+      job->state = PT_JOB_SHADED;
+      pipe_condvar_broadcast(threads->done_cond);
+   }
+
+   pipe_mutex_unlock(threads->mutex);
+
+   return 0;
+}
+
+
+/**
+ * Wait for the oldest job to be shaded, shading it on this thread if no
+ * worker has picked it up yet, and finish it.
+ */
+static void
+finish_oldest_job(struct pt_threads *threads)
+{
+   struct pt_job *job = &threads->jobs[threads->head % threads->num_jobs];
+
+   pipe_mutex_lock(threads->mutex);
+   if (threads->next_shade == threads->head) {
+      threads->next_shade++;
+      job->state = PT_JOB_SHADING;
+      pipe_mutex_unlock(threads->mutex);
+
+      job->shade(job, threads->draw->vs.tgsi.machine);
+   }
+   else {
+      while (job->state != PT_JOB_SHADED)
+         pipe_condvar_wait(threads->done_cond, threads->mutex);
+      pipe_mutex_unlock(threads->mutex);
+   }
+
+   job->finish(job);
+   threads->head++;
+}
+
+
+/**
+ * Get a job slot for a chunk, finishing the oldest job if the ring is
+ * full.  The element lists are copied, as the front end reuses its buffers
+ * for the next chunk.
+ * \return NULL if out of memory
+ */
+struct pt_job *
+draw_pt_threads_alloc_job(struct pt_threads *threads,
+                          struct draw_pt_middle_end *middle,
+                          const struct draw_fetch_info *fetch_info,
+                          const struct draw_prim_info *prim_info)
+{
+   struct pt_job *job;
+
+   assert(prim_info->primitive_count == 1);
+
+   if (threads->tail - threads->head == threads->num_jobs)
+      finish_oldest_job(threads);
+
+   job = &threads->jobs[threads->tail % threads->num_jobs];
+
+   if (!fetch_info->linear && fetch_info->count > job->max_fetch_elts) {
+      FREE(job->fetch_elts);
+      job->fetch_elts = MALLOC(fetch_info->count * sizeof(unsigned));
+      job->max_fetch_elts = job->fetch_elts ? fetch_info->count : 0;
+      if (!job->fetch_elts)
+         return NULL;
+   }
+
+   if (!prim_info->linear && prim_info->count > job->max_draw_elts) {
+      FREE(job->draw_elts);
+      job->draw_elts = MALLOC(prim_info->count * sizeof(ushort));
+      job->max_draw_elts = job->draw_elts ? prim_info->count : 0;
+      if (!job->draw_elts)
+         return NULL;
+   }
+
+   job->middle = middle;
+   job->fetch_info = *fetch_info;
+   job->prim_info = *prim_info;
+   job->instance_id = threads->draw->instance_id;
+   job->clipped = 0;
+   memset(&job->vert_info, 0, sizeof(job->vert_info));
+
+   if (!fetch_info->linear) {
+      memcpy(job->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      job->fetch_info.elts = job->fetch_elts;
+   }
+
+   if (!prim_info->linear) {
+      memcpy(job->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+      job->prim_info.elts = job->draw_elts;
+   }
+
+   job->prim_info.primitive_lengths = &job->prim_info.count;
+
+   return job;
+}
+
+
+/**
+ * Queue a job returned by draw_pt_threads_alloc_job() once the middle end
+ * has filled in its callbacks and data.
+ */
+void
+draw_pt_threads_submit(struct pt_threads *threads, struct pt_job *job)
+{
+   assert(job == &threads->jobs[threads->tail % threads->num_jobs]);
+
+   pipe_mutex_lock(threads->mutex);
+   job->state = PT_JOB_QUEUED;
+   threads->tail++;
+   pipe_condvar_signal(threads->work_cond);
+   pipe_mutex_unlock(threads->mutex);
+}
+
+
+/**
+ * Finish all queued jobs, in order.
+ */
+void
+draw_pt_threads_flush(struct pt_threads *threads)
+{
+   while (threads->head != threads->tail)
+      finish_oldest_job(threads);
+}
+
+
+/**
+ * Forget a vertex shader about to be deleted, so a new shader allocated at
+ * the same address is bound to the thread machines again.
+ */
+void
+draw_pt_threads_release_shader(struct pt_threads *threads,
+                               const struct tgsi_token *tokens)
+{
+   unsigned i;
+
+   draw_pt_threads_flush(threads);
+
+   pipe_mutex_lock(threads->mutex);
+   for (i = 0; i < threads->num_threads; i++) {
+      struct tgsi_exec_machine *machine = threads->thread[i].machine;
+
+      if (machine && machine->Tokens == tokens)
+         machine->Tokens = NULL;
+   }
+   pipe_mutex_unlock(threads->mutex);
+}
+
+
+struct pt_threads *
+draw_pt_threads_create(struct draw_context *draw, unsigned num_threads)
+{
+   struct pt_threads *threads;
+   unsigned i;
+
+   assert(num_threads > 0 && num_threads <= DRAW_MAX_THREADS);
+
+   threads = CALLOC_STRUCT(pt_threads);
+   if (!threads)
+      return NULL;
+
+   threads->draw = draw;
+
+   /* enough to keep every thread busy while the drawing thread finishes
+    * the oldest job
+    */
+   threads->num_jobs = 2 * (num_threads + 1);
+   threads->jobs = CALLOC(threads->num_jobs, sizeof(struct pt_job));
+   if (!threads->jobs) {
+      FREE(threads);
+      return NULL;
+   }
+
+   pipe_mutex_init(threads->mutex);
+   pipe_condvar_init(threads->work_cond);
+   pipe_condvar_init(threads->done_cond);
+
+   for (i = 0; i < num_threads; i++) {
+      struct pt_thread *thread = &threads->thread[i];
+
+      thread->threads = threads;
+      thread->thread = pipe_thread_create(pt_thread_function, thread);
+      if (!thread->thread)
+         break;
+   }
+   threads->num_threads = i;
+
+   if (!threads->num_threads) {
+      draw_pt_threads_destroy(threads);
+      return NULL;
+   }
+
+   return threads;
+}
+
+
+void
+draw_pt_threads_destroy(struct pt_threads *threads)
+{
+   unsigned i;
+
+   draw_pt_threads_flush(threads);
+
+   pipe_mutex_lock(threads->mutex);
+   threads->exit_flag = TRUE;
+   pipe_condvar_broadcast(threads->work_cond);
+   pipe_mutex_unlock(threads->mutex);
+
+   for (i = 0; i < threads->num_threads; i++) {
+      pipe_thread_wait(threads->thread[i].thread);
+      if (threads->thread[i].machine)
+         tgsi_exec_machine_destroy(threads->thread[i].machine);
+   }
+
+   for (i = 0; i < threads->num_jobs; i++) {
+      FREE(threads->jobs[i].fetch_elts);
+      FREE(threads->jobs[i].draw_elts);
+   }
+
+   pipe_condvar_destroy(threads->work_cond);
+   pipe_condvar_destroy(threads->done_cond);
+   pipe_mutex_destroy(threads->mutex);
+
+   FREE(threads->jobs);
+   FREE(threads);
+}
+
+
+/**
+ * Number of worker threads to create for a new draw context: one less
+ * than the number of CPUs, as the drawing thread shades too, unless
+ * overridden with DRAW_NUM_THREADS.
+ */
+unsigned
+draw_pt_threads_default_count(void)
+{
+   util_cpu_detect();
+
+   return debug_get_num_option("DRAW_NUM_THREADS",
+                               MIN2(util_cpu_caps.nr_cpus - 1,
+                                    DRAW_MAX_THREADS));
+}
+
+
+/**
+ * Get the vertex shading threads of \p draw for a chunk which can use
+ * them, creating them on first use.
+ *
+ * \param exec  whether the chunk is shaded by the TGSI interpreter, which
+ *              needs an interpreter per thread
+ * \return NULL if there are no threads to use
+ */
+struct pt_threads *
+draw_pt_threads_get(struct draw_context *draw, boolean exec)
+{
+   struct pt_threads *threads = draw->pt.threads;
+   unsigned i;
+
+   if (!threads) {
+      if (!draw->pt.num_threads)
+         return NULL;
+
+      threads = draw_pt_threads_create(draw, draw->pt.num_threads);
+      if (!threads) {
+         /* don't try again for every chunk */
+         draw->pt.num_threads = 0;
+         return NULL;
+      }
+
+      draw->pt.threads = threads;
+   }
+
+   if (exec && !threads->have_machines) {
+      /* The workers only read their machine when picking up a job. */
+      pipe_mutex_lock(threads->mutex);
+      for (i = 0; i < threads->num_threads; i++) {
+         struct pt_thread *thread = &threads->thread[i];
+
+         if (!thread->machine) {
+            thread->machine = tgsi_exec_machine_create();
+            if (!thread->machine)
+               break;
+
+            tgsi_exec_machine_set_lanes(thread->machine, MAX_TGSI_VERTICES);
+         }
+      }
+      threads->have_machines = i == threads->num_threads;
+      pipe_mutex_unlock(threads->mutex);
+
+      if (!threads->have_machines)
+         return NULL;
+   }
+
+   return threads;
+}
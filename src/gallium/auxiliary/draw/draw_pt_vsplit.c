@@ -31,7 +31,14 @@
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/* Default vertex cache geometry (DRAW_VERTEX_CACHE_SIZE/WAYS).  Twice the
+ * segment size, so that every vertex of a segment normally stays cached
+ * until the segment is flushed.
+ */
+#define CACHE_SIZE     2048
+#define CACHE_WAYS     4
+#define CACHE_MAX_WAYS 16
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
@@ -52,11 +59,19 @@ struct vsplit_frontend {
    ushort draw_elts[SEGMENT_SIZE];
    ushort identity_draw_elts[SEGMENT_SIZE];
 
+   /**
+    * Set-associative cache mapping fetch elements to draw elements.  Each
+    * set of ways entries holds draw elements, i.e. indices into
+    * fetch_elts, of fetch elements hashing to the set, and is replaced in
+    * FIFO order.  An entry is only valid if it points into the current
+    * segment at the same fetch element, so nothing needs to be cleared
+    * between segments.
+    */
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      ushort *draws;
+      ubyte *next_way;
+      unsigned set_mask;
+      unsigned ways;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -67,8 +82,6 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -76,6 +89,12 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_context *draw = vsplit->draw;
+
+   draw->vcache_stats.misses += vsplit->cache.num_fetch_elts;
+   draw->vcache_stats.hits +=
+      vsplit->cache.num_draw_elts - vsplit->cache.num_fetch_elts;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -87,23 +106,33 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 static INLINE void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
+   const unsigned ways = vsplit->cache.ways;
+   const unsigned set = fetch & vsplit->cache.set_mask;
+   ushort *draws = &vsplit->cache.draws[set * ways];
+   unsigned i, draw;
+
+   /* Overflows due to the element bias are always fetched again */
+   if (!ofbias) {
+      for (i = 0; i < ways; i++) {
+         draw = draws[i];
+         if (draw < vsplit->cache.num_fetch_elts &&
+             vsplit->fetch_elts[draw] == fetch) {
+            vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
+            return;
+         }
+      }
+   }
 
-   /* If the value isn't in the cache of it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+   /* add fetch, replacing the oldest entry of the set */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   draw = vsplit->cache.num_fetch_elts++;
+   vsplit->fetch_elts[draw] = fetch;
 
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
-   }
+   i = vsplit->cache.next_way[set];
+   draws[i] = draw;
+   vsplit->cache.next_way[set] = (i + 1) & (ways - 1);
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
 }
 
 /**
@@ -198,16 +227,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
                       unsigned start, unsigned fetch, int elt_bias)
 {
    struct draw_context *draw = vsplit->draw;
-   unsigned raw_elem_idx = start + fetch + elt_bias;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-
-   /* special care for DRAW_MAX_FETCH_IDX */
-   if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
    vsplit_add_cache(vsplit, elt_idx, ofbias);
 }
 
@@ -279,6 +299,10 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   FREE(vsplit->cache.draws);
+   FREE(vsplit->cache.next_way);
    FREE(frontend);
 }
 
@@ -286,11 +310,27 @@ static void vsplit_destroy(struct draw_pt_front_end *frontend)
 struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
 {
    struct vsplit_frontend *vsplit = CALLOC_STRUCT(vsplit_frontend);
+   unsigned size, ways;
    ushort i;
 
    if (!vsplit)
       return NULL;
 
+   /* both powers of two, and at least one set */
+   ways = debug_get_num_option("DRAW_VERTEX_CACHE_WAYS", CACHE_WAYS);
+   ways = util_next_power_of_two(CLAMP(ways, 1, CACHE_MAX_WAYS));
+   size = debug_get_num_option("DRAW_VERTEX_CACHE_SIZE", CACHE_SIZE);
+   size = util_next_power_of_two(CLAMP(size, ways, 64 * 1024));
+
+   vsplit->cache.ways = ways;
+   vsplit->cache.set_mask = size / ways - 1;
+   vsplit->cache.draws = CALLOC(size, sizeof(ushort));
+   vsplit->cache.next_way = CALLOC(size / ways, sizeof(ubyte));
+   if (!vsplit->cache.draws || !vsplit->cache.next_way) {
+      vsplit_destroy(&vsplit->base);
+      return NULL;
+   }
+
    vsplit->base.prepare = vsplit_prepare;
    vsplit->base.run     = NULL;
    vsplit->base.flush   = vsplit_flush;
@@ -139,6 +139,9 @@ draw_delete_vertex_shader(struct draw_context *draw,
 
    dvs->nr_variants = 0;
 
+   if (draw->pt.threads)
+      draw_pt_threads_release_shader(draw->pt.threads, dvs->state.tokens);
+
    dvs->delete( dvs );
 }
 
@@ -153,6 +156,8 @@ draw_vs_init( struct draw_context *draw )
    if (!draw->vs.tgsi.machine)
       return FALSE;
 
+   tgsi_exec_machine_set_lanes(draw->vs.tgsi.machine, MAX_TGSI_VERTICES);
+
    draw->vs.emit_cache = translate_cache_create();
    if (!draw->vs.emit_cache) 
       return FALSE;
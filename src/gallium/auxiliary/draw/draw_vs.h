@@ -142,6 +142,22 @@ struct draw_vertex_shader {
 		       unsigned input_stride,
 		       unsigned output_stride );
 
+   /**
+    * As run_linear, but on the given interpreter and without touching any
+    * other shader or draw state, so it may be called from the vertex
+    * shading threads.  NULL for shaders which can't be run that way.
+    */
+   void (*run_linear_machine)( struct draw_vertex_shader *shader,
+                               struct tgsi_exec_machine *machine,
+                               const float (*input)[4],
+                               float (*output)[4],
+                               const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
+                               const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
+                               unsigned count,
+                               unsigned input_stride,
+                               unsigned output_stride,
+                               unsigned instance_id );
+
 
    void (*delete)( struct draw_vertex_shader * );
 };
@@ -203,7 +219,8 @@ static INLINE int draw_vs_variant_key_compare( const struct draw_vs_variant_key
 }
 
 
-#define MAX_TGSI_VERTICES 4
+/** Number of vertices the TGSI interpreter shades at once */
+#define MAX_TGSI_VERTICES TGSI_EXEC_MAX_LANES
    
 
 
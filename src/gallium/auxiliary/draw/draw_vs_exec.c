@@ -81,29 +81,36 @@ vs_exec_prepare( struct draw_vertex_shader *shader,
  * it's time to try doing all the other stuff separately.
  */
 static void
-vs_exec_run_linear( struct draw_vertex_shader *shader,
-		    const float (*input)[4],
-		    float (*output)[4],
-                    const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
-                    const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
-		    unsigned count,
-		    unsigned input_stride,
-		    unsigned output_stride )
+vs_exec_run_linear_machine( struct draw_vertex_shader *shader,
+                            struct tgsi_exec_machine *machine,
+                            const float (*input)[4],
+                            float (*output)[4],
+                            const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
+                            const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
+                            unsigned count,
+                            unsigned input_stride,
+                            unsigned output_stride,
+                            unsigned instance_id )
 {
-   struct exec_vertex_shader *evs = exec_vertex_shader(shader);
-   struct tgsi_exec_machine *machine = evs->machine;
    unsigned int i, j;
    unsigned slot;
    boolean clamp_vertex_color = shader->draw->rasterizer->clamp_vertex_color;
 
+   /* Thread machines are bound here; shaders using samplers are never
+    * run on them (see the middle ends), so no sampler is needed.
+    */
+   if (machine->Tokens != shader->state.tokens) {
+      tgsi_exec_machine_bind_shader(machine, shader->state.tokens, NULL);
+   }
+
    tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
                                   constants, const_size);
 
    if (shader->info.uses_instanceid) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_INSTANCEID];
       assert(i < Elements(machine->SystemValue));
-      for (j = 0; j < TGSI_QUAD_SIZE; j++)
-         machine->SystemValue[i].i[j] = shader->draw->instance_id;
+      for (j = 0; j < MAX_TGSI_VERTICES; j++)
+         machine->SystemValue[i].i[j] = instance_id;
    }
 
    for (i = 0; i < count; i += MAX_TGSI_VERTICES) {
@@ -145,11 +152,7 @@ vs_exec_run_linear( struct draw_vertex_shader *shader,
 	 input = (const float (*)[4])((const char *)input + input_stride);
       } 
 
-      tgsi_set_exec_mask(machine,
-                         1,
-                         max_vertices > 1,
-                         max_vertices > 2,
-                         max_vertices > 3);
+      tgsi_set_exec_lanes_mask(machine, (1 << max_vertices) - 1);
 
       /* run interpreter */
       tgsi_exec_machine_run( machine );
@@ -195,6 +198,25 @@ vs_exec_run_linear( struct draw_vertex_shader *shader,
 }
 
 
+static void
+vs_exec_run_linear( struct draw_vertex_shader *shader,
+		    const float (*input)[4],
+		    float (*output)[4],
+                    const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
+                    const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
+		    unsigned count,
+		    unsigned input_stride,
+		    unsigned output_stride )
+{
+   struct exec_vertex_shader *evs = exec_vertex_shader(shader);
+
+   vs_exec_run_linear_machine(shader, evs->machine, input, output,
+                              constants, const_size, count,
+                              input_stride, output_stride,
+                              shader->draw->instance_id);
+}
+
+
 
 
 static void
@@ -227,6 +249,7 @@ draw_create_vs_exec(struct draw_context *draw,
    vs->base.draw = draw;
    vs->base.prepare = vs_exec_prepare;
    vs->base.run_linear = vs_exec_run_linear;
+   vs->base.run_linear_machine = vs_exec_run_linear_machine;
    vs->base.delete = vs_exec_delete;
    vs->base.create_variant = draw_vs_create_variant_generic;
    vs->machine = draw->vs.tgsi.machine;
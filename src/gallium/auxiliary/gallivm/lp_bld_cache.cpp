@@ -0,0 +1,359 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS
+#endif
+
+// Undef these vars just to silence warnings
+#undef PACKAGE_BUGREPORT
+#undef PACKAGE_NAME
+#undef PACKAGE_STRING
+#undef PACKAGE_TARNAME
+#undef PACKAGE_VERSION
+
+
+#include <stddef.h>
+
+#include "pipe/p_config.h"
+
+#if HAVE_LLVM >= 0x0303 && defined(PIPE_OS_UNIX)
+#define LP_OBJECT_CACHE 1
+#endif
+
+#ifdef LP_OBJECT_CACHE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#endif
+
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_hash.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+
+#include "lp_bld_cache.h"
+
+
+/**
+ * Bump this whenever the code generated for the same IR changes, e.g. when
+ * the target options in lp_build_create_jit_compiler_for_module() do.
+ */
+#define LP_OBJECT_CACHE_VERSION 1
+
+#define LP_OBJECT_CACHE_MAGIC "GLVMOBJ"
+
+
+static const char *cache_dir = NULL;
+
+
+#ifdef LP_OBJECT_CACHE
+
+struct lp_object_cache_header
+{
+   char magic[8];
+   uint32_t size;
+   uint32_t crc32;
+};
+
+
+struct lp_object_cache : public llvm::ObjectCache
+{
+   std::string path;
+
+   /** Object read from the disk, handed over to MC-JIT */
+   llvm::MemoryBuffer *object;
+
+   lp_object_cache() : object(NULL) {}
+
+   ~lp_object_cache() {
+      delete object;
+   }
+
+   virtual void
+   notifyObjectCompiled(const llvm::Module *M, const llvm::MemoryBuffer *Obj);
+
+   virtual llvm::MemoryBuffer *
+   getObject(const llvm::Module *M) {
+      llvm::MemoryBuffer *obj = object;
+      (void) M;
+      object = NULL;
+      return obj;
+   }
+};
+
+
+static uint64_t
+fnv1a_64(const char *data, size_t size)
+{
+   uint64_t hash = 0xcbf29ce484222325ULL;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= (unsigned char) data[i];
+      hash *= 0x100000001b3ULL;
+   }
+
+   return hash;
+}
+
+
+static boolean
+read_all(int fd, void *data, size_t size)
+{
+   char *p = (char *) data;
+
+   while (size) {
+      ssize_t ret = read(fd, p, size);
+      if (ret <= 0) {
+         if (ret < 0 && errno == EINTR)
+            continue;
+         return FALSE;
+      }
+      p += ret;
+      size -= ret;
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+write_all(int fd, const void *data, size_t size)
+{
+   const char *p = (const char *) data;
+
+   while (size) {
+      ssize_t ret = write(fd, p, size);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return FALSE;
+      }
+      p += ret;
+      size -= ret;
+   }
+
+   return TRUE;
+}
+
+
+static llvm::MemoryBuffer *
+read_object(const char *path)
+{
+   struct lp_object_cache_header header;
+   llvm::MemoryBuffer *object;
+   int fd;
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   if (!read_all(fd, &header, sizeof header) ||
+       memcmp(header.magic, LP_OBJECT_CACHE_MAGIC, sizeof header.magic) != 0) {
+      close(fd);
+      return NULL;
+   }
+
+   object = llvm::MemoryBuffer::getNewUninitMemBuffer(header.size, path);
+   if (!object) {
+      close(fd);
+      return NULL;
+   }
+
+   if (!read_all(fd, const_cast<char *>(object->getBufferStart()),
+                 header.size) ||
+       util_hash_crc32(object->getBufferStart(), header.size) !=
+       header.crc32) {
+      delete object;
+      object = NULL;
+   }
+
+   close(fd);
+
+   return object;
+}
+
+
+/**
+ * Write the object to a temporary file first, so that other processes
+ * never see a partial entry.
+ */
+void
+lp_object_cache::notifyObjectCompiled(const llvm::Module *M,
+                                      const llvm::MemoryBuffer *Obj)
+{
+   struct lp_object_cache_header header;
+   char tmp_path[4096];
+   boolean ok;
+   int fd;
+
+   (void) M;
+
+   util_snprintf(tmp_path, sizeof tmp_path, "%s.%d.tmp",
+                 path.c_str(), (int) getpid());
+
+   fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return;
+
+   memset(&header, 0, sizeof header);
+   memcpy(header.magic, LP_OBJECT_CACHE_MAGIC, sizeof header.magic);
+   header.size = Obj->getBufferSize();
+   header.crc32 = util_hash_crc32(Obj->getBufferStart(),
+                                  Obj->getBufferSize());
+
+   ok = write_all(fd, &header, sizeof header) &&
+        write_all(fd, Obj->getBufferStart(), Obj->getBufferSize());
+
+   if (close(fd) != 0)
+      ok = FALSE;
+
+   if (!ok || rename(tmp_path, path.c_str()) != 0)
+      unlink(tmp_path);
+}
+
+#endif /* LP_OBJECT_CACHE */
+
+
+void
+lp_object_cache_init(void)
+{
+#ifdef LP_OBJECT_CACHE
+   cache_dir = debug_get_option("GALLIVM_CACHE_DIR", NULL);
+   if (cache_dir && mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+      debug_printf("gallivm: can't create cache directory %s\n", cache_dir);
+      cache_dir = NULL;
+   }
+#endif
+}
+
+
+boolean
+lp_object_cache_enabled(void)
+{
+   return cache_dir != NULL;
+}
+
+
+struct lp_object_cache *
+lp_object_cache_create(LLVMModuleRef module, boolean no_opt)
+{
+#ifdef LP_OBJECT_CACHE
+   using namespace llvm;
+
+   struct util_cpu_caps caps = util_cpu_caps;
+   struct lp_object_cache *cache;
+   std::string key;
+   char name[64];
+
+   if (!cache_dir)
+      return NULL;
+
+   /* The number of CPUs doesn't affect code generation. */
+   caps.nr_cpus = 0;
+
+   raw_string_ostream os(key);
+   os << "version " << LP_OBJECT_CACHE_VERSION << "\n";
+   os << "llvm " << HAVE_LLVM << "\n";
+#ifdef DEBUG
+   os << "debug\n";
+#endif
+   os << "opt " << (no_opt ? 0 : 1) << "\n";
+   os << "cpu " << sys::getHostCPUName() << "\n";
+   os.write((const char *) &caps, sizeof caps);
+   os << "\n";
+   unwrap(module)->print(os, NULL);
+   os.flush();
+
+   util_snprintf(name, sizeof name, "%016llx%08x.o",
+                 (unsigned long long) fnv1a_64(key.data(), key.size()),
+                 util_hash_crc32(key.data(), key.size()));
+
+   cache = new lp_object_cache;
+   cache->path = std::string(cache_dir) + "/" + name;
+   cache->object = read_object(cache->path.c_str());
+
+   return cache;
+#else
+   (void) module;
+   (void) no_opt;
+   return NULL;
+#endif
+}
+
+
+boolean
+lp_object_cache_has_object(const struct lp_object_cache *cache)
+{
+#ifdef LP_OBJECT_CACHE
+   return cache->object != NULL;
+#else
+   (void) cache;
+   return FALSE;
+#endif
+}
+
+
+void
+lp_object_cache_attach(struct lp_object_cache *cache,
+                       LLVMExecutionEngineRef engine)
+{
+#ifdef LP_OBJECT_CACHE
+   llvm::unwrap(engine)->setObjectCache(cache);
+#else
+   (void) cache;
+   (void) engine;
+#endif
+}
+
+
+void
+lp_object_cache_destroy(struct lp_object_cache *cache)
+{
+#ifdef LP_OBJECT_CACHE
+   delete cache;
+#else
+   (void) cache;
+#endif
+}
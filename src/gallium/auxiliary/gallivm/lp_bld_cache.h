@@ -0,0 +1,97 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * On-disk cache of the machine code MC-JIT generates for gallivm modules.
+ *
+ * Entries are keyed by a hash of the module's IR, which is derived from
+ * the shader variant key, together with the LLVM version, the code
+ * generation options and util_cpu_caps.  The cache is enabled by setting
+ * GALLIVM_CACHE_DIR to a writable directory.
+ *
+ * Only the architectures where gallivm uses MC-JIT (PowerPC 64, s390, ARM
+ * and AArch64) use the cache.  The old JIT used on x86 has no object cache.
+ */
+
+#ifndef LP_BLD_CACHE_H
+#define LP_BLD_CACHE_H
+
+
+#include "lp_bld.h"
+#include <llvm-c/ExecutionEngine.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct lp_object_cache;
+
+
+/**
+ * Read the cache configuration.  Called once by lp_build_init().
+ */
+void
+lp_object_cache_init(void);
+
+boolean
+lp_object_cache_enabled(void);
+
+/**
+ * Look up the code for \p module, which must be complete.  Returns NULL if
+ * the cache is disabled.
+ */
+struct lp_object_cache *
+lp_object_cache_create(LLVMModuleRef module, boolean no_opt);
+
+/**
+ * Whether the code was found, in which case the module doesn't need to be
+ * optimized before it is given to MC-JIT.
+ */
+boolean
+lp_object_cache_has_object(const struct lp_object_cache *cache);
+
+/**
+ * Have \p engine load the cached code, or store the code it generates.
+ * Must be called before any function of the module is compiled.
+ */
+void
+lp_object_cache_attach(struct lp_object_cache *cache,
+                       LLVMExecutionEngineRef engine);
+
+/**
+ * Destroy the cache object, after its execution engine.
+ */
+void
+lp_object_cache_destroy(struct lp_object_cache *cache);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* !LP_BLD_CACHE_H */
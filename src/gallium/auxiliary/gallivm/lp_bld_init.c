@@ -35,6 +35,7 @@
 #include "lp_bld.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
+#include "lp_bld_cache.h"
 #include "lp_bld_init.h"
 
 #include <llvm-c/Analysis.h>
@@ -126,6 +127,21 @@ static struct gallivm_state *GlobalGallivm = NULL;
 #endif
 
 
+/**
+ * Whether MC-JIT output is looked up in the object cache.  If so, the
+ * functions are only optimized when compiling the module misses the cache.
+ */
+static INLINE boolean
+use_object_cache(void)
+{
+#if USE_MCJIT
+   return lp_object_cache_enabled();
+#else
+   return FALSE;
+#endif
+}
+
+
 /**
  * Create the LLVM (optimization) pass manager and install
  * relevant optimization passes.
@@ -143,7 +159,7 @@ create_pass_manager(struct gallivm_state *gallivm)
 
    LLVMAddTargetData(gallivm->target, gallivm->passmgr);
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 && !gallivm->no_opt) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
@@ -219,6 +235,10 @@ free_gallivm_state(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->cache) {
+      lp_object_cache_destroy(gallivm->cache);
+   }
+
 #if !USE_MCJIT
    /* Don't free the TargetData, it's owned by the exec engine */
 #else
@@ -238,6 +258,7 @@ free_gallivm_state(struct gallivm_state *gallivm)
       LLVMDisposeBuilder(gallivm->builder);
 
    gallivm->engine = NULL;
+   gallivm->cache = NULL;
    gallivm->target = NULL;
    gallivm->module = NULL;
    gallivm->provider = NULL;
@@ -256,7 +277,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->no_opt) {
          optlevel = None;
       }
       else {
@@ -331,10 +352,11 @@ static LLVMContextRef gallivm_context = NULL;
 
 /**
  * Allocate gallivm LLVM objects.
+ * \param context  the LLVM context to use, or NULL for the shared one
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
-init_gallivm_state(struct gallivm_state *gallivm)
+init_gallivm_state(struct gallivm_state *gallivm, LLVMContextRef context)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -342,10 +364,13 @@ init_gallivm_state(struct gallivm_state *gallivm)
 
    lp_build_init();
 
-   if (!gallivm_context) {
-      gallivm_context = LLVMContextCreate();
+   if (!context) {
+      if (!gallivm_context) {
+         gallivm_context = LLVMContextCreate();
+      }
+      context = gallivm_context;
    }
-   gallivm->context = gallivm_context;
+   gallivm->context = context;
    if (!gallivm->context)
       goto fail;
 
@@ -504,6 +529,12 @@ lp_build_init(void)
    }
 #endif
 
+   lp_object_cache_init();
+#if !USE_MCJIT
+   if (lp_object_cache_enabled())
+      debug_printf("gallivm: GALLIVM_CACHE_DIR is ignored without MC-JIT\n");
+#endif
+
    gallivm_initialized = TRUE;
 
 #if 0
@@ -517,6 +548,18 @@ lp_build_init(void)
 }
 
 
+/**
+ * Whether several threads may compile gallivm states at once, each state
+ * in an LLVM context of its own.  The old JIT keeps process-wide state
+ * that isn't protected for that, MC-JIT doesn't.
+ */
+boolean
+gallivm_jit_is_thread_safe(void)
+{
+   return USE_MCJIT;
+}
+
+
 
 /**
  * Create a new gallivm_state object.
@@ -535,7 +578,7 @@ gallivm_create(void)
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm)) {
+      if (!init_gallivm_state(gallivm, NULL)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -549,6 +592,40 @@ gallivm_create(void)
 }
 
 
+/**
+ * Create a new gallivm_state object in the given LLVM context, or in the
+ * shared one if \p context is NULL.  The shared context must only be used
+ * by one thread at a time, so a thread compiling code in the background
+ * needs a context of its own.  Like the shared one, such a context must
+ * never be freed.
+ *
+ * With \p no_opt, the code is generated without optimizations, which is
+ * slower to run but much faster to compile.
+ */
+struct gallivm_state *
+gallivm_create_in_context(LLVMContextRef context, boolean no_opt)
+{
+   struct gallivm_state *gallivm;
+
+#if HAVE_LLVM <= 0x206
+   if (!context && !no_opt) {
+      return gallivm_create();
+   }
+#endif
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      gallivm->no_opt = no_opt;
+      if (!init_gallivm_state(gallivm, context)) {
+         FREE(gallivm);
+         gallivm = NULL;
+      }
+   }
+
+   return gallivm;
+}
+
+
 /**
  * Destroy a gallivm_state object.
  */
@@ -607,7 +684,10 @@ gallivm_verify_function(struct gallivm_state *gallivm,
    }
 #endif
 
-   gallivm_optimize_function(gallivm, func);
+   /* With the object cache the whole module is optimized when compiled. */
+   if (!use_object_cache()) {
+      gallivm_optimize_function(gallivm, func);
+   }
 
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       /* Print the LLVM IR to stderr */
@@ -633,9 +713,33 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
 #if USE_MCJIT
    assert(!gallivm->engine);
+
+   if (use_object_cache()) {
+      boolean no_opt = gallivm->no_opt ||
+                       (gallivm_debug & GALLIVM_DEBUG_NO_OPT) != 0;
+
+      gallivm->cache = lp_object_cache_create(gallivm->module, no_opt);
+
+      if (!gallivm->cache || !lp_object_cache_has_object(gallivm->cache)) {
+         LLVMValueRef func;
+
+         for (func = LLVMGetFirstFunction(gallivm->module);
+              func;
+              func = LLVMGetNextFunction(func)) {
+            if (!LLVMIsDeclaration(func)) {
+               gallivm_optimize_function(gallivm, func);
+            }
+         }
+      }
+   }
+
    if (!init_gallivm_engine(gallivm)) {
       assert(0);
    }
+
+   if (gallivm->cache) {
+      lp_object_cache_attach(gallivm->cache, gallivm->engine);
+   }
 #endif
    assert(gallivm->engine);
 
@@ -46,6 +46,8 @@ struct gallivm_state
    LLVMContextRef context;
    LLVMBuilderRef builder;
    unsigned compiled;
+   boolean no_opt;  /**< don't optimize, for faster compilation */
+   struct lp_object_cache *cache;
 };
 
 
@@ -53,9 +55,16 @@ void
 lp_build_init(void);
 
 
+boolean
+gallivm_jit_is_thread_safe(void);
+
+
 struct gallivm_state *
 gallivm_create(void);
 
+struct gallivm_state *
+gallivm_create_in_context(LLVMContextRef context, boolean no_opt);
+
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
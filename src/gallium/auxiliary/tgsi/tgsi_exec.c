@@ -31,10 +31,10 @@
  *
  * Flow control information:
  *
- * Since we operate on 'quads' (4 pixels or 4 vertices in parallel)
- * flow control statements (IF/ELSE/ENDIF, LOOP/ENDLOOP) require special
- * care since a condition may be true for some quad components but false
- * for other components.
+ * Since we operate on 'quads' (4 pixels or 4 vertices in parallel), or on
+ * 2 or 4 quads at a time (see tgsi_exec_machine_set_lanes()), flow control
+ * statements (IF/ELSE/ENDIF, LOOP/ENDLOOP) require special care since a
+ * condition may be true for some lanes but false for other lanes.
  *
  * We basically execute all statements (even if they're in the part of
  * an IF/ELSE clause that's "not taken") and use a special mask to
@@ -60,6 +60,7 @@
 #include "tgsi_exec.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 
 
 #define DEBUG_EXECUTION 0
@@ -72,128 +73,350 @@
 #define TILE_BOTTOM_LEFT  2
 #define TILE_BOTTOM_RIGHT 3
 
+
+/*
+ * SIMD kernels for the most common ALU micro ops.
+ *
+ * The lane count is always a multiple of TGSI_QUAD_SIZE, so the kernels
+ * process 4 lanes per SSE operation and, when the CPU supports it, 8 lanes
+ * per AVX operation.  Only operations whose results are bit-identical to
+ * the C code are used (no rcp/rsqrt approximations, min/max operand order
+ * matching the C ternaries), so neither the CPU nor the lane count changes
+ * the results of a shader.
+ */
+#if defined(PIPE_ARCH_SSE)
+
+#include <xmmintrin.h>
+
+#define TGSI_EXEC_SSE 1
+
+#if defined(__AVX__) || \
+    (defined(PIPE_CC_GCC) && !defined(__clang__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define TGSI_EXEC_AVX 1
+#include <immintrin.h>
+#define AVX_TARGET __attribute__((target("avx")))
+#else
+#define TGSI_EXEC_AVX 0
+#endif
+
+#if TGSI_EXEC_AVX
+static boolean use_avx = FALSE;
+
+#define SIMD_DISPATCH(NAME, ARGS) \
+   if (use_avx) \
+      avx_##NAME ARGS; \
+   else \
+      sse_##NAME ARGS
+#else
+#define SIMD_DISPATCH(NAME, ARGS) \
+   sse_##NAME ARGS
+#endif
+
+/*
+ * The kernel expressions below operate on a, b and c, which hold 4 (SSE)
+ * or 8 (AVX) lanes of the first, second and third source.
+ */
+#define SSE_KERNEL(NAME, PARAMS, LOAD, SSE_EXPR) \
+static void \
+sse_##NAME PARAMS \
+{ \
+   unsigned i; \
+   for (i = 0; i < n; i += 4) { \
+      const __m128 LOAD(_mm_loadu_ps); \
+      _mm_storeu_ps(dst + i, SSE_EXPR); \
+   } \
+}
+
+#define AVX_KERNEL(NAME, PARAMS, LOAD, SSE_EXPR, AVX_EXPR) \
+static AVX_TARGET void \
+avx_##NAME PARAMS \
+{ \
+   unsigned i; \
+   for (i = 0; i + 8 <= n; i += 8) { \
+      const __m256 LOAD(_mm256_loadu_ps); \
+      _mm256_storeu_ps(dst + i, AVX_EXPR); \
+   } \
+   if (i < n) { \
+      const __m128 LOAD(_mm_loadu_ps); \
+      _mm_storeu_ps(dst + i, SSE_EXPR); \
+   } \
+}
+
+#define UNARY_PARAMS \
+   (float *dst, const float *src0, unsigned n)
+#define UNARY_LOAD(load) \
+   a = load(src0 + i)
+#define BINARY_PARAMS \
+   (float *dst, const float *src0, const float *src1, unsigned n)
+#define BINARY_LOAD(load) \
+   a = load(src0 + i), b = load(src1 + i)
+#define TRINARY_PARAMS \
+   (float *dst, const float *src0, const float *src1, const float *src2, \
+    unsigned n)
+#define TRINARY_LOAD(load) \
+   a = load(src0 + i), b = load(src1 + i), c = load(src2 + i)
+
+#if TGSI_EXEC_AVX
+#define SIMD_KERNEL(NAME, ARITY, SSE_EXPR, AVX_EXPR) \
+   SSE_KERNEL(NAME, ARITY##_PARAMS, ARITY##_LOAD, SSE_EXPR) \
+   AVX_KERNEL(NAME, ARITY##_PARAMS, ARITY##_LOAD, SSE_EXPR, AVX_EXPR)
+#else
+#define SIMD_KERNEL(NAME, ARITY, SSE_EXPR, AVX_EXPR) \
+   SSE_KERNEL(NAME, ARITY##_PARAMS, ARITY##_LOAD, SSE_EXPR)
+#endif
+
+#define SSE_ONE      _mm_set1_ps(1.0f)
+#define SSE_SIGN     _mm_set1_ps(-0.0f)
+#define AVX_ONE      _mm256_set1_ps(1.0f)
+#define AVX_SIGN     _mm256_set1_ps(-0.0f)
+#define AVX_CMP(a, b, pred) _mm256_cmp_ps(a, b, pred)
+
+SIMD_KERNEL(abs, UNARY,
+            _mm_andnot_ps(SSE_SIGN, a),
+            _mm256_andnot_ps(AVX_SIGN, a))
+SIMD_KERNEL(neg, UNARY,
+            _mm_xor_ps(SSE_SIGN, a),
+            _mm256_xor_ps(AVX_SIGN, a))
+SIMD_KERNEL(mov, UNARY,
+            a,
+            a)
+SIMD_KERNEL(rcp, UNARY,
+            _mm_div_ps(SSE_ONE, a),
+            _mm256_div_ps(AVX_ONE, a))
+SIMD_KERNEL(sqrt, UNARY,
+            _mm_sqrt_ps(a),
+            _mm256_sqrt_ps(a))
+SIMD_KERNEL(rsq, UNARY,
+            _mm_div_ps(SSE_ONE, _mm_sqrt_ps(a)),
+            _mm256_div_ps(AVX_ONE, _mm256_sqrt_ps(a)))
+
+SIMD_KERNEL(add, BINARY,
+            _mm_add_ps(a, b),
+            _mm256_add_ps(a, b))
+SIMD_KERNEL(sub, BINARY,
+            _mm_sub_ps(a, b),
+            _mm256_sub_ps(a, b))
+SIMD_KERNEL(mul, BINARY,
+            _mm_mul_ps(a, b),
+            _mm256_mul_ps(a, b))
+/* maxps/minps return b unless a > b (a < b), just like micro_max/min */
+SIMD_KERNEL(max, BINARY,
+            _mm_max_ps(a, b),
+            _mm256_max_ps(a, b))
+SIMD_KERNEL(min, BINARY,
+            _mm_min_ps(a, b),
+            _mm256_min_ps(a, b))
+SIMD_KERNEL(and, BINARY,
+            _mm_and_ps(a, b),
+            _mm256_and_ps(a, b))
+SIMD_KERNEL(or, BINARY,
+            _mm_or_ps(a, b),
+            _mm256_or_ps(a, b))
+SIMD_KERNEL(xor, BINARY,
+            _mm_xor_ps(a, b),
+            _mm256_xor_ps(a, b))
+
+/* Comparisons yielding 1.0f/0.0f (SEQ etc.) or ~0/0 masks (FSEQ etc.) */
+SIMD_KERNEL(seq, BINARY,
+            _mm_and_ps(_mm_cmpeq_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_EQ_OQ), AVX_ONE))
+SIMD_KERNEL(sne, BINARY,
+            _mm_and_ps(_mm_cmpneq_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_NEQ_UQ), AVX_ONE))
+SIMD_KERNEL(slt, BINARY,
+            _mm_and_ps(_mm_cmplt_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_LT_OS), AVX_ONE))
+SIMD_KERNEL(sle, BINARY,
+            _mm_and_ps(_mm_cmple_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_LE_OS), AVX_ONE))
+SIMD_KERNEL(sgt, BINARY,
+            _mm_and_ps(_mm_cmpgt_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_GT_OS), AVX_ONE))
+SIMD_KERNEL(sge, BINARY,
+            _mm_and_ps(_mm_cmpge_ps(a, b), SSE_ONE),
+            _mm256_and_ps(AVX_CMP(a, b, _CMP_GE_OS), AVX_ONE))
+SIMD_KERNEL(fseq, BINARY,
+            _mm_cmpeq_ps(a, b),
+            AVX_CMP(a, b, _CMP_EQ_OQ))
+SIMD_KERNEL(fsne, BINARY,
+            _mm_cmpneq_ps(a, b),
+            AVX_CMP(a, b, _CMP_NEQ_UQ))
+SIMD_KERNEL(fslt, BINARY,
+            _mm_cmplt_ps(a, b),
+            AVX_CMP(a, b, _CMP_LT_OS))
+SIMD_KERNEL(fsge, BINARY,
+            _mm_cmpge_ps(a, b),
+            AVX_CMP(a, b, _CMP_GE_OS))
+
+/* No FMA: the product is rounded before the addition, as in C */
+SIMD_KERNEL(mad, TRINARY,
+            _mm_add_ps(_mm_mul_ps(a, b), c),
+            _mm256_add_ps(_mm256_mul_ps(a, b), c))
+SIMD_KERNEL(lrp, TRINARY,
+            _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(b, c)), c),
+            _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(b, c)), c))
+SIMD_KERNEL(cmp, TRINARY,
+            _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(a, _mm_setzero_ps()), b),
+                      _mm_andnot_ps(_mm_cmplt_ps(a, _mm_setzero_ps()), c)),
+            _mm256_blendv_ps(c, b, AVX_CMP(a, _mm256_setzero_ps(),
+                                           _CMP_LT_OS)))
+
+#else
+#define TGSI_EXEC_SSE 0
+#endif /* PIPE_ARCH_SSE */
+
+
 static void
 micro_abs(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = fabsf(src->f[0]);
-   dst->f[1] = fabsf(src->f[1]);
-   dst->f[2] = fabsf(src->f[2]);
-   dst->f[3] = fabsf(src->f[3]);
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(abs, (dst->f, src->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = fabsf(src->f[i]);
+#endif
 }
 
 static void
 micro_arl(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->i[0] = (int)floorf(src->f[0]);
-   dst->i[1] = (int)floorf(src->f[1]);
-   dst->i[2] = (int)floorf(src->f[2]);
-   dst->i[3] = (int)floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = (int)floorf(src->f[i]);
 }
 
 static void
 micro_arr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->i[0] = (int)floorf(src->f[0] + 0.5f);
-   dst->i[1] = (int)floorf(src->f[1] + 0.5f);
-   dst->i[2] = (int)floorf(src->f[2] + 0.5f);
-   dst->i[3] = (int)floorf(src->f[3] + 0.5f);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = (int)floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_ceil(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->f[0] = ceilf(src->f[0]);
-   dst->f[1] = ceilf(src->f[1]);
-   dst->f[2] = ceilf(src->f[2]);
-   dst->f[3] = ceilf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = ceilf(src->f[i]);
 }
 
 static void
 micro_clamp(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src0,
             const union tgsi_exec_channel *src1,
-            const union tgsi_exec_channel *src2)
+            const union tgsi_exec_channel *src2,
+            unsigned n)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src1->f[0] : src0->f[0] > src2->f[0] ? src2->f[0] : src0->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src1->f[1] : src0->f[1] > src2->f[1] ? src2->f[1] : src0->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src1->f[2] : src0->f[2] > src2->f[2] ? src2->f[2] : src0->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src1->f[3] : src0->f[3] > src2->f[3] ? src2->f[3] : src0->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src1->f[i] : src0->f[i] > src2->f[i] ? src2->f[i] : src0->f[i];
 }
 
 static void
 micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(cmp, (dst->f, src0->f, src1->f, src2->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] < 0.0f ? src1->f[i] : src2->f[i];
+#endif
 }
 
 static void
 micro_cnd(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned n)
 {
-   dst->f[0] = src2->f[0] > 0.5f ? src0->f[0] : src1->f[0];
-   dst->f[1] = src2->f[1] > 0.5f ? src0->f[1] : src1->f[1];
-   dst->f[2] = src2->f[2] > 0.5f ? src0->f[2] : src1->f[2];
-   dst->f[3] = src2->f[3] > 0.5f ? src0->f[3] : src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src2->f[i] > 0.5f ? src0->f[i] : src1->f[i];
 }
 
 static void
 micro_cos(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = cosf(src->f[0]);
-   dst->f[1] = cosf(src->f[1]);
-   dst->f[2] = cosf(src->f[2]);
-   dst->f[3] = cosf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = cosf(src->f[i]);
 }
 
 static void
 micro_ddx(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   unsigned q;
+
+   for (q = 0; q < n; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_RIGHT] -
+                      src->f[q + TILE_BOTTOM_LEFT];
+   }
 }
 
 static void
 micro_ddy(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
+   unsigned q;
+
+   for (q = 0; q < n; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_LEFT] -
+                      src->f[q + TILE_TOP_LEFT];
+   }
 }
 
 static void
 micro_exp2(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
+   unsigned i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_exp2(src->f[0]);
-   dst->f[1] = util_fast_exp2(src->f[1]);
-   dst->f[2] = util_fast_exp2(src->f[2]);
-   dst->f[3] = util_fast_exp2(src->f[3]);
+   for (i = 0; i < n; i++)
+      dst->f[i] = util_fast_exp2(src->f[i]);
 #else
 #if DEBUG
    /* Inf is okay for this instruction, so clamp it to silence assertions. */
-   uint i;
    union tgsi_exec_channel clamped;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < n; i++) {
       if (src->f[i] > 127.99999f) {
          clamped.f[i] = 127.99999f;
       } else if (src->f[i] < -126.99999f) {
@@ -205,278 +428,342 @@ micro_exp2(union tgsi_exec_channel *dst,
    src = &clamped;
 #endif /* DEBUG */
 
-   dst->f[0] = powf(2.0f, src->f[0]);
-   dst->f[1] = powf(2.0f, src->f[1]);
-   dst->f[2] = powf(2.0f, src->f[2]);
-   dst->f[3] = powf(2.0f, src->f[3]);
+   for (i = 0; i < n; i++)
+      dst->f[i] = powf(2.0f, src->f[i]);
 #endif /* FAST_MATH */
 }
 
 static void
 micro_flr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = floorf(src->f[0]);
-   dst->f[1] = floorf(src->f[1]);
-   dst->f[2] = floorf(src->f[2]);
-   dst->f[3] = floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = floorf(src->f[i]);
 }
 
 static void
 micro_frc(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = src->f[0] - floorf(src->f[0]);
-   dst->f[1] = src->f[1] - floorf(src->f[1]);
-   dst->f[2] = src->f[2] - floorf(src->f[2]);
-   dst->f[3] = src->f[3] - floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src->f[i] - floorf(src->f[i]);
 }
 
 static void
 micro_iabs(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->i[0] = src->i[0] >= 0 ? src->i[0] : -src->i[0];
-   dst->i[1] = src->i[1] >= 0 ? src->i[1] : -src->i[1];
-   dst->i[2] = src->i[2] >= 0 ? src->i[2] : -src->i[2];
-   dst->i[3] = src->i[3] >= 0 ? src->i[3] : -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src->i[i] >= 0 ? src->i[i] : -src->i[i];
 }
 
 static void
 micro_ineg(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->i[0] = -src->i[0];
-   dst->i[1] = -src->i[1];
-   dst->i[2] = -src->i[2];
-   dst->i[3] = -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = -src->i[i];
 }
 
 static void
 micro_lg2(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
 #if FAST_MATH
-   dst->f[0] = util_fast_log2(src->f[0]);
-   dst->f[1] = util_fast_log2(src->f[1]);
-   dst->f[2] = util_fast_log2(src->f[2]);
-   dst->f[3] = util_fast_log2(src->f[3]);
+      dst->f[i] = util_fast_log2(src->f[i]);
 #else
-   dst->f[0] = logf(src->f[0]) * 1.442695f;
-   dst->f[1] = logf(src->f[1]) * 1.442695f;
-   dst->f[2] = logf(src->f[2]) * 1.442695f;
-   dst->f[3] = logf(src->f[3]) * 1.442695f;
+      dst->f[i] = logf(src->f[i]) * 1.442695f;
 #endif
+   }
 }
 
 static void
 micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(lrp, (dst->f, src0->f, src1->f, src2->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] * (src1->f[i] - src2->f[i]) + src2->f[i];
+#endif
 }
 
 static void
 micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(mad, (dst->f, src0->f, src1->f, src2->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] * src1->f[i] + src2->f[i];
+#endif
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->u[0] = src->u[0];
-   dst->u[1] = src->u[1];
-   dst->u[2] = src->u[2];
-   dst->u[3] = src->u[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(mov, (dst->f, src->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src->u[i];
+#endif
 }
 
 static void
 micro_rcp(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(rcp, (dst->f, src->f, n));
+#else
+   unsigned i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < n; i++)
+      assert(src->f[i] != 0.0f);
+#endif
+   for (i = 0; i < n; i++)
+      dst->f[i] = 1.0f / src->f[i];
 #endif
-   dst->f[0] = 1.0f / src->f[0];
-   dst->f[1] = 1.0f / src->f[1];
-   dst->f[2] = 1.0f / src->f[2];
-   dst->f[3] = 1.0f / src->f[3];
 }
 
 static void
 micro_rnd(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = floorf(src->f[0] + 0.5f);
-   dst->f[1] = floorf(src->f[1] + 0.5f);
-   dst->f[2] = floorf(src->f[2] + 0.5f);
-   dst->f[3] = floorf(src->f[3] + 0.5f);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_rsq(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(rsq, (dst->f, src->f, n));
+#else
+   unsigned i;
+
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (i = 0; i < n; i++)
+      assert(src->f[i] != 0.0f);
+#endif
+   for (i = 0; i < n; i++)
+      dst->f[i] = 1.0f / sqrtf(src->f[i]);
 #endif
-   dst->f[0] = 1.0f / sqrtf(src->f[0]);
-   dst->f[1] = 1.0f / sqrtf(src->f[1]);
-   dst->f[2] = 1.0f / sqrtf(src->f[2]);
-   dst->f[3] = 1.0f / sqrtf(src->f[3]);
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->f[0] = sqrtf(src->f[0]);
-   dst->f[1] = sqrtf(src->f[1]);
-   dst->f[2] = sqrtf(src->f[2]);
-   dst->f[3] = sqrtf(src->f[3]);
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sqrt, (dst->f, src->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = sqrtf(src->f[i]);
+#endif
 }
 
 static void
 micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(seq, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] == src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sge, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] >= src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = src->f[0] < 0.0f ? -1.0f : src->f[0] > 0.0f ? 1.0f : 0.0f;
-   dst->f[1] = src->f[1] < 0.0f ? -1.0f : src->f[1] > 0.0f ? 1.0f : 0.0f;
-   dst->f[2] = src->f[2] < 0.0f ? -1.0f : src->f[2] > 0.0f ? 1.0f : 0.0f;
-   dst->f[3] = src->f[3] < 0.0f ? -1.0f : src->f[3] > 0.0f ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src->f[i] < 0.0f ? -1.0f : src->f[i] > 0.0f ? 1.0f : 0.0f;
 }
 
 static void
 micro_isgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->i[0] = src->i[0] < 0 ? -1 : src->i[0] > 0 ? 1 : 0;
-   dst->i[1] = src->i[1] < 0 ? -1 : src->i[1] > 0 ? 1 : 0;
-   dst->i[2] = src->i[2] < 0 ? -1 : src->i[2] > 0 ? 1 : 0;
-   dst->i[3] = src->i[3] < 0 ? -1 : src->i[3] > 0 ? 1 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src->i[i] < 0 ? -1 : src->i[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sgt, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sin(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = sinf(src->f[0]);
-   dst->f[1] = sinf(src->f[1]);
-   dst->f[2] = sinf(src->f[2]);
-   dst->f[3] = sinf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = sinf(src->f[i]);
 }
 
 static void
 micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sle, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] <= src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(slt, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
 micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sne, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] != src1->f[i] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
-micro_sfl(union tgsi_exec_channel *dst)
+micro_sfl(union tgsi_exec_channel *dst,
+          unsigned n)
 {
-   dst->f[0] = 0.0f;
-   dst->f[1] = 0.0f;
-   dst->f[2] = 0.0f;
-   dst->f[3] = 0.0f;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = 0.0f;
 }
 
 static void
-micro_str(union tgsi_exec_channel *dst)
+micro_str(union tgsi_exec_channel *dst,
+          unsigned n)
 {
-   dst->f[0] = 1.0f;
-   dst->f[1] = 1.0f;
-   dst->f[2] = 1.0f;
-   dst->f[3] = 1.0f;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = 1.0f;
 }
 
 static void
 micro_trunc(union tgsi_exec_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned n)
 {
-   dst->f[0] = (float)(int)src->f[0];
-   dst->f[1] = (float)(int)src->f[1];
-   dst->f[2] = (float)(int)src->f[2];
-   dst->f[3] = (float)(int)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = (float)(int)src->f[i];
 }
 
 
@@ -502,20 +789,20 @@ enum tgsi_exec_datatype {
       MACH->ExecMask = MACH->CondMask & MACH->LoopMask & MACH->ContMask & MACH->Switch.mask & MACH->FuncMask
 
 
-static const union tgsi_exec_channel ZeroVec =
-   { { 0.0, 0.0, 0.0, 0.0 } };
+/** Initializer of all TGSI_EXEC_MAX_LANES lanes of a channel to X */
+#if TGSI_EXEC_MAX_LANES != 16
+#error "update ALL_LANES() for the new TGSI_EXEC_MAX_LANES"
+#endif
+#define ALL_LANES(X) \
+   { { X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X } }
 
-static const union tgsi_exec_channel OneVec = {
-   {1.0f, 1.0f, 1.0f, 1.0f}
-};
+static const union tgsi_exec_channel ZeroVec = ALL_LANES(0.0f);
 
-static const union tgsi_exec_channel P128Vec = {
-   {128.0f, 128.0f, 128.0f, 128.0f}
-};
+static const union tgsi_exec_channel OneVec = ALL_LANES(1.0f);
 
-static const union tgsi_exec_channel M128Vec = {
-   {-128.0f, -128.0f, -128.0f, -128.0f}
-};
+static const union tgsi_exec_channel P128Vec = ALL_LANES(128.0f);
+
+static const union tgsi_exec_channel M128Vec = ALL_LANES(-128.0f);
 
 
 /**
@@ -632,6 +919,10 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+predecode_instructions(struct tgsi_exec_machine *mach);
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -670,6 +961,8 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      predecode_instructions(mach);
+
       return;
    }
 
@@ -804,6 +1097,8 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   predecode_instructions(mach);
 }
 
 
@@ -822,6 +1117,12 @@ tgsi_exec_machine_create( void )
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
    mach->Predicates = &mach->Temps[TGSI_EXEC_TEMP_P0];
+   mach->NumLanes = TGSI_QUAD_SIZE;
+
+#if TGSI_EXEC_AVX
+   util_cpu_detect();
+   use_avx = util_cpu_caps.has_avx;
+#endif
 
    mach->Inputs = align_malloc(sizeof(struct tgsi_exec_vector) * PIPE_MAX_ATTRIBS, 16);
    mach->Outputs = align_malloc(sizeof(struct tgsi_exec_vector) * PIPE_MAX_ATTRIBS, 16);
@@ -829,7 +1130,7 @@ tgsi_exec_machine_create( void )
       goto fail;
 
    /* Setup constants needed by the SSE2 executor. */
-   for( i = 0; i < 4; i++ ) {
+   for( i = 0; i < TGSI_EXEC_MAX_LANES; i++ ) {
       mach->Temps[TGSI_EXEC_TEMP_00000000_I].xyzw[TGSI_EXEC_TEMP_00000000_C].u[i] = 0x00000000;
       mach->Temps[TGSI_EXEC_TEMP_7FFFFFFF_I].xyzw[TGSI_EXEC_TEMP_7FFFFFFF_C].u[i] = 0x7FFFFFFF;
       mach->Temps[TGSI_EXEC_TEMP_80000000_I].xyzw[TGSI_EXEC_TEMP_80000000_C].u[i] = 0x80000000;
@@ -860,11 +1161,33 @@ fail:
 }
 
 
+/**
+ * Set the number of pixels or vertices (lanes) each tgsi_exec_machine_run()
+ * call processes: 4 (a single quad, the default), 8 or 16.  Running more
+ * lanes at once amortizes the instruction decoding and dispatch over more
+ * pixels/vertices and lets the ALU kernels use wider SIMD operations.
+ *
+ * For fragment shaders lanes 4*q..4*q+3 hold quad q, which matters for
+ * derivatives.  Geometry shaders must keep the default.
+ */
+void
+tgsi_exec_machine_set_lanes(struct tgsi_exec_machine *mach,
+                            unsigned num_lanes)
+{
+   assert(num_lanes == 4 || num_lanes == 8 || num_lanes == 16);
+   assert(num_lanes <= TGSI_EXEC_MAX_LANES);
+
+   mach->NumLanes = num_lanes;
+}
+
+
 void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
       FREE(mach->Instructions);
+      FREE(mach->FastInstructions);
+      align_free(mach->ImmVectors);
       FREE(mach->Declarations);
 
       align_free(mach->Inputs);
@@ -877,41 +1200,43 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 static void
 micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] + src1->f[0];
-   dst->f[1] = src0->f[1] + src1->f[1];
-   dst->f[2] = src0->f[2] + src1->f[2];
-   dst->f[3] = src0->f[3] + src1->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(add, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] + src1->f[i];
+#endif
 }
 
 static void
 micro_div(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned n )
 {
-   if (src1->f[0] != 0) {
-      dst->f[0] = src0->f[0] / src1->f[0];
-   }
-   if (src1->f[1] != 0) {
-      dst->f[1] = src0->f[1] / src1->f[1];
-   }
-   if (src1->f[2] != 0) {
-      dst->f[2] = src0->f[2] / src1->f[2];
-   }
-   if (src1->f[3] != 0) {
-      dst->f[3] = src0->f[3] / src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      if (src1->f[i] != 0) {
+         dst->f[i] = src0->f[i] / src1->f[i];
+      }
    }
 }
 
 static void
 micro_rcc(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
    uint i;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < n; i++) {
       float recip = 1.0f / src->f[i];
 
       if (recip > 0.0f) {
@@ -945,86 +1270,121 @@ micro_lt(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1,
    const union tgsi_exec_channel *src2,
-   const union tgsi_exec_channel *src3 )
+   const union tgsi_exec_channel *src3,
+   unsigned n)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src2->f[0] : src3->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src2->f[1] : src3->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src2->f[2] : src3->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src2->f[3] : src3->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src2->f[i] : src3->f[i];
 }
 
 static void
 micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(max, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? src0->f[i] : src1->f[i];
+#endif
 }
 
 static void
 micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(min, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src0->f[i] : src1->f[i];
+#endif
 }
 
 static void
 micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->f[0] = src0->f[0] * src1->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(mul, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] * src1->f[i];
+#endif
 }
 
 static void
 micro_neg(
    union tgsi_exec_channel *dst,
-   const union tgsi_exec_channel *src )
+   const union tgsi_exec_channel *src,
+   unsigned n)
 {
-   dst->f[0] = -src->f[0];
-   dst->f[1] = -src->f[1];
-   dst->f[2] = -src->f[2];
-   dst->f[3] = -src->f[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(neg, (dst->f, src->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = -src->f[i];
+#endif
 }
 
 static void
 micro_pow(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned n )
 {
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
 #if FAST_MATH
-   dst->f[0] = util_fast_pow( src0->f[0], src1->f[0] );
-   dst->f[1] = util_fast_pow( src0->f[1], src1->f[1] );
-   dst->f[2] = util_fast_pow( src0->f[2], src1->f[2] );
-   dst->f[3] = util_fast_pow( src0->f[3], src1->f[3] );
+      dst->f[i] = util_fast_pow( src0->f[i], src1->f[i] );
 #else
-   dst->f[0] = powf( src0->f[0], src1->f[0] );
-   dst->f[1] = powf( src0->f[1], src1->f[1] );
-   dst->f[2] = powf( src0->f[2], src1->f[2] );
-   dst->f[3] = powf( src0->f[3], src1->f[3] );
+      dst->f[i] = powf( src0->f[i], src1->f[i] );
 #endif
+   }
 }
 
 static void
 micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
+{
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(sub, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = src0->f[i] - src1->f[i];
+#endif
+}
+
+/** Set the first n lanes of an integer channel to value */
+static INLINE void
+broadcast_int(union tgsi_exec_channel *chan, int value, uint n)
 {
-   dst->f[0] = src0->f[0] - src1->f[0];
-   dst->f[1] = src0->f[1] - src1->f[1];
-   dst->f[2] = src0->f[2] - src1->f[2];
-   dst->f[3] = src0->f[3] - src1->f[3];
+   uint i;
+
+   for (i = 0; i < n; i++)
+      chan->i[i] = value;
 }
 
 static void
@@ -1036,13 +1396,14 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
                        const union tgsi_exec_channel *index2D,
                        union tgsi_exec_channel *chan)
 {
+   const uint n = mach->NumLanes;
    uint i;
 
    assert(swizzle < 4);
 
    switch (file) {
    case TGSI_FILE_CONSTANT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index2D->i[i] >= 0 && index2D->i[i] < PIPE_MAX_CONSTANT_BUFFERS);
          assert(mach->Consts[index2D->i[i]]);
 
@@ -1071,7 +1432,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_INPUT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          /*
          if (TGSI_PROCESSOR_GEOMETRY == mach->Processor) {
             debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
@@ -1089,13 +1450,13 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       /* XXX no swizzling at this point.  Will be needed if we put
        * gl_FragCoord, for example, in a sys value register.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          chan->u[i] = mach->SystemValue[index->i[i]].u[i];
       }
       break;
 
    case TGSI_FILE_TEMPORARY:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index->i[i] < TGSI_EXEC_NUM_TEMPS);
          assert(index2D->i[i] == 0);
 
@@ -1104,7 +1465,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_IMMEDIATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index->i[i] >= 0 && index->i[i] < (int)mach->ImmLimit);
          assert(index2D->i[i] == 0);
 
@@ -1113,7 +1474,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_ADDRESS:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1122,7 +1483,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_PREDICATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index->i[i] >= 0 && index->i[i] < TGSI_EXEC_NUM_PREDS);
          assert(index2D->i[i] == 0);
 
@@ -1132,7 +1493,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1142,7 +1503,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    default:
       assert(0);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          chan->u[i] = 0;
       }
    }
@@ -1155,6 +1516,7 @@ fetch_source(const struct tgsi_exec_machine *mach,
              const uint chan_index,
              enum tgsi_exec_datatype src_datatype)
 {
+   const uint n = mach->NumLanes;
    union tgsi_exec_channel index;
    union tgsi_exec_channel index2D;
    uint swizzle;
@@ -1166,10 +1528,7 @@ fetch_source(const struct tgsi_exec_machine *mach,
     *       file = Register.File
     *       [1] = Register.Index
     */
-   index.i[0] =
-   index.i[1] =
-   index.i[2] =
-   index.i[3] = reg->Register.Index;
+   broadcast_int(&index, reg->Register.Index, n);
 
    /* There is an extra source register that indirectly subscripts
     * a register file. The direct index now becomes an offset
@@ -1187,11 +1546,10 @@ fetch_source(const struct tgsi_exec_machine *mach,
       const uint execmask = mach->ExecMask;
       uint i;
 
-      /* which address register (always zero now) */
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      /* which address register (always zero now); set all the lanes, as
+       * the compiler cannot tell that only the first n are read
+       */
+      broadcast_int(&index2, reg->Indirect.Index, TGSI_EXEC_MAX_LANES);
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
       fetch_src_file_channel(mach,
@@ -1203,15 +1561,13 @@ fetch_source(const struct tgsi_exec_machine *mach,
                              &indir_index);
 
       /* add value of address register to the offset */
-      index.i[0] += indir_index.i[0];
-      index.i[1] += indir_index.i[1];
-      index.i[2] += indir_index.i[2];
-      index.i[3] += indir_index.i[3];
+      for (i = 0; i < n; i++)
+         index.i[i] += indir_index.i[i];
 
       /* for disabled execution channels, zero-out the index to
        * avoid using a potential garbage value.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < n; i++) {
          if ((execmask & (1 << i)) == 0)
             index.i[i] = 0;
       }
@@ -1226,10 +1582,7 @@ fetch_source(const struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      broadcast_int(&index2D, reg->Dimension.Index, n);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1248,10 +1601,7 @@ fetch_source(const struct tgsi_exec_machine *mach,
          const uint execmask = mach->ExecMask;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         broadcast_int(&index2, reg->DimIndirect.Index, TGSI_EXEC_MAX_LANES);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1262,15 +1612,13 @@ fetch_source(const struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < n; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < n; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1282,10 +1630,7 @@ fetch_source(const struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      broadcast_int(&index2D, 0, n);
    }
 
    swizzle = tgsi_util_get_full_src_register_swizzle( reg, chan_index );
@@ -1299,18 +1644,71 @@ fetch_source(const struct tgsi_exec_machine *mach,
 
    if (reg->Register.Absolute) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_abs(chan, chan);
+         micro_abs(chan, chan, n);
       } else {
-         micro_iabs(chan, chan);
+         micro_iabs(chan, chan, n);
       }
    }
 
    if (reg->Register.Negate) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_neg(chan, chan);
+         micro_neg(chan, chan, n);
       } else {
-         micro_ineg(chan, chan);
+         micro_ineg(chan, chan, n);
+      }
+   }
+}
+
+/**
+ * Write the lanes of chan enabled in execmask to dst, clamped according
+ * to the TGSI_SAT_x mode.
+ */
+static INLINE void
+store_channel(union tgsi_exec_channel *dst,
+              const union tgsi_exec_channel *chan,
+              uint execmask,
+              uint saturate,
+              uint n)
+{
+   uint i;
+
+   switch (saturate) {
+   case TGSI_SAT_NONE:
+      if (execmask == (1u << n) - 1) {
+         memcpy(dst, chan, n * sizeof(chan->u[0]));
+         break;
       }
+      for (i = 0; i < n; i++)
+         if (execmask & (1 << i))
+            dst->i[i] = chan->i[i];
+      break;
+
+   case TGSI_SAT_ZERO_ONE:
+      for (i = 0; i < n; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   case TGSI_SAT_MINUS_PLUS_ONE:
+      for (i = 0; i < n; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < -1.0f)
+               dst->f[i] = -1.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   default:
+      assert( 0 );
    }
 }
 
@@ -1322,6 +1720,7 @@ store_dest(struct tgsi_exec_machine *mach,
            uint chan_index,
            enum tgsi_exec_datatype dst_datatype)
 {
+   const uint n = mach->NumLanes;
    uint i;
    union tgsi_exec_channel null;
    union tgsi_exec_channel *dst;
@@ -1351,10 +1750,7 @@ store_dest(struct tgsi_exec_machine *mach,
       uint swizzle;
 
       /* which address register (always zero for now) */
-      index.i[0] =
-      index.i[1] =
-      index.i[2] =
-      index.i[3] = reg->Indirect.Index;
+      broadcast_int(&index, reg->Indirect.Index, n);
 
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
@@ -1381,10 +1777,7 @@ store_dest(struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      broadcast_int(&index2D, reg->Dimension.Index, n);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1404,10 +1797,7 @@ store_dest(struct tgsi_exec_machine *mach,
          unsigned swizzle;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         broadcast_int(&index2, reg->DimIndirect.Index, TGSI_EXEC_MAX_LANES);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1418,15 +1808,13 @@ store_dest(struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < n; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < n; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1438,10 +1826,7 @@ store_dest(struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      broadcast_int(&index2D, 0, n);
    }
 
    switch (reg->Register.File) {
@@ -1459,7 +1844,7 @@ store_dest(struct tgsi_exec_machine *mach,
                    reg->Register.Index);
       if (TGSI_PROCESSOR_GEOMETRY == mach->Processor) {
          debug_printf("STORING OUT[%d] mask(%d), = (", offset + index, execmask);
-         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         for (i = 0; i < n; i++)
             if (execmask & (1 << i))
                debug_printf("%f, ", chan->f[i]);
          debug_printf(")\n");
@@ -1516,13 +1901,13 @@ store_dest(struct tgsi_exec_machine *mach,
       pred = &mach->Predicates[inst->Predicate.Index].xyzw[swizzle];
 
       if (inst->Predicate.Negate) {
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < n; i++) {
             if (pred->u[i]) {
                execmask &= ~(1 << i);
             }
          }
       } else {
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < n; i++) {
             if (!pred->u[i]) {
                execmask &= ~(1 << i);
             }
@@ -1530,41 +1915,8 @@ store_dest(struct tgsi_exec_machine *mach,
       }
    }
 
-   switch (inst->Instruction.Saturate) {
-   case TGSI_SAT_NONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i))
-            dst->i[i] = chan->i[i];
-      break;
-
-   case TGSI_SAT_ZERO_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < 0.0f)
-               dst->f[i] = 0.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   case TGSI_SAT_MINUS_PLUS_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < -1.0f)
-               dst->f[i] = -1.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   default:
-      assert( 0 );
-   }
-}
+   store_channel(dst, chan, execmask, inst->Instruction.Saturate, n);
+}
 
 #define FETCH(VAL,INDEX,CHAN)\
     fetch_source(mach, VAL, &inst->Src[INDEX], CHAN, TGSI_EXEC_DATA_FLOAT)
@@ -1605,7 +1957,7 @@ exec_kill_if(struct tgsi_exec_machine *mach,
       uniquemask |= 1 << swizzle;
 
       FETCH(&r[0], 0, chan_index);
-      for (i = 0; i < 4; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (r[0].f[i] < 0.0f)
             kilmask |= 1 << i;
    }
@@ -1674,10 +2026,11 @@ conditional_emit_primitive(struct tgsi_exec_machine *mach)
 
 
 /*
- * Fetch four texture samples using STR texture coordinates.
+ * Fetch n texture samples using STR texture coordinates, one quad at a time.
  */
 static void
 fetch_texel( struct tgsi_sampler *sampler,
+             const unsigned n,
              const unsigned sview_idx,
              const unsigned sampler_idx,
              const union tgsi_exec_channel *s,
@@ -1685,7 +2038,7 @@ fetch_texel( struct tgsi_sampler *sampler,
              const union tgsi_exec_channel *p,
              const union tgsi_exec_channel *c0,
              const union tgsi_exec_channel *c1,
-             float derivs[3][2][TGSI_QUAD_SIZE],
+             float derivs[3][2][TGSI_EXEC_MAX_LANES],
              const int8_t offset[3],
              enum tgsi_sampler_control control,
              union tgsi_exec_channel *r,
@@ -1693,18 +2046,29 @@ fetch_texel( struct tgsi_sampler *sampler,
              union tgsi_exec_channel *b,
              union tgsi_exec_channel *a )
 {
-   uint j;
+   uint j, q;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+   float quad_derivs[3][2][TGSI_QUAD_SIZE];
 
-   /* FIXME: handle explicit derivs, offsets */
-   sampler->get_samples(sampler, sview_idx, sampler_idx,
-                        s->f, t->f, p->f, c0->f, c1->f, derivs, offset, control, rgba);
+   for (q = 0; q < n; q += TGSI_QUAD_SIZE) {
+      if (derivs) {
+         for (j = 0; j < 3; j++) {
+            memcpy(quad_derivs[j][0], &derivs[j][0][q], sizeof quad_derivs[j][0]);
+            memcpy(quad_derivs[j][1], &derivs[j][1][q], sizeof quad_derivs[j][1]);
+         }
+      }
+
+      /* FIXME: handle explicit derivs, offsets */
+      sampler->get_samples(sampler, sview_idx, sampler_idx,
+                           &s->f[q], &t->f[q], &p->f[q], &c0->f[q], &c1->f[q],
+                           derivs ? quad_derivs : NULL, offset, control, rgba);
 
-   for (j = 0; j < 4; j++) {
-      r->f[j] = rgba[0][j];
-      g->f[j] = rgba[1][j];
-      b->f[j] = rgba[2][j];
-      a->f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r->f[q + j] = rgba[0][j];
+         g->f[q + j] = rgba[1][j];
+         b->f[q + j] = rgba[2][j];
+         a->f[q + j] = rgba[3][j];
+      }
    }
 }
 
@@ -1727,7 +2091,7 @@ fetch_texel_offsets(struct tgsi_exec_machine *mach,
    if (inst->Texture.NumOffsets == 1) {
       union tgsi_exec_channel index;
       union tgsi_exec_channel offset[3];
-      index.i[0] = index.i[1] = index.i[2] = index.i[3] = inst->TexOffsets[0].Index;
+      broadcast_int(&index, inst->TexOffsets[0].Index, mach->NumLanes);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
                              inst->TexOffsets[0].SwizzleX, &index, &ZeroVec, &offset[0]);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
@@ -1753,19 +2117,13 @@ fetch_assign_deriv_channel(struct tgsi_exec_machine *mach,
                            const struct tgsi_full_instruction *inst,
                            unsigned regdsrcx,
                            unsigned chan,
-                           float derivs[2][TGSI_QUAD_SIZE])
+                           float derivs[2][TGSI_EXEC_MAX_LANES])
 {
    union tgsi_exec_channel d;
    FETCH(&d, regdsrcx, chan);
-   derivs[0][0] = d.f[0];
-   derivs[0][1] = d.f[1];
-   derivs[0][2] = d.f[2];
-   derivs[0][3] = d.f[3];
+   memcpy(derivs[0], d.f, mach->NumLanes * sizeof(float));
    FETCH(&d, regdsrcx + 1, chan);
-   derivs[1][0] = d.f[0];
-   derivs[1][1] = d.f[1];
-   derivs[1][2] = d.f[2];
-   derivs[1][3] = d.f[3];
+   memcpy(derivs[1], d.f, mach->NumLanes * sizeof(float));
 }
 
 
@@ -1842,7 +2200,7 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[i], 0, TGSI_CHAN_X + i);
 
       if (proj)
-         micro_div(&r[i], &r[i], proj);
+         micro_div(&r[i], &r[i], proj, mach->NumLanes);
 
       args[i] = &r[i];
    }
@@ -1852,12 +2210,12 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[shadow_ref], shadow_ref / 4, TGSI_CHAN_X + (shadow_ref % 4));
 
       if (proj)
-         micro_div(&r[shadow_ref], &r[shadow_ref], proj);
+         micro_div(&r[shadow_ref], &r[shadow_ref], proj, mach->NumLanes);
 
       args[shadow_ref] = &r[shadow_ref];
    }
 
-   fetch_texel(mach->Sampler, unit, unit,
+   fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
          args[0], args[1], args[2], args[3], args[4],
          NULL, offsets, control,
          &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -1887,7 +2245,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 {
    const uint unit = inst->Src[3].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_MAX_LANES];
    uint chan;
    int8_t offsets[3];
 
@@ -1900,7 +2258,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
                   &r[0], &ZeroVec, &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -1916,7 +2274,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -1930,7 +2288,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -1950,7 +2308,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -1969,7 +2327,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -1995,7 +2353,7 @@ exec_txf(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[4];
    uint chan;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
-   int j;
+   uint j, q;
    int8_t offsets[3];
    unsigned target;
 
@@ -2034,14 +2392,17 @@ exec_txf(struct tgsi_exec_machine *mach,
       break;
    }      
 
-   mach->Sampler->get_texel(mach->Sampler, unit, r[0].i, r[1].i, r[2].i, r[3].i,
-                            offsets, rgba);
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      mach->Sampler->get_texel(mach->Sampler, unit,
+                               &r[0].i[q], &r[1].i[q], &r[2].i[q], &r[3].i[q],
+                               offsets, rgba);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
 
    if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I) {
@@ -2082,7 +2443,7 @@ exec_txq(struct tgsi_exec_machine *mach,
    /* XXX: This interface can't return per-pixel values */
    mach->Sampler->get_dims(mach->Sampler, unit, src.i[0], result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -2103,7 +2464,7 @@ exec_sample(struct tgsi_exec_machine *mach,
 {
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
-   union tgsi_exec_channel r[4], c1;
+   union tgsi_exec_channel r[5], c1;
    const union tgsi_exec_channel *lod = &ZeroVec;
    enum tgsi_sampler_control control = tgsi_sampler_lod_none;
    uint chan;
@@ -2138,13 +2499,13 @@ exec_sample(struct tgsi_exec_machine *mach,
    case TGSI_TEXTURE_1D:
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &r[2], &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &ZeroVec, &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2157,13 +2518,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[1], 0, TGSI_CHAN_Y);
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &ZeroVec, &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
@@ -2177,13 +2538,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[2], 0, TGSI_CHAN_Z);
       if(compare) {
          FETCH(&r[3], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2196,13 +2557,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[3], 0, TGSI_CHAN_W);
       if(compare) {
          FETCH(&r[4], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], &r[4],
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2234,7 +2595,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_MAX_LANES];
    uint chan;
    unsigned char swizzles[4];
    int8_t offsets[3];
@@ -2252,7 +2613,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2268,7 +2629,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* inputs */
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2286,7 +2647,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach->Sampler, mach->NumLanes, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,
                   derivs, offsets, tgsi_sampler_derivs_explicit,
                   &r[0], &r[1], &r[2], &r[3]);
@@ -2322,14 +2683,14 @@ eval_constant_coef(
 {
    unsigned i;
 
-   for( i = 0; i < TGSI_QUAD_SIZE; i++ ) {
+   for( i = 0; i < mach->NumLanes; i++ ) {
       mach->Inputs[attrib].xyzw[chan].f[i] = mach->InterpCoefs[attrib].a0[chan];
    }
 }
 
 /**
  * Evaluate a linear-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 static void
 eval_linear_coef(
@@ -2337,20 +2698,25 @@ eval_linear_coef(
    unsigned attrib,
    unsigned chan )
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0;
-   mach->Inputs[attrib].xyzw[chan].f[1] = a0 + dadx;
-   mach->Inputs[attrib].xyzw[chan].f[2] = a0 + dady;
-   mach->Inputs[attrib].xyzw[chan].f[3] = a0 + dadx + dady;
+   float *dst = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+      dst[q + 0] = a0;
+      dst[q + 1] = a0 + dadx;
+      dst[q + 2] = a0 + dady;
+      dst[q + 3] = a0 + dadx + dady;
+   }
 }
 
 /**
  * Evaluate a perspective-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 static void
 eval_perspective_coef(
@@ -2358,17 +2724,22 @@ eval_perspective_coef(
    unsigned attrib,
    unsigned chan )
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
    const float *w = mach->QuadPos.xyzw[3].f;
-   /* divide by W here */
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0 / w[0];
-   mach->Inputs[attrib].xyzw[chan].f[1] = (a0 + dadx) / w[1];
-   mach->Inputs[attrib].xyzw[chan].f[2] = (a0 + dady) / w[2];
-   mach->Inputs[attrib].xyzw[chan].f[3] = (a0 + dadx + dady) / w[3];
+   float *dst = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+      /* divide by W here */
+      dst[q + 0] = a0 / w[q + 0];
+      dst[q + 1] = (a0 + dadx) / w[q + 1];
+      dst[q + 2] = (a0 + dady) / w[q + 2];
+      dst[q + 3] = (a0 + dadx + dady) / w[q + 3];
+   }
 }
 
 
@@ -2407,7 +2778,7 @@ exec_declaration(struct tgsi_exec_machine *mach,
             assert(decl->Semantic.Index == 0);
             assert(first == last);
 
-            for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+            for (i = 0; i < mach->NumLanes; i++) {
                mach->Inputs[first].xyzw[0].f[i] = mach->Face;
             }
          } else {
@@ -2470,7 +2841,7 @@ exec_declaration(struct tgsi_exec_machine *mach,
 }
 
 
-typedef void (* micro_op)(union tgsi_exec_channel *dst);
+typedef void (* micro_op)(union tgsi_exec_channel *dst, unsigned n);
 
 static void
 exec_vector(struct tgsi_exec_machine *mach,
@@ -2484,14 +2855,15 @@ exec_vector(struct tgsi_exec_machine *mach,
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          union tgsi_exec_channel dst;
 
-         op(&dst);
+         op(&dst, mach->NumLanes);
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
       }
    }
 }
 
 typedef void (* micro_unary_op)(union tgsi_exec_channel *dst,
-                                const union tgsi_exec_channel *src);
+                                const union tgsi_exec_channel *src,
+                                unsigned n);
 
 static void
 exec_scalar_unary(struct tgsi_exec_machine *mach,
@@ -2505,7 +2877,7 @@ exec_scalar_unary(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel dst;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src);
+   op(&dst, &src, mach->NumLanes);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -2528,7 +2900,7 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
          union tgsi_exec_channel src;
 
          fetch_source(mach, &src, &inst->Src[0], chan, src_datatype);
-         op(&dst.xyzw[chan], &src);
+         op(&dst.xyzw[chan], &src, mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -2540,7 +2912,8 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
 
 typedef void (* micro_binary_op)(union tgsi_exec_channel *dst,
                                  const union tgsi_exec_channel *src0,
-                                 const union tgsi_exec_channel *src1);
+                                 const union tgsi_exec_channel *src1,
+                                 unsigned n);
 
 static void
 exec_scalar_binary(struct tgsi_exec_machine *mach,
@@ -2555,7 +2928,7 @@ exec_scalar_binary(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, src_datatype);
    fetch_source(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src[0], &src[1]);
+   op(&dst, &src[0], &src[1], mach->NumLanes);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -2579,7 +2952,7 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1]);
+         op(&dst.xyzw[chan], &src[0], &src[1], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -2592,7 +2965,8 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 typedef void (* micro_trinary_op)(union tgsi_exec_channel *dst,
                                   const union tgsi_exec_channel *src0,
                                   const union tgsi_exec_channel *src1,
-                                  const union tgsi_exec_channel *src2);
+                                  const union tgsi_exec_channel *src2,
+                                  unsigned n);
 
 static void
 exec_vector_trinary(struct tgsi_exec_machine *mach,
@@ -2611,7 +2985,7 @@ exec_vector_trinary(struct tgsi_exec_machine *mach,
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
          fetch_source(mach, &src[2], &inst->Src[2], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -2630,12 +3004,12 @@ exec_dp3(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_Z; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -2654,12 +3028,12 @@ exec_dp4(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_W; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -2678,14 +3052,14 @@ exec_dp2a(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[0], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[0], &arg[0], &arg[1], &arg[2], mach->NumLanes);
 
    fetch_source(mach, &arg[1], &inst->Src[2], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_add(&arg[0], &arg[0], &arg[1]);
+   micro_add(&arg[0], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -2703,18 +3077,18 @@ exec_dph(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[0], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[0], &arg[0], &arg[1], &arg[2], mach->NumLanes);
 
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-   micro_add(&arg[0], &arg[0], &arg[1]);
+   micro_add(&arg[0], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -2732,11 +3106,11 @@ exec_dp2(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -2754,21 +3128,21 @@ exec_nrm4(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel scale;
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&scale, &arg[0], &arg[0]);
+   micro_mul(&scale, &arg[0], &arg[0], mach->NumLanes);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_W; chan++) {
       union tgsi_exec_channel product;
 
       fetch_source(mach, &arg[chan], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&product, &arg[chan], &arg[chan]);
-      micro_add(&scale, &scale, &product);
+      micro_mul(&product, &arg[chan], &arg[chan], mach->NumLanes);
+      micro_add(&scale, &scale, &product, mach->NumLanes);
    }
 
-   micro_rsq(&scale, &scale);
+   micro_rsq(&scale, &scale, mach->NumLanes);
 
    for (chan = TGSI_CHAN_X; chan <= TGSI_CHAN_W; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-         micro_mul(&arg[chan], &arg[chan], &scale);
+         micro_mul(&arg[chan], &arg[chan], &scale, mach->NumLanes);
          store_dest(mach, &arg[chan], &inst->Dst[0], inst, chan, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -2784,21 +3158,21 @@ exec_nrm3(struct tgsi_exec_machine *mach,
       union tgsi_exec_channel scale;
 
       fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&scale, &arg[0], &arg[0]);
+      micro_mul(&scale, &arg[0], &arg[0], mach->NumLanes);
 
       for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_Z; chan++) {
          union tgsi_exec_channel product;
 
          fetch_source(mach, &arg[chan], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
-         micro_mul(&product, &arg[chan], &arg[chan]);
-         micro_add(&scale, &scale, &product);
+         micro_mul(&product, &arg[chan], &arg[chan], mach->NumLanes);
+         micro_add(&scale, &scale, &product, mach->NumLanes);
       }
 
-      micro_rsq(&scale, &scale);
+      micro_rsq(&scale, &scale, mach->NumLanes);
 
       for (chan = TGSI_CHAN_X; chan <= TGSI_CHAN_Z; chan++) {
          if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-            micro_mul(&arg[chan], &arg[chan], &scale);
+            micro_mul(&arg[chan], &arg[chan], &scale, mach->NumLanes);
             store_dest(mach, &arg[chan], &inst->Dst[0], inst, chan, TGSI_EXEC_DATA_FLOAT);
          }
       }
@@ -2820,11 +3194,11 @@ exec_scs(struct tgsi_exec_machine *mach,
       fetch_source(mach, &arg, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
 
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-         micro_cos(&result, &arg);
+         micro_cos(&result, &arg, mach->NumLanes);
          store_dest(mach, &result, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-         micro_sin(&result, &arg);
+         micro_sin(&result, &arg, mach->NumLanes);
          store_dest(mach, &result, &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -2847,21 +3221,21 @@ exec_x2d(struct tgsi_exec_machine *mach,
    fetch_source(mach, &r[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XZ) {
       fetch_source(mach, &r[2], &inst->Src[2], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[2], &r[2], &r[0]);
+      micro_mul(&r[2], &r[2], &r[0], mach->NumLanes);
       fetch_source(mach, &r[3], &inst->Src[2], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[3], &r[3], &r[1]);
-      micro_add(&r[2], &r[2], &r[3]);
+      micro_mul(&r[3], &r[3], &r[1], mach->NumLanes);
+      micro_add(&r[2], &r[2], &r[3], mach->NumLanes);
       fetch_source(mach, &r[3], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-      micro_add(&d[0], &r[2], &r[3]);
+      micro_add(&d[0], &r[2], &r[3], mach->NumLanes);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_YW) {
       fetch_source(mach, &r[2], &inst->Src[2], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[2], &r[2], &r[0]);
+      micro_mul(&r[2], &r[2], &r[0], mach->NumLanes);
       fetch_source(mach, &r[3], &inst->Src[2], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[3], &r[3], &r[1]);
-      micro_add(&r[2], &r[2], &r[3]);
+      micro_mul(&r[3], &r[3], &r[1], mach->NumLanes);
+      micro_add(&r[2], &r[2], &r[3], mach->NumLanes);
       fetch_source(mach, &r[3], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_add(&d[1], &r[2], &r[3]);
+      micro_add(&d[1], &r[2], &r[3], mach->NumLanes);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &d[0], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
@@ -2886,41 +3260,41 @@ exec_rfl(struct tgsi_exec_machine *mach,
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XYZ) {
       /* r0 = dp3(src0, src0) */
       fetch_source(mach, &r[2], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[0], &r[2], &r[2]);
+      micro_mul(&r[0], &r[2], &r[2], mach->NumLanes);
       fetch_source(mach, &r[4], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[8], &r[4], &r[4]);
-      micro_add(&r[0], &r[0], &r[8]);
+      micro_mul(&r[8], &r[4], &r[4], mach->NumLanes);
+      micro_add(&r[0], &r[0], &r[8], mach->NumLanes);
       fetch_source(mach, &r[6], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[8], &r[6], &r[6]);
-      micro_add(&r[0], &r[0], &r[8]);
+      micro_mul(&r[8], &r[6], &r[6], mach->NumLanes);
+      micro_add(&r[0], &r[0], &r[8], mach->NumLanes);
 
       /* r1 = dp3(src0, src1) */
       fetch_source(mach, &r[3], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[1], &r[2], &r[3]);
+      micro_mul(&r[1], &r[2], &r[3], mach->NumLanes);
       fetch_source(mach, &r[5], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[8], &r[4], &r[5]);
-      micro_add(&r[1], &r[1], &r[8]);
+      micro_mul(&r[8], &r[4], &r[5], mach->NumLanes);
+      micro_add(&r[1], &r[1], &r[8], mach->NumLanes);
       fetch_source(mach, &r[7], &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&r[8], &r[6], &r[7]);
-      micro_add(&r[1], &r[1], &r[8]);
+      micro_mul(&r[8], &r[6], &r[7], mach->NumLanes);
+      micro_add(&r[1], &r[1], &r[8], mach->NumLanes);
 
       /* r1 = 2 * r1 / r0 */
-      micro_add(&r[1], &r[1], &r[1]);
-      micro_div(&r[1], &r[1], &r[0]);
+      micro_add(&r[1], &r[1], &r[1], mach->NumLanes);
+      micro_div(&r[1], &r[1], &r[0], mach->NumLanes);
 
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-         micro_mul(&r[2], &r[2], &r[1]);
-         micro_sub(&r[2], &r[2], &r[3]);
+         micro_mul(&r[2], &r[2], &r[1], mach->NumLanes);
+         micro_sub(&r[2], &r[2], &r[3], mach->NumLanes);
          store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-         micro_mul(&r[4], &r[4], &r[1]);
-         micro_sub(&r[4], &r[4], &r[5]);
+         micro_mul(&r[4], &r[4], &r[1], mach->NumLanes);
+         micro_sub(&r[4], &r[4], &r[5], mach->NumLanes);
          store_dest(mach, &r[4], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
-         micro_mul(&r[6], &r[6], &r[1]);
-         micro_sub(&r[6], &r[6], &r[7]);
+         micro_mul(&r[6], &r[6], &r[1], mach->NumLanes);
+         micro_sub(&r[6], &r[6], &r[7], mach->NumLanes);
          store_dest(mach, &r[6], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -2939,26 +3313,26 @@ exec_xpd(struct tgsi_exec_machine *mach,
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &r[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
 
-   micro_mul(&r[2], &r[0], &r[1]);
+   micro_mul(&r[2], &r[0], &r[1], mach->NumLanes);
 
    fetch_source(mach, &r[3], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &r[4], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
 
-   micro_mul(&r[5], &r[3], &r[4] );
-   micro_sub(&d[TGSI_CHAN_X], &r[2], &r[5]);
+   micro_mul(&r[5], &r[3], &r[4], mach->NumLanes);
+   micro_sub(&d[TGSI_CHAN_X], &r[2], &r[5], mach->NumLanes);
 
    fetch_source(mach, &r[2], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
 
-   micro_mul(&r[3], &r[3], &r[2]);
+   micro_mul(&r[3], &r[3], &r[2], mach->NumLanes);
 
    fetch_source(mach, &r[5], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
 
-   micro_mul(&r[1], &r[1], &r[5]);
-   micro_sub(&d[TGSI_CHAN_Y], &r[3], &r[1]);
+   micro_mul(&r[1], &r[1], &r[5], mach->NumLanes);
+   micro_sub(&d[TGSI_CHAN_Y], &r[3], &r[1], mach->NumLanes);
 
-   micro_mul(&r[5], &r[5], &r[4]);
-   micro_mul(&r[0], &r[0], &r[2]);
-   micro_sub(&d[TGSI_CHAN_Z], &r[5], &r[0]);
+   micro_mul(&r[5], &r[5], &r[4], mach->NumLanes);
+   micro_mul(&r[0], &r[0], &r[2], mach->NumLanes);
+   micro_sub(&d[TGSI_CHAN_Z], &r[5], &r[0], mach->NumLanes);
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &d[TGSI_CHAN_X], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
@@ -2984,7 +3358,7 @@ exec_dst(struct tgsi_exec_machine *mach,
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &r[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1]);
+      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1], mach->NumLanes);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
       fetch_source(mach, &d[TGSI_CHAN_Z], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
@@ -3014,15 +3388,15 @@ exec_log(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_abs(&r[2], &r[0]);  /* r2 = abs(r0) */
-   micro_lg2(&r[1], &r[2]);  /* r1 = lg2(r2) */
-   micro_flr(&r[0], &r[1]);  /* r0 = floor(r1) */
+   micro_abs(&r[2], &r[0], mach->NumLanes);  /* r2 = abs(r0) */
+   micro_lg2(&r[1], &r[2], mach->NumLanes);  /* r1 = lg2(r2) */
+   micro_flr(&r[0], &r[1], mach->NumLanes);  /* r0 = floor(r1) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_exp2(&r[0], &r[0]);       /* r0 = 2 ^ r0 */
-      micro_div(&r[0], &r[2], &r[0]); /* r0 = r2 / r0 */
+      micro_exp2(&r[0], &r[0], mach->NumLanes);       /* r0 = 2 ^ r0 */
+      micro_div(&r[0], &r[2], &r[0], mach->NumLanes); /* r0 = r2 / r0 */
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
@@ -3040,17 +3414,17 @@ exec_exp(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_flr(&r[1], &r[0]);  /* r1 = floor(r0) */
+   micro_flr(&r[1], &r[0], mach->NumLanes);  /* r1 = floor(r0) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-      micro_exp2(&r[2], &r[1]);       /* r2 = 2 ^ r1 */
+      micro_exp2(&r[2], &r[1], mach->NumLanes);       /* r2 = 2 ^ r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_sub(&r[2], &r[0], &r[1]); /* r2 = r0 - r1 */
+      micro_sub(&r[2], &r[0], &r[1], mach->NumLanes); /* r2 = r0 - r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
-      micro_exp2(&r[2], &r[0]);       /* r2 = 2 ^ r0 */
+      micro_exp2(&r[2], &r[0], mach->NumLanes);       /* r2 = 2 ^ r0 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
@@ -3069,17 +3443,17 @@ exec_lit(struct tgsi_exec_machine *mach,
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
          fetch_source(mach, &r[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-         micro_max(&r[1], &r[1], &ZeroVec);
+         micro_max(&r[1], &r[1], &ZeroVec, mach->NumLanes);
 
          fetch_source(mach, &r[2], &inst->Src[0], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-         micro_min(&r[2], &r[2], &P128Vec);
-         micro_max(&r[2], &r[2], &M128Vec);
-         micro_pow(&r[1], &r[1], &r[2]);
-         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec);
+         micro_min(&r[2], &r[2], &P128Vec, mach->NumLanes);
+         micro_max(&r[2], &r[2], &M128Vec, mach->NumLanes);
+         micro_pow(&r[1], &r[1], &r[2], mach->NumLanes);
+         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec, mach->NumLanes);
          store_dest(mach, &d[TGSI_CHAN_Z], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec);
+         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec, mach->NumLanes);
          store_dest(mach, &d[TGSI_CHAN_Y], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -3134,20 +3508,14 @@ exec_case(struct tgsi_exec_machine *mach,
    uint prevMask = mach->SwitchStack[mach->SwitchStackTop - 1].mask;
    union tgsi_exec_channel src;
    uint mask = 0;
+   uint i;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
 
-   if (mach->Switch.selector.u[0] == src.u[0]) {
-      mask |= 0x1;
-   }
-   if (mach->Switch.selector.u[1] == src.u[1]) {
-      mask |= 0x2;
-   }
-   if (mach->Switch.selector.u[2] == src.u[2]) {
-      mask |= 0x4;
-   }
-   if (mach->Switch.selector.u[3] == src.u[3]) {
-      mask |= 0x8;
+   for (i = 0; i < mach->NumLanes; i++) {
+      if (mach->Switch.selector.u[i] == src.u[i]) {
+         mask |= 1 << i;
+      }
    }
 
    mach->Switch.defaultMask |= mask;
@@ -3179,415 +3547,944 @@ exec_endswitch(struct tgsi_exec_machine *mach)
 
 static void
 micro_i2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = (float)src->i[0];
-   dst->f[1] = (float)src->i[1];
-   dst->f[2] = (float)src->i[2];
-   dst->f[3] = (float)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = (float)src->i[i];
 }
 
 static void
 micro_not(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->u[0] = ~src->u[0];
-   dst->u[1] = ~src->u[1];
-   dst->u[2] = ~src->u[2];
-   dst->u[3] = ~src->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = ~src->u[i];
 }
 
 static void
 micro_shl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] << masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] << masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] << masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] << masked_count;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      unsigned masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] << masked_count;
+   }
 }
 
 static void
 micro_and(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(and, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] & src1->u[i];
+#endif
 }
 
 static void
 micro_or(union tgsi_exec_channel *dst,
          const union tgsi_exec_channel *src0,
-         const union tgsi_exec_channel *src1)
+         const union tgsi_exec_channel *src1,
+         unsigned n)
 {
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(or, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] | src1->u[i];
+#endif
 }
 
 static void
 micro_xor(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(xor, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] ^ src1->u[i];
+#endif
 }
 
 static void
 micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned n)
 {
-   dst->i[0] = src0->i[0] % src1->i[0];
-   dst->i[1] = src0->i[1] % src1->i[1];
-   dst->i[2] = src0->i[2] % src1->i[2];
-   dst->i[3] = src0->i[3] % src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] % src1->i[i];
 }
 
 static void
 micro_f2i(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->i[0] = (int)src->f[0];
-   dst->i[1] = (int)src->f[1];
-   dst->i[2] = (int)src->f[2];
-   dst->i[3] = (int)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = (int)src->f[i];
 }
 
 static void
 micro_fseq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(fseq, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->f[i] == src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
 micro_fsge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(fsge, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->f[i] >= src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
 micro_fslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(fslt, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->f[i] < src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
 micro_fsne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
+#if TGSI_EXEC_SSE
+   SIMD_DISPATCH(fsne, (dst->f, src0->f, src1->f, n));
+#else
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->f[i] != src1->f[i] ? ~0 : 0;
+#endif
 }
 
 static void
 micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->i[0] = src0->i[0] / src1->i[0];
-   dst->i[1] = src0->i[1] / src1->i[1];
-   dst->i[2] = src0->i[2] / src1->i[2];
-   dst->i[3] = src0->i[3] / src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] / src1->i[i];
 }
 
 static void
 micro_imax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->i[0] = src0->i[0] > src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] > src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] > src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] > src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] > src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_imin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] < src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] < src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] < src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_isge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->i[0] = src0->i[0] >= src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] >= src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] >= src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] >= src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] >= src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_ishr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   unsigned masked_count;
-   masked_count = src1->i[0] & 0x1f;
-   dst->i[0] = src0->i[0] >> masked_count;
-   masked_count = src1->i[1] & 0x1f;
-   dst->i[1] = src0->i[1] >> masked_count;
-   masked_count = src1->i[2] & 0x1f;
-   dst->i[2] = src0->i[2] >> masked_count;
-   masked_count = src1->i[3] & 0x1f;
-   dst->i[3] = src0->i[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      unsigned masked_count = src1->i[i] & 0x1f;
+      dst->i[i] = src0->i[i] >> masked_count;
+   }
 }
 
 static void
 micro_islt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] < src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] < src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] < src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_f2u(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->u[0] = (uint)src->f[0];
-   dst->u[1] = (uint)src->f[1];
-   dst->u[2] = (uint)src->f[2];
-   dst->u[3] = (uint)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = (uint)src->f[i];
 }
 
 static void
 micro_u2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned n)
 {
-   dst->f[0] = (float)src->u[0];
-   dst->f[1] = (float)src->u[1];
-   dst->f[2] = (float)src->u[2];
-   dst->f[3] = (float)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->f[i] = (float)src->u[i];
 }
 
 static void
 micro_uadd(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] + src1->u[i];
 }
 
 static void
 micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] / src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] / src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] / src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] / src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] / src1->u[i] : ~0u;
 }
 
 static void
 micro_umad(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] * src1->u[0] + src2->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1] + src2->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2] + src2->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3] + src2->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] * src1->u[i] + src2->u[i];
 }
 
 static void
 micro_umax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] > src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] > src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] > src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] > src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] > src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] < src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] < src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] < src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umod(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] % src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] % src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] % src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] % src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] % src1->u[i] : ~0u;
 }
 
 static void
 micro_umul(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] * src1->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] * src1->u[i];
 }
 
 static void
 micro_imul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned n)
 {
+   unsigned i;
+
 #define I64M(x, y) ((((int64_t)x) * ((int64_t)y)) >> 32)
-   dst->i[0] = I64M(src0->i[0], src1->i[0]);
-   dst->i[1] = I64M(src0->i[1], src1->i[1]);
-   dst->i[2] = I64M(src0->i[2], src1->i[2]);
-   dst->i[3] = I64M(src0->i[3], src1->i[3]);
+   for (i = 0; i < n; i++)
+      dst->i[i] = I64M(src0->i[i], src1->i[i]);
 #undef I64M
 }
 
 static void
 micro_umul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned n)
 {
+   unsigned i;
+
 #define U64M(x, y) ((((uint64_t)x) * ((uint64_t)y)) >> 32)
-   dst->u[0] = U64M(src0->u[0], src1->u[0]);
-   dst->u[1] = U64M(src0->u[1], src1->u[1]);
-   dst->u[2] = U64M(src0->u[2], src1->u[2]);
-   dst->u[3] = U64M(src0->u[3], src1->u[3]);
+   for (i = 0; i < n; i++)
+      dst->u[i] = U64M(src0->u[i], src1->u[i]);
 #undef U64M
 }
 
 static void
 micro_useq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] == src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] == src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] == src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] == src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] == src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] >= src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] >= src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] >= src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] >= src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] >= src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_ushr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] >> masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] >> masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] >> masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < n; i++) {
+      unsigned masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] >> masked_count;
+   }
 }
 
 static void
 micro_uslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] < src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] < src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] < src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned n)
 {
-   dst->u[0] = src0->u[0] != src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] != src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] != src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] != src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] != src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_uarl(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned n)
 {
-   dst->i[0] = src->u[0];
-   dst->i[1] = src->u[1];
-   dst->i[2] = src->u[2];
-   dst->i[3] = src->u[3];
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->i[i] = src->u[i];
 }
 
 static void
 micro_ucmp(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned n)
+{
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      dst->u[i] = src0->u[i] ? src1->u[i] : src2->u[i];
+}
+
+/*
+ * Pre-decoded instructions.
+ *
+ * fetch_source() and store_dest() resolve the register file, index,
+ * indirection and swizzle of every operand each time an instruction runs.
+ * When a shader is bound, the common ALU instructions that only use
+ * directly addressed operands are additionally lowered to a
+ * tgsi_exec_fast_inst holding pointers to the channels they read and
+ * write, so running them is just a few micro op calls.  Everything else
+ * still goes through exec_instruction().
+ */
+
+enum fast_src_kind {
+   FAST_SRC_CHANNEL,    /**< chan[] points at the (swizzled) channels */
+   FAST_SRC_CONSTANT    /**< constant buffer element, broadcast on fetch */
+};
+
+struct fast_src {
+   ubyte kind;
+   ubyte absolute;
+   ubyte negate;
+   ubyte const_buf;
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+   int const_pos[TGSI_NUM_CHANNELS];
+};
+
+typedef void (* fast_exec_func)(struct tgsi_exec_machine *mach,
+                                const struct tgsi_exec_fast_inst *fi);
+
+struct tgsi_exec_fast_inst {
+   fast_exec_func exec;         /**< NULL if not pre-decoded */
+   union {
+      micro_unary_op unary;
+      micro_binary_op binary;
+      micro_trinary_op trinary;
+   } op;
+   ubyte saturate;              /**< TGSI_SAT_x */
+   ubyte in_place;              /**< results may be written straight to dst */
+   ubyte num_dp_chans;          /**< DP2/DP3/DP4 only */
+   union tgsi_exec_channel *dst[TGSI_NUM_CHANNELS];  /**< NULL if masked */
+   struct fast_src src[3];
+};
+
+
+/**
+ * Get channel chan of a source operand, using tmp as storage if the value
+ * has to be broadcast or modified.
+ */
+static INLINE const union tgsi_exec_channel *
+fast_fetch(const struct tgsi_exec_machine *mach,
+           const struct fast_src *src,
+           uint chan,
+           union tgsi_exec_channel *tmp)
+{
+   const uint n = mach->NumLanes;
+   const union tgsi_exec_channel *val;
+
+   if (src->kind == FAST_SRC_CHANNEL) {
+      val = src->chan[chan];
+   } else {
+      const uint *buf = (const uint *) mach->Consts[src->const_buf];
+      const int pos = src->const_pos[chan];
+
+      /* same bounds check as fetch_src_file_channel(), and an unbound
+       * buffer reads as zero too
+       */
+      broadcast_int(tmp, buf && pos < (int) mach->ConstsSize[src->const_buf] ?
+                         (int) buf[pos] : 0, n);
+      val = tmp;
+   }
+
+   if (src->absolute) {
+      micro_abs(tmp, val, n);
+      val = tmp;
+   }
+   if (src->negate) {
+      micro_neg(tmp, val, n);
+      val = tmp;
+   }
+
+   return val;
+}
+
+/**
+ * Whether results can be computed directly into the destination
+ * registers rather than into temporaries followed by masked stores.
+ */
+static INLINE boolean
+fast_in_place(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_fast_inst *fi)
+{
+   return fi->in_place && mach->ExecMask == (1u << mach->NumLanes) - 1;
+}
+
+static void
+fast_store(const struct tgsi_exec_machine *mach,
+           const struct tgsi_exec_fast_inst *fi,
+           const struct tgsi_exec_vector *val)
+{
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (fi->dst[chan]) {
+         store_channel(fi->dst[chan], &val->xyzw[chan], mach->ExecMask,
+                       fi->saturate, mach->NumLanes);
+      }
+   }
+}
+
+static void
+fast_store_scalar(const struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_fast_inst *fi,
+                  const union tgsi_exec_channel *val)
+{
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (fi->dst[chan]) {
+         store_channel(fi->dst[chan], val, mach->ExecMask,
+                       fi->saturate, mach->NumLanes);
+      }
+   }
+}
+
+static void
+fast_vector_unary(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_fast_inst *fi)
+{
+   const uint n = mach->NumLanes;
+   const boolean in_place = fast_in_place(mach, fi);
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (fi->dst[chan]) {
+         union tgsi_exec_channel tmp;
+
+         fi->op.unary(in_place ? fi->dst[chan] : &dst.xyzw[chan],
+                      fast_fetch(mach, &fi->src[0], chan, &tmp), n);
+      }
+   }
+   if (!in_place)
+      fast_store(mach, fi, &dst);
+}
+
+static void
+fast_vector_binary(struct tgsi_exec_machine *mach,
+                   const struct tgsi_exec_fast_inst *fi)
+{
+   const uint n = mach->NumLanes;
+   const boolean in_place = fast_in_place(mach, fi);
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (fi->dst[chan]) {
+         union tgsi_exec_channel tmp[2];
+
+         fi->op.binary(in_place ? fi->dst[chan] : &dst.xyzw[chan],
+                       fast_fetch(mach, &fi->src[0], chan, &tmp[0]),
+                       fast_fetch(mach, &fi->src[1], chan, &tmp[1]), n);
+      }
+   }
+   if (!in_place)
+      fast_store(mach, fi, &dst);
+}
+
+static void
+fast_vector_trinary(struct tgsi_exec_machine *mach,
+                    const struct tgsi_exec_fast_inst *fi)
+{
+   const uint n = mach->NumLanes;
+   const boolean in_place = fast_in_place(mach, fi);
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (fi->dst[chan]) {
+         union tgsi_exec_channel tmp[3];
+
+         fi->op.trinary(in_place ? fi->dst[chan] : &dst.xyzw[chan],
+                        fast_fetch(mach, &fi->src[0], chan, &tmp[0]),
+                        fast_fetch(mach, &fi->src[1], chan, &tmp[1]),
+                        fast_fetch(mach, &fi->src[2], chan, &tmp[2]), n);
+      }
+   }
+   if (!in_place)
+      fast_store(mach, fi, &dst);
+}
+
+static void
+fast_scalar_unary(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_fast_inst *fi)
+{
+   union tgsi_exec_channel tmp;
+   union tgsi_exec_channel dst;
+
+   fi->op.unary(&dst, fast_fetch(mach, &fi->src[0], TGSI_CHAN_X, &tmp),
+                mach->NumLanes);
+   fast_store_scalar(mach, fi, &dst);
+}
+
+static void
+fast_scalar_binary(struct tgsi_exec_machine *mach,
+                   const struct tgsi_exec_fast_inst *fi)
+{
+   union tgsi_exec_channel tmp[2];
+   union tgsi_exec_channel dst;
+
+   fi->op.binary(&dst,
+                 fast_fetch(mach, &fi->src[0], TGSI_CHAN_X, &tmp[0]),
+                 fast_fetch(mach, &fi->src[1], TGSI_CHAN_X, &tmp[1]),
+                 mach->NumLanes);
+   fast_store_scalar(mach, fi, &dst);
+}
+
+/** DP2, DP3 and DP4, computed in the same order as exec_dp4() */
+static void
+fast_dp(struct tgsi_exec_machine *mach,
+        const struct tgsi_exec_fast_inst *fi)
+{
+   const uint n = mach->NumLanes;
+   union tgsi_exec_channel tmp[2];
+   union tgsi_exec_channel dst;
+   uint chan;
+
+   micro_mul(&dst,
+             fast_fetch(mach, &fi->src[0], TGSI_CHAN_X, &tmp[0]),
+             fast_fetch(mach, &fi->src[1], TGSI_CHAN_X, &tmp[1]), n);
+
+   for (chan = TGSI_CHAN_Y; chan < fi->num_dp_chans; chan++) {
+      micro_mad(&dst,
+                fast_fetch(mach, &fi->src[0], chan, &tmp[0]),
+                fast_fetch(mach, &fi->src[1], chan, &tmp[1]),
+                &dst, n);
+   }
+
+   fast_store_scalar(mach, fi, &dst);
+}
+
+
+/**
+ * Resolve a directly addressed source operand.
+ * \return FALSE if it has to go through fetch_source()
+ */
+static boolean
+predecode_src(const struct tgsi_exec_machine *mach,
+              const struct tgsi_full_src_register *reg,
+              struct fast_src *src)
+{
+   const struct tgsi_exec_vector *vec = NULL;
+   uint chan;
+
+   if (reg->Register.Indirect || reg->Register.Index < 0)
+      return FALSE;
+
+   if (reg->Register.Dimension &&
+       (reg->Register.File != TGSI_FILE_CONSTANT ||
+        reg->Dimension.Indirect ||
+        reg->Dimension.Index >= PIPE_MAX_CONSTANT_BUFFERS))
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_CONSTANT:
+      src->kind = FAST_SRC_CONSTANT;
+      src->const_buf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         src->const_pos[chan] = reg->Register.Index * 4 +
+            tgsi_util_get_full_src_register_swizzle(reg, chan);
+      }
+      break;
+
+   case TGSI_FILE_TEMPORARY:
+      if (reg->Register.Index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      vec = &mach->Temps[reg->Register.Index];
+      break;
+
+   case TGSI_FILE_INPUT:
+      if (reg->Register.Index >= PIPE_MAX_ATTRIBS)
+         return FALSE;
+      vec = &mach->Inputs[reg->Register.Index];
+      break;
+
+   case TGSI_FILE_OUTPUT:
+      if (reg->Register.Index >= PIPE_MAX_ATTRIBS)
+         return FALSE;
+      vec = &mach->Outputs[reg->Register.Index];
+      break;
+
+   case TGSI_FILE_IMMEDIATE:
+      if (reg->Register.Index >= (int) mach->ImmLimit)
+         return FALSE;
+      vec = &mach->ImmVectors[reg->Register.Index];
+      break;
+
+   default:
+      return FALSE;
+   }
+
+   if (vec) {
+      src->kind = FAST_SRC_CHANNEL;
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         src->chan[chan] =
+            &vec->xyzw[tgsi_util_get_full_src_register_swizzle(reg, chan)];
+      }
+   }
+
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+
+   return TRUE;
+}
+
+/**
+ * Lower an instruction to a tgsi_exec_fast_inst, leaving fi->exec NULL if
+ * it needs the general path.
+ */
+static void
+predecode_instruction(struct tgsi_exec_machine *mach,
+                      const struct tgsi_full_instruction *inst,
+                      struct tgsi_exec_fast_inst *fi)
+{
+   const struct tgsi_full_dst_register *reg = &inst->Dst[0];
+   struct tgsi_exec_vector *vec;
+   fast_exec_func exec;
+   uint i, chan;
+
+   switch (inst->Instruction.Opcode) {
+#define FAST_OP(OPCODE, EXEC, KIND, OP) \
+   case TGSI_OPCODE_##OPCODE:           \
+      exec = EXEC;                      \
+      fi->op.KIND = OP;                 \
+      break
+
+   FAST_OP(MOV, fast_vector_unary, unary, micro_mov);
+   FAST_OP(ABS, fast_vector_unary, unary, micro_abs);
+   FAST_OP(FRC, fast_vector_unary, unary, micro_frc);
+   FAST_OP(FLR, fast_vector_unary, unary, micro_flr);
+   FAST_OP(CEIL, fast_vector_unary, unary, micro_ceil);
+   FAST_OP(TRUNC, fast_vector_unary, unary, micro_trunc);
+   FAST_OP(ROUND, fast_vector_unary, unary, micro_rnd);
+   FAST_OP(SSG, fast_vector_unary, unary, micro_sgn);
+   FAST_OP(ADD, fast_vector_binary, binary, micro_add);
+   FAST_OP(SUB, fast_vector_binary, binary, micro_sub);
+   FAST_OP(MUL, fast_vector_binary, binary, micro_mul);
+   FAST_OP(DIV, fast_vector_binary, binary, micro_div);
+   FAST_OP(MIN, fast_vector_binary, binary, micro_min);
+   FAST_OP(MAX, fast_vector_binary, binary, micro_max);
+   FAST_OP(SLT, fast_vector_binary, binary, micro_slt);
+   FAST_OP(SGE, fast_vector_binary, binary, micro_sge);
+   FAST_OP(SEQ, fast_vector_binary, binary, micro_seq);
+   FAST_OP(SNE, fast_vector_binary, binary, micro_sne);
+   FAST_OP(SLE, fast_vector_binary, binary, micro_sle);
+   FAST_OP(SGT, fast_vector_binary, binary, micro_sgt);
+   FAST_OP(FSEQ, fast_vector_binary, binary, micro_fseq);
+   FAST_OP(FSNE, fast_vector_binary, binary, micro_fsne);
+   FAST_OP(FSLT, fast_vector_binary, binary, micro_fslt);
+   FAST_OP(FSGE, fast_vector_binary, binary, micro_fsge);
+   FAST_OP(MAD, fast_vector_trinary, trinary, micro_mad);
+   FAST_OP(LRP, fast_vector_trinary, trinary, micro_lrp);
+   FAST_OP(CMP, fast_vector_trinary, trinary, micro_cmp);
+   FAST_OP(CND, fast_vector_trinary, trinary, micro_cnd);
+   FAST_OP(CLAMP, fast_vector_trinary, trinary, micro_clamp);
+   FAST_OP(RCP, fast_scalar_unary, unary, micro_rcp);
+   FAST_OP(RSQ, fast_scalar_unary, unary, micro_rsq);
+   FAST_OP(SQRT, fast_scalar_unary, unary, micro_sqrt);
+   FAST_OP(EX2, fast_scalar_unary, unary, micro_exp2);
+   FAST_OP(LG2, fast_scalar_unary, unary, micro_lg2);
+   FAST_OP(SIN, fast_scalar_unary, unary, micro_sin);
+   FAST_OP(COS, fast_scalar_unary, unary, micro_cos);
+   FAST_OP(POW, fast_scalar_binary, binary, micro_pow);
+#undef FAST_OP
+
+   case TGSI_OPCODE_DP2:
+   case TGSI_OPCODE_DP3:
+   case TGSI_OPCODE_DP4:
+      exec = fast_dp;
+      fi->num_dp_chans = inst->Instruction.Opcode == TGSI_OPCODE_DP2 ? 2 :
+                         inst->Instruction.Opcode == TGSI_OPCODE_DP3 ? 3 : 4;
+      break;
+
+   default:
+      return;
+   }
+
+   if (inst->Instruction.Predicate ||
+       inst->Instruction.NumDstRegs != 1 ||
+       reg->Register.Indirect ||
+       reg->Register.Dimension)
+      return;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (reg->Register.Index >= TGSI_EXEC_NUM_TEMPS)
+         return;
+      vec = &mach->Temps[reg->Register.Index];
+      break;
+
+   case TGSI_FILE_OUTPUT:
+      /* outputs are only relocated by geometry shaders, which never get
+       * here, so TEMP_OUTPUT is always 0.
+       */
+      if (reg->Register.Index >= PIPE_MAX_ATTRIBS)
+         return;
+      vec = &mach->Outputs[reg->Register.Index];
+      break;
+
+   default:
+      return;
+   }
+
+   for (i = 0; i < inst->Instruction.NumSrcRegs; i++) {
+      if (!predecode_src(mach, &inst->Src[i], &fi->src[i]))
+         return;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (reg->Register.WriteMask & (1 << chan))
+         fi->dst[chan] = &vec->xyzw[chan];
+   }
+
+   fi->saturate = inst->Instruction.Saturate;
+   fi->in_place = fi->saturate == TGSI_SAT_NONE &&
+                  !tgsi_check_soa_dependencies(inst);
+   fi->exec = exec;
+}
+
+/**
+ * Build mach->FastInstructions for the bound shader.  Setting the
+ * TGSI_EXEC_PREDECODE environment variable to false disables it.
+ */
+static void
+predecode_instructions(struct tgsi_exec_machine *mach)
 {
-   dst->u[0] = src0->u[0] ? src1->u[0] : src2->u[0];
-   dst->u[1] = src0->u[1] ? src1->u[1] : src2->u[1];
-   dst->u[2] = src0->u[2] ? src1->u[2] : src2->u[2];
-   dst->u[3] = src0->u[3] ? src1->u[3] : src2->u[3];
+   uint i, chan, lane;
+
+   FREE(mach->FastInstructions);
+   mach->FastInstructions = NULL;
+   align_free(mach->ImmVectors);
+   mach->ImmVectors = NULL;
+
+   /* geometry shaders relocate outputs and index inputs per vertex */
+   if (mach->Processor == TGSI_PROCESSOR_GEOMETRY ||
+       !mach->NumInstructions ||
+       !debug_get_bool_option("TGSI_EXEC_PREDECODE", TRUE))
+      return;
+
+   if (mach->ImmLimit) {
+      mach->ImmVectors = align_malloc(mach->ImmLimit *
+                                      sizeof(struct tgsi_exec_vector), 16);
+      if (!mach->ImmVectors)
+         return;
+
+      for (i = 0; i < mach->ImmLimit; i++) {
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+            for (lane = 0; lane < TGSI_EXEC_MAX_LANES; lane++)
+               mach->ImmVectors[i].xyzw[chan].f[lane] = mach->Imms[i][chan];
+         }
+      }
+   }
+
+   mach->FastInstructions = CALLOC(mach->NumInstructions,
+                                   sizeof(struct tgsi_exec_fast_inst));
+   if (!mach->FastInstructions)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      predecode_instruction(mach, &mach->Instructions[i],
+                            &mach->FastInstructions[i]);
+   }
 }
 
+
 static void
 exec_instruction(
    struct tgsi_exec_machine *mach,
@@ -3595,6 +4492,7 @@ exec_instruction(
    int *pc )
 {
    union tgsi_exec_channel r[10];
+   uint i;
 
    (*pc)++;
 
@@ -3986,17 +4884,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       FETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].f[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].f[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].f[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].f[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < mach->NumLanes; i++) {
+         if( ! r[0].f[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -4008,17 +4899,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       IFETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].u[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].u[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].u[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].u[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < mach->NumLanes; i++) {
+         if( ! r[0].u[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -4206,17 +5090,10 @@ exec_instruction(
    case TGSI_OPCODE_BREAKC:
       IFETCH(&r[0], 0, TGSI_CHAN_X);
       /* update CondMask */
-      if (r[0].u[0] && (mach->ExecMask & 0x1)) {
-         mach->LoopMask &= ~0x1;
-      }
-      if (r[0].u[1] && (mach->ExecMask & 0x2)) {
-         mach->LoopMask &= ~0x2;
-      }
-      if (r[0].u[2] && (mach->ExecMask & 0x4)) {
-         mach->LoopMask &= ~0x4;
-      }
-      if (r[0].u[3] && (mach->ExecMask & 0x8)) {
-         mach->LoopMask &= ~0x8;
+      for (i = 0; i < mach->NumLanes; i++) {
+         if (r[0].u[i] && (mach->ExecMask & (1 << i))) {
+            mach->LoopMask &= ~(1 << i);
+         }
       }
       /* Todo: if mach->LoopMask == 0, jump to end of loop */
       UPDATE_EXEC_MASK(mach);
@@ -4443,14 +5320,14 @@ exec_instruction(
 
 /**
  * Run TGSI interpreter.
- * \return bitmask of "alive" quad components
+ * \return bitmask of "alive" lanes (quad components)
  */
 uint
 tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 {
    uint i;
    int pc = 0;
-   uint default_mask = 0xf;
+   uint default_mask = (1 << mach->NumLanes) - 1;
 
    mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0] = 0;
    mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] = 0;
@@ -4505,7 +5382,15 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 #endif
 
          assert(pc < (int) mach->NumInstructions);
-         exec_instruction(mach, mach->Instructions + pc, &pc);
+         if (mach->FastInstructions && mach->FastInstructions[pc].exec) {
+            const struct tgsi_exec_fast_inst *fi =
+               &mach->FastInstructions[pc++];
+
+            fi->exec(mach, fi);
+         }
+         else {
+            exec_instruction(mach, mach->Instructions + pc, &pc);
+         }
 
 #if DEBUG_EXECUTION
          for (i = 0; i < TGSI_EXEC_NUM_TEMPS + TGSI_EXEC_NUM_TEMP_EXTRAS; i++) {
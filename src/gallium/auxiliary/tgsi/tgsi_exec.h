@@ -45,6 +45,16 @@ extern "C" {
 #define TGSI_NUM_CHANNELS 4  /* R,G,B,A */
 #define TGSI_QUAD_SIZE    4  /* 4 pixel/quad */
 
+/**
+ * Maximum number of pixels or vertices the machine runs in parallel,
+ * i.e. the number of lanes of each register channel.  This is a multiple
+ * of TGSI_QUAD_SIZE; see tgsi_exec_machine_set_lanes().
+ *
+ * Every machine has storage for this many lanes, whatever it runs with, so
+ * the TGSI_EXEC_NUM_TEMPS temporaries make a machine about 1 MB big.
+ */
+#define TGSI_EXEC_MAX_LANES 16
+
 #define TGSI_FOR_EACH_CHANNEL( CHAN )\
    for (CHAN = 0; CHAN < TGSI_NUM_CHANNELS; CHAN++)
 
@@ -61,16 +71,17 @@ extern "C" {
 
 /**
   * Registers may be treated as float, signed int or unsigned int.
+  * Only the first NumLanes lanes of a channel are used.
   */
 union tgsi_exec_channel
 {
-   float    f[TGSI_QUAD_SIZE];
-   int      i[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE];
+   float    f[TGSI_EXEC_MAX_LANES];
+   int      i[TGSI_EXEC_MAX_LANES];
+   unsigned u[TGSI_EXEC_MAX_LANES];
 };
 
 /**
-  * A vector[RGBA] of channels[4 pixels]
+  * A vector[RGBA] of channels[lanes]
   */
 struct tgsi_exec_vector
 {
@@ -259,6 +270,9 @@ enum tgsi_break_type {
 #define TGSI_EXEC_MAX_BREAK_STACK (TGSI_EXEC_MAX_LOOP_NESTING + TGSI_EXEC_MAX_SWITCH_NESTING)
 
 
+struct tgsi_exec_fast_inst;
+
+
 /**
  * Run-time virtual machine state for executing TGSI shader.
  */
@@ -293,12 +307,15 @@ struct tgsi_exec_machine
    const struct tgsi_token       *Tokens;   /**< Declarations, instructions */
    unsigned                      Processor; /**< TGSI_PROCESSOR_x */
 
+   /** Number of pixels/vertices run in parallel, a multiple of 4 */
+   unsigned                      NumLanes;
+
    /* GEOMETRY processor only. */
    unsigned                      *Primitives;
    unsigned                       NumOutputs;
    unsigned                       MaxGeometryShaderOutputs;
 
-   /* FRAGMENT processor only. */
+   /* FRAGMENT processor only.  Lanes 4*q..4*q+3 hold quad q. */
    const struct tgsi_interp_coef *InterpCoefs;
    struct tgsi_exec_vector       QuadPos;
    float                         Face;    /**< +1 if front facing, -1 if back facing */
@@ -350,6 +367,11 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Pre-decoded copies of Instructions, see predecode_instructions() */
+   struct tgsi_exec_fast_inst *FastInstructions;
+   /** Imms broadcast to all lanes, read by FastInstructions */
+   struct tgsi_exec_vector *ImmVectors;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -372,6 +394,10 @@ tgsi_exec_machine_bind_shader(
    const struct tgsi_token *tokens,
    struct tgsi_sampler *sampler);
 
+void
+tgsi_exec_machine_set_lanes(struct tgsi_exec_machine *mach,
+                            unsigned num_lanes);
+
 uint
 tgsi_exec_machine_run(
    struct tgsi_exec_machine *mach );
@@ -406,6 +432,21 @@ tgsi_set_exec_mask(struct tgsi_exec_machine *mach,
 }
 
 
+/**
+ * Set execution mask values for all lanes prior to executing the shader.
+ * Bit i of lane_mask enables lane i.
+ */
+static INLINE void
+tgsi_set_exec_lanes_mask(struct tgsi_exec_machine *mach, unsigned lane_mask)
+{
+   int *mask = mach->Temps[TGSI_EXEC_MASK_I].xyzw[TGSI_EXEC_MASK_C].i;
+   unsigned i;
+
+   for (i = 0; i < mach->NumLanes; i++)
+      mask[i] = (lane_mask & (1 << i)) ? ~0 : 0;
+}
+
+
 extern void
 tgsi_exec_set_constant_buffers(struct tgsi_exec_machine *mach,
                                unsigned num_bufs,
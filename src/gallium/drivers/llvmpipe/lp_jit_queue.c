@@ -0,0 +1,287 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "util/u_memory.h"
+#include "lp_jit_queue.h"
+
+
+struct lp_jit_thread
+{
+   struct lp_jit_queue *queue;
+   pipe_thread thread;
+
+   /** Never freed, see gallivm_create_in_context() */
+   LLVMContextRef context;
+   pipe_mutex context_mutex;
+};
+
+
+struct lp_jit_queue
+{
+   pipe_mutex mutex;
+   pipe_condvar job_added;
+   pipe_condvar job_done;
+
+   /** FIFO of queued jobs */
+   struct lp_jit_job *head, *tail;
+
+   boolean exit_flag;
+
+   unsigned num_threads;
+   struct lp_jit_thread *threads;
+};
+
+
+static void
+add_job_locked(struct lp_jit_queue *queue, struct lp_jit_job *job,
+               boolean urgent)
+{
+   assert(job->run);
+   assert(job->state == LP_JIT_JOB_IDLE);
+
+   job->state = LP_JIT_JOB_QUEUED;
+   if (urgent) {
+      job->next = queue->head;
+      queue->head = job;
+      if (!queue->tail)
+         queue->tail = job;
+   }
+   else {
+      job->next = NULL;
+      if (queue->tail)
+         queue->tail->next = job;
+      else
+         queue->head = job;
+      queue->tail = job;
+   }
+
+   pipe_condvar_signal(queue->job_added);
+}
+
+
+static PIPE_THREAD_ROUTINE( jit_thread_function, init_data )
+{
+   struct lp_jit_thread *thread = (struct lp_jit_thread *) init_data;
+   struct lp_jit_queue *queue = thread->queue;
+
+   pipe_mutex_lock(queue->mutex);
+
+   while (1) {
+      struct lp_jit_job *job;
+
+      while (!queue->head && !queue->exit_flag)
+         pipe_condvar_wait(queue->job_added, queue->mutex);
+
+      if (queue->exit_flag)
+         break;
+
+      job = queue->head;
+      queue->head = job->next;
+      if (!queue->head)
+         queue->tail = NULL;
+
+      job->next = NULL;
+      job->state = LP_JIT_JOB_RUNNING;
+      job->context_mutex = &thread->context_mutex;
+
+      pipe_mutex_unlock(queue->mutex);
+
+      pipe_mutex_lock(thread->context_mutex);
+      if (!thread->context)
+         thread->context = LLVMContextCreate();
+      job->run(job, thread->context);
+      pipe_mutex_unlock(thread->context_mutex);
+
+      pipe_mutex_lock(queue->mutex);
+      job->state = LP_JIT_JOB_DONE;
+      if (job->followup)
+         add_job_locked(queue, job->followup, FALSE);
+      pipe_condvar_broadcast(queue->job_done);
+   }
+
+   pipe_mutex_unlock(queue->mutex);
+
+   return 0;
+}
+
+
+/**
+ * Create a queue served by \p num_threads threads.
+ */
+struct lp_jit_queue *
+lp_jit_queue_create(unsigned num_threads)
+{
+   struct lp_jit_queue *queue;
+   unsigned i;
+
+   assert(num_threads > 0);
+
+   queue = CALLOC_STRUCT(lp_jit_queue);
+   if (!queue)
+      return NULL;
+
+   queue->threads = CALLOC(num_threads, sizeof *queue->threads);
+   if (!queue->threads) {
+      FREE(queue);
+      return NULL;
+   }
+
+   pipe_mutex_init(queue->mutex);
+   pipe_condvar_init(queue->job_added);
+   pipe_condvar_init(queue->job_done);
+
+   queue->num_threads = num_threads;
+
+   for (i = 0; i < num_threads; i++) {
+      struct lp_jit_thread *thread = &queue->threads[i];
+
+      thread->queue = queue;
+      pipe_mutex_init(thread->context_mutex);
+      thread->thread = pipe_thread_create(jit_thread_function, thread);
+   }
+
+   return queue;
+}
+
+
+/**
+ * Stop the threads.  All jobs must be finished.
+ */
+void
+lp_jit_queue_destroy(struct lp_jit_queue *queue)
+{
+   unsigned i;
+
+   pipe_mutex_lock(queue->mutex);
+   assert(!queue->head);
+   queue->exit_flag = TRUE;
+   pipe_condvar_broadcast(queue->job_added);
+   pipe_mutex_unlock(queue->mutex);
+
+   for (i = 0; i < queue->num_threads; i++) {
+      pipe_thread_wait(queue->threads[i].thread);
+      pipe_mutex_destroy(queue->threads[i].context_mutex);
+   }
+
+   pipe_condvar_destroy(queue->job_done);
+   pipe_condvar_destroy(queue->job_added);
+   pipe_mutex_destroy(queue->mutex);
+
+   FREE(queue->threads);
+   FREE(queue);
+}
+
+
+/**
+ * Queue \p job to be run on one of the threads, ahead of the jobs
+ * already queued if \p urgent is set.
+ */
+void
+lp_jit_queue_add(struct lp_jit_queue *queue, struct lp_jit_job *job,
+                 boolean urgent)
+{
+   pipe_mutex_lock(queue->mutex);
+   add_job_locked(queue, job, urgent);
+   pipe_mutex_unlock(queue->mutex);
+}
+
+
+/**
+ * \return TRUE if \p job is done.  Anything the job wrote before
+ *         returning is visible to the caller then.
+ */
+boolean
+lp_jit_queue_done(struct lp_jit_queue *queue, struct lp_jit_job *job)
+{
+   boolean done;
+
+   pipe_mutex_lock(queue->mutex);
+   done = job->state == LP_JIT_JOB_DONE;
+   pipe_mutex_unlock(queue->mutex);
+
+   return done;
+}
+
+
+/**
+ * Wait for \p job, which must have been queued, to be done.
+ */
+void
+lp_jit_queue_wait(struct lp_jit_queue *queue, struct lp_jit_job *job)
+{
+   pipe_mutex_lock(queue->mutex);
+
+   assert(job->state != LP_JIT_JOB_IDLE);
+   while (job->state != LP_JIT_JOB_DONE)
+      pipe_condvar_wait(queue->job_done, queue->mutex);
+
+   pipe_mutex_unlock(queue->mutex);
+}
+
+
+/**
+ * Make sure \p job is not queued or running anymore.  A job which hasn't
+ * started yet is taken off the queue and won't run, nor will its
+ * followup be queued.
+ *
+ * \return TRUE if the job ran, in which case the caller must hold
+ *         job->context_mutex while destroying what it created.
+ */
+boolean
+lp_jit_queue_finish(struct lp_jit_queue *queue, struct lp_jit_job *job)
+{
+   boolean ran;
+
+   pipe_mutex_lock(queue->mutex);
+
+   if (job->state == LP_JIT_JOB_QUEUED) {
+      struct lp_jit_job *prev = NULL;
+
+      if (queue->head != job) {
+         prev = queue->head;
+         while (prev->next != job)
+            prev = prev->next;
+      }
+
+      if (prev)
+         prev->next = job->next;
+      else
+         queue->head = job->next;
+
+      if (queue->tail == job)
+         queue->tail = prev;
+
+      job->next = NULL;
+      job->state = LP_JIT_JOB_IDLE;
+   }
+
+   while (job->state == LP_JIT_JOB_RUNNING)
+      pipe_condvar_wait(queue->job_done, queue->mutex);
+
+   ran = job->state == LP_JIT_JOB_DONE;
+
+   pipe_mutex_unlock(queue->mutex);
+
+   return ran;
+}
@@ -0,0 +1,87 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * A pool of threads running LLVM compilations in the background.
+ *
+ * Each thread has an LLVM context of its own, as the shared gallivm
+ * context may only be used by one thread at a time.  Anything a job
+ * creates in that context must only be destroyed while holding the
+ * job's context_mutex.
+ */
+
+#ifndef LP_JIT_QUEUE_H
+#define LP_JIT_QUEUE_H
+
+#include "os/os_thread.h"
+#include "gallivm/lp_bld.h"
+
+
+struct lp_jit_queue;
+
+enum lp_jit_job_state {
+   LP_JIT_JOB_IDLE = 0,
+   LP_JIT_JOB_QUEUED,
+   LP_JIT_JOB_RUNNING,
+   LP_JIT_JOB_DONE
+};
+
+struct lp_jit_job
+{
+   /** Called on one of the threads of the queue */
+   void (*run)(struct lp_jit_job *job, LLVMContextRef context);
+
+   enum lp_jit_job_state state;
+
+   /** Protects the LLVM context the job ran in, once it is running */
+   pipe_mutex *context_mutex;
+
+   /** Queued once this job is done */
+   struct lp_jit_job *followup;
+
+   struct lp_jit_job *next;
+};
+
+
+struct lp_jit_queue *
+lp_jit_queue_create(unsigned num_threads);
+
+void
+lp_jit_queue_destroy(struct lp_jit_queue *queue);
+
+void
+lp_jit_queue_add(struct lp_jit_queue *queue, struct lp_jit_job *job,
+                 boolean urgent);
+
+boolean
+lp_jit_queue_done(struct lp_jit_queue *queue, struct lp_jit_job *job);
+
+void
+lp_jit_queue_wait(struct lp_jit_queue *queue, struct lp_jit_job *job);
+
+boolean
+lp_jit_queue_finish(struct lp_jit_queue *queue, struct lp_jit_job *job);
+
+
+#endif /* LP_JIT_QUEUE_H */
@@ -61,9 +61,6 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
-
-
 /**
  * Max bytes per scene.  This may be replaced by a runtime parameter.
  */
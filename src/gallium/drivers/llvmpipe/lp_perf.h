@@ -35,6 +35,9 @@
 
 #include "pipe/p_compiler.h"
 
+/** Number of rasterizer threads with counters of their own */
+#define LP_COUNT_MAX_THREADS 64
+
 /**
  * Various counters
  */
@@ -62,6 +65,14 @@ struct lp_counters
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   /**
+    * Bins rasterized by each rasterizer thread, and how many of those were
+    * taken from other threads.  Threads past the first
+    * LP_COUNT_MAX_THREADS are not counted.
+    */
+   unsigned nr_bins[LP_COUNT_MAX_THREADS];
+   unsigned nr_stolen_bins[LP_COUNT_MAX_THREADS];
 };
 
 
@@ -73,10 +84,16 @@ extern struct lp_counters lp_count;
 #define LP_COUNT(counter) lp_count.counter++
 #define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
 #define LP_COUNT_GET(counter) (lp_count.counter)
+#define LP_COUNT_THREAD(counter, thread) \
+   do { \
+      if ((thread) < LP_COUNT_MAX_THREADS) \
+         lp_count.counter[thread]++; \
+   } while (0)
 #else
 #define LP_COUNT(counter)
 #define LP_COUNT_ADD(counter, incr) (void)(incr)
 #define LP_COUNT_GET(counter) 0
+#define LP_COUNT_THREAD(counter, thread) (void)(thread)
 #endif
 
 
@@ -48,18 +48,42 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+/**
+ * Current value of the draw module's vertex cache counter for the given
+ * LP_QUERY_VERTEX_CACHE_x query type.
+ */
+static uint64_t
+vertex_cache_count(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   uint64_t hits, misses;
+
+   draw_get_vertex_cache_stats(llvmpipe->draw, &hits, &misses);
+
+   return type == LP_QUERY_VERTEX_CACHE_HITS ? hits : misses;
+}
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          type == LP_QUERY_VERTEX_CACHE_HITS ||
+          type == LP_QUERY_VERTEX_CACHE_MISSES);
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
    if (pq) {
       pq->type = type;
+      pq->num_threads = MAX2(1, screen->num_threads);
+      pq->start = CALLOC(2 * pq->num_threads, sizeof(uint64_t));
+      if (!pq->start) {
+         FREE(pq);
+         return NULL;
+      }
+      pq->end = pq->start + pq->num_threads;
    }
 
    return (struct pipe_query *) pq;
@@ -84,6 +108,7 @@ llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
       lp_fence_reference(&pq->fence, NULL);
    }
 
+   FREE(pq->start);
    FREE(pq);
 }
 
@@ -94,9 +119,8 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
                           boolean wait,
                           union pipe_query_result *vresult)
 {
-   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
-   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   unsigned num_threads = pq->num_threads;
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
@@ -174,6 +198,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_VERTEX_CACHE_HITS:
+   case LP_QUERY_VERTEX_CACHE_MISSES:
+      /* counted by draw, not by the rasterizer threads */
+      *result = pq->end[0] - pq->start[0];
+      break;
    default:
       assert(0);
       break;
@@ -189,17 +218,17 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
-   /* Check if the query is already in the scene.  If so, we need to
-    * flush the scene now.  Real apps shouldn't re-use a query in a
-    * frame of rendering.
+   /* Check if the query is already in a scene, including one which is
+    * still being rasterized.  If so, we need to finish the scene now.
+    * Real apps shouldn't re-use a query in a frame of rendering.
     */
-   if (pq->fence && !lp_fence_issued(pq->fence)) {
+   if (pq->fence && !lp_fence_signalled(pq->fence)) {
       llvmpipe_finish(pipe, __FUNCTION__);
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(pq->start[0]));
+   memset(pq->end, 0, pq->num_threads * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -231,6 +260,10 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->active_occlusion_queries++;
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
+   case LP_QUERY_VERTEX_CACHE_HITS:
+   case LP_QUERY_VERTEX_CACHE_MISSES:
+      pq->start[0] = vertex_cache_count(llvmpipe, pq->type);
+      break;
    default:
       break;
    }
@@ -293,6 +326,10 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe->active_occlusion_queries--;
       llvmpipe->dirty |= LP_NEW_OCCLUSION_QUERY;
       break;
+   case LP_QUERY_VERTEX_CACHE_HITS:
+   case LP_QUERY_VERTEX_CACHE_MISSES:
+      pq->end[0] = vertex_cache_count(llvmpipe, pq->type);
+      break;
    default:
       break;
    }
@@ -35,15 +35,20 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
-#include "lp_limits.h"
 
 
 struct llvmpipe_context;
 
 
+/* Driver-specific queries, see llvmpipe_get_driver_query_info() */
+#define LP_QUERY_VERTEX_CACHE_HITS    (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_VERTEX_CACHE_MISSES  (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+
+
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* size of the start and end arrays */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
@@ -67,14 +67,35 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   rast->num_active_threads =
+      lp_scene_bin_iter_begin( scene, MAX2(rast->num_threads, 1) );
+
+   if (!rast->adaptive_threads)
+      rast->num_active_threads = MAX2(rast->num_threads, 1);
 }
 
 
+/**
+ * End rasterizing a scene.
+ * Called once per scene by one thread, after all threads are done with it.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = NULL;
+
+   /* Only signal the fence once the scene is reset, as setup will start
+    * binning into it again as soon as it is signalled.
+    */
+   lp_fence_reference(&fence, scene->fence);
+
+   lp_scene_end_rasterization( scene );
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 
    rast->curr_scene = NULL;
 }
@@ -347,7 +368,6 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    const struct lp_rast_shader_inputs *inputs = arg.shade_tile;
    const struct lp_rast_state *state;
-   struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
    unsigned x, y;
 
@@ -363,7 +383,6 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    if (!state) {
       return;
    }
-   variant = state->variant;
 
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
@@ -399,18 +418,18 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
          /* run shader on 4x4 block */
          BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+         state->jit_function[RAST_WHOLE]( &state->jit_context,
+                                          tile_x + x, tile_y + y,
+                                          inputs->frontfacing,
+                                          GET_A0(inputs),
+                                          GET_DADX(inputs),
+                                          GET_DADY(inputs),
+                                          color,
+                                          depth,
+                                          0xffff,
+                                          &task->thread_data,
+                                          stride,
+                                          depth_stride);
          END_JIT_CALL();
       }
    }
@@ -504,18 +523,18 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
-                                            x, y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            mask,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+      state->jit_function[RAST_EDGE_TEST](&state->jit_context,
+                                          x, y,
+                                          inputs->frontfacing,
+                                          GET_A0(inputs),
+                                          GET_DADX(inputs),
+                                          GET_DADY(inputs),
+                                          color,
+                                          depth,
+                                          mask,
+                                          &task->thread_data,
+                                          stride,
+                                          depth_stride);
       END_JIT_CALL();
    }
 }
@@ -719,21 +738,22 @@ rasterize_scene(struct lp_rasterizer_task *task,
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
+         boolean stolen;
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j, &stolen))) {
+            LP_COUNT_THREAD(nr_bins, task->thread_index);
+            if (stolen)
+               LP_COUNT_THREAD(nr_stolen_bins, task->thread_index);
+
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
       }
    }
 
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -767,44 +787,29 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       rast->curr_scene = NULL;
    }
    else {
-      /* threaded rendering! */
-      unsigned i;
-
+      /* threaded rendering!  Thread 0 wakes up the others it needs.
+       * This only blocks when the queue of full scenes is full; the
+       * scene's fence tells when it has been rasterized.
+       */
       lp_scene_enqueue( rast->full_scenes, scene );
 
-      /* signal the threads that there's work to do */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_signal(&rast->tasks[i].work_ready);
-      }
+      pipe_semaphore_signal(&rast->tasks[0].work_ready);
    }
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
 
-void
-lp_rast_finish( struct lp_rasterizer *rast )
-{
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
-   }
-}
-
-
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
  *   3. signal that we're done
+ *
+ * Thread 0 is woken up for every scene.  It begins the scene, wakes up as
+ * many of the other threads as the scene needs and waits for them to be
+ * done before ending the scene and signalling its fence.
  */
 static PIPE_THREAD_ROUTINE( thread_function, init_data )
 {
@@ -828,40 +833,45 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
          break;
 
       if (task->thread_index == 0) {
+         unsigned i;
+
          /* thread[0]:
           *  - get next scene to rasterize
           *  - map the framebuffer surfaces
+          *  - wake up the other threads which have work to do
           */
          lp_rast_begin( rast, 
                         lp_scene_dequeue( rast->full_scenes, TRUE ) );
-      }
 
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
-       */
-      pipe_barrier_wait( &rast->barrier );
+         for (i = 1; i < rast->num_active_threads; i++) {
+            pipe_semaphore_signal(&rast->tasks[i].work_ready);
+         }
 
-      /* do work */
-      if (debug)
-         debug_printf("thread %d doing work\n", task->thread_index);
+         if (debug)
+            debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task,
-                      rast->curr_scene);
-      
-      /* wait for all threads to finish with this scene */
-      pipe_barrier_wait( &rast->barrier );
+         rasterize_scene(task, rast->curr_scene);
+
+         /* wait for the other threads to finish with this scene */
+         for (i = 1; i < rast->num_active_threads; i++) {
+            pipe_semaphore_wait(&rast->tasks[i].work_done);
+         }
 
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
          lp_rast_end( rast );
       }
+      else {
+         /* do work */
+         if (debug)
+            debug_printf("thread %d doing work\n", task->thread_index);
 
-      /* signal done with work */
-      if (debug)
-         debug_printf("thread %d done working\n", task->thread_index);
+         rasterize_scene(task, rast->curr_scene);
+
+         /* signal done with work */
+         if (debug)
+            debug_printf("thread %d done working\n", task->thread_index);
 
-      pipe_semaphore_signal(&task->work_done);
+         pipe_semaphore_signal(&task->work_done);
+      }
    }
 
    return 0;
@@ -908,7 +918,14 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
-   for (i = 0; i < Elements(rast->tasks); i++) {
+   /* with no threads, rendering happens on tasks[0] */
+   rast->tasks = CALLOC(MAX2(num_threads, 1), sizeof *rast->tasks);
+   rast->threads = CALLOC(MAX2(num_threads, 1), sizeof *rast->threads);
+   if (!rast->tasks || !rast->threads) {
+      goto no_tasks;
+   }
+
+   for (i = 0; i < MAX2(num_threads, 1); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
@@ -917,16 +934,18 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->adaptive_threads = debug_get_bool_option("LP_ADAPTIVE_THREADS", TRUE);
 
    create_rast_threads(rast);
 
-   /* for synchronizing rasterization threads */
-   pipe_barrier_init( &rast->barrier, rast->num_threads );
-
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
    return rast;
 
+no_tasks:
+   FREE(rast->tasks);
+   FREE(rast->threads);
+   lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
 no_rast:
@@ -960,11 +979,11 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       pipe_semaphore_destroy(&rast->tasks[i].work_done);
    }
 
-   /* for synchronizing rasterization threads */
-   pipe_barrier_destroy( &rast->barrier );
-
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->tasks);
+   FREE(rast->threads);
+
    FREE(rast);
 }
 
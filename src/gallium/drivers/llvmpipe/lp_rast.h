@@ -87,6 +87,12 @@ struct lp_rast_state {
     * the tile color/z/stencil data somehow
      */
    struct lp_fragment_shader_variant *variant;
+
+   /* The entry points of the variant's code to run.  Setup picks them
+    * on the context thread, as the variant's code may still be replaced
+    * by optimized code compiled in the background.
+    */
+   lp_jit_frag_func jit_function[2];
 };
 
 
@@ -153,9 +159,6 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
-void
-lp_rast_finish( struct lp_rasterizer *rast );
-
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -0,0 +1,277 @@
+/**************************************************************************
+ *
+ * Copyright 2007-2009 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Trivial accept and reject masks of the 16 sub-blocks of a block, for
+ * the triangle rasterization functions in lp_rast_tri.c.
+ */
+
+#ifndef LP_RAST_MASKS_H
+#define LP_RAST_MASKS_H
+
+#include "pipe/p_compiler.h"
+#include "lp_rast.h"
+
+#if defined(PIPE_ARCH_SSE)
+#if defined(__AVX2__)
+#define LP_RAST_AVX2 1
+#include <immintrin.h>
+#endif
+#include <emmintrin.h>
+#endif
+
+
+static INLINE unsigned
+build_mask_linear(int64_t c, int64_t dcdx, int64_t dcdy)
+{
+   unsigned mask = 0;
+
+   int64_t c0 = c;
+   int64_t c1 = c0 + dcdy;
+   int64_t c2 = c1 + dcdy;
+   int64_t c3 = c2 + dcdy;
+
+   mask |= ((c0 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 0);
+   mask |= ((c0 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 1);
+   mask |= ((c0 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 2);
+   mask |= ((c0 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 3);
+   mask |= ((c1 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 4);
+   mask |= ((c1 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 5);
+   mask |= ((c1 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 6);
+   mask |= ((c1 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 7);
+   mask |= ((c2 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 8);
+   mask |= ((c2 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 9);
+   mask |= ((c2 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 10);
+   mask |= ((c2 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 11);
+   mask |= ((c3 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 12);
+   mask |= ((c3 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 13);
+   mask |= ((c3 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 14);
+   mask |= ((c3 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 15);
+  
+   return mask;
+}
+
+
+/**
+ * Evaluate the planes at the 16 points of a 4x4 grid, starting at c[j]
+ * and stepping by dcdx[j] and dcdy[j], and set bit i of *outmask if any
+ * plane is negative at point i (in raster order).  If cdiff is not NULL,
+ * the same is done for c[j] + cdiff[j] into *partmask.
+ *
+ * All planes are tested at once: the values are combined with a bitwise
+ * or, which keeps the sign bit, and the sign bits are only extracted at
+ * the end.
+ */
+static INLINE void
+build_masks(unsigned nr_planes,
+            const int64_t *c,
+            const int64_t *cdiff,
+            const int64_t *dcdx,
+            const int64_t *dcdy,
+            unsigned *outmask,
+            unsigned *partmask)
+{
+#if defined(LP_RAST_AVX2)
+   __m256i out[4], part[4];
+   unsigned i, j;
+
+   for (i = 0; i < 4; i++) {
+      out[i] = _mm256_setzero_si256();
+      part[i] = _mm256_setzero_si256();
+   }
+
+   for (j = 0; j < nr_planes; j++) {
+      const __m256i xdcdy = _mm256_set1_epi64x(dcdy[j]);
+      __m256i cstep = _mm256_setr_epi64x(c[j],
+                                         c[j] + dcdx[j],
+                                         c[j] + dcdx[j] * 2,
+                                         c[j] + dcdx[j] * 3);
+
+      for (i = 0; i < 4; i++) {
+         out[i] = _mm256_or_si256(out[i], cstep);
+         if (cdiff) {
+            const __m256i xcdiff = _mm256_set1_epi64x(cdiff[j]);
+            part[i] = _mm256_or_si256(part[i],
+                                      _mm256_add_epi64(cstep, xcdiff));
+         }
+         cstep = _mm256_add_epi64(cstep, xdcdy);
+      }
+   }
+
+   for (i = 0; i < 4; i++) {
+      *outmask |= _mm256_movemask_pd(_mm256_castsi256_pd(out[i])) << (i * 4);
+      if (cdiff) {
+         *partmask |=
+            _mm256_movemask_pd(_mm256_castsi256_pd(part[i])) << (i * 4);
+      }
+   }
+#elif defined(PIPE_ARCH_SSE)
+   /* Two 64-bit values per vector, so out[i] holds half a row */
+   __m128i out[8], part[8];
+   unsigned i, j;
+
+   for (i = 0; i < 8; i++) {
+      out[i] = _mm_setzero_si128();
+      part[i] = _mm_setzero_si128();
+   }
+
+   for (j = 0; j < nr_planes; j++) {
+      const __m128i xdcdy = _mm_set1_epi64x(dcdy[j]);
+      __m128i cstep01 = _mm_set_epi64x(c[j] + dcdx[j], c[j]);
+      __m128i cstep23 = _mm_set_epi64x(c[j] + dcdx[j] * 3,
+                                       c[j] + dcdx[j] * 2);
+
+      for (i = 0; i < 4; i++) {
+         out[i * 2 + 0] = _mm_or_si128(out[i * 2 + 0], cstep01);
+         out[i * 2 + 1] = _mm_or_si128(out[i * 2 + 1], cstep23);
+         if (cdiff) {
+            const __m128i xcdiff = _mm_set1_epi64x(cdiff[j]);
+            part[i * 2 + 0] = _mm_or_si128(part[i * 2 + 0],
+                                           _mm_add_epi64(cstep01, xcdiff));
+            part[i * 2 + 1] = _mm_or_si128(part[i * 2 + 1],
+                                           _mm_add_epi64(cstep23, xcdiff));
+         }
+         cstep01 = _mm_add_epi64(cstep01, xdcdy);
+         cstep23 = _mm_add_epi64(cstep23, xdcdy);
+      }
+   }
+
+   for (i = 0; i < 8; i++) {
+      *outmask |= _mm_movemask_pd(_mm_castsi128_pd(out[i])) << (i * 2);
+      if (cdiff) {
+         *partmask |= _mm_movemask_pd(_mm_castsi128_pd(part[i])) << (i * 2);
+      }
+   }
+#else
+   unsigned j;
+
+   for (j = 0; j < nr_planes; j++) {
+      *outmask |= build_mask_linear(c[j], dcdx[j], dcdy[j]);
+      if (cdiff) {
+         *partmask |= build_mask_linear(c[j] + cdiff[j], dcdx[j], dcdy[j]);
+      }
+   }
+#endif
+}
+
+
+
+#if defined(PIPE_ARCH_SSE)
+
+/**
+ * Same as build_masks(), for planes whose values fit in 32 bits.
+ */
+static INLINE void
+build_masks_32(unsigned nr_planes,
+               const int64_t *c,
+               const int64_t *cdiff,
+               const int64_t *dcdx,
+               const int64_t *dcdy,
+               unsigned *outmask,
+               unsigned *partmask)
+{
+#if defined(LP_RAST_AVX2)
+   /* Two rows per vector */
+   __m256i out[2], part[2];
+   unsigned i, j;
+
+   for (i = 0; i < 2; i++) {
+      out[i] = _mm256_setzero_si256();
+      part[i] = _mm256_setzero_si256();
+   }
+
+   for (j = 0; j < nr_planes; j++) {
+      const int c0 = (int) c[j];
+      const int dx = (int) dcdx[j];
+      const int dy = (int) dcdy[j];
+      const __m256i xdcdy2 = _mm256_set1_epi32(dy * 2);
+      __m256i cstep = _mm256_setr_epi32(c0, c0 + dx, c0 + dx*2, c0 + dx*3,
+                                        c0 + dy, c0 + dy + dx,
+                                        c0 + dy + dx*2, c0 + dy + dx*3);
+
+      for (i = 0; i < 2; i++) {
+         out[i] = _mm256_or_si256(out[i], cstep);
+         if (cdiff) {
+            const __m256i xcdiff = _mm256_set1_epi32((int) cdiff[j]);
+            part[i] = _mm256_or_si256(part[i],
+                                      _mm256_add_epi32(cstep, xcdiff));
+         }
+         cstep = _mm256_add_epi32(cstep, xdcdy2);
+      }
+   }
+
+   *outmask |= _mm256_movemask_ps(_mm256_castsi256_ps(out[0])) |
+               _mm256_movemask_ps(_mm256_castsi256_ps(out[1])) << 8;
+   if (cdiff) {
+      *partmask |= _mm256_movemask_ps(_mm256_castsi256_ps(part[0])) |
+                   _mm256_movemask_ps(_mm256_castsi256_ps(part[1])) << 8;
+   }
+#else
+   __m128i out[4], part[4];
+   unsigned i, j;
+
+   for (i = 0; i < 4; i++) {
+      out[i] = _mm_setzero_si128();
+      part[i] = _mm_setzero_si128();
+   }
+
+   for (j = 0; j < nr_planes; j++) {
+      const int c0 = (int) c[j];
+      const int dx = (int) dcdx[j];
+      const __m128i xdcdy = _mm_set1_epi32((int) dcdy[j]);
+      __m128i cstep = _mm_setr_epi32(c0, c0 + dx, c0 + dx*2, c0 + dx*3);
+
+      for (i = 0; i < 4; i++) {
+         out[i] = _mm_or_si128(out[i], cstep);
+         if (cdiff) {
+            const __m128i xcdiff = _mm_set1_epi32((int) cdiff[j]);
+            part[i] = _mm_or_si128(part[i], _mm_add_epi32(cstep, xcdiff));
+         }
+         cstep = _mm_add_epi32(cstep, xdcdy);
+      }
+   }
+
+   /* Pack down to epi8, preserving the sign bits, and extract them
+    */
+   {
+      __m128i out01 = _mm_packs_epi32(out[0], out[1]);
+      __m128i out23 = _mm_packs_epi32(out[2], out[3]);
+      *outmask |= _mm_movemask_epi8(_mm_packs_epi16(out01, out23));
+   }
+
+   if (cdiff) {
+      __m128i part01 = _mm_packs_epi32(part[0], part[1]);
+      __m128i part23 = _mm_packs_epi32(part[2], part[3]);
+      *partmask |= _mm_movemask_epi8(_mm_packs_epi16(part01, part23));
+   }
+#endif
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+#endif /* LP_RAST_MASKS_H */
@@ -123,14 +123,20 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread, at least one */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   pipe_thread threads[LP_MAX_THREADS];
+   pipe_thread *threads;
 
-   /** For synchronizing the rasterization threads */
-   pipe_barrier barrier;
+   /**
+    * Only wake as many threads as the current scene has non-empty bins
+    * (LP_ADAPTIVE_THREADS, on by default).
+    */
+   boolean adaptive_threads;
+
+   /** Number of threads rasterizing curr_scene, including thread 0 */
+   unsigned num_active_threads;
 };
 
 
@@ -323,18 +329,18 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                         x, y,
-                                         inputs->frontfacing,
-                                         GET_A0(inputs),
-                                         GET_DADX(inputs),
-                                         GET_DADY(inputs),
-                                         color,
-                                         depth,
-                                         0xffff,
-                                         &task->thread_data,
-                                         stride,
-                                         depth_stride);
+      state->jit_function[RAST_WHOLE]( &state->jit_context,
+                                       x, y,
+                                       inputs->frontfacing,
+                                       GET_A0(inputs),
+                                       GET_DADX(inputs),
+                                       GET_DADY(inputs),
+                                       color,
+                                       depth,
+                                       0xffff,
+                                       &task->thread_data,
+                                       stride,
+                                       depth_stride);
       END_JIT_CALL();
    }
 }
@@ -34,6 +34,12 @@
 #include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_rast_priv.h"
+#include "lp_rast_masks.h"
+
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#include "util/u_sse.h"
+#endif
 
 /**
  * Shade all pixels in a 4x4 block.
@@ -64,48 +70,16 @@ block_full_16(struct lp_rasterizer_task *task,
 }
 
 static INLINE unsigned
-build_mask_linear(int64_t c, int64_t dcdx, int64_t dcdy)
+build_mask_linear_planes(unsigned nr_planes,
+                         const int64_t *c,
+                         const int64_t *dcdx,
+                         const int64_t *dcdy)
 {
    unsigned mask = 0;
-
-   int64_t c0 = c;
-   int64_t c1 = c0 + dcdy;
-   int64_t c2 = c1 + dcdy;
-   int64_t c3 = c2 + dcdy;
-
-   mask |= ((c0 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 0);
-   mask |= ((c0 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 1);
-   mask |= ((c0 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 2);
-   mask |= ((c0 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 3);
-   mask |= ((c1 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 4);
-   mask |= ((c1 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 5);
-   mask |= ((c1 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 6);
-   mask |= ((c1 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 7);
-   mask |= ((c2 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 8);
-   mask |= ((c2 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 9);
-   mask |= ((c2 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 10);
-   mask |= ((c2 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 11);
-   mask |= ((c3 + 0 * dcdx) >> FIXED_SHIFT) & (1 << 12);
-   mask |= ((c3 + 1 * dcdx) >> FIXED_SHIFT) & (1 << 13);
-   mask |= ((c3 + 2 * dcdx) >> FIXED_SHIFT) & (1 << 14);
-   mask |= ((c3 + 3 * dcdx) >> FIXED_SHIFT) & (1 << 15);
-  
+   build_masks(nr_planes, c, NULL, dcdx, dcdy, &mask, NULL);
    return mask;
 }
 
-
-static INLINE void
-build_masks(int64_t c,
-            int64_t cdiff,
-            int64_t dcdx,
-            int64_t dcdy,
-	    unsigned *outmask,
-	    unsigned *partmask)
-{
-   *outmask |= build_mask_linear(c, dcdx, dcdy);
-   *partmask |= build_mask_linear(c + cdiff, dcdx, dcdy);
-}
-
 void
 lp_rast_triangle_3_16(struct lp_rasterizer_task *task,
                       const union lp_rast_cmd_arg arg)
@@ -163,80 +137,17 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 }
 
 #else
-#include <emmintrin.h>
-#include "util/u_sse.h"
-
-
-static INLINE void
-build_masks_32(int c, 
-               int cdiff,
-               int dcdx,
-               int dcdy,
-               unsigned *outmask,
-               unsigned *partmask)
-{
-   __m128i cstep0 = _mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3);
-   __m128i xdcdy = _mm_set1_epi32(dcdy);
-
-   /* Get values across the quad
-    */
-   __m128i cstep1 = _mm_add_epi32(cstep0, xdcdy);
-   __m128i cstep2 = _mm_add_epi32(cstep1, xdcdy);
-   __m128i cstep3 = _mm_add_epi32(cstep2, xdcdy);
-
-   {
-      __m128i cstep01, cstep23, result;
-
-      cstep01 = _mm_packs_epi32(cstep0, cstep1);
-      cstep23 = _mm_packs_epi32(cstep2, cstep3);
-      result = _mm_packs_epi16(cstep01, cstep23);
-
-      *outmask |= _mm_movemask_epi8(result);
-   }
-
-
-   {
-      __m128i cio4 = _mm_set1_epi32(cdiff);
-      __m128i cstep01, cstep23, result;
-
-      cstep0 = _mm_add_epi32(cstep0, cio4);
-      cstep1 = _mm_add_epi32(cstep1, cio4);
-      cstep2 = _mm_add_epi32(cstep2, cio4);
-      cstep3 = _mm_add_epi32(cstep3, cio4);
-
-      cstep01 = _mm_packs_epi32(cstep0, cstep1);
-      cstep23 = _mm_packs_epi32(cstep2, cstep3);
-      result = _mm_packs_epi16(cstep01, cstep23);
-
-      *partmask |= _mm_movemask_epi8(result);
-   }
-}
 
 
 static INLINE unsigned
-build_mask_linear_32(int c, int dcdx, int dcdy)
+build_mask_linear_planes_32(unsigned nr_planes,
+                            const int64_t *c,
+                            const int64_t *dcdx,
+                            const int64_t *dcdy)
 {
-   __m128i cstep0 = _mm_setr_epi32(c, c+dcdx, c+dcdx*2, c+dcdx*3);
-   __m128i xdcdy = _mm_set1_epi32(dcdy);
-
-   /* Get values across the quad
-    */
-   __m128i cstep1 = _mm_add_epi32(cstep0, xdcdy);
-   __m128i cstep2 = _mm_add_epi32(cstep1, xdcdy);
-   __m128i cstep3 = _mm_add_epi32(cstep2, xdcdy);
-
-   /* pack pairs of results into epi16
-    */
-   __m128i cstep01 = _mm_packs_epi32(cstep0, cstep1);
-   __m128i cstep23 = _mm_packs_epi32(cstep2, cstep3);
-
-   /* pack into epi8, preserving sign bits
-    */
-   __m128i result = _mm_packs_epi16(cstep01, cstep23);
-
-   /* extract sign bits to create mask
-    */
-   return _mm_movemask_epi8(result);
+   unsigned mask = 0;
+   build_masks_32(nr_planes, c, NULL, dcdx, dcdy, &mask, NULL);
+   return mask;
 }
 
 static INLINE unsigned
@@ -474,8 +385,8 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 #endif
 
 
-#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks(c, cdiff, dcdx, dcdy, omask, pmask)
-#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear(c, dcdx, dcdy)
+#define BUILD_MASKS(n, c, cdiff, dcdx, dcdy, omask, pmask) build_masks(n, c, cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(n, c, dcdx, dcdy) build_mask_linear_planes(n, c, dcdx, dcdy)
 
 #define TAG(x) x##_1
 #define NR_PLANES 1
@@ -515,8 +426,8 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 #ifdef PIPE_ARCH_SSE
 #undef BUILD_MASKS
 #undef BUILD_MASK_LINEAR
-#define BUILD_MASKS(c, cdiff, dcdx, dcdy, omask, pmask) build_masks_32((int)c, (int)cdiff, dcdx, dcdy, omask, pmask)
-#define BUILD_MASK_LINEAR(c, dcdx, dcdy) build_mask_linear_32((int)c, dcdx, dcdy)
+#define BUILD_MASKS(n, c, cdiff, dcdx, dcdy, omask, pmask) build_masks_32(n, c, cdiff, dcdx, dcdy, omask, pmask)
+#define BUILD_MASK_LINEAR(n, c, dcdx, dcdy) build_mask_linear_planes_32(n, c, dcdx, dcdy)
 #endif
 
 #define TAG(x) x##_32_1
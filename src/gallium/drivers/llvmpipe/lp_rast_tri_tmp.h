@@ -37,7 +37,6 @@
  *
  * XXX: Varients for more/fewer planes.
  * XXX: Need ways of dropping planes as we descend.
- * XXX: SIMD
  */
 static void
 TAG(do_block_4)(struct lp_rasterizer_task *task,
@@ -46,15 +45,18 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
                 int x, int y,
                 const int64_t *c)
 {
-   unsigned mask = 0xffff;
+   int64_t cm1[NR_PLANES], dcdx[NR_PLANES], dcdy[NR_PLANES];
+   unsigned mask;
    int j;
 
    for (j = 0; j < NR_PLANES; j++) {
-      mask &= ~BUILD_MASK_LINEAR(c[j] - 1, 
-				 -plane[j].dcdx,
-				 plane[j].dcdy);
+      cm1[j] = c[j] - 1;
+      dcdx[j] = -plane[j].dcdx;
+      dcdy[j] = plane[j].dcdy;
    }
 
+   mask = 0xffff & ~BUILD_MASK_LINEAR(NR_PLANES, cm1, dcdx, dcdy);
+
    /* Now pass to the shader:
     */
    if (mask)
@@ -72,6 +74,8 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
                  int x, int y,
                  const int64_t *c)
 {
+   int64_t cox[NR_PLANES], cdiff[NR_PLANES];
+   int64_t dcdx[NR_PLANES], dcdy[NR_PLANES];
    unsigned outmask, inmask, partmask, partial_mask;
    unsigned j;
 
@@ -79,19 +83,21 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
    partmask = 0;                /* outside one or more trivial accept planes */
 
    for (j = 0; j < NR_PLANES; j++) {
-      const int64_t dcdx = -IMUL64(plane[j].dcdx, 4);
-      const int64_t dcdy = IMUL64(plane[j].dcdy, 4);
-      const int64_t cox = IMUL64(plane[j].eo, 4);
       const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
       const int64_t cio = IMUL64(ei, 4) - 1;
 
-      BUILD_MASKS(c[j] + cox,
-		  cio - cox,
-		  dcdx, dcdy, 
-		  &outmask,   /* sign bits from c[i][0..15] + cox */
-		  &partmask); /* sign bits from c[i][0..15] + cio */
+      dcdx[j] = -IMUL64(plane[j].dcdx, 4);
+      dcdy[j] = IMUL64(plane[j].dcdy, 4);
+      cox[j] = c[j] + IMUL64(plane[j].eo, 4);
+      cdiff[j] = cio - IMUL64(plane[j].eo, 4);
    }
 
+   BUILD_MASKS(NR_PLANES,
+               cox, cdiff,
+               dcdx, dcdy,
+               &outmask,   /* sign bits from c[i][0..15] + cox */
+               &partmask); /* sign bits from c[i][0..15] + cio */
+
    if (outmask == 0xffff)
       return;
 
@@ -161,6 +167,8 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
    const int x = task->x, y = task->y;
    struct lp_rast_plane plane[NR_PLANES];
    int64_t c[NR_PLANES];
+   int64_t cox[NR_PLANES], cdiff[NR_PLANES];
+   int64_t dcdx[NR_PLANES], dcdy[NR_PLANES];
    unsigned outmask, inmask, partmask, partial_mask;
    unsigned j = 0;
 
@@ -179,22 +187,28 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       c[j] = plane[j].c + IMUL64(plane[j].dcdy, y) - IMUL64(plane[j].dcdx, x);
 
       {
-         const int64_t dcdx = -IMUL64(plane[j].dcdx, 16);
-         const int64_t dcdy = IMUL64(plane[j].dcdy, 16);
-         const int64_t cox = IMUL64(plane[j].eo, 16);
          const int64_t ei = plane[j].dcdy - plane[j].dcdx - plane[j].eo;
          const int64_t cio = IMUL64(ei, 16) - 1;
 
-         BUILD_MASKS(c[j] + cox,
-                     cio - cox,
-                     dcdx, dcdy,
-                     &outmask,   /* sign bits from c[i][0..15] + cox */
-                     &partmask); /* sign bits from c[i][0..15] + cio */
+         dcdx[j] = -IMUL64(plane[j].dcdx, 16);
+         dcdy[j] = IMUL64(plane[j].dcdy, 16);
+         cox[j] = c[j] + IMUL64(plane[j].eo, 16);
+         cdiff[j] = cio - IMUL64(plane[j].eo, 16);
       }
 
       j++;
    }
 
+   assert(j == NR_PLANES);
+
+   /* Test the 16 16x16 blocks of the tile against all planes at once
+    */
+   BUILD_MASKS(NR_PLANES,
+               cox, cdiff,
+               dcdx, dcdy,
+               &outmask,   /* sign bits from c[i][0..15] + cox */
+               &partmask); /* sign bits from c[i][0..15] + cio */
+
    if (outmask == 0xffff)
       return;
 
@@ -34,6 +34,7 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "util/u_atomic.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -48,10 +49,10 @@ struct resource_ref {
 
 /**
  * Create a new scene object.
- * \param queue  the queue to put newly rendered/emptied scenes into
+ * \param num_threads  the number of threads that will rasterize the scene
  */
 struct lp_scene *
-lp_scene_create( struct pipe_context *pipe )
+lp_scene_create( struct pipe_context *pipe, unsigned num_threads )
 {
    struct lp_scene *scene = CALLOC_STRUCT(lp_scene);
    if (!scene)
@@ -64,6 +65,16 @@ lp_scene_create( struct pipe_context *pipe )
 
    pipe_mutex_init(scene->mutex);
 
+   scene->max_bin_ranges = MAX2(num_threads, 1);
+   scene->bin_ranges = align_malloc(scene->max_bin_ranges *
+                                    sizeof(struct bin_range), 64);
+   if (!scene->data.head || !scene->bin_ranges) {
+      FREE(scene->data.head);
+      align_free(scene->bin_ranges);
+      FREE(scene);
+      return NULL;
+   }
+
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,9 +101,11 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
+   lp_fence_reference(&scene->queued_fence, NULL);
    pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
+   align_free(scene->bin_ranges);
    FREE(scene);
 }
 
@@ -208,6 +221,8 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 {
    int i, j;
 
+   pipe_mutex_lock(scene->mutex);
+
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->cbufs[i].map) {
@@ -296,6 +311,8 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    scene->alloc_failed = FALSE;
 
    util_unreference_framebuffer_state( &scene->fb );
+
+   pipe_mutex_unlock(scene->mutex);
 }
 
 
@@ -427,81 +444,184 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 /**
  * Does this scene have a reference to the given resource?
+ * Returns a mask of LP_REFERENCED_FOR_READ/WRITE flags.  The scene may be
+ * in the middle of being rasterized.
  */
-boolean
-lp_scene_is_resource_referenced(const struct lp_scene *scene,
+unsigned
+lp_scene_is_resource_referenced(struct lp_scene *scene,
                                 const struct pipe_resource *resource)
 {
    const struct resource_ref *ref;
+   unsigned referenced = LP_UNREFERENCED;
    int i;
 
-   for (ref = scene->resources; ref; ref = ref->next) {
+   pipe_mutex_lock(scene->mutex);
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+   }
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource)
+      referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
+   for (ref = scene->resources; ref && !referenced; ref = ref->next) {
       for (i = 0; i < ref->count; i++)
          if (ref->resource[i] == resource)
-            return TRUE;
+            referenced = LP_REFERENCED_FOR_READ;
    }
 
-   return FALSE;
+   pipe_mutex_unlock(scene->mutex);
+
+   return referenced;
 }
 
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/** Extract the even bits of a Morton code */
+static unsigned
+morton_compact(unsigned d)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
+   d &= 0x55555555;
+   d = (d | (d >> 1)) & 0x33333333;
+   d = (d | (d >> 2)) & 0x0f0f0f0f;
+   d = (d | (d >> 4)) & 0x00ff00ff;
+   d = (d | (d >> 8)) & 0x0000ffff;
+   return d;
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+/**
+ * Recompute lp_scene::bin_order, listing the bins in Z order.
+ */
+static void
+compute_bin_order(struct lp_scene *scene)
 {
-   scene->curr_x = scene->curr_y = -1;
+   const unsigned side = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                     scene->tiles_y));
+   unsigned d, n = 0;
+
+   STATIC_ASSERT(TILES_X <= 256 && TILES_Y <= 256);
+
+   for (d = 0; d < side * side; d++) {
+      const unsigned x = morton_compact(d);
+      const unsigned y = morton_compact(d >> 1);
+
+      if (x < scene->tiles_x && y < scene->tiles_y)
+         scene->bin_order[n++] = (y << 8) | x;
+   }
+
+   assert(n == scene->tiles_x * scene->tiles_y);
+   (void) n;
+
+   scene->bin_order_tiles_x = scene->tiles_x;
+   scene->bin_order_tiles_y = scene->tiles_y;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Queue the non-empty bins in Z order and split them among at most
+ * \p num_threads threads.  Each thread starts on its own part of the
+ * screen, and helps the others once it is done with it.
+ *
+ * Returns the number of threads that were given a share, which is less
+ * than \p num_threads when the scene has fewer non-empty bins than that.
+ * Threads beyond the returned number only steal from the others.
  */
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+unsigned
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
 {
-   struct cmd_bin *bin = NULL;
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned i, n = 0;
 
-   pipe_mutex_lock(scene->mutex);
+   assert(num_threads > 0 && num_threads <= scene->max_bin_ranges);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
+   if (scene->bin_order_tiles_x != scene->tiles_x ||
+       scene->bin_order_tiles_y != scene->tiles_y)
+      compute_bin_order(scene);
+
+   for (i = 0; i < num_bins; i++) {
+      const unsigned packed = scene->bin_order[i];
+
+      if (lp_scene_get_bin(scene, packed & 0xff, packed >> 8)->head)
+         scene->bin_queue[n++] = packed;
    }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   scene->num_queued_bins = n;
+
+   num_threads = MAX2(MIN2(num_threads, n), 1);
+
+   for (i = 0; i < num_threads; i++) {
+      const unsigned begin = n * i / num_threads;
+      const unsigned end = n * (i + 1) / num_threads;
+
+      p_atomic_set(&scene->bin_ranges[i].bounds, (end << 16) | begin);
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   scene->num_bin_ranges = num_threads;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+   return num_threads;
+}
+
+
+/**
+ * Take a position in lp_scene::bin_queue out of \p range, from the front
+ * for the thread owning the range and from the back for other threads.
+ * Returns -1 if the range is exhausted.
+ */
+static int
+claim_bin(struct bin_range *range, boolean steal)
+{
+   int32_t bounds, new_bounds;
+   unsigned next, end;
+
+   do {
+      bounds = p_atomic_read(&range->bounds);
+      next = bounds & 0xffff;
+      end = (unsigned) bounds >> 16;
+
+      if (next >= end)
+         return -1;
+
+      if (steal)
+         new_bounds = (--end << 16) | next;
+      else
+         new_bounds = (end << 16) | ++next;
+   } while (p_atomic_cmpxchg(&range->bounds, bounds, new_bounds) != bounds);
+
+   return steal ? end : next - 1;
+}
+
+
+/**
+ * Return pointer to next bin to be rendered by the thread \p thread_index.
+ * Multiple rendering threads will call this function to get a chunk
+ * of work (a bin) to work on.  \p stolen is set when the bin came from
+ * another thread's share.
+ */
+struct cmd_bin *
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen )
+{
+   const unsigned num_ranges = scene->num_bin_ranges;
+   const boolean has_range = thread_index < num_ranges;
+   unsigned i;
+
+   for (i = 0; i < num_ranges; i++) {
+      const unsigned victim = (thread_index + i) % num_ranges;
+      const boolean steal = !has_range || i != 0;
+      const int pos = claim_bin(&scene->bin_ranges[victim], steal);
+
+      if (pos >= 0) {
+         const unsigned packed = scene->bin_queue[pos];
+
+         *x = packed & 0xff;
+         *y = packed >> 8;
+         *stolen = steal;
+         return lp_scene_get_bin(scene, *x, *y);
+      }
+   }
+
+   return NULL;
 }
 
 
@@ -49,6 +49,19 @@ struct lp_rast_state;
 #define TILES_Y (LP_MAX_HEIGHT / TILE_SIZE)
 
 
+/**
+ * A contiguous share of lp_scene::bin_queue handed to one rasterizer
+ * thread.  The first and one-past-the-last positions are packed in a
+ * single word, so that the owner can take bins from the front and other
+ * threads can steal from the back with one compare-and-swap.  Each range
+ * gets its own cache line.
+ */
+struct bin_range {
+   int32_t bounds;   /**< (end << 16) | next */
+   char pad[64 - sizeof(int32_t)];
+};
+
+
 /* Commands per command block (ideally so sizeof(cmd_block) is a power of
  * two in size.)
  */
@@ -62,6 +75,12 @@ struct lp_rast_state;
  */
 #define LP_SCENE_MAX_SIZE (9*1024*1024)
 
+/* Scene temporary storage of all the scenes of a context which are queued
+ * or being rasterized.  Setup waits for the oldest scenes to finish before
+ * starting a new scene beyond this:
+ */
+#define LP_SCENE_MAX_QUEUED_SIZE (2 * LP_SCENE_MAX_SIZE)
+
 /* The maximum amount of texture storage referenced by a scene is
  * clamped ot this size:
  */
@@ -153,6 +172,17 @@ struct lp_scene {
    /** list of resources referenced by the scene commands */
    struct resource_ref *resources;
 
+   /** Protects fb and resources against lp_scene_end_rasterization(),
+    * which is called by the rasterizer while setup may be looking at them.
+    */
+   pipe_mutex mutex;
+
+   /** The fence of the last rasterization of this scene and the amount of
+    * scene data which was queued with it.  Only used by setup.
+    */
+   struct lp_fence *queued_fence;
+   unsigned queued_size;
+
    /** Total memory used by the scene (in bytes).  This sums all the
     * data blocks and counts all bins, state, resource references and
     * other random allocations within the scene.
@@ -173,8 +203,22 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
+   /**
+    * All bins in Z (Morton) order, packed as (y << 8) | x, so that
+    * consecutive bins are close together on screen.  Only recomputed when
+    * the number of tiles changes.
+    */
+   uint16_t bin_order[TILES_X * TILES_Y];
+   unsigned bin_order_tiles_x, bin_order_tiles_y;
+
+   /** The non-empty bins of this scene, in the same order as bin_order */
+   uint16_t bin_queue[TILES_X * TILES_Y];
+   unsigned num_queued_bins;
+
+   /** Per-thread shares of bin_queue, for iterating over bins */
+   struct bin_range *bin_ranges;
+   unsigned max_bin_ranges;
+   unsigned num_bin_ranges;
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -182,7 +226,8 @@ struct lp_scene {
 
 
 
-struct lp_scene *lp_scene_create(struct pipe_context *pipe);
+struct lp_scene *lp_scene_create(struct pipe_context *pipe,
+                                 unsigned num_threads);
 
 void lp_scene_destroy(struct lp_scene *scene);
 
@@ -199,8 +244,8 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
                                         boolean initializing_scene);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+unsigned lp_scene_is_resource_referenced(struct lp_scene *scene,
+                                         const struct pipe_resource *resource );
 
 
 /**
@@ -378,11 +423,12 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+unsigned
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen );
 
 
 
@@ -38,7 +38,10 @@
 
 
 
-#define MAX_SCENE_QUEUE 4
+/* Scenes queued by all the contexts of a screen.  Contexts block when this
+ * is full.
+ */
+#define MAX_SCENE_QUEUE 64
 
 struct scene_packet {
    struct util_packet header;
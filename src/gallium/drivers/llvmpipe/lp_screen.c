@@ -35,6 +35,7 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
+#include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_type.h"
 
 #include "os/os_time.h"
@@ -47,6 +48,8 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_jit_queue.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -421,8 +424,15 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* Rendering may still be in progress, see lp_setup_rasterize_scene() */
+      if (texture->dt_fence) {
+         lp_fence_wait(texture->dt_fence);
+         lp_fence_reference(&texture->dt_fence, NULL);
+      }
+
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
 }
 
 static void
@@ -434,6 +444,9 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (screen->jit_queue)
+      lp_jit_queue_destroy(screen->jit_queue);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -494,6 +507,26 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   static const struct pipe_driver_query_info queries[] = {
+      {"vertex-cache-hits", LP_QUERY_VERTEX_CACHE_HITS, 0, FALSE},
+      {"vertex-cache-misses", LP_QUERY_VERTEX_CACHE_MISSES, 0, FALSE}
+   };
+
+   if (!info)
+      return Elements(queries);
+
+   if (index >= Elements(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -539,6 +572,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -549,7 +583,14 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = 0;
 #endif
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
-   screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+
+   screen->num_jit_threads = MIN2(screen->num_threads, 2);
+   screen->num_jit_threads = debug_get_num_option("LP_JIT_THREADS", screen->num_jit_threads);
+   /* Compiling in the background needs a JIT that can run in several
+    * threads at once.
+    */
+   if (!gallivm_jit_is_thread_safe())
+      screen->num_jit_threads = 0;
 
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
@@ -559,6 +600,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    pipe_mutex_init(screen->rast_mutex);
 
+   if (screen->num_jit_threads)
+      screen->jit_queue = lp_jit_queue_create(screen->num_jit_threads);
+
    util_format_s3tc_init();
 
    return &screen->base;
@@ -57,6 +57,10 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Optimized fragment shader variants are compiled on these threads */
+   unsigned num_jit_threads;
+   struct lp_jit_queue *jit_queue;
 };
 
 
@@ -63,22 +63,60 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Wait for a queued scene to be rasterized.
+ */
+static void
+wait_for_scene(struct lp_scene *scene, const char *reason)
+{
+   if (!lp_fence_signalled(scene->queued_fence)) {
+      if (LP_DEBUG & DEBUG_SETUP)
+         debug_printf("%s: wait for scene %d\n",
+                      reason, scene->queued_fence->id);
+
+      lp_fence_wait(scene->queued_fence);
+   }
+
+   lp_fence_reference(&scene->queued_fence, NULL);
+   scene->queued_size = 0;
+}
+
+
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
+   unsigned queued_size = 0;
+   unsigned i;
+
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= Elements(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
-   if (setup->scene->fence) {
-      if (LP_DEBUG & DEBUG_SETUP)
-         debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+   /* The scenes are used in turn, so this is the oldest one.
+    */
+   if (setup->scene->queued_fence)
+      wait_for_scene(setup->scene, __FUNCTION__);
 
-      lp_fence_wait(setup->scene->fence);
+   /* Also wait for the oldest of the other scenes while too much scene
+    * data is queued.
+    */
+   for (i = 1; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[(setup->scene_idx + i) %
+                                             setup->num_scenes];
+      queued_size += scene->queued_size;
+   }
+
+   for (i = 1; i < setup->num_scenes &&
+               queued_size > LP_SCENE_MAX_QUEUED_SIZE; i++) {
+      struct lp_scene *scene = setup->scenes[(setup->scene_idx + i) %
+                                             setup->num_scenes];
+      if (scene->queued_fence) {
+         queued_size -= scene->queued_size;
+         wait_for_scene(scene, __FUNCTION__);
+      }
    }
 
    lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
@@ -128,6 +166,7 @@ void lp_setup_reset( struct lp_setup_context *setup )
       setup->constants[i].stored_data = NULL;
    }
    setup->fs.stored = NULL;
+   setup->fs.pending = NULL;
    setup->dirty = ~0;
 
    /* no current bin */
@@ -152,6 +191,18 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 {
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   struct lp_setup_pending_state *pending;
+   unsigned i;
+
+   /* The scene can't be rasterized without the code of all its fragment
+    * shaders, so this is where compiling them in the background stalls,
+    * if anywhere.
+    */
+   for (pending = setup->fs.pending; pending; pending = pending->next) {
+      llvmpipe_get_fs_jit_functions(llvmpipe_context(setup->pipe),
+                                    pending->state->variant, TRUE,
+                                    pending->state->jit_function);
+   }
 
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
@@ -164,12 +215,28 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
+   /* Remember what to wait for before the scene can be reused.  The
+    * rasterizer resets the scene, and setup goes on with the next one
+    * in the meantime.
+    */
+   lp_fence_reference(&scene->queued_fence, scene->fence);
+   scene->queued_size = scene->scene_size;
+
+   /* Presenting a display target doesn't flush, so remember the fence
+    * to wait for there.
+    */
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+      if (cbuf && llvmpipe_resource(cbuf->texture)->dt) {
+         lp_fence_reference(&llvmpipe_resource(cbuf->texture)->dt_fence,
+                            scene->fence);
+      }
+   }
+
    pipe_mutex_lock(screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    pipe_mutex_unlock(screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -187,9 +254,10 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  It is signalled once, when the last
+    * rasterizer thread is done with the scene:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -889,10 +957,14 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < Elements(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+   /* check the framebuffers and textures of the scenes, including those
+    * which are still queued for rasterization
+    */
+   for (i = 0; i < setup->num_scenes; i++) {
+      unsigned referenced =
+         lp_scene_is_resource_referenced(setup->scenes[i], texture);
+      if (referenced) {
+         return referenced;
       }
    }
 
@@ -1035,6 +1107,22 @@ try_update_scene_state( struct lp_setup_context *setup )
    }
 
 
+   if (setup->fs.current.variant) {
+      lp_jit_frag_func jit_function[2];
+
+      /* Switch to the code compiled in the background once it's ready.
+       */
+      llvmpipe_get_fs_jit_functions(llvmpipe_context(setup->pipe),
+                                    setup->fs.current.variant, FALSE,
+                                    jit_function);
+      if (memcmp(setup->fs.current.jit_function, jit_function,
+                 sizeof jit_function) != 0) {
+         memcpy(setup->fs.current.jit_function, jit_function,
+                sizeof jit_function);
+         setup->dirty |= LP_SETUP_NEW_FS;
+      }
+   }
+
    if (setup->dirty & LP_SETUP_NEW_FS) {
       if (!setup->fs.stored ||
           memcmp(setup->fs.stored,
@@ -1053,6 +1141,24 @@ try_update_scene_state( struct lp_setup_context *setup )
             return FALSE;
          }
 
+         /* Without code yet, get it when the scene is flushed.
+          */
+         if (setup->fs.current.variant &&
+             !setup->fs.current.jit_function[RAST_EDGE_TEST]) {
+            struct lp_setup_pending_state *pending;
+
+            pending = (struct lp_setup_pending_state *)
+               lp_scene_alloc(scene, sizeof *pending);
+            if (!pending) {
+               assert(!new_scene);
+               return FALSE;
+            }
+
+            pending->state = stored;
+            pending->next = setup->fs.pending;
+            setup->fs.pending = pending;
+         }
+
          memcpy(stored,
                 &setup->fs.current,
                 sizeof setup->fs.current);
@@ -1186,12 +1292,12 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < Elements(setup->scenes); i++) {
+   /* wait for the queued scenes, and free all the scenes */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
-         lp_fence_wait(scene->fence);
+      if (scene->queued_fence)
+         wait_for_scene(scene, __FUNCTION__);
 
       lp_scene_destroy(scene);
    }
@@ -1236,9 +1342,14 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
-   /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
+   /* create some empty scenes.  More scenes let setup get further ahead
+    * of the rasterizer threads.
+    */
+   setup->num_scenes = debug_get_num_option("LP_NUM_SCENES", DEFAULT_SCENES);
+   setup->num_scenes = CLAMP(setup->num_scenes, 1, MAX_SCENES);
+
+   for (i = 0; i < setup->num_scenes; i++) {
+      setup->scenes[i] = lp_scene_create( pipe, setup->num_threads );
       if (!setup->scenes[i]) {
          goto no_scenes;
       }
@@ -1253,7 +1364,7 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       if (setup->scenes[i]) {
          lp_scene_destroy(setup->scenes[i]);
       }
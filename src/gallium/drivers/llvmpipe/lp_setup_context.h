@@ -53,8 +53,21 @@
 struct lp_setup_variant;
 
 
+/**
+ * A state stored in the scene, whose fragment shader code was still
+ * being compiled when it was binned.
+ */
+struct lp_setup_pending_state {
+   struct lp_rast_state *state;
+   struct lp_setup_pending_state *next;
+};
+
+
 /** Max number of scenes */
-#define MAX_SCENES 2
+#define MAX_SCENES 16
+
+/** Default number of scenes, see LP_NUM_SCENES */
+#define DEFAULT_SCENES 4
 
 
 
@@ -86,6 +99,7 @@ struct lp_setup_context
    struct draw_stage *vbuf;
    unsigned num_threads;
    unsigned scene_idx;
+   unsigned num_scenes;                  /**< pipeline depth */
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
@@ -131,6 +145,7 @@ struct lp_setup_context
       const struct lp_rast_state *stored; /**< what's in the scene */
       struct lp_rast_state current;  /**< currently set state */
       struct pipe_resource *current_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+      struct lp_setup_pending_state *pending; /**< stored, lacking code */
    } fs;
 
    /** fragment shader constants */
@@ -101,6 +101,7 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_screen.h"
 
 
 /** Fragment shader number (for debugging) */
@@ -2121,8 +2122,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2407,8 +2407,6 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMBuildRetVoid(builder);
 
    gallivm_verify_function(gallivm, function);
-
-   variant->nr_instrs += lp_build_count_instructions(function);
 }
 
 
@@ -2515,6 +2513,180 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Generate the functions of the variant in variant->gallivm, compile them
+ * and return their entry points in \p jit_function.
+ *
+ * \return the number of LLVM instructions generated
+ */
+static unsigned
+compile_variant(struct lp_fragment_shader_variant *variant,
+                lp_jit_frag_func jit_function[2])
+{
+   unsigned nr_instrs;
+
+   lp_jit_init_types(variant);
+
+   generate_fragment(variant->shader, variant, RAST_EDGE_TEST);
+   nr_instrs = lp_build_count_instructions(variant->function[RAST_EDGE_TEST]);
+
+   if (variant->opaque) {
+      /* Specialized shader, which doesn't need to read the color buffer. */
+      generate_fragment(variant->shader, variant, RAST_WHOLE);
+      nr_instrs += lp_build_count_instructions(variant->function[RAST_WHOLE]);
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->function[RAST_EDGE_TEST]);
+
+   if (variant->function[RAST_WHOLE]) {
+      jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_WHOLE]);
+   } else {
+      jit_function[RAST_WHOLE] = jit_function[RAST_EDGE_TEST];
+   }
+
+   return nr_instrs;
+}
+
+
+/**
+ * Compile the unoptimized code of a variant on a JIT queue thread.
+ */
+static void
+compile_fallback_job(struct lp_jit_job *job, LLVMContextRef context)
+{
+   struct lp_fragment_shader_variant *variant =
+      (struct lp_fragment_shader_variant *)
+      ((char *) job - Offset(struct lp_fragment_shader_variant, fallback_job));
+
+   variant->gallivm = gallivm_create_in_context(context, TRUE);
+   if (!variant->gallivm)
+      return;
+
+   variant->nr_instrs = compile_variant(variant,
+                                        variant->fallback_jit_function);
+
+   /*
+    * Move the code out of the way of the optimized compilation, which is
+    * queued as soon as this returns.
+    */
+   variant->fallback_gallivm = variant->gallivm;
+   memcpy(variant->fallback_function, variant->function,
+          sizeof variant->function);
+
+   variant->gallivm = NULL;
+   memset(variant->function, 0, sizeof variant->function);
+   variant->jit_context_ptr_type = NULL;
+   variant->jit_thread_data_ptr_type = NULL;
+   variant->jit_linear_context_ptr_type = NULL;
+}
+
+
+/**
+ * Compile the optimized code of a variant on a JIT queue thread.
+ */
+static void
+compile_variant_job(struct lp_jit_job *job, LLVMContextRef context)
+{
+   struct lp_fragment_shader_variant *variant =
+      (struct lp_fragment_shader_variant *)
+      ((char *) job - Offset(struct lp_fragment_shader_variant, job));
+
+   variant->gallivm = gallivm_create_in_context(context, FALSE);
+   if (!variant->gallivm)
+      return;
+
+   /* The unoptimized code was counted already. */
+   (void) compile_variant(variant, variant->jit_function);
+}
+
+
+/**
+ * Stand-in for the code of a variant which failed to compile.
+ */
+static void
+null_fragment_function(const struct lp_jit_context *context,
+                       uint32_t x,
+                       uint32_t y,
+                       uint32_t facing,
+                       const void *a0,
+                       const void *dadx,
+                       const void *dady,
+                       uint8_t **color,
+                       uint8_t *depth,
+                       uint32_t mask,
+                       struct lp_jit_thread_data *thread_data,
+                       unsigned *stride,
+                       unsigned depth_stride)
+{
+}
+
+
+/**
+ * Get the entry points to rasterize \p variant with.  These are the
+ * unoptimized ones until the JIT queue is done with the optimized ones.
+ * Must be called on the context thread, for the queue to make what its
+ * jobs wrote visible.
+ *
+ * \param wait  wait for the unoptimized code if it isn't compiled yet
+ * \return FALSE, with NULL entry points, if there is no code yet
+ */
+boolean
+llvmpipe_get_fs_jit_functions(struct llvmpipe_context *lp,
+                              struct lp_fragment_shader_variant *variant,
+                              boolean wait,
+                              lp_jit_frag_func jit_function[2])
+{
+   if (!variant->optimized_done) {
+      struct lp_jit_queue *queue = llvmpipe_screen(lp->pipe.screen)->jit_queue;
+
+      if (!variant->fallback_done) {
+         if (wait)
+            lp_jit_queue_wait(queue, &variant->fallback_job);
+         else if (!lp_jit_queue_done(queue, &variant->fallback_job)) {
+            jit_function[RAST_EDGE_TEST] = NULL;
+            jit_function[RAST_WHOLE] = NULL;
+            return FALSE;
+         }
+
+         variant->fallback_done = TRUE;
+         lp->nr_fs_instrs += variant->nr_instrs;
+      }
+
+      /* There's nothing else to run if the fallback failed to compile. */
+      if (wait && !variant->fallback_gallivm)
+         lp_jit_queue_wait(queue, &variant->job);
+
+      if (lp_jit_queue_done(queue, &variant->job))
+         variant->optimized_done = TRUE;
+   }
+
+   if (variant->optimized_done && variant->gallivm) {
+      memcpy(jit_function, variant->jit_function, sizeof variant->jit_function);
+   }
+   else if (variant->fallback_gallivm) {
+      memcpy(jit_function, variant->fallback_jit_function,
+             sizeof variant->fallback_jit_function);
+   }
+   else {
+      /* out of memory; whatever the variant draws is lost */
+      jit_function[RAST_EDGE_TEST] = null_fragment_function;
+      jit_function[RAST_WHOLE] = null_fragment_function;
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
@@ -2524,6 +2696,7 @@ generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
    boolean fullcolormask;
@@ -2532,12 +2705,6 @@ generate_variant(struct llvmpipe_context *lp,
    if(!variant)
       return NULL;
 
-   variant->gallivm = gallivm_create();
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2576,36 +2743,27 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   /*
-    * Compile everything
-    */
-
-   gallivm_compile_module(variant->gallivm);
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
+   if (screen->jit_queue) {
+      /*
+       * Compile the variant in the background: first without
+       * optimizations, ahead of the other queued compilations, as the
+       * variant can't be rasterized without code; then with them.
+       */
+      variant->fallback_job.run = compile_fallback_job;
+      variant->fallback_job.followup = &variant->job;
+      variant->job.run = compile_variant_job;
+      lp_jit_queue_add(screen->jit_queue, &variant->fallback_job, TRUE);
    }
+   else {
+      variant->gallivm = gallivm_create();
+      if (!variant->gallivm) {
+         FREE(variant);
+         return NULL;
+      }
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+      variant->nr_instrs = compile_variant(variant, variant->jit_function);
+      variant->fallback_done = TRUE;
+      variant->optimized_done = TRUE;
    }
 
    return variant;
@@ -2732,6 +2890,8 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   pipe_mutex *fallback_context_mutex = NULL;
+   pipe_mutex *context_mutex = NULL;
    unsigned i;
 
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
@@ -2744,16 +2904,53 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   /* free all the variant's JIT'd functions */
-   for (i = 0; i < Elements(variant->function); i++) {
-      if (variant->function[i]) {
-         gallivm_free_function(variant->gallivm,
-                               variant->function[i],
-                               variant->jit_function[i]);
+   if (variant->fallback_job.run) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
+      /*
+       * Cancel or wait for the background compilations, in order, as the
+       * first one queues the second.
+       */
+      if (lp_jit_queue_finish(screen->jit_queue, &variant->fallback_job))
+         fallback_context_mutex = variant->fallback_job.context_mutex;
+      if (lp_jit_queue_finish(screen->jit_queue, &variant->job))
+         context_mutex = variant->job.context_mutex;
+   }
+
+   if (variant->fallback_gallivm) {
+      pipe_mutex_lock(*fallback_context_mutex);
+
+      for (i = 0; i < Elements(variant->fallback_function); i++) {
+         if (variant->fallback_function[i]) {
+            gallivm_free_function(variant->fallback_gallivm,
+                                  variant->fallback_function[i],
+                                  variant->fallback_jit_function[i]);
+         }
       }
+
+      gallivm_destroy(variant->fallback_gallivm);
+
+      pipe_mutex_unlock(*fallback_context_mutex);
    }
 
-   gallivm_destroy(variant->gallivm);
+   /* free all the variant's JIT'd functions */
+   if (variant->gallivm) {
+      if (context_mutex)
+         pipe_mutex_lock(*context_mutex);
+
+      for (i = 0; i < Elements(variant->function); i++) {
+         if (variant->function[i]) {
+            gallivm_free_function(variant->gallivm,
+                                  variant->function[i],
+                                  variant->jit_function[i]);
+         }
+      }
+
+      gallivm_destroy(variant->gallivm);
+
+      if (context_mutex)
+         pipe_mutex_unlock(*context_mutex);
+   }
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -2762,7 +2959,8 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
+   if (variant->fallback_done)
+      lp->nr_fs_instrs -= variant->nr_instrs;
 
    FREE(variant);
 }
@@ -3150,7 +3348,9 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
+         /* otherwise counted once compiled, by llvmpipe_get_fs_jit_functions() */
+         if (variant->fallback_done)
+            lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
@@ -36,6 +36,7 @@
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
+#include "lp_jit_queue.h" /* for struct lp_jit_job */
 
 
 struct tgsi_token;
@@ -110,6 +111,23 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /*
+    * With a JIT queue, fallback_job compiles the variant without
+    * optimizations into the fallback fields, then job compiles the
+    * optimized code into the fields above.  Both run on the queue's
+    * threads; the context only looks at their results once it has seen
+    * the job done, see llvmpipe_get_fs_jit_functions().
+    */
+   struct gallivm_state *fallback_gallivm;
+   LLVMValueRef fallback_function[2];
+   lp_jit_frag_func fallback_jit_function[2];
+   struct lp_jit_job fallback_job;
+   struct lp_jit_job job;
+
+   /* Whether the context has seen the jobs above done */
+   boolean fallback_done;
+   boolean optimized_done;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -153,5 +171,11 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 boolean
 llvmpipe_rasterization_disabled(struct llvmpipe_context *lp);
 
+boolean
+llvmpipe_get_fs_jit_functions(struct llvmpipe_context *lp,
+                              struct lp_fragment_shader_variant *variant,
+                              boolean wait,
+                              lp_jit_frag_func jit_function[2]);
+
 
 #endif /* LP_STATE_FS_H_ */
@@ -0,0 +1,575 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file
+ * Triangle rasterization benchmark.
+ *
+ * Draws batches of randomly placed and oriented triangles, with sizes
+ * drawn from several distributions, into a 1024x1024 render target, and
+ * reports the number of triangles rasterized per second.  Run with
+ * LP_NUM_THREADS=0 to measure a single rasterizer thread.
+ *
+ * Before that, the masks the rasterizer builds for random planes with
+ * build_masks() and build_masks_32() are checked against the scalar
+ * build_mask_linear().
+ */
+
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "os/os_time.h"
+#include "state_tracker/sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_rast_masks.h"
+#include "lp_test.h"
+
+
+#define TARGET_SIZE 1024
+
+/** Triangles per draw call */
+#define BATCH_SIZE 1024
+
+/** Random sets of planes checked by test_masks() */
+#define NUM_MASK_TESTS (64 * 1024)
+
+
+struct rast_distribution
+{
+   const char *name;
+
+   /** Range of the triangles' circumradius, in pixels */
+   float min_radius;
+   float max_radius;
+};
+
+
+static const struct rast_distribution
+distributions[] = {
+   { "tiny",    0.5f,    2.0f },
+   { "small",   2.0f,    8.0f },
+   { "medium",  8.0f,   32.0f },
+   { "large",  32.0f,  128.0f },
+   { "huge",  128.0f,  512.0f },
+   { "mixed",   0.5f,  512.0f },
+};
+
+
+struct rast_vertex
+{
+   float position[4];
+   float color[4];
+};
+
+
+struct rast_test
+{
+   struct sw_winsys winsys;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource *target;
+   struct pipe_surface *cbuf;
+   struct pipe_resource *vbuf;
+   void *blend;
+   void *dsa;
+   void *rasterizer;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "distribution\t"
+           "triangles\t"
+           "seconds\t"
+           "triangles_per_second\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct rast_distribution *dist,
+              unsigned num_tris,
+              double seconds)
+{
+   fprintf(fp,
+           "%s\t%u\t%f\t%f\n",
+           dist->name, num_tris, seconds, num_tris / seconds);
+
+   fflush(fp);
+}
+
+
+static boolean
+init_test(struct rast_test *test)
+{
+   struct pipe_context *pipe;
+   struct pipe_resource templ;
+   struct pipe_surface surf_templ;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rasterizer;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velems[2];
+   struct pipe_vertex_buffer vbuf;
+   const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+                                   TGSI_SEMANTIC_COLOR };
+   const uint semantic_indexes[] = { 0, 0 };
+
+   /* Only render targets are used, which don't need the winsys */
+   memset(&test->winsys, 0, sizeof test->winsys);
+
+   test->screen = llvmpipe_create_screen(&test->winsys);
+   if (!test->screen)
+      return FALSE;
+
+   test->pipe = pipe = test->screen->context_create(test->screen, NULL);
+   if (!pipe)
+      return FALSE;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = TARGET_SIZE;
+   templ.height0 = TARGET_SIZE;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   test->target = test->screen->resource_create(test->screen, &templ);
+   if (!test->target)
+      return FALSE;
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = templ.format;
+   test->cbuf = pipe->create_surface(pipe, test->target, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = TARGET_SIZE;
+   fb.height = TARGET_SIZE;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = test->cbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   test->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, test->blend);
+
+   memset(&dsa, 0, sizeof dsa);
+   test->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, test->dsa);
+
+   memset(&rasterizer, 0, sizeof rasterizer);
+   rasterizer.cull_face = PIPE_FACE_NONE;
+   rasterizer.half_pixel_center = 1;
+   rasterizer.bottom_edge_rule = 1;
+   rasterizer.depth_clip = 1;
+   test->rasterizer = pipe->create_rasterizer_state(pipe, &rasterizer);
+   pipe->bind_rasterizer_state(pipe, test->rasterizer);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = TARGET_SIZE / 2.0f;
+   viewport.scale[1] = TARGET_SIZE / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.scale[3] = 1.0f;
+   viewport.translate[0] = TARGET_SIZE / 2.0f;
+   viewport.translate[1] = TARGET_SIZE / 2.0f;
+   viewport.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_offset = Offset(struct rast_vertex, position);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = Offset(struct rast_vertex, color);
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   test->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, test->velems);
+
+   test->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                  semantic_indexes);
+   pipe->bind_vs_state(pipe, test->vs);
+
+   test->fs = util_make_fragment_passthrough_shader(pipe,
+                                                    TGSI_SEMANTIC_COLOR,
+                                                    TGSI_INTERPOLATE_PERSPECTIVE,
+                                                    TRUE);
+   pipe->bind_fs_state(pipe, test->fs);
+
+   test->vbuf = pipe_buffer_create(test->screen, PIPE_BIND_VERTEX_BUFFER,
+                                   PIPE_USAGE_STATIC,
+                                   BATCH_SIZE * 3 * sizeof(struct rast_vertex));
+   if (!test->vbuf)
+      return FALSE;
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = sizeof(struct rast_vertex);
+   vbuf.buffer = test->vbuf;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vbuf);
+
+   return TRUE;
+}
+
+
+static void
+fini_test(struct rast_test *test)
+{
+   struct pipe_context *pipe = test->pipe;
+
+   if (pipe) {
+      if (test->vs)
+         pipe->delete_vs_state(pipe, test->vs);
+      if (test->fs)
+         pipe->delete_fs_state(pipe, test->fs);
+      if (test->velems)
+         pipe->delete_vertex_elements_state(pipe, test->velems);
+      if (test->rasterizer)
+         pipe->delete_rasterizer_state(pipe, test->rasterizer);
+      if (test->dsa)
+         pipe->delete_depth_stencil_alpha_state(pipe, test->dsa);
+      if (test->blend)
+         pipe->delete_blend_state(pipe, test->blend);
+
+      pipe_surface_reference(&test->cbuf, NULL);
+      pipe->destroy(pipe);
+   }
+
+   pipe_resource_reference(&test->vbuf, NULL);
+   pipe_resource_reference(&test->target, NULL);
+
+   if (test->screen)
+      test->screen->destroy(test->screen);
+}
+
+
+/**
+ * Return a random value of at most \p bits bits, and a random sign.
+ */
+static int64_t
+random_int64(unsigned bits)
+{
+   uint64_t value = 0;
+   unsigned i;
+
+   /* RAND_MAX may be as small as 32767 */
+   for (i = 0; i < 4; i++)
+      value = (value << 16) | (rand() & 0xffff);
+
+   value &= ((uint64_t) 1 << bits) - 1;
+
+   return (rand() & 1) ? -(int64_t) value : (int64_t) value;
+}
+
+
+static boolean
+check_masks(const char *name, unsigned nr_planes,
+            const int64_t *c, const int64_t *cdiff,
+            const int64_t *dcdx, const int64_t *dcdy,
+            unsigned outmask, unsigned ref_outmask,
+            unsigned partmask, unsigned ref_partmask)
+{
+   unsigned j;
+
+   if (outmask == ref_outmask && partmask == ref_partmask)
+      return TRUE;
+
+   fprintf(stderr, "%s: MISMATCH\n", name);
+   for (j = 0; j < nr_planes; j++) {
+      fprintf(stderr, "  plane %u: c = %" PRId64 ", cdiff = %" PRId64
+              ", dcdx = %" PRId64 ", dcdy = %" PRId64 "\n",
+              j, c[j], cdiff ? cdiff[j] : 0, dcdx[j], dcdy[j]);
+   }
+   fprintf(stderr, "  outmask  0x%04x, expected 0x%04x\n",
+           outmask, ref_outmask);
+   if (cdiff) {
+      fprintf(stderr, "  partmask 0x%04x, expected 0x%04x\n",
+              partmask, ref_partmask);
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Check the masks built by build_masks(), and by build_masks_32() for
+ * planes whose values fit in 32 bits, against those built one plane at a
+ * time by build_mask_linear().  The magnitudes of the values are random
+ * too, so that the planes change sign within the block at all positions.
+ */
+static boolean
+test_masks(unsigned verbose)
+{
+   boolean success = TRUE;
+   unsigned n, j;
+
+   for (n = 0; n < NUM_MASK_TESTS; n++) {
+      const unsigned nr_planes = 1 + rand() % 8;
+      const boolean fits_32 = n & 1;
+      /* Keep c + 3 * dcdx + 3 * dcdy + cdiff from overflowing */
+      const unsigned c_bits = fits_32 ? 28 : 60;
+      const unsigned step_bits = fits_32 ? 26 : 58;
+      int64_t c[8], cdiff[8], dcdx[8], dcdy[8];
+      unsigned ref_outmask = 0, ref_partmask = 0;
+      unsigned outmask, partmask;
+
+      for (j = 0; j < nr_planes; j++) {
+         c[j] = random_int64(rand() % (c_bits + 1));
+         cdiff[j] = random_int64(rand() % (step_bits + 1));
+         dcdx[j] = random_int64(rand() % (step_bits + 1));
+         dcdy[j] = random_int64(rand() % (step_bits + 1));
+
+         ref_outmask |= build_mask_linear(c[j], dcdx[j], dcdy[j]);
+         ref_partmask |= build_mask_linear(c[j] + cdiff[j], dcdx[j], dcdy[j]);
+      }
+
+      outmask = partmask = 0;
+      build_masks(nr_planes, c, cdiff, dcdx, dcdy, &outmask, &partmask);
+      if (!check_masks("build_masks", nr_planes, c, cdiff, dcdx, dcdy,
+                       outmask, ref_outmask, partmask, ref_partmask))
+         success = FALSE;
+
+      outmask = 0;
+      build_masks(nr_planes, c, NULL, dcdx, dcdy, &outmask, NULL);
+      if (!check_masks("build_masks", nr_planes, c, NULL, dcdx, dcdy,
+                       outmask, ref_outmask, 0, 0))
+         success = FALSE;
+
+#if defined(PIPE_ARCH_SSE)
+      if (fits_32) {
+         outmask = partmask = 0;
+         build_masks_32(nr_planes, c, cdiff, dcdx, dcdy,
+                        &outmask, &partmask);
+         if (!check_masks("build_masks_32", nr_planes,
+                          c, cdiff, dcdx, dcdy,
+                          outmask, ref_outmask, partmask, ref_partmask))
+            success = FALSE;
+
+         outmask = 0;
+         build_masks_32(nr_planes, c, NULL, dcdx, dcdy, &outmask, NULL);
+         if (!check_masks("build_masks_32", nr_planes,
+                          c, NULL, dcdx, dcdy,
+                          outmask, ref_outmask, 0, 0))
+            success = FALSE;
+      }
+#endif
+   }
+
+   if (verbose) {
+      printf("masks    %8u plane sets %s\n", NUM_MASK_TESTS,
+             success ? "passed" : "FAILED");
+   }
+
+   return success;
+}
+
+
+/**
+ * Fill the vertex buffer with a batch of triangles.  The radius is drawn
+ * log-uniformly from the distribution's range, so that each size range
+ * gets about the same number of triangles.
+ *
+ * \return the total area of the triangles, in pixels
+ */
+static double
+make_batch(struct rast_test *test, const struct rast_distribution *dist)
+{
+   struct rast_vertex verts[BATCH_SIZE * 3];
+   const double log_min = log(dist->min_radius);
+   const double log_max = log(dist->max_radius);
+   double area = 0.0;
+   unsigned i, k;
+
+   for (i = 0; i < BATCH_SIZE; i++) {
+      const double radius = exp(log_min + (log_max - log_min) * random_float());
+      const double cx = TARGET_SIZE * random_float();
+      const double cy = TARGET_SIZE * random_float();
+      const double angle = 2.0 * M_PI * random_float();
+
+      /* Area of an equilateral triangle of circumradius r */
+      area += 0.75 * sqrt(3.0) * radius * radius;
+
+      for (k = 0; k < 3; k++) {
+         struct rast_vertex *v = &verts[i * 3 + k];
+         const double a = angle + k * (2.0 * M_PI / 3.0);
+         const double x = cx + radius * cos(a);
+         const double y = cy + radius * sin(a);
+
+         v->position[0] = (float) (x * 2.0 / TARGET_SIZE - 1.0);
+         v->position[1] = (float) (y * 2.0 / TARGET_SIZE - 1.0);
+         v->position[2] = 0.0f;
+         v->position[3] = 1.0f;
+
+         v->color[0] = random_float();
+         v->color[1] = random_float();
+         v->color[2] = random_float();
+         v->color[3] = 1.0f;
+      }
+   }
+
+   pipe_buffer_write(test->pipe, test->vbuf, 0, sizeof verts, verts);
+
+   return area;
+}
+
+
+static void
+finish(struct rast_test *test)
+{
+   struct pipe_fence_handle *fence = NULL;
+
+   test->pipe->flush(test->pipe, &fence, 0);
+   if (fence) {
+      test->screen->fence_finish(test->screen, fence, PIPE_TIMEOUT_INFINITE);
+      test->screen->fence_reference(test->screen, &fence, NULL);
+   }
+}
+
+
+/**
+ * Draw \p max_tris triangles of the distribution, or fewer for large
+ * triangles, so that at most about 64 times the target is covered.
+ */
+static boolean
+test_distribution(struct rast_test *test,
+                  unsigned verbose, FILE *fp,
+                  const struct rast_distribution *dist,
+                  unsigned max_tris)
+{
+   const double max_area = 64.0 * TARGET_SIZE * TARGET_SIZE;
+   double area_per_batch;
+   unsigned num_batches, i;
+   int64_t start, end;
+   double seconds;
+
+   area_per_batch = make_batch(test, dist);
+
+   num_batches = MAX2(max_tris / BATCH_SIZE, 1);
+   num_batches = MIN2(num_batches, MAX2((unsigned) (max_area / area_per_batch), 1));
+
+   /* Compile the shader variants and warm up the caches */
+   util_draw_arrays(test->pipe, PIPE_PRIM_TRIANGLES, 0, BATCH_SIZE * 3);
+   finish(test);
+
+   start = os_time_get();
+
+   for (i = 0; i < num_batches; i++) {
+      util_draw_arrays(test->pipe, PIPE_PRIM_TRIANGLES, 0, BATCH_SIZE * 3);
+   }
+   finish(test);
+
+   end = os_time_get();
+
+   seconds = (end - start) * 1e-6;
+   if (seconds <= 0.0)
+      seconds = 1e-6;
+
+   if (verbose || !fp) {
+      printf("%-8s %8u triangles %10.3f ms %12.0f triangles/s\n",
+             dist->name, num_batches * BATCH_SIZE, seconds * 1e3,
+             num_batches * BATCH_SIZE / seconds);
+   }
+
+   if (fp)
+      write_tsv_row(fp, dist, num_batches * BATCH_SIZE, seconds);
+
+   return TRUE;
+}
+
+
+static boolean
+test_distributions(unsigned verbose, FILE *fp,
+                   const struct rast_distribution *dists, unsigned num_dists,
+                   unsigned max_tris)
+{
+   struct rast_test test;
+   boolean success = TRUE;
+   unsigned i;
+
+   if (!test_masks(verbose))
+      success = FALSE;
+
+   memset(&test, 0, sizeof test);
+
+   if (!init_test(&test)) {
+      fprintf(stderr, "failed to create an llvmpipe context\n");
+      fini_test(&test);
+      return FALSE;
+   }
+
+   for (i = 0; i < num_dists; i++) {
+      if (!test_distribution(&test, verbose, fp, &dists[i], max_tris))
+         success = FALSE;
+   }
+
+   fini_test(&test);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_distributions(verbose, fp, distributions,
+                             Elements(distributions), 1024 * 1024);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_distributions(verbose, fp, distributions,
+                             Elements(distributions), n);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   /* The mixed distribution */
+   return test_distributions(verbose, fp,
+                             &distributions[Elements(distributions) - 1], 1,
+                             64 * 1024);
+}
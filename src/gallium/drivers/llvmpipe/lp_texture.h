@@ -63,6 +63,9 @@ struct llvmpipe_texture_image
  * vertex buffers and const buffers.
  * The latter are simple malloc'd blocks of memory.
  */
+struct lp_fence;
+
+
 struct llvmpipe_resource
 {
    struct pipe_resource base;
@@ -82,6 +85,12 @@ struct llvmpipe_resource
     */
    struct sw_displaytarget *dt;
 
+   /**
+    * Fence of the last scene queued with the display target as a render
+    * target, waited for before the display target is presented.
+    */
+   struct lp_fence *dt_fence;
+
    /**
     * Malloc'ed data for regular textures, or a mapping to dt above.
     */
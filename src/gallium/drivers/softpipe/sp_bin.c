@@ -0,0 +1,461 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "os/os_thread.h"
+#include "tgsi/tgsi_exec.h"
+#include "util/u_dynarray.h"
+#include "util/u_memory.h"
+#include "sp_bin.h"
+#include "sp_context.h"
+#include "sp_quad.h"
+#include "sp_quad_pipe.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+/**
+ * A batch of quads, all in one screen tile, that setup emitted together.
+ */
+struct sp_bin_run
+{
+   unsigned coef;    /**< byte offset of the coefficients in bin->coefs */
+   unsigned first;   /**< index of the first quad in thread->quads */
+   unsigned nr;
+};
+
+
+/**
+ * The part of a quad_header that setup fills in.
+ */
+struct sp_bin_quad
+{
+   struct quad_header_input input;
+   unsigned mask;
+};
+
+
+struct sp_bin_thread
+{
+   struct sp_bin_context *bin;
+
+   pipe_thread thread;
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+
+   /** The binned work, in the order setup emitted it */
+   struct util_dynarray runs;    /**< of struct sp_bin_run */
+   struct util_dynarray quads;   /**< of struct sp_bin_quad */
+
+   struct quad_pipeline quad;
+   const struct sp_fragment_shader_variant *fs_variant; /**< in the machine */
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   uint64_t occlusion_count;
+   uint64_t ps_invocations;
+
+   struct quad_header headers[MAX_QUADS];
+   struct quad_header *header_ptrs[MAX_QUADS];
+};
+
+
+struct sp_bin_context
+{
+   struct softpipe_context *softpipe;
+
+   /**
+    * Interpolation coefficients of the binned quads: posCoef followed by
+    * the fragment shader input coefficients, for each primitive.
+    */
+   struct util_dynarray coefs;
+   unsigned last_coef;   /**< offset of the most recently added ones */
+
+   boolean threads_started;
+   boolean exit_flag;
+
+   /** threads[0] is the context's own thread */
+   unsigned num_threads;
+   struct sp_bin_thread threads[SP_MAX_THREADS];
+};
+
+
+/**
+ * Return the offset in bin->coefs of a copy of the quad's coefficients.
+ * Setup emits many batches per primitive which share one copy.
+ */
+static unsigned
+bin_coefs(struct sp_bin_context *bin, const struct quad_header *quad)
+{
+   const struct sp_fragment_shader_variant *fs = bin->softpipe->fs_variant;
+   const unsigned num_inputs = fs->info.file_max[TGSI_FILE_INPUT] + 1;
+   struct tgsi_interp_coef *coef;
+
+   if (bin->coefs.size) {
+      coef = (struct tgsi_interp_coef *)
+         ((char *) bin->coefs.data + bin->last_coef);
+
+      if (memcmp(&coef[0], quad->posCoef, sizeof *coef) == 0 &&
+          memcmp(&coef[1], quad->coef, num_inputs * sizeof *coef) == 0)
+         return bin->last_coef;
+   }
+
+   bin->last_coef = bin->coefs.size;
+   coef = util_dynarray_grow(&bin->coefs, (1 + num_inputs) * sizeof *coef);
+   coef[0] = *quad->posCoef;
+   memcpy(&coef[1], quad->coef, num_inputs * sizeof *coef);
+
+   return bin->last_coef;
+}
+
+
+/**
+ * Called by setup in place of running the quad pipeline.
+ */
+void
+sp_bin_quads(struct sp_bin_context *bin,
+             struct quad_header *quads[], unsigned nr)
+{
+   /* the depth test stage looks up the tile of the first quad only */
+   const union tile_address addr = tile_address(quads[0]->input.x0,
+                                                quads[0]->input.y0);
+   const unsigned pos = CACHE_POS(addr.bits.x, addr.bits.y);
+   struct sp_bin_thread *thread = &bin->threads[pos % bin->num_threads];
+   struct sp_bin_run *run;
+   struct sp_bin_quad *quad;
+   unsigned i;
+
+   assert(nr <= MAX_QUADS);
+
+   run = util_dynarray_grow(&thread->runs, sizeof *run);
+   run->coef = bin_coefs(bin, quads[0]);
+   run->first = thread->quads.size / sizeof *quad;
+   run->nr = nr;
+
+   quad = util_dynarray_grow(&thread->quads, nr * sizeof *quad);
+   for (i = 0; i < nr; i++) {
+      quad[i].input = quads[i]->input;
+      quad[i].mask = quads[i]->inout.mask;
+   }
+}
+
+
+/**
+ * Bring a thread's fragment shader, samplers and quad pipeline up to
+ * date with the context.  Called on the context's thread.
+ */
+static void
+validate_thread(struct sp_bin_thread *thread)
+{
+   struct softpipe_context *sp = thread->bin->softpipe;
+   const struct sp_tgsi_sampler *sampler =
+      sp->tgsi.sampler[PIPE_SHADER_FRAGMENT];
+   unsigned i;
+
+   /* Same samplers and views, but our own texture caches, which follow
+    * the context's ones through texture changes.
+    */
+   memcpy(thread->sampler->sp_sampler, sampler->sp_sampler,
+          sizeof sampler->sp_sampler);
+
+   for (i = 0; i < sp->num_sampler_views[PIPE_SHADER_FRAGMENT]; i++) {
+      struct softpipe_tex_tile_cache *tc = thread->tex_cache[i];
+
+      thread->sampler->sp_sview[i] = sampler->sp_sview[i];
+      if (!sampler->sp_sview[i].cache)
+         continue;
+
+      if (!tc) {
+         tc = sp_create_tex_tile_cache(&sp->pipe);
+         if (!tc)
+            continue;
+         thread->tex_cache[i] = tc;
+      }
+
+      sp_tex_tile_cache_set_sampler_view(tc,
+         sp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+      if (tc->texture) {
+         struct softpipe_resource *spt = softpipe_resource(tc->texture);
+         if (spt->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spt->timestamp;
+         }
+      }
+
+      thread->sampler->sp_sview[i].cache = tc;
+   }
+
+   if (thread->fs_variant != sp->fs_variant) {
+      sp->fs_variant->prepare(sp->fs_variant, thread->quad.fs_machine,
+                              (struct tgsi_sampler *) thread->sampler);
+      thread->fs_variant = sp->fs_variant;
+   }
+
+   sp_build_quad_pipeline(sp, &thread->quad);
+}
+
+
+/**
+ * Run a thread's binned quads through its quad pipeline.
+ */
+static void
+render_bin(struct sp_bin_thread *thread)
+{
+   const char *coefs = thread->bin->coefs.data;
+   const struct sp_bin_quad *quads = thread->quads.data;
+   const struct sp_bin_run *run = thread->runs.data;
+   const struct sp_bin_run *end = util_dynarray_end(&thread->runs);
+   struct quad_stage *first = thread->quad.first;
+
+   first->begin(first);
+
+   for (; run < end; run++) {
+      const struct tgsi_interp_coef *coef =
+         (const struct tgsi_interp_coef *) (coefs + run->coef);
+      unsigned i;
+
+      for (i = 0; i < run->nr; i++) {
+         struct quad_header *quad = &thread->headers[i];
+
+         quad->input = quads[run->first + i].input;
+         quad->inout.mask = quads[run->first + i].mask;
+         quad->posCoef = &coef[0];
+         quad->coef = &coef[1];
+         thread->header_ptrs[i] = quad;
+      }
+
+      first->run(first, thread->header_ptrs, run->nr);
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE( bin_thread_function, init_data )
+{
+   struct sp_bin_thread *thread = (struct sp_bin_thread *) init_data;
+   struct sp_bin_context *bin = thread->bin;
+
+   while (1) {
+      pipe_semaphore_wait(&thread->work_ready);
+
+      if (bin->exit_flag)
+         break;
+
+      render_bin(thread);
+
+      pipe_semaphore_signal(&thread->work_done);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Render everything binned so far and wait for it.
+ * Called at the end of each vbuf draw call, so that the state the threads
+ * read from the context can't change under them.
+ */
+void
+sp_bin_flush(struct sp_bin_context *bin)
+{
+   struct softpipe_context *sp = bin->softpipe;
+   unsigned i;
+
+   if (!bin->coefs.size)
+      return;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      if (thread->runs.size) {
+         validate_thread(thread);
+         if (i > 0)
+            pipe_semaphore_signal(&thread->work_ready);
+      }
+   }
+
+   if (bin->threads[0].runs.size)
+      render_bin(&bin->threads[0]);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      if (thread->runs.size) {
+         if (i > 0)
+            pipe_semaphore_wait(&thread->work_done);
+
+         thread->runs.size = 0;
+         thread->quads.size = 0;
+      }
+
+      sp->occlusion_count += thread->occlusion_count;
+      sp->pipeline_statistics.ps_invocations += thread->ps_invocations;
+      thread->occlusion_count = 0;
+      thread->ps_invocations = 0;
+   }
+
+   bin->coefs.size = 0;
+}
+
+
+/**
+ * Invalidate the threads' texture caches, along with the context's.
+ */
+void
+sp_bin_flush_tex_caches(struct sp_bin_context *bin)
+{
+   unsigned i, j;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      for (j = 0; j < PIPE_MAX_SHADER_SAMPLER_VIEWS; j++) {
+         if (bin->threads[i].tex_cache[j])
+            sp_flush_tex_tile_cache(bin->threads[i].tex_cache[j]);
+      }
+   }
+}
+
+
+/**
+ * Unbind a fragment shader variant which is about to be deleted.
+ */
+void
+sp_bin_release_fs_variant(struct sp_bin_context *bin,
+                          const struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      if (thread->fs_variant == var) {
+         tgsi_exec_machine_bind_shader(thread->quad.fs_machine, NULL, NULL);
+         thread->fs_variant = NULL;
+      }
+   }
+}
+
+
+/**
+ * Create the binned renderer.  This splits the context's tile caches,
+ * so it must be called before any rendering.
+ */
+struct sp_bin_context *
+sp_bin_create(struct softpipe_context *sp, unsigned num_threads)
+{
+   struct sp_bin_context *bin;
+   unsigned i, j;
+
+   assert(num_threads <= SP_MAX_THREADS);
+
+   bin = CALLOC_STRUCT(sp_bin_context);
+   if (!bin)
+      return NULL;
+
+   bin->softpipe = sp;
+   bin->num_threads = num_threads;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      if (!sp_tile_cache_split(sp->cbuf_cache[i], num_threads))
+         goto fail;
+   }
+   if (!sp_tile_cache_split(sp->zsbuf_cache, num_threads))
+      goto fail;
+
+   for (i = 0; i < num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      thread->bin = bin;
+
+      if (!sp_create_quad_pipeline(sp, &thread->quad))
+         goto fail;
+
+      thread->quad.fs_machine = tgsi_exec_machine_create();
+      thread->sampler = sp_create_tgsi_sampler();
+      if (!thread->quad.fs_machine || !thread->sampler)
+         goto fail;
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         thread->quad.cbuf_cache[j] = sp->cbuf_cache[j]->shards[i];
+      thread->quad.zsbuf_cache = sp->zsbuf_cache->shards[i];
+      thread->quad.occlusion_count = &thread->occlusion_count;
+      thread->quad.ps_invocations = &thread->ps_invocations;
+   }
+
+   for (i = 1; i < num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      pipe_semaphore_init(&thread->work_ready, 0);
+      pipe_semaphore_init(&thread->work_done, 0);
+      thread->thread = pipe_thread_create(bin_thread_function, thread);
+   }
+   bin->threads_started = TRUE;
+
+   return bin;
+
+fail:
+   sp_bin_destroy(bin);
+   return NULL;
+}
+
+
+void
+sp_bin_destroy(struct sp_bin_context *bin)
+{
+   unsigned i, j;
+
+   if (bin->threads_started) {
+      bin->exit_flag = TRUE;
+      for (i = 1; i < bin->num_threads; i++) {
+         pipe_semaphore_signal(&bin->threads[i].work_ready);
+      }
+      for (i = 1; i < bin->num_threads; i++) {
+         pipe_thread_wait(bin->threads[i].thread);
+         pipe_semaphore_destroy(&bin->threads[i].work_ready);
+         pipe_semaphore_destroy(&bin->threads[i].work_done);
+      }
+   }
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_bin_thread *thread = &bin->threads[i];
+
+      sp_destroy_quad_pipeline(&thread->quad);
+
+      if (thread->quad.fs_machine)
+         tgsi_exec_machine_destroy(thread->quad.fs_machine);
+
+      for (j = 0; j < PIPE_MAX_SHADER_SAMPLER_VIEWS; j++) {
+         if (thread->tex_cache[j])
+            sp_destroy_tex_tile_cache(thread->tex_cache[j]);
+      }
+
+      FREE(thread->sampler);
+
+      util_dynarray_fini(&thread->runs);
+      util_dynarray_fini(&thread->quads);
+   }
+
+   util_dynarray_fini(&bin->coefs);
+   FREE(bin);
+}
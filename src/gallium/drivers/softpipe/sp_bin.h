@@ -0,0 +1,74 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Binned, multi-threaded quad rendering (SOFTPIPE_NUM_THREADS).
+ *
+ * Instead of running the quad pipeline, setup appends each batch of quads
+ * to the bin of the thread owning the batch's screen tile.  Thread i owns
+ * the tiles whose tile cache position is congruent to i modulo the number
+ * of threads and keeps them in shard i of each tile cache.  At the end of
+ * every vbuf draw call sp_bin_flush() has each thread run its batches, in
+ * the order setup emitted them, through a quad pipeline, fragment shader
+ * machine and texture caches of its own.
+ *
+ * Every tile thus sees the same quad batches, and every tile cache entry
+ * the same fetches and evictions, as with single-threaded rendering, which
+ * keeps the results bit-identical to it.
+ */
+
+#ifndef SP_BIN_H
+#define SP_BIN_H
+
+#include "pipe/p_compiler.h"
+
+
+struct softpipe_context;
+struct sp_fragment_shader_variant;
+struct quad_header;
+struct sp_bin_context;
+
+
+struct sp_bin_context *
+sp_bin_create(struct softpipe_context *sp, unsigned num_threads);
+
+void
+sp_bin_destroy(struct sp_bin_context *bin);
+
+void
+sp_bin_quads(struct sp_bin_context *bin,
+             struct quad_header *quads[], unsigned nr);
+
+void
+sp_bin_flush(struct sp_bin_context *bin);
+
+void
+sp_bin_flush_tex_caches(struct sp_bin_context *bin);
+
+void
+sp_bin_release_fs_variant(struct sp_bin_context *bin,
+                          const struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_BIN_H */
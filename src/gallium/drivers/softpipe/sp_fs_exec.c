@@ -141,14 +141,14 @@ exec_run( const struct sp_fragment_shader_variant *var,
          case TGSI_SEMANTIC_COLOR:
             {
                uint cbuf = sem_index[i];
-
-               assert(sizeof(quad->output.color[cbuf]) ==
-                      sizeof(machine->Outputs[i]));
+               uint chan;
 
                /* copy float[4][4] result */
-               memcpy(quad->output.color[cbuf],
-                      &machine->Outputs[i],
-                      sizeof(quad->output.color[0]) );
+               for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+                  memcpy(quad->output.color[cbuf][chan],
+                         machine->Outputs[i].xyzw[chan].f,
+                         sizeof(quad->output.color[cbuf][chan]));
+               }
             }
             break;
          case TGSI_SEMANTIC_POSITION:
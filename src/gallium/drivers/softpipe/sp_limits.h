@@ -39,5 +39,8 @@
 #define MAX_WIDTH (1 << (SP_MAX_TEXTURE_2D_LEVELS - 1))
 #define MAX_HEIGHT (1 << (SP_MAX_TEXTURE_2D_LEVELS - 1))
 
+/** Max number of threads for binned rendering (SOFTPIPE_NUM_THREADS) */
+#define SP_MAX_THREADS 16
+
 
 #endif /* SP_LIMITS_H */
@@ -36,6 +36,7 @@
  */
 
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_setup.h"
 #include "sp_state.h"
@@ -345,6 +346,10 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   /* render the quads that setup binned for the rendering threads */
+   if (softpipe->bin)
+      sp_bin_flush(softpipe->bin);
 }
 
 
@@ -585,6 +590,10 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   /* render the quads that setup binned for the rendering threads */
+   if (softpipe->bin)
+      sp_bin_flush(softpipe->bin);
 }
 
 /*
@@ -31,9 +31,14 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_state.h"
+
 
 struct softpipe_context;
+struct softpipe_tile_cache;
+struct tgsi_exec_machine;
 struct quad_header;
+struct quad_pipeline;
 
 
 /**
@@ -43,6 +48,7 @@ struct quad_header;
  */
 struct quad_stage {
    struct softpipe_context *softpipe;
+   struct quad_pipeline *pipeline;  /**< the pipeline this stage belongs to */
 
    struct quad_stage *next;
 
@@ -67,6 +73,32 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
-void sp_build_quad_pipeline(struct softpipe_context *sp);
+
+/**
+ * The quad stages together with the per-thread state they write to.
+ * The context owns one pipeline; binned rendering gives each of its
+ * threads another (see sp_bin.c).
+ */
+struct quad_pipeline {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+
+   struct tgsi_exec_machine *fs_machine;
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+
+   /** Query counters */
+   uint64_t *occlusion_count;
+   uint64_t *ps_invocations;
+};
+
+boolean sp_create_quad_pipeline(struct softpipe_context *sp,
+                                struct quad_pipeline *qp);
+void sp_destroy_quad_pipeline(struct quad_pipeline *qp);
+void sp_build_quad_pipeline(struct softpipe_context *sp,
+                            struct quad_pipeline *qp);
 
 #endif /* SP_QUAD_PIPE_H */
@@ -51,6 +51,21 @@ static struct softpipe_query *softpipe_query( struct pipe_query *p )
    return (struct softpipe_query *)p;
 }
 
+/**
+ * Current value of the draw module's vertex cache counter for the given
+ * SP_QUERY_VERTEX_CACHE_x query type.
+ */
+static uint64_t
+vertex_cache_count(struct softpipe_context *softpipe, unsigned type)
+{
+   uint64_t hits, misses;
+
+   draw_get_vertex_cache_stats(softpipe->draw, &hits, &misses);
+
+   return type == SP_QUERY_VERTEX_CACHE_HITS ? hits : misses;
+}
+
+
 static struct pipe_query *
 softpipe_create_query(struct pipe_context *pipe, 
 		      unsigned type)
@@ -67,7 +82,9 @@ softpipe_create_query(struct pipe_context *pipe,
           type == PIPE_QUERY_PIPELINE_STATISTICS ||
           type == PIPE_QUERY_GPU_FINISHED ||
           type == PIPE_QUERY_TIMESTAMP ||
-          type == PIPE_QUERY_TIMESTAMP_DISJOINT);
+          type == PIPE_QUERY_TIMESTAMP_DISJOINT ||
+          type == SP_QUERY_VERTEX_CACHE_HITS ||
+          type == SP_QUERY_VERTEX_CACHE_MISSES);
    sq = CALLOC_STRUCT( softpipe_query );
    sq->type = type;
 
@@ -123,6 +140,10 @@ softpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
              sizeof(sq->stats));
       softpipe->active_statistics_queries++;
       break;
+   case SP_QUERY_VERTEX_CACHE_HITS:
+   case SP_QUERY_VERTEX_CACHE_MISSES:
+      sq->start = vertex_cache_count(softpipe, sq->type);
+      break;
    default:
       assert(0);
       break;
@@ -194,6 +215,10 @@ softpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 
       softpipe->active_statistics_queries--;
       break;
+   case SP_QUERY_VERTEX_CACHE_HITS:
+   case SP_QUERY_VERTEX_CACHE_MISSES:
+      sq->end = vertex_cache_count(softpipe, sq->type);
+      break;
    default:
       assert(0);
       break;
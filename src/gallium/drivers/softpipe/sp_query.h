@@ -32,6 +32,10 @@
 #ifndef SP_QUERY_H
 #define SP_QUERY_H
 
+/* Driver-specific queries, see softpipe_get_driver_query_info() */
+#define SP_QUERY_VERTEX_CACHE_HITS    (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define SP_QUERY_VERTEX_CACHE_MISSES  (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+
 extern boolean
 softpipe_check_render_cond(struct softpipe_context *sp);
 
@@ -42,17 +42,6 @@ static struct softpipe_cached_tile *
 sp_alloc_tile(struct softpipe_tile_cache *tc);
 
 
-/**
- * Return the position in the cache for the tile that contains win pos (x,y).
- * We currently use a direct mapped cache so this is like a hack key.
- * At some point we should investige something more sophisticated, like
- * a LRU replacement policy.
- */
-#define CACHE_POS(x, y) \
-   (((x) + (y) * 5) % NUM_ENTRIES)
-
-
-
 /**
  * Is the tile at (x,y) in cleared state?
  */
@@ -99,6 +88,7 @@ sp_create_tile_cache( struct pipe_context *pipe )
    tc = CALLOC_STRUCT( softpipe_tile_cache );
    if (tc) {
       tc->pipe = pipe;
+      tc->shard_count = 1;
       for (pos = 0; pos < Elements(tc->tile_addrs); pos++) {
          tc->tile_addrs[pos].bits.invalid = 1;
       }
@@ -134,6 +124,10 @@ sp_destroy_tile_cache(struct softpipe_tile_cache *tc)
    if (tc) {
       uint pos;
 
+      for (pos = 0; pos < tc->num_shards; pos++) {
+         sp_destroy_tile_cache(tc->shards[pos]);
+      }
+
       for (pos = 0; pos < Elements(tc->entries); pos++) {
          /*assert(tc->entries[pos].x < 0);*/
          FREE( tc->entries[pos] );
@@ -157,6 +151,11 @@ sp_tile_cache_set_surface(struct softpipe_tile_cache *tc,
                           struct pipe_surface *ps)
 {
    struct pipe_context *pipe = tc->pipe;
+   uint i;
+
+   for (i = 0; i < tc->num_shards; i++) {
+      sp_tile_cache_set_surface(tc->shards[i], ps);
+   }
 
    if (tc->transfer_map) {
       if (ps == tc->surface)
@@ -188,6 +187,34 @@ sp_tile_cache_set_surface(struct softpipe_tile_cache *tc,
 }
 
 
+/**
+ * Split the cache into num_shards shards, see softpipe_tile_cache::shards.
+ * Rendering must then go through the shards; the cache itself only
+ * forwards clears, flushes and surface changes.
+ */
+boolean
+sp_tile_cache_split(struct softpipe_tile_cache *tc, unsigned num_shards)
+{
+   uint i;
+
+   assert(!tc->num_shards);
+   assert(num_shards <= Elements(tc->shards));
+
+   for (i = 0; i < num_shards; i++) {
+      struct softpipe_tile_cache *shard = sp_create_tile_cache(tc->pipe);
+      if (!shard)
+         return FALSE;
+
+      shard->shard_index = i;
+      shard->shard_count = num_shards;
+      sp_tile_cache_set_surface(shard, tc->surface);
+      tc->shards[tc->num_shards++] = shard;
+   }
+
+   return TRUE;
+}
+
+
 /**
  * Return the transfer being cached.
  */
@@ -331,6 +358,10 @@ sp_tile_cache_flush_clear(struct softpipe_tile_cache *tc)
       for (x = 0; x < w; x += TILE_SIZE) {
          union tile_address addr = tile_address(x, y);
 
+         if (CACHE_POS(addr.bits.x, addr.bits.y) % tc->shard_count !=
+             tc->shard_index)
+            continue;
+
          if (is_clear_flag_set(tc->clear_flags, addr)) {
             /* write the scratch tile to the surface */
             if (tc->depth_stencil) {
@@ -417,6 +448,13 @@ sp_flush_tile_cache(struct softpipe_tile_cache *tc)
    struct pipe_transfer *pt = tc->transfer;
    int inuse = 0, pos;
 
+   if (tc->num_shards) {
+      for (pos = 0; pos < tc->num_shards; pos++) {
+         sp_flush_tile_cache(tc->shards[pos]);
+      }
+      return;
+   }
+
    if (pt) {
       /* caching a drawing transfer */
       for (pos = 0; pos < Elements(tc->entries); pos++) {
@@ -489,6 +527,9 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
                              addr.bits.y);
    struct softpipe_cached_tile *tile = tc->entries[pos];
 
+   assert(!tc->num_shards);
+   assert(pos % tc->shard_count == tc->shard_index);
+
    if (!tile) {
       tile = sp_alloc_tile(tc);
       tc->entries[pos] = tile;
@@ -601,6 +642,12 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
 {
    uint pos;
 
+   for (pos = 0; pos < tc->num_shards; pos++) {
+      sp_tile_cache_clear(tc->shards[pos], color, clearValue);
+   }
+   if (tc->num_shards)
+      return;
+
    tc->clear_color = *color;
 
    tc->clear_val = clearValue;
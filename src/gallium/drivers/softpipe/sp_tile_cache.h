@@ -78,6 +78,16 @@ struct softpipe_cached_tile
 #define NUM_ENTRIES 50
 
 
+/**
+ * Return the position in the cache for the tile that contains win pos (x,y).
+ * We currently use a direct mapped cache so this is like a hack key.
+ * At some point we should investige something more sophisticated, like
+ * a LRU replacement policy.
+ */
+#define CACHE_POS(x, y) \
+   (((x) + (y) * 5) % NUM_ENTRIES)
+
+
 struct softpipe_tile_cache
 {
    struct pipe_context *pipe;
@@ -96,6 +106,18 @@ struct softpipe_tile_cache
 
    union tile_address last_tile_addr;
    struct softpipe_cached_tile *last_tile;  /**< most recently retrieved tile */
+
+   /**
+    * For binned rendering the cache is split into one shard per thread.
+    * Shard i only holds the tiles whose cache position is congruent to i
+    * modulo num_shards, so every tile sees the same sequence of fetches
+    * and evictions as it would in the unsplit cache.  Clears, flushes and
+    * surface changes of the unsplit cache are forwarded to its shards.
+    */
+   struct softpipe_tile_cache *shards[SP_MAX_THREADS];
+   unsigned num_shards;
+   unsigned shard_index;   /**< for a shard: pos % shard_count it holds */
+   unsigned shard_count;   /**< for a shard: number of sibling shards */
 };
 
 
@@ -120,6 +142,9 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern boolean
+sp_tile_cache_split(struct softpipe_tile_cache *tc, unsigned num_shards);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
@@ -0,0 +1,560 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2014 LunarG, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Vertex cache benchmark.
+ *
+ * Draws the index buffers of the Wavefront .obj meshes given on the command
+ * line (or of a few generated ones) as indexed triangle lists, and reports
+ * the draw time and the vertex cache hit rate, as returned by the
+ * "vertex-cache-hits" and "vertex-cache-misses" driver queries, of each.
+ * The cache geometry of the software drivers can be changed with the
+ * DRAW_VERTEX_CACHE_SIZE and DRAW_VERTEX_CACHE_WAYS environment variables.
+ */
+
+#define WIDTH 300
+#define HEIGHT 300
+#define REPEAT 20
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_init_info */
+#include "util/u_draw.h"
+/* os_time_get */
+#include "os/os_time.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* to get a hardware pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct mesh
+{
+	const char *name;
+
+	float (*verts)[2][4];
+	unsigned num_verts;
+
+	unsigned *indices;
+	unsigned num_indices;
+};
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	struct pipe_resource *target;
+
+	/* driver query types, 0 if the driver doesn't have them */
+	unsigned hits_query;
+	unsigned misses_query;
+};
+
+static unsigned find_query(struct pipe_screen *screen, const char *name)
+{
+	struct pipe_driver_query_info info;
+	int i, num;
+
+	if (!screen->get_driver_query_info)
+		return 0;
+
+	num = screen->get_driver_query_info(screen, 0, NULL);
+	for (i = 0; i < num; i++) {
+		if (screen->get_driver_query_info(screen, i, &info) &&
+		    strcmp(info.name, name) == 0)
+			return info.query_type;
+	}
+
+	return 0;
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	int ret;
+
+	/* find a hardware device */
+	ret = pipe_loader_probe(&p->dev, 1);
+	assert(ret);
+
+	/* init a pipe screen */
+	p->screen = pipe_loader_create_screen(p->dev, PIPE_SEARCH_DIR);
+	assert(p->screen);
+
+	/* create the pipe driver context and cso context */
+	p->pipe = p->screen->context_create(p->screen, NULL);
+	p->cso = cso_create_context(p->pipe);
+
+	p->hits_query = find_query(p->screen, "vertex-cache-hits");
+	p->misses_query = find_query(p->screen, "vertex-cache-misses");
+
+	/* set clear color */
+	p->clear_color.f[0] = 0.3;
+	p->clear_color.f[1] = 0.1;
+	p->clear_color.f[2] = 0.3;
+	p->clear_color.f[3] = 1.0;
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport, meshes are scaled to [-1, 1] in all dimensions */
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.scale[3] = 1.0f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+	p->viewport.translate[3] = 0.0f;
+
+	/* vertex elements state, position and color */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+	p->velem[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+			const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+							TGSI_SEMANTIC_COLOR };
+			const uint semantic_indexes[] = { 0, 0 };
+			p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+                    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+}
+
+static void close_prog(struct program *p)
+{
+	/* unset all state */
+	cso_release_all(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+
+	cso_destroy_context(p->cso);
+	p->pipe->destroy(p->pipe);
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+
+	FREE(p);
+}
+
+static void free_mesh(struct mesh *m)
+{
+	FREE(m->verts);
+	FREE(m->indices);
+}
+
+/**
+ * Scale the vertex positions to [-1, 1] and derive colors from them.
+ */
+static void normalize_mesh(struct mesh *m)
+{
+	float min[3], max[3];
+	unsigned i, j;
+
+	for (j = 0; j < 3; j++) {
+		min[j] = max[j] = m->num_verts ? m->verts[0][0][j] : 0.0f;
+	}
+
+	for (i = 0; i < m->num_verts; i++) {
+		for (j = 0; j < 3; j++) {
+			min[j] = MIN2(min[j], m->verts[i][0][j]);
+			max[j] = MAX2(max[j], m->verts[i][0][j]);
+		}
+	}
+
+	for (i = 0; i < m->num_verts; i++) {
+		for (j = 0; j < 3; j++) {
+			float range = max[j] - min[j];
+			float t = range > 0.0f ? (m->verts[i][0][j] - min[j]) / range : 0.5f;
+			m->verts[i][0][j] = t * 1.8f - 0.9f;
+			m->verts[i][1][j] = t;
+		}
+		m->verts[i][0][3] = 1.0f;
+		m->verts[i][1][3] = 1.0f;
+	}
+}
+
+/**
+ * Load the positions and faces of a Wavefront .obj file, turning polygons
+ * into triangle fans.  Everything else, including texture coordinates and
+ * normals, is ignored.
+ */
+static boolean load_obj(struct mesh *m, const char *filename)
+{
+	unsigned max_verts = 1024, max_indices = 4096;
+	char line[1024];
+	FILE *f;
+
+	f = fopen(filename, "r");
+	if (!f)
+		return FALSE;
+
+	memset(m, 0, sizeof(*m));
+	m->name = filename;
+	m->verts = MALLOC(max_verts * sizeof(*m->verts));
+	m->indices = MALLOC(max_indices * sizeof(*m->indices));
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == 'v' && line[1] == ' ') {
+			float *v;
+
+			if (m->num_verts == max_verts) {
+				m->verts = REALLOC(m->verts,
+						   max_verts * sizeof(*m->verts),
+						   2 * max_verts * sizeof(*m->verts));
+				max_verts *= 2;
+			}
+
+			v = m->verts[m->num_verts++][0];
+			v[0] = v[1] = v[2] = 0.0f;
+			sscanf(line + 2, "%f %f %f", &v[0], &v[1], &v[2]);
+		}
+		else if (line[0] == 'f' && line[1] == ' ') {
+			unsigned poly[3], n = 0;
+			char *s = line + 2;
+
+			for (;;) {
+				char *end;
+				long idx = strtol(s, &end, 10);
+
+				if (end == s)
+					break;
+
+				/* skip texcoord and normal indices */
+				s = end;
+				while (*s && *s != ' ' && *s != '\t' && *s != '\n')
+					s++;
+
+				/* negative indices are relative to the end */
+				if (idx < 0)
+					idx += m->num_verts + 1;
+				if (idx < 1 || idx > (long)m->num_verts) {
+					fclose(f);
+					free_mesh(m);
+					return FALSE;
+				}
+
+				if (n == 3) {
+					poly[1] = poly[2];
+					n = 2;
+				}
+				poly[n++] = idx - 1;
+
+				if (n == 3) {
+					if (m->num_indices + 3 > max_indices) {
+						m->indices = REALLOC(m->indices,
+								     max_indices * sizeof(*m->indices),
+								     2 * max_indices * sizeof(*m->indices));
+						max_indices *= 2;
+					}
+
+					memcpy(&m->indices[m->num_indices], poly, sizeof(poly));
+					m->num_indices += 3;
+				}
+			}
+		}
+	}
+
+	fclose(f);
+
+	if (!m->num_indices) {
+		free_mesh(m);
+		return FALSE;
+	}
+
+	normalize_mesh(m);
+	return TRUE;
+}
+
+/**
+ * Generate a rows x cols vertex grid, with its quads either in row order,
+ * or in column bands of band quads, the order in which a vertex cache
+ * optimizer typically lays out a regular mesh.
+ */
+static void make_grid(struct mesh *m, const char *name,
+		      unsigned rows, unsigned cols, unsigned band)
+{
+	unsigned r, c, c0, n = 0;
+
+	memset(m, 0, sizeof(*m));
+	m->name = name;
+	m->num_verts = rows * cols;
+	m->num_indices = (rows - 1) * (cols - 1) * 6;
+	m->verts = MALLOC(m->num_verts * sizeof(*m->verts));
+	m->indices = MALLOC(m->num_indices * sizeof(*m->indices));
+
+	for (r = 0; r < rows; r++) {
+		for (c = 0; c < cols; c++) {
+			float *v = m->verts[r * cols + c][0];
+			v[0] = (float)c;
+			v[1] = (float)r;
+			v[2] = sinf(c * 0.1f) * cosf(r * 0.1f);
+		}
+	}
+
+	for (c0 = 0; c0 < cols - 1; c0 += band) {
+		for (r = 0; r < rows - 1; r++) {
+			for (c = c0; c < MIN2(c0 + band, cols - 1); c++) {
+				unsigned i0 = r * cols + c, i1 = i0 + cols;
+
+				m->indices[n++] = i0;
+				m->indices[n++] = i1;
+				m->indices[n++] = i0 + 1;
+				m->indices[n++] = i0 + 1;
+				m->indices[n++] = i1;
+				m->indices[n++] = i1 + 1;
+			}
+		}
+	}
+
+	assert(n == m->num_indices);
+	normalize_mesh(m);
+}
+
+static void draw_mesh(struct program *p, const struct mesh *m)
+{
+	struct pipe_resource *vbuf, *ibuf;
+	struct pipe_vertex_buffer vb;
+	struct pipe_index_buffer ib;
+	struct pipe_draw_info info;
+	struct pipe_query *hits = NULL, *misses = NULL;
+	union pipe_query_result result;
+	int64_t start, end;
+	unsigned i;
+
+	vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				  PIPE_USAGE_STATIC, m->num_verts * sizeof(*m->verts));
+	pipe_buffer_write(p->pipe, vbuf, 0, m->num_verts * sizeof(*m->verts), m->verts);
+
+	ibuf = pipe_buffer_create(p->screen, PIPE_BIND_INDEX_BUFFER,
+				  PIPE_USAGE_STATIC, m->num_indices * sizeof(*m->indices));
+	pipe_buffer_write(p->pipe, ibuf, 0, m->num_indices * sizeof(*m->indices), m->indices);
+
+	memset(&vb, 0, sizeof(vb));
+	vb.stride = sizeof(*m->verts);
+	vb.buffer = vbuf;
+	cso_set_vertex_buffers(p->cso, 0, 1, &vb);
+
+	memset(&ib, 0, sizeof(ib));
+	ib.index_size = sizeof(*m->indices);
+	ib.buffer = ibuf;
+	p->pipe->set_index_buffer(p->pipe, &ib);
+
+	util_draw_init_info(&info);
+	info.indexed = TRUE;
+	info.mode = PIPE_PRIM_TRIANGLES;
+	info.count = m->num_indices;
+	info.max_index = m->num_verts - 1;
+
+	if (p->hits_query && p->misses_query) {
+		hits = p->pipe->create_query(p->pipe, p->hits_query);
+		misses = p->pipe->create_query(p->pipe, p->misses_query);
+		p->pipe->begin_query(p->pipe, hits);
+		p->pipe->begin_query(p->pipe, misses);
+	}
+
+	start = os_time_get();
+
+	for (i = 0; i < REPEAT; i++) {
+		p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, &p->clear_color, 0, 0);
+		p->pipe->draw_vbo(p->pipe, &info);
+	}
+
+	p->pipe->flush(p->pipe, NULL, 0);
+
+	end = os_time_get();
+
+	printf("%s: %u vertices, %u triangles, %.3f ms/draw",
+	       m->name, m->num_verts, m->num_indices / 3,
+	       (end - start) / 1000.0 / REPEAT);
+
+	if (hits && misses) {
+		uint64_t num_hits, num_misses;
+
+		p->pipe->end_query(p->pipe, hits);
+		p->pipe->end_query(p->pipe, misses);
+
+		p->pipe->get_query_result(p->pipe, hits, TRUE, &result);
+		num_hits = result.u64;
+		p->pipe->get_query_result(p->pipe, misses, TRUE, &result);
+		num_misses = result.u64;
+
+		/* vertices shaded per triangle, and per mesh vertex */
+		printf(", hit rate %.1f%%, ACMR %.3f, ATVR %.3f",
+		       100.0 * num_hits / MAX2(num_hits + num_misses, 1),
+		       3.0 * num_misses / ((uint64_t)m->num_indices * REPEAT),
+		       (double)num_misses / ((uint64_t)m->num_verts * REPEAT));
+
+		p->pipe->destroy_query(p->pipe, hits);
+		p->pipe->destroy_query(p->pipe, misses);
+	}
+
+	printf("\n");
+
+	p->pipe->set_index_buffer(p->pipe, NULL);
+	pipe_resource_reference(&ibuf, NULL);
+	pipe_resource_reference(&vbuf, NULL);
+}
+
+static void draw(struct program *p, const struct mesh *meshes, unsigned num_meshes)
+{
+	unsigned i;
+
+	/* set the render target */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	/* set misc state we care about */
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	/* shaders */
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	/* vertex element data */
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+
+	if (!p->hits_query || !p->misses_query)
+		printf("driver has no vertex cache queries, only timing draws\n");
+
+	for (i = 0; i < num_meshes; i++)
+		draw_mesh(p, &meshes[i]);
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	struct mesh *meshes;
+	unsigned num_meshes = 0;
+	unsigned i;
+
+	meshes = CALLOC(MAX2(argc - 1, 2), sizeof(*meshes));
+
+	for (i = 1; i < (unsigned)argc; i++) {
+		if (load_obj(&meshes[num_meshes], argv[i]))
+			num_meshes++;
+		else
+			fprintf(stderr, "failed to load %s\n", argv[i]);
+	}
+
+	if (argc == 1) {
+		make_grid(&meshes[num_meshes++], "grid 512x128, row order", 128, 512, 511);
+		make_grid(&meshes[num_meshes++], "grid 512x128, 16 quad bands", 128, 512, 16);
+	}
+
+	init_prog(p);
+	draw(p, meshes, num_meshes);
+	close_prog(p);
+
+	for (i = 0; i < num_meshes; i++)
+		free_mesh(&meshes[i]);
+	FREE(meshes);
+
+	return 0;
+}
@@ -0,0 +1,414 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the same indexed and linear draws through the draw module with 0
+ * to 4 vertex shading threads (DRAW_NUM_THREADS) and checks that the
+ * backend sees the exact same primitives and vertices every time.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_text.h"
+#include "draw/draw_context.h"
+#include "draw/draw_vbuf.h"
+#include "draw/draw_vertex.h"
+
+
+#define MAX_THREADS 4
+#define NUM_VERTICES 20000
+#define NUM_INDICES 300000
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL CONST[0..7]\n"
+   "DCL TEMP[0..3]\n"
+   "IMM[0] FLT32 { 0.5, 1.0, 0.25, 2.0 }\n"
+   "  0: MUL TEMP[0], IN[0].xxxx, CONST[0]\n"
+   "  1: MAD TEMP[0], IN[0].yyyy, CONST[1], TEMP[0]\n"
+   "  2: MAD TEMP[0], IN[0].zzzz, CONST[2], TEMP[0]\n"
+   "  3: MAD OUT[0], IN[0].wwww, CONST[3], TEMP[0]\n"
+   "  4: DP3 TEMP[1].x, IN[1], CONST[4]\n"
+   "  5: MAX TEMP[1].x, TEMP[1].xxxx, IMM[0].zzzz\n"
+   "  6: RSQ TEMP[2].x, TEMP[1].xxxx\n"
+   "  7: MUL TEMP[3], IN[1], TEMP[2].xxxx\n"
+   "  8: MAD OUT[1], TEMP[3], CONST[5], IMM[0].xxxx\n"
+   "  9: END\n";
+
+
+/**
+ * A vbuf_render which hashes every primitive type and emitted vertex, in
+ * the order the draw module hands them over.
+ */
+struct hash_render {
+   struct vbuf_render base;
+   struct vertex_info vinfo;
+   ubyte *vertices;
+   unsigned vertex_size;
+   uint64_t hash;
+   unsigned num_indices;
+};
+
+static INLINE struct hash_render *
+hash_render(struct vbuf_render *render)
+{
+   return (struct hash_render *) render;
+}
+
+static void
+hash_bytes(struct hash_render *hr, const void *data, unsigned size)
+{
+   const ubyte *bytes = (const ubyte *) data;
+   unsigned i;
+
+   /* FNV-1a */
+   for (i = 0; i < size; i++)
+      hr->hash = (hr->hash ^ bytes[i]) * 1099511628211ULL;
+}
+
+static const struct vertex_info *
+hr_get_vertex_info(struct vbuf_render *render)
+{
+   return &hash_render(render)->vinfo;
+}
+
+static boolean
+hr_allocate_vertices(struct vbuf_render *render,
+                     ushort vertex_size, ushort nr_vertices)
+{
+   struct hash_render *hr = hash_render(render);
+
+   FREE(hr->vertices);
+   hr->vertices = MALLOC(vertex_size * nr_vertices);
+   hr->vertex_size = vertex_size;
+   return hr->vertices != NULL;
+}
+
+static void *
+hr_map_vertices(struct vbuf_render *render)
+{
+   return hash_render(render)->vertices;
+}
+
+static void
+hr_unmap_vertices(struct vbuf_render *render, ushort min_index,
+                  ushort max_index)
+{
+}
+
+static void
+hr_set_primitive(struct vbuf_render *render, unsigned prim)
+{
+   hash_bytes(hash_render(render), &prim, sizeof prim);
+}
+
+static void
+hr_draw_elements(struct vbuf_render *render, const ushort *indices,
+                 uint nr_indices)
+{
+   struct hash_render *hr = hash_render(render);
+   unsigned i;
+
+   for (i = 0; i < nr_indices; i++) {
+      hash_bytes(hr, hr->vertices + indices[i] * hr->vertex_size,
+                 hr->vertex_size);
+   }
+   hr->num_indices += nr_indices;
+}
+
+static void
+hr_draw_arrays(struct vbuf_render *render, uint start, uint nr_vertices)
+{
+   struct hash_render *hr = hash_render(render);
+   unsigned i;
+
+   for (i = 0; i < nr_vertices; i++) {
+      hash_bytes(hr, hr->vertices + (start + i) * hr->vertex_size,
+                 hr->vertex_size);
+   }
+   hr->num_indices += nr_vertices;
+}
+
+static void
+hr_release_vertices(struct vbuf_render *render)
+{
+}
+
+static void
+hr_destroy(struct vbuf_render *render)
+{
+   struct hash_render *hr = hash_render(render);
+
+   FREE(hr->vertices);
+   FREE(hr);
+}
+
+
+/*
+ * Just enough of a pipe context for the draw module's pipeline stages.
+ */
+
+static int
+screen_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+static void *
+create_rasterizer_state(struct pipe_context *pipe,
+                        const struct pipe_rasterizer_state *state)
+{
+   return (void *) state;
+}
+
+static void
+bind_rasterizer_state(struct pipe_context *pipe, void *state)
+{
+}
+
+static void
+delete_rasterizer_state(struct pipe_context *pipe, void *state)
+{
+}
+
+
+static void
+set_num_threads(unsigned num_threads)
+{
+   char value[16];
+
+   util_snprintf(value, sizeof value, "%u", num_threads);
+#ifdef PIPE_OS_WINDOWS
+   _putenv_s("DRAW_NUM_THREADS", value);
+#else
+   setenv("DRAW_NUM_THREADS", value, 1);
+#endif
+}
+
+
+/**
+ * Draw the test geometry with \p num_threads threads.
+ * \return the hash of what the backend got, and the number of indices in
+ *         \p num_indices
+ */
+static uint64_t
+run_draws(struct pipe_context *pipe, unsigned num_threads,
+          const float *vertices, const unsigned *indices,
+          unsigned *num_indices)
+{
+   static const float constants[8][4] = {
+      { 1.0f, 0.0f, 0.0f, 0.0f },
+      { 0.0f, 0.8f, 0.1f, 0.0f },
+      { 0.0f, 0.1f, 0.9f, 0.0f },
+      { 0.2f, 0.0f, 0.3f, 1.0f },
+      { 0.5f, 0.4f, 0.3f, 0.0f },
+      { 0.9f, 0.7f, 0.5f, 0.3f },
+      { 0.0f, 0.0f, 0.0f, 0.0f },
+      { 0.0f, 0.0f, 0.0f, 0.0f }
+   };
+   struct tgsi_token tokens[1000];
+   struct pipe_shader_state shader;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velems[2];
+   struct pipe_vertex_buffer vbuf;
+   struct pipe_draw_info info;
+   struct draw_vertex_shader *vs;
+   struct draw_context *draw;
+   struct hash_render *hr;
+   uint64_t hash;
+
+   hr = CALLOC_STRUCT(hash_render);
+   if (!hr)
+      exit(1);
+
+   hr->hash = 14695981039346656037ULL;
+   hr->base.max_indices = 1024;
+   hr->base.max_vertex_buffer_bytes = 1 << 20;
+   hr->base.get_vertex_info = hr_get_vertex_info;
+   hr->base.allocate_vertices = hr_allocate_vertices;
+   hr->base.map_vertices = hr_map_vertices;
+   hr->base.unmap_vertices = hr_unmap_vertices;
+   hr->base.set_primitive = hr_set_primitive;
+   hr->base.draw_elements = hr_draw_elements;
+   hr->base.draw_arrays = hr_draw_arrays;
+   hr->base.release_vertices = hr_release_vertices;
+   hr->base.destroy = hr_destroy;
+
+   draw_emit_vertex_attr(&hr->vinfo, EMIT_4F, INTERP_LINEAR, 0);
+   draw_emit_vertex_attr(&hr->vinfo, EMIT_4F, INTERP_LINEAR, 1);
+   draw_compute_vertex_size(&hr->vinfo);
+
+   /* read when the draw context is created */
+   set_num_threads(num_threads);
+
+   draw = draw_create_no_llvm(pipe);
+   if (!draw)
+      exit(1);
+
+   draw_set_rasterize_stage(draw, draw_vbuf_stage(draw, &hr->base));
+   draw_set_render(draw, &hr->base);
+
+   memset(&rast, 0, sizeof rast);
+   rast.depth_clip = 1;
+   rast.half_pixel_center = 1;
+   draw_set_rasterizer_state(draw, &rast, &rast);
+
+   viewport.scale[0] = 100.0f;
+   viewport.scale[1] = 100.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.scale[3] = 1.0f;
+   viewport.translate[0] = 100.0f;
+   viewport.translate[1] = 100.0f;
+   viewport.translate[2] = 0.5f;
+   viewport.translate[3] = 0.0f;
+   draw_set_viewport_states(draw, 0, 1, &viewport);
+
+   if (!tgsi_text_translate(vs_text, tokens, Elements(tokens)))
+      exit(1);
+   memset(&shader, 0, sizeof shader);
+   shader.tokens = tokens;
+   vs = draw_create_vertex_shader(draw, &shader);
+   draw_bind_vertex_shader(draw, vs);
+   draw_set_mapped_constant_buffer(draw, PIPE_SHADER_VERTEX, 0,
+                                   constants, sizeof constants);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 16;
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   draw_set_vertex_elements(draw, 2, velems);
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = 8 * sizeof(float);
+   vbuf.user_buffer = vertices;
+   draw_set_vertex_buffers(draw, 0, 1, &vbuf);
+   draw_set_mapped_vertex_buffer(draw, 0, vertices,
+                                 NUM_VERTICES * 8 * sizeof(float));
+   draw_set_indexes(draw, indices, sizeof(unsigned),
+                    NUM_INDICES * sizeof(unsigned));
+
+   memset(&info, 0, sizeof info);
+   info.instance_count = 1;
+   info.max_index = NUM_VERTICES - 1;
+
+   /* too small to be threaded, comes before the threads exist */
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = 30;
+   draw_vbo(draw, &info);
+
+   info.indexed = TRUE;
+   info.count = NUM_INDICES;
+   draw_vbo(draw, &info);
+
+   info.indexed = FALSE;
+   info.mode = PIPE_PRIM_TRIANGLE_STRIP;
+   info.count = NUM_VERTICES;
+   draw_vbo(draw, &info);
+
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = 30;
+   draw_vbo(draw, &info);
+
+   draw_flush(draw);
+
+   hash = hr->hash;
+   *num_indices = hr->num_indices;
+
+   draw_delete_vertex_shader(draw, vs);
+   draw_destroy(draw);
+
+   return hash;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   float *vertices;
+   unsigned *indices;
+   uint64_t ref_hash = 0;
+   unsigned ref_num_indices = 0;
+   unsigned num_threads, i;
+   int ret = 0;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = screen_get_param;
+
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+   pipe.create_rasterizer_state = create_rasterizer_state;
+   pipe.bind_rasterizer_state = bind_rasterizer_state;
+   pipe.delete_rasterizer_state = delete_rasterizer_state;
+
+   vertices = MALLOC(NUM_VERTICES * 8 * sizeof(float));
+   indices = MALLOC(NUM_INDICES * sizeof(unsigned));
+   if (!vertices || !indices)
+      return 1;
+
+   srand(1);
+   for (i = 0; i < NUM_VERTICES * 8; i++)
+      vertices[i] = (rand() % 2000) / 1000.0f - 1.0f;
+   for (i = 0; i < NUM_VERTICES; i++)
+      vertices[i * 8 + 3] = 1.0f;
+   for (i = 0; i < NUM_INDICES; i++)
+      indices[i] = rand() % NUM_VERTICES;
+
+   for (num_threads = 0; num_threads <= MAX_THREADS; num_threads++) {
+      unsigned num_indices;
+      uint64_t hash = run_draws(&pipe, num_threads, vertices, indices,
+                                &num_indices);
+
+      printf("%u threads: hash %016llx, %u indices\n", num_threads,
+             (unsigned long long) hash, num_indices);
+
+      if (num_threads == 0) {
+         ref_hash = hash;
+         ref_num_indices = num_indices;
+      }
+      else if (hash != ref_hash || num_indices != ref_num_indices) {
+         printf("  FAILED: differs from the unthreaded draws\n");
+         ret = 1;
+      }
+   }
+
+   FREE(indices);
+   FREE(vertices);
+
+   return ret;
+}
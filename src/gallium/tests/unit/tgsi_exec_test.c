@@ -0,0 +1,322 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs a small corpus of vertex shaders through the TGSI interpreter 4, 8
+ * and 16 lanes at a time, with and without pre-decoded instructions,
+ * checks that every configuration gives bit-identical results and prints
+ * how long each one took.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_shader_tokens.h"
+#include "util/u_memory.h"
+#include "os/os_time.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+
+
+#define NUM_VERTICES 4096
+#define NUM_ITERATIONS 50
+#define NUM_INPUTS 3
+#define NUM_OUTPUTS 2
+#define NUM_CONSTS 24
+
+
+struct test_shader {
+   const char *name;
+   const char *text;
+};
+
+static const struct test_shader shaders[] = {
+   {
+      "transform",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "DCL CONST[0..3]\n"
+      "DP4 OUT[0].x, IN[0], CONST[0]\n"
+      "DP4 OUT[0].y, IN[0], CONST[1]\n"
+      "DP4 OUT[0].z, IN[0], CONST[2]\n"
+      "DP4 OUT[0].w, IN[0], CONST[3]\n"
+      "MOV OUT[1], IN[1]\n"
+      "END\n"
+   },
+   {
+      "lighting",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "DCL CONST[0..11]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] FLT32 { 0.0, 1.0, 0.5, 8.0 }\n"
+      "DP4 TEMP[0].x, IN[0], CONST[0]\n"
+      "DP4 TEMP[0].y, IN[0], CONST[1]\n"
+      "DP4 TEMP[0].z, IN[0], CONST[2]\n"
+      "DP4 TEMP[0].w, IN[0], CONST[3]\n"
+      "MOV OUT[0], TEMP[0]\n"
+      "DP3 TEMP[1].x, IN[1], IN[1]\n"
+      "RSQ TEMP[1].x, |TEMP[1].xxxx|\n"
+      "MUL TEMP[1].xyz, IN[1], TEMP[1].xxxx\n"
+      "MOV TEMP[3], CONST[8]\n"
+      /* two directional lights with specular */
+      "DP3 TEMP[2].x, TEMP[1], CONST[4]\n"
+      "MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      "POW TEMP[2].y, TEMP[2].xxxx, IMM[0].wwww\n"
+      "MAD TEMP[3], CONST[5], TEMP[2].xxxx, TEMP[3]\n"
+      "MAD TEMP[3], CONST[9], TEMP[2].yyyy, TEMP[3]\n"
+      "DP3 TEMP[2].x, TEMP[1], CONST[6]\n"
+      "MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      "POW TEMP[2].y, TEMP[2].xxxx, IMM[0].wwww\n"
+      "MAD TEMP[3], CONST[7], TEMP[2].xxxx, TEMP[3]\n"
+      "MAD TEMP[3], CONST[10], TEMP[2].yyyy, TEMP[3]\n"
+      "MOV_SAT OUT[1], TEMP[3]\n"
+      "END\n"
+   },
+   {
+      "skinning",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL IN[2]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "DCL CONST[0..23]\n"
+      "DCL TEMP[0..1]\n"
+      "DCL ADDR[0]\n"
+      "IMM[0] FLT32 { 4.0, 0.0, 0.0, 0.0 }\n"
+      "MUL TEMP[1].x, IN[2].yyyy, IMM[0].xxxx\n"
+      "ARL ADDR[0].x, TEMP[1].xxxx\n"
+      "DP4 TEMP[0].x, IN[0], CONST[ADDR[0].x+8]\n"
+      "DP4 TEMP[0].y, IN[0], CONST[ADDR[0].x+9]\n"
+      "DP4 TEMP[0].z, IN[0], CONST[ADDR[0].x+10]\n"
+      "DP4 TEMP[0].w, IN[0], CONST[ADDR[0].x+11]\n"
+      "DP4 OUT[0].x, TEMP[0], CONST[0]\n"
+      "DP4 OUT[0].y, TEMP[0], CONST[1]\n"
+      "DP4 OUT[0].z, TEMP[0], CONST[2]\n"
+      "DP4 OUT[0].w, TEMP[0], CONST[3]\n"
+      "MOV OUT[1], IN[1]\n"
+      "END\n"
+   },
+   {
+      "control flow",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL IN[2]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "DCL CONST[0..7]\n"
+      "DCL TEMP[0..5]\n"
+      "IMM[0] FLT32 { 0.0, 1.0, 0.5, 8.0 }\n"
+      "DP4 TEMP[0].x, IN[0], CONST[0]\n"
+      "DP4 TEMP[0].y, IN[0], CONST[1]\n"
+      "DP4 TEMP[0].z, IN[0], CONST[2]\n"
+      "DP4 TEMP[0].w, IN[0], CONST[3]\n"
+      "MOV OUT[0], TEMP[0]\n"
+      "DP3 TEMP[1].x, IN[1], IN[1]\n"
+      "RSQ TEMP[1].x, |TEMP[1].xxxx|\n"
+      "MUL TEMP[1].xyz, IN[1], TEMP[1].xxxx\n"
+      "DP3 TEMP[2].x, TEMP[1], CONST[4]\n"
+      "MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      "POW TEMP[2].y, TEMP[2].xxxx, CONST[5].wwww\n"
+      "MAD TEMP[3], CONST[5], TEMP[2].xxxx, CONST[6]\n"
+      /* divergent branch */
+      "SLT TEMP[4].x, TEMP[2].xxxx, IMM[0].zzzz\n"
+      "IF TEMP[4].xxxx\n"
+      "  LRP TEMP[3], TEMP[2].yyyy, CONST[7], TEMP[3]\n"
+      "ELSE\n"
+      "  MIN TEMP[3], TEMP[3], IMM[0].yyyy\n"
+      "  SUB TEMP[3].w, IMM[0].yyyy, TEMP[3].wwww\n"
+      "ENDIF\n"
+      /* divergent loop */
+      "MOV TEMP[5], IMM[0].xxxx\n"
+      "BGNLOOP\n"
+      "  ADD TEMP[5].x, TEMP[5].xxxx, IMM[0].yyyy\n"
+      "  MAD TEMP[3].xyz, TEMP[3], IMM[0].zzzz, TEMP[1]\n"
+      "  SGE TEMP[5].y, TEMP[5].xxxx, IN[2].xxxx\n"
+      "  IF TEMP[5].yyyy\n"
+      "    BRK\n"
+      "  ENDIF\n"
+      "ENDLOOP\n"
+      "CMP OUT[1], -TEMP[4].xxxx, TEMP[3], -TEMP[3].wzyx\n"
+      "END\n"
+   },
+   {
+      /* constants past the end of the buffer read as zero */
+      "const bounds",
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "DCL CONST[0..127]\n"
+      "ADD OUT[0], IN[0], CONST[23]\n"
+      "MAD OUT[1], IN[0], CONST[100], CONST[127].wzyx\n"
+      "END\n"
+   }
+};
+
+
+static float inputs[NUM_VERTICES][NUM_INPUTS][4];
+static float reference[NUM_VERTICES][NUM_OUTPUTS][4];
+static float outputs[NUM_VERTICES][NUM_OUTPUTS][4];
+
+
+static float
+rand_float(float lo, float hi)
+{
+   return lo + (hi - lo) * (float) rand() / (float) RAND_MAX;
+}
+
+
+/**
+ * Shade all vertices NUM_ITERATIONS times, num_lanes at a time.
+ * \return time taken in microseconds
+ */
+static int64_t
+run_shader(const struct tgsi_token *tokens, const float consts[][4],
+           unsigned num_lanes, boolean predecode,
+           float (*out)[NUM_OUTPUTS][4])
+{
+   struct tgsi_exec_machine *mach = tgsi_exec_machine_create();
+   const void *bufs[1];
+   unsigned buf_sizes[1];
+   unsigned iter, v, lane, attr, chan;
+   int64_t start, end;
+
+   putenv(predecode ? "TGSI_EXEC_PREDECODE=1" : "TGSI_EXEC_PREDECODE=0");
+
+   tgsi_exec_machine_set_lanes(mach, num_lanes);
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL);
+
+   bufs[0] = consts;
+   buf_sizes[0] = NUM_CONSTS * 4 * sizeof(float);
+   tgsi_exec_set_constant_buffers(mach, 1, bufs, buf_sizes);
+
+   start = os_time_get();
+
+   for (iter = 0; iter < NUM_ITERATIONS; iter++) {
+      for (v = 0; v < NUM_VERTICES; v += num_lanes) {
+         for (lane = 0; lane < num_lanes; lane++) {
+            for (attr = 0; attr < NUM_INPUTS; attr++) {
+               for (chan = 0; chan < 4; chan++) {
+                  mach->Inputs[attr].xyzw[chan].f[lane] =
+                     inputs[v + lane][attr][chan];
+               }
+            }
+         }
+
+         tgsi_exec_machine_run(mach);
+
+         for (lane = 0; lane < num_lanes; lane++) {
+            for (attr = 0; attr < NUM_OUTPUTS; attr++) {
+               for (chan = 0; chan < 4; chan++) {
+                  out[v + lane][attr][chan] =
+                     mach->Outputs[attr].xyzw[chan].f[lane];
+               }
+            }
+         }
+      }
+   }
+
+   end = os_time_get();
+
+   tgsi_exec_machine_bind_shader(mach, NULL, NULL);
+   tgsi_exec_machine_destroy(mach);
+
+   return end - start;
+}
+
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned lanes[3] = { 4, 8, 16 };
+   struct tgsi_token tokens[1000];
+   float consts[NUM_CONSTS][4];
+   unsigned i, j, s, v;
+   unsigned fails = 0;
+
+   srand(42);
+
+   for (i = 0; i < NUM_CONSTS; i++)
+      for (j = 0; j < 4; j++)
+         consts[i][j] = rand_float(-1.0f, 1.0f);
+   consts[5][3] = 16.0f;
+
+   for (v = 0; v < NUM_VERTICES; v++) {
+      for (i = 0; i < NUM_INPUTS; i++)
+         for (j = 0; j < 4; j++)
+            inputs[v][i][j] = rand_float(-2.0f, 2.0f);
+      inputs[v][0][3] = 1.0f;
+      /* number of loop iterations, 1 to 8 */
+      inputs[v][2][0] = (float) (1 + rand() % 8);
+      /* bone index, 0 to 3 */
+      inputs[v][2][1] = (float) (rand() % 4);
+   }
+
+   printf("%-14s lanes  generic (ms)  predecoded (ms)\n", "shader");
+
+   for (s = 0; s < Elements(shaders); s++) {
+      if (!tgsi_text_translate(shaders[s].text, tokens, Elements(tokens))) {
+         printf("Could not translate the %s shader\n", shaders[s].name);
+         ++fails;
+         continue;
+      }
+
+      run_shader(tokens, (const float (*)[4]) consts, 4, FALSE, reference);
+
+      for (i = 0; i < Elements(lanes); i++) {
+         int64_t times[2];
+
+         for (j = 0; j < 2; j++) {
+            times[j] = run_shader(tokens, (const float (*)[4]) consts,
+                                  lanes[i], j, outputs);
+
+            if (memcmp(reference, outputs, sizeof(outputs)) != 0) {
+               printf("%s: %u lanes%s give different results\n",
+                      shaders[s].name, lanes[i], j ? " predecoded" : "");
+               ++fails;
+            }
+         }
+
+         printf("%-14s %5u  %12.3f  %15.3f\n", shaders[s].name, lanes[i],
+                times[0] / 1000.0, times[1] / 1000.0);
+      }
+   }
+
+   if (fails)
+      printf("Failure!\n");
+   else
+      printf("Success!\n");
+
+   return fails != 0;
+}
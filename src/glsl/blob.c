@@ -0,0 +1,273 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "ralloc.h"
+#include "blob.h"
+
+#define BLOB_INITIAL_SIZE 4096
+
+#define BLOB_ALIGN(value, alignment) \
+   (((value) + (alignment) - 1) & ~((size_t) (alignment) - 1))
+
+/* Make sure there is room for \c additional more bytes. */
+static bool
+grow_to_fit(struct blob *blob, size_t additional)
+{
+   size_t to_allocate;
+   uint8_t *new_data;
+
+   if (blob->out_of_memory)
+      return false;
+
+   if (blob->size + additional <= blob->allocated)
+      return true;
+
+   if (blob->allocated == 0)
+      to_allocate = BLOB_INITIAL_SIZE;
+   else
+      to_allocate = blob->allocated * 2;
+
+   if (to_allocate < blob->size + additional)
+      to_allocate = blob->size + additional;
+
+   new_data = reralloc_size(blob, blob->data, to_allocate);
+   if (new_data == NULL) {
+      blob->out_of_memory = true;
+      return false;
+   }
+
+   blob->data = new_data;
+   blob->allocated = to_allocate;
+
+   return true;
+}
+
+/* Pad the blob with zeros up to a multiple of \c alignment. */
+static bool
+align_blob(struct blob *blob, size_t alignment)
+{
+   const size_t new_size = BLOB_ALIGN(blob->size, alignment);
+
+   if (blob->size < new_size) {
+      if (!grow_to_fit(blob, new_size - blob->size))
+         return false;
+
+      memset(blob->data + blob->size, 0, new_size - blob->size);
+      blob->size = new_size;
+   }
+
+   return true;
+}
+
+static void
+align_blob_reader(struct blob_reader *blob, size_t alignment)
+{
+   const size_t offset = blob->current - blob->data;
+
+   blob->current = blob->data + BLOB_ALIGN(offset, alignment);
+}
+
+struct blob *
+blob_create(void *mem_ctx)
+{
+   return rzalloc(mem_ctx, struct blob);
+}
+
+bool
+blob_write_bytes(struct blob *blob, const void *bytes, size_t to_write)
+{
+   if (!grow_to_fit(blob, to_write))
+      return false;
+
+   memcpy(blob->data + blob->size, bytes, to_write);
+   blob->size += to_write;
+
+   return true;
+}
+
+intptr_t
+blob_reserve_bytes(struct blob *blob, size_t to_write)
+{
+   intptr_t ret;
+
+   if (!grow_to_fit(blob, to_write))
+      return -1;
+
+   ret = blob->size;
+   blob->size += to_write;
+
+   return ret;
+}
+
+bool
+blob_overwrite_bytes(struct blob *blob, size_t offset,
+                     const void *bytes, size_t to_write)
+{
+   if (offset + to_write < offset || offset + to_write > blob->size)
+      return false;
+
+   memcpy(blob->data + offset, bytes, to_write);
+
+   return true;
+}
+
+bool
+blob_write_uint8(struct blob *blob, uint8_t value)
+{
+   return blob_write_bytes(blob, &value, sizeof(value));
+}
+
+bool
+blob_write_uint32(struct blob *blob, uint32_t value)
+{
+   align_blob(blob, sizeof(value));
+
+   return blob_write_bytes(blob, &value, sizeof(value));
+}
+
+bool
+blob_write_uint64(struct blob *blob, uint64_t value)
+{
+   align_blob(blob, sizeof(value));
+
+   return blob_write_bytes(blob, &value, sizeof(value));
+}
+
+bool
+blob_write_string(struct blob *blob, const char *str)
+{
+   size_t len;
+
+   /* A length of zero stands for NULL; otherwise it counts the NUL. */
+   if (str == NULL)
+      return blob_write_uint32(blob, 0);
+
+   len = strlen(str) + 1;
+
+   return blob_write_uint32(blob, (uint32_t) len) &&
+          blob_write_bytes(blob, str, len);
+}
+
+void
+blob_reader_init(struct blob_reader *blob, const void *data, size_t size)
+{
+   blob->data = (const uint8_t *) data;
+   blob->end = blob->data + size;
+   blob->current = blob->data;
+   blob->overrun = false;
+}
+
+/* Check that \c size more bytes can be read, flagging an overrun if not. */
+static bool
+ensure_can_read(struct blob_reader *blob, size_t size)
+{
+   if (blob->overrun)
+      return false;
+
+   if (blob->current <= blob->end &&
+       size <= (size_t) (blob->end - blob->current))
+      return true;
+
+   blob->overrun = true;
+
+   return false;
+}
+
+const void *
+blob_read_bytes(struct blob_reader *blob, size_t size)
+{
+   const void *ret;
+
+   if (!ensure_can_read(blob, size))
+      return NULL;
+
+   ret = blob->current;
+   blob->current += size;
+
+   return ret;
+}
+
+void
+blob_copy_bytes(struct blob_reader *blob, void *dest, size_t size)
+{
+   const void *bytes = blob_read_bytes(blob, size);
+
+   if (bytes == NULL) {
+      memset(dest, 0, size);
+      return;
+   }
+
+   memcpy(dest, bytes, size);
+}
+
+uint8_t
+blob_read_uint8(struct blob_reader *blob)
+{
+   uint8_t ret;
+
+   blob_copy_bytes(blob, &ret, sizeof(ret));
+
+   return ret;
+}
+
+uint32_t
+blob_read_uint32(struct blob_reader *blob)
+{
+   uint32_t ret;
+
+   align_blob_reader(blob, sizeof(ret));
+   blob_copy_bytes(blob, &ret, sizeof(ret));
+
+   return ret;
+}
+
+uint64_t
+blob_read_uint64(struct blob_reader *blob)
+{
+   uint64_t ret;
+
+   align_blob_reader(blob, sizeof(ret));
+   blob_copy_bytes(blob, &ret, sizeof(ret));
+
+   return ret;
+}
+
+char *
+blob_read_string(struct blob_reader *blob, void *mem_ctx)
+{
+   const uint32_t len = blob_read_uint32(blob);
+   const char *str;
+
+   if (len == 0)
+      return NULL;
+
+   str = (const char *) blob_read_bytes(blob, len);
+   if (str == NULL || str[len - 1] != '\0') {
+      blob->overrun = true;
+      return NULL;
+   }
+
+   return ralloc_strdup(mem_ctx, str);
+}
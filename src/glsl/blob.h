@@ -0,0 +1,134 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BLOB_H
+#define BLOB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \file blob.h
+ *
+ * A growable byte buffer for serializing data, and a matching reader.
+ *
+ * Fixed-size values are written at their natural alignment (relative to
+ * the start of the blob) so that a blob that has been mapped into memory,
+ * for example straight from the on-disk shader cache, can be read without
+ * copying.  The reader never reads past the end of its buffer; once an
+ * overrun is detected all further reads return zeros and
+ * \c blob_reader::overrun is set.
+ */
+
+struct blob {
+   uint8_t *data;
+   size_t allocated;
+   size_t size;
+
+   /** Set when growing the buffer failed; all later writes are dropped. */
+   bool out_of_memory;
+};
+
+struct blob_reader {
+   const uint8_t *data;
+   const uint8_t *end;
+   const uint8_t *current;
+   bool overrun;
+};
+
+/**
+ * Create a blob.  The blob and its data are owned by \c mem_ctx.
+ */
+struct blob *
+blob_create(void *mem_ctx);
+
+bool
+blob_write_bytes(struct blob *blob, const void *bytes, size_t to_write);
+
+/**
+ * Reserve space for \c to_write bytes and return its offset, or -1 on
+ * failure.  The space can be filled in later with \c blob_overwrite_bytes.
+ */
+intptr_t
+blob_reserve_bytes(struct blob *blob, size_t to_write);
+
+bool
+blob_overwrite_bytes(struct blob *blob, size_t offset,
+                     const void *bytes, size_t to_write);
+
+bool
+blob_write_uint8(struct blob *blob, uint8_t value);
+
+bool
+blob_write_uint32(struct blob *blob, uint32_t value);
+
+bool
+blob_write_uint64(struct blob *blob, uint64_t value);
+
+/**
+ * Write a NUL-terminated string; \c NULL is allowed and read back as
+ * \c NULL.
+ */
+bool
+blob_write_string(struct blob *blob, const char *str);
+
+void
+blob_reader_init(struct blob_reader *blob, const void *data, size_t size);
+
+/**
+ * Return a pointer to the next \c size bytes and advance past them, or
+ * \c NULL on overrun.  The returned memory belongs to the blob.
+ */
+const void *
+blob_read_bytes(struct blob_reader *blob, size_t size);
+
+void
+blob_copy_bytes(struct blob_reader *blob, void *dest, size_t size);
+
+uint8_t
+blob_read_uint8(struct blob_reader *blob);
+
+uint32_t
+blob_read_uint32(struct blob_reader *blob);
+
+uint64_t
+blob_read_uint64(struct blob_reader *blob);
+
+/**
+ * Read a string written by \c blob_write_string.  The string is copied
+ * into \c mem_ctx.
+ */
+char *
+blob_read_string(struct blob_reader *blob, void *mem_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOB_H */
@@ -39,7 +39,8 @@
  *
  *    The builtin_builder::create_builtins() function contains lists of all
  *    built-in function signatures, where they're available, what types they
- *    take, and so on.
+ *    take, and so on.  The signatures of a built-in are only generated the
+ *    first time a shader calls it.
  *
  * 4. Implementations of built-in function signatures
  *
@@ -350,8 +351,11 @@ namespace {
  * builtin_builder: A singleton object representing the core of the built-in
  * function module.
  *
- * It generates IR for every built-in function signature, and organizes them
- * into functions.
+ * It generates IR for the built-in function signatures, and organizes them
+ * into functions.  The functions for all the built-in names are created up
+ * front, but their signatures are generated on demand, by find().  Once
+ * generated, a function is never modified again, so the IR can be shared by
+ * every context and compile until release().
  */
 class builtin_builder {
 public:
@@ -366,8 +370,8 @@ public:
    /**
     * A shader to hold all the built-in signatures; created by this module.
     *
-    * This includes signatures for every built-in, regardless of version or
-    * enabled extensions.  The availability predicate associated with each
+    * This includes signatures for every built-in that has been looked up,
+    * regardless of version or enabled extensions.  The availability predicate associated with each
     * signature allows matching_signature() to filter out the irrelevant ones.
     */
    gl_shader *shader;
@@ -379,9 +383,16 @@ private:
    ir_variable *gl_ModelViewProjectionMatrix;
    ir_variable *gl_Vertex;
 
+   /**
+    * The built-in whose signatures create_builtins() generates, or NULL to
+    * only create the (empty) functions for all the built-in names.
+    */
+   const char *wanted;
+
    void create_shader();
    void create_intrinsics();
-   void create_builtins();
+   void create_builtins(const char *name);
+   bool want(const char *name);
 
    /**
     * IR builder helpers:
@@ -598,7 +609,8 @@ private:
 builtin_builder::builtin_builder()
    : shader(NULL),
      gl_ModelViewProjectionMatrix(NULL),
-     gl_Vertex(NULL)
+     gl_Vertex(NULL),
+     wanted(NULL)
 {
    mem_ctx = NULL;
 }
@@ -625,6 +637,12 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    if (f == NULL)
       return NULL;
 
+   /* Every built-in has at least one signature, so an empty function is one
+    * that hasn't been generated yet.
+    */
+   if (f->signatures.is_empty())
+      create_builtins(f->name);
+
    ir_function_signature *sig = f->matching_signature(state, actual_parameters);
    if (sig == NULL)
       return NULL;
@@ -642,7 +660,7 @@ builtin_builder::initialize()
    mem_ctx = ralloc_context(NULL);
    create_shader();
    create_intrinsics();
-   create_builtins();
+   create_builtins(NULL);
 }
 
 void
@@ -697,15 +715,44 @@ builtin_builder::create_intrinsics()
 }
 
 /**
- * Create ir_function and ir_function_signature objects for each built-in.
+ * Decide whether create_builtins() should generate the signatures of the
+ * built-in \p name.
+ *
+ * When no particular built-in is wanted, this only creates its function, so
+ * that find() knows about the name.
+ */
+bool
+builtin_builder::want(const char *name)
+{
+   if (wanted != NULL)
+      return strcmp(name, wanted) == 0;
+
+   if (shader->symbols->get_function(name) == NULL)
+      shader->symbols->add_function(new(mem_ctx) ir_function(name));
+
+   return false;
+}
+
+/**
+ * Create ir_function_signature objects for the built-in \p name, or
+ * ir_function objects for every built-in if \p name is NULL.
  *
  * Contains a list of every available built-in.
  */
 void
-builtin_builder::create_builtins()
+builtin_builder::create_builtins(const char *name)
 {
+/* The signatures are only evaluated when the built-in is wanted. */
+#define ADD_FUNCTION(NAME, ...)                 \
+   do {                                         \
+      if (want(NAME))                           \
+         add_function(NAME, __VA_ARGS__);       \
+   } while (0)
+
+   wanted = name;
+
 #define F(NAME)                                 \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::float_type), \
                 _##NAME(glsl_type::vec2_type),  \
                 _##NAME(glsl_type::vec3_type),  \
@@ -713,7 +760,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FI(NAME)                                \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::float_type), \
                 _##NAME(glsl_type::vec2_type),  \
                 _##NAME(glsl_type::vec3_type),  \
@@ -725,7 +772,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIU(NAME)                                                 \
-   add_function(#NAME,                                            \
+   ADD_FUNCTION(#NAME,                                            \
                 _##NAME(always_available, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
@@ -743,7 +790,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define IU(NAME)                                \
-   add_function(#NAME,                          \
+   ADD_FUNCTION(#NAME,                          \
                 _##NAME(glsl_type::int_type),   \
                 _##NAME(glsl_type::ivec2_type), \
                 _##NAME(glsl_type::ivec3_type), \
@@ -756,7 +803,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIUB(NAME)                                                \
-   add_function(#NAME,                                            \
+   ADD_FUNCTION(#NAME,                                            \
                 _##NAME(always_available, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type),  \
                 _##NAME(always_available, glsl_type::vec3_type),  \
@@ -779,7 +826,7 @@ builtin_builder::create_builtins()
                 NULL);
 
 #define FIU2_MIXED(NAME)                                                                 \
-   add_function(#NAME,                                                                   \
+   ADD_FUNCTION(#NAME,                                                                   \
                 _##NAME(always_available, glsl_type::float_type, glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec2_type,  glsl_type::float_type), \
                 _##NAME(always_available, glsl_type::vec3_type,  glsl_type::float_type), \
@@ -816,7 +863,7 @@ builtin_builder::create_builtins()
    F(asin)
    F(acos)
 
-   add_function("atan",
+   ADD_FUNCTION("atan",
                 _atan(glsl_type::float_type),
                 _atan(glsl_type::vec2_type),
                 _atan(glsl_type::vec3_type),
@@ -849,7 +896,7 @@ builtin_builder::create_builtins()
    F(ceil)
    F(fract)
 
-   add_function("mod",
+   ADD_FUNCTION("mod",
                 _mod(glsl_type::float_type, glsl_type::float_type),
                 _mod(glsl_type::vec2_type,  glsl_type::float_type),
                 _mod(glsl_type::vec3_type,  glsl_type::float_type),
@@ -866,7 +913,7 @@ builtin_builder::create_builtins()
    FIU2_MIXED(max)
    FIU2_MIXED(clamp)
 
-   add_function("mix",
+   ADD_FUNCTION("mix",
                 _mix_lrp(glsl_type::float_type, glsl_type::float_type),
                 _mix_lrp(glsl_type::vec2_type,  glsl_type::float_type),
                 _mix_lrp(glsl_type::vec3_type,  glsl_type::float_type),
@@ -897,7 +944,7 @@ builtin_builder::create_builtins()
                 _mix_sel(shader_integer_mix, glsl_type::bvec4_type, glsl_type::bvec4_type),
                 NULL);
 
-   add_function("step",
+   ADD_FUNCTION("step",
                 _step(glsl_type::float_type, glsl_type::float_type),
                 _step(glsl_type::float_type, glsl_type::vec2_type),
                 _step(glsl_type::float_type, glsl_type::vec3_type),
@@ -908,7 +955,7 @@ builtin_builder::create_builtins()
                 _step(glsl_type::vec4_type,  glsl_type::vec4_type),
                 NULL);
 
-   add_function("smoothstep",
+   ADD_FUNCTION("smoothstep",
                 _smoothstep(glsl_type::float_type, glsl_type::float_type),
                 _smoothstep(glsl_type::float_type, glsl_type::vec2_type),
                 _smoothstep(glsl_type::float_type, glsl_type::vec3_type),
@@ -924,43 +971,43 @@ builtin_builder::create_builtins()
 
    F(floatBitsToInt)
    F(floatBitsToUint)
-   add_function("intBitsToFloat",
+   ADD_FUNCTION("intBitsToFloat",
                 _intBitsToFloat(glsl_type::int_type),
                 _intBitsToFloat(glsl_type::ivec2_type),
                 _intBitsToFloat(glsl_type::ivec3_type),
                 _intBitsToFloat(glsl_type::ivec4_type),
                 NULL);
-   add_function("uintBitsToFloat",
+   ADD_FUNCTION("uintBitsToFloat",
                 _uintBitsToFloat(glsl_type::uint_type),
                 _uintBitsToFloat(glsl_type::uvec2_type),
                 _uintBitsToFloat(glsl_type::uvec3_type),
                 _uintBitsToFloat(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("packUnorm2x16",   _packUnorm2x16(shader_packing_or_es3),   NULL);
-   add_function("packSnorm2x16",   _packSnorm2x16(shader_packing_or_es3),   NULL);
-   add_function("packUnorm4x8",    _packUnorm4x8(shader_packing),           NULL);
-   add_function("packSnorm4x8",    _packSnorm4x8(shader_packing),           NULL);
-   add_function("unpackUnorm2x16", _unpackUnorm2x16(shader_packing_or_es3), NULL);
-   add_function("unpackSnorm2x16", _unpackSnorm2x16(shader_packing_or_es3), NULL);
-   add_function("unpackUnorm4x8",  _unpackUnorm4x8(shader_packing),         NULL);
-   add_function("unpackSnorm4x8",  _unpackSnorm4x8(shader_packing),         NULL);
-   add_function("packHalf2x16",    _packHalf2x16(shader_packing_or_es3),    NULL);
-   add_function("unpackHalf2x16",  _unpackHalf2x16(shader_packing_or_es3),  NULL);
+   ADD_FUNCTION("packUnorm2x16",   _packUnorm2x16(shader_packing_or_es3),   NULL);
+   ADD_FUNCTION("packSnorm2x16",   _packSnorm2x16(shader_packing_or_es3),   NULL);
+   ADD_FUNCTION("packUnorm4x8",    _packUnorm4x8(shader_packing),           NULL);
+   ADD_FUNCTION("packSnorm4x8",    _packSnorm4x8(shader_packing),           NULL);
+   ADD_FUNCTION("unpackUnorm2x16", _unpackUnorm2x16(shader_packing_or_es3), NULL);
+   ADD_FUNCTION("unpackSnorm2x16", _unpackSnorm2x16(shader_packing_or_es3), NULL);
+   ADD_FUNCTION("unpackUnorm4x8",  _unpackUnorm4x8(shader_packing),         NULL);
+   ADD_FUNCTION("unpackSnorm4x8",  _unpackSnorm4x8(shader_packing),         NULL);
+   ADD_FUNCTION("packHalf2x16",    _packHalf2x16(shader_packing_or_es3),    NULL);
+   ADD_FUNCTION("unpackHalf2x16",  _unpackHalf2x16(shader_packing_or_es3),  NULL);
 
    F(length)
    F(distance)
    F(dot)
 
-   add_function("cross", _cross(glsl_type::vec3_type), NULL);
+   ADD_FUNCTION("cross", _cross(glsl_type::vec3_type), NULL);
 
    F(normalize)
-   add_function("ftransform", _ftransform(), NULL);
+   ADD_FUNCTION("ftransform", _ftransform(), NULL);
    F(faceforward)
    F(reflect)
    F(refract)
    // ...
-   add_function("matrixCompMult",
+   ADD_FUNCTION("matrixCompMult",
                 _matrixCompMult(glsl_type::mat2_type),
                 _matrixCompMult(glsl_type::mat3_type),
                 _matrixCompMult(glsl_type::mat4_type),
@@ -971,7 +1018,7 @@ builtin_builder::create_builtins()
                 _matrixCompMult(glsl_type::mat4x2_type),
                 _matrixCompMult(glsl_type::mat4x3_type),
                 NULL);
-   add_function("outerProduct",
+   ADD_FUNCTION("outerProduct",
                 _outerProduct(glsl_type::mat2_type),
                 _outerProduct(glsl_type::mat3_type),
                 _outerProduct(glsl_type::mat4_type),
@@ -982,17 +1029,17 @@ builtin_builder::create_builtins()
                 _outerProduct(glsl_type::mat4x2_type),
                 _outerProduct(glsl_type::mat4x3_type),
                 NULL);
-   add_function("determinant",
+   ADD_FUNCTION("determinant",
                 _determinant_mat2(),
                 _determinant_mat3(),
                 _determinant_mat4(),
                 NULL);
-   add_function("inverse",
+   ADD_FUNCTION("inverse",
                 _inverse_mat2(),
                 _inverse_mat3(),
                 _inverse_mat4(),
                 NULL);
-   add_function("transpose",
+   ADD_FUNCTION("transpose",
                 _transpose(glsl_type::mat2_type),
                 _transpose(glsl_type::mat3_type),
                 _transpose(glsl_type::mat4_type),
@@ -1010,25 +1057,25 @@ builtin_builder::create_builtins()
    FIUB(notEqual)
    FIUB(equal)
 
-   add_function("any",
+   ADD_FUNCTION("any",
                 _any(glsl_type::bvec2_type),
                 _any(glsl_type::bvec3_type),
                 _any(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("all",
+   ADD_FUNCTION("all",
                 _all(glsl_type::bvec2_type),
                 _all(glsl_type::bvec3_type),
                 _all(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("not",
+   ADD_FUNCTION("not",
                 _not(glsl_type::bvec2_type),
                 _not(glsl_type::bvec3_type),
                 _not(glsl_type::bvec4_type),
                 NULL);
 
-   add_function("textureSize",
+   ADD_FUNCTION("textureSize",
                 _textureSize(v130, glsl_type::int_type,   glsl_type::sampler1D_type),
                 _textureSize(v130, glsl_type::int_type,   glsl_type::isampler1D_type),
                 _textureSize(v130, glsl_type::int_type,   glsl_type::usampler1D_type),
@@ -1081,7 +1128,7 @@ builtin_builder::create_builtins()
                 _textureSize(texture_multisample, glsl_type::ivec3_type, glsl_type::usampler2DMSArray_type),
                 NULL);
 
-   add_function("texture",
+   ADD_FUNCTION("texture",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1162,7 +1209,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureLod",
+   ADD_FUNCTION("textureLod",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1197,7 +1244,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureOffset",
+   ADD_FUNCTION("textureOffset",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -1255,7 +1302,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130_fs_only, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProj",
+   ADD_FUNCTION("textureProj",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -1308,7 +1355,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texelFetch",
+   ADD_FUNCTION("texelFetch",
                 _texelFetch(v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::int_type),
                 _texelFetch(v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::int_type),
@@ -1346,7 +1393,7 @@ builtin_builder::create_builtins()
                 _texelFetch(texture_multisample, glsl_type::uvec4_type, glsl_type::usampler2DMSArray_type, glsl_type::ivec3_type),
                 NULL);
 
-   add_function("texelFetchOffset",
+   ADD_FUNCTION("texelFetchOffset",
                 _texelFetch(v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::int_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::int_type, glsl_type::int_type),
                 _texelFetch(v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::int_type, glsl_type::int_type),
@@ -1373,7 +1420,7 @@ builtin_builder::create_builtins()
 
                 NULL);
 
-   add_function("textureProjOffset",
+   ADD_FUNCTION("textureProjOffset",
                 _texture(ir_tex, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_tex, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -1426,7 +1473,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txb, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("textureLodOffset",
+   ADD_FUNCTION("textureLodOffset",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -1453,7 +1500,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProjLod",
+   ADD_FUNCTION("textureProjLod",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -1476,7 +1523,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureProjLodOffset",
+   ADD_FUNCTION("textureProjLodOffset",
                 _texture(ir_txl, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txl, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -1499,7 +1546,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txl, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("textureGrad",
+   ADD_FUNCTION("textureGrad",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1542,7 +1589,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 NULL);
 
-   add_function("textureGradOffset",
+   ADD_FUNCTION("textureGradOffset",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::float_type, TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::float_type, TEX_OFFSET),
@@ -1576,7 +1623,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type, TEX_OFFSET),
                 NULL);
 
-   add_function("textureProjGrad",
+   ADD_FUNCTION("textureProjGrad",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
@@ -1608,7 +1655,7 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureProjGradOffset",
+   ADD_FUNCTION("textureProjGradOffset",
                 _texture(ir_txd, v130, glsl_type::vec4_type,  glsl_type::sampler1D_type,  glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::ivec4_type, glsl_type::isampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
                 _texture(ir_txd, v130, glsl_type::uvec4_type, glsl_type::usampler1D_type, glsl_type::vec2_type, TEX_PROJECT | TEX_OFFSET),
@@ -1640,10 +1687,10 @@ builtin_builder::create_builtins()
                 _texture(ir_txd, v130, glsl_type::float_type, glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT | TEX_OFFSET),
                 NULL);
 
-   add_function("EmitVertex",   _EmitVertex(),   NULL);
-   add_function("EndPrimitive", _EndPrimitive(), NULL);
+   ADD_FUNCTION("EmitVertex",   _EmitVertex(),   NULL);
+   ADD_FUNCTION("EndPrimitive", _EndPrimitive(), NULL);
 
-   add_function("textureQueryLOD",
+   ADD_FUNCTION("textureQueryLOD",
                 _textureQueryLod(glsl_type::sampler1D_type,  glsl_type::float_type),
                 _textureQueryLod(glsl_type::isampler1D_type, glsl_type::float_type),
                 _textureQueryLod(glsl_type::usampler1D_type, glsl_type::float_type),
@@ -1680,7 +1727,7 @@ builtin_builder::create_builtins()
                 _textureQueryLod(glsl_type::samplerCubeArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureQueryLevels",
+   ADD_FUNCTION("textureQueryLevels",
                 _textureQueryLevels(glsl_type::sampler1D_type),
                 _textureQueryLevels(glsl_type::sampler2D_type),
                 _textureQueryLevels(glsl_type::sampler3D_type),
@@ -1713,48 +1760,48 @@ builtin_builder::create_builtins()
 
                 NULL);
 
-   add_function("texture1D",
+   ADD_FUNCTION("texture1D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DArray",
+   ADD_FUNCTION("texture1DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture1DProj",
+   ADD_FUNCTION("texture1DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture1DLod",
+   ADD_FUNCTION("texture1DLod",
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DArrayLod",
+   ADD_FUNCTION("texture1DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler1DArray_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture1DProjLod",
+   ADD_FUNCTION("texture1DProjLod",
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txl, tex1d_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2D",
+   ADD_FUNCTION("texture2D",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tex, texture_external, glsl_type::vec4_type,  glsl_type::samplerExternalOES_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DArray",
+   ADD_FUNCTION("texture2DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DProj",
+   ADD_FUNCTION("texture2DProj",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
@@ -1763,177 +1810,177 @@ builtin_builder::create_builtins()
                 _texture(ir_tex, texture_external, glsl_type::vec4_type,  glsl_type::samplerExternalOES_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DLod",
+   ADD_FUNCTION("texture2DLod",
                 _texture(ir_txl, lod_exists_in_stage, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DArrayLod",
+   ADD_FUNCTION("texture2DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler2DArray_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DProjLod",
+   ADD_FUNCTION("texture2DProjLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3D",
+   ADD_FUNCTION("texture3D",
                 _texture(ir_tex, tex3d,    glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_tex3d, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProj",
+   ADD_FUNCTION("texture3DProj",
                 _texture(ir_tex, tex3d,    glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, fs_tex3d, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3DLod",
+   ADD_FUNCTION("texture3DLod",
                 _texture(ir_txl, tex3d_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProjLod",
+   ADD_FUNCTION("texture3DProjLod",
                 _texture(ir_txl, tex3d_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureCube",
+   ADD_FUNCTION("textureCube",
                 _texture(ir_tex, always_available, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_only,          glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("textureCubeLod",
+   ADD_FUNCTION("textureCubeLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture2DRect",
+   ADD_FUNCTION("texture2DRect",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DRectProj",
+   ADD_FUNCTION("texture2DRectProj",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow1D",
+   ADD_FUNCTION("shadow1D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DArray",
+   ADD_FUNCTION("shadow1DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type,  glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type,  glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2D",
+   ADD_FUNCTION("shadow2D",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DArray",
+   ADD_FUNCTION("shadow2DArray",
                 _texture(ir_tex, texture_array,    glsl_type::vec4_type,  glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 _texture(ir_txb, fs_texture_array, glsl_type::vec4_type,  glsl_type::sampler2DArrayShadow_type, glsl_type::vec4_type),
                 NULL);
 
-   add_function("shadow1DProj",
+   ADD_FUNCTION("shadow1DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DProj",
+   ADD_FUNCTION("shadow2DProj",
                 _texture(ir_tex, v110,         glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 _texture(ir_txb, v110_fs_only, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow1DLod",
+   ADD_FUNCTION("shadow1DLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DLod",
+   ADD_FUNCTION("shadow2DLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DArrayLod",
+   ADD_FUNCTION("shadow1DArrayLod",
                 _texture(ir_txl, texture_array_lod, glsl_type::vec4_type, glsl_type::sampler1DArrayShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DProjLod",
+   ADD_FUNCTION("shadow1DProjLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DProjLod",
+   ADD_FUNCTION("shadow2DProjLod",
                 _texture(ir_txl, v110_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DRect",
+   ADD_FUNCTION("shadow2DRect",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DRectProj",
+   ADD_FUNCTION("shadow2DRectProj",
                 _texture(ir_tex, texture_rectangle, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture1DGradARB",
+   ADD_FUNCTION("texture1DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::float_type),
                 NULL);
 
-   add_function("texture1DProjGradARB",
+   ADD_FUNCTION("texture1DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec2_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DGradARB",
+   ADD_FUNCTION("texture2DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DProjGradARB",
+   ADD_FUNCTION("texture2DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture3DGradARB",
+   ADD_FUNCTION("texture3DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("texture3DProjGradARB",
+   ADD_FUNCTION("texture3DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler3D_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureCubeGradARB",
+   ADD_FUNCTION("textureCubeGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::samplerCube_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DGradARB",
+   ADD_FUNCTION("shadow1DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow1DProjGradARB",
+   ADD_FUNCTION("shadow1DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler1DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DGradARB",
+   ADD_FUNCTION("shadow2DGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DProjGradARB",
+   ADD_FUNCTION("shadow2DProjGradARB",
                 _texture(ir_txd, shader_texture_lod, glsl_type::vec4_type,  glsl_type::sampler2DShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("texture2DRectGradARB",
+   ADD_FUNCTION("texture2DRectGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("texture2DRectProjGradARB",
+   ADD_FUNCTION("texture2DRectProjGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec3_type, TEX_PROJECT),
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRect_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("shadow2DRectGradARB",
+   ADD_FUNCTION("shadow2DRectGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec3_type),
                 NULL);
 
-   add_function("shadow2DRectProjGradARB",
+   ADD_FUNCTION("shadow2DRectProjGradARB",
                 _texture(ir_txd, shader_texture_lod_and_rect, glsl_type::vec4_type,  glsl_type::sampler2DRectShadow_type, glsl_type::vec4_type, TEX_PROJECT),
                 NULL);
 
-   add_function("textureGather",
+   ADD_FUNCTION("textureGather",
                 _texture(ir_tg4, texture_gather, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tg4, texture_gather, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type),
                 _texture(ir_tg4, texture_gather, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type),
@@ -1981,7 +2028,7 @@ builtin_builder::create_builtins()
                 _texture(ir_tg4, gpu_shader5, glsl_type::vec4_type, glsl_type::sampler2DRectShadow_type, glsl_type::vec2_type),
                 NULL);
 
-   add_function("textureGatherOffset",
+   ADD_FUNCTION("textureGatherOffset",
                 _texture(ir_tg4, texture_gather_only, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
                 _texture(ir_tg4, texture_gather_only, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
                 _texture(ir_tg4, texture_gather_only, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type, TEX_OFFSET),
@@ -2019,7 +2066,7 @@ builtin_builder::create_builtins()
                 _texture(ir_tg4, gpu_shader5, glsl_type::vec4_type, glsl_type::sampler2DRectShadow_type, glsl_type::vec2_type, TEX_OFFSET_NONCONST),
                 NULL);
 
-   add_function("textureGatherOffsets",
+   ADD_FUNCTION("textureGatherOffsets",
                 _texture(ir_tg4, gpu_shader5, glsl_type::vec4_type, glsl_type::sampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
                 _texture(ir_tg4, gpu_shader5, glsl_type::ivec4_type, glsl_type::isampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
                 _texture(ir_tg4, gpu_shader5, glsl_type::uvec4_type, glsl_type::usampler2D_type, glsl_type::vec2_type, TEX_OFFSET_ARRAY),
@@ -2065,58 +2112,58 @@ builtin_builder::create_builtins()
    IU(findMSB)
    F(fma)
 
-   add_function("ldexp",
+   ADD_FUNCTION("ldexp",
                 _ldexp(glsl_type::float_type, glsl_type::int_type),
                 _ldexp(glsl_type::vec2_type,  glsl_type::ivec2_type),
                 _ldexp(glsl_type::vec3_type,  glsl_type::ivec3_type),
                 _ldexp(glsl_type::vec4_type,  glsl_type::ivec4_type),
                 NULL);
 
-   add_function("frexp",
+   ADD_FUNCTION("frexp",
                 _frexp(glsl_type::float_type, glsl_type::int_type),
                 _frexp(glsl_type::vec2_type,  glsl_type::ivec2_type),
                 _frexp(glsl_type::vec3_type,  glsl_type::ivec3_type),
                 _frexp(glsl_type::vec4_type,  glsl_type::ivec4_type),
                 NULL);
-   add_function("uaddCarry",
+   ADD_FUNCTION("uaddCarry",
                 _uaddCarry(glsl_type::uint_type),
                 _uaddCarry(glsl_type::uvec2_type),
                 _uaddCarry(glsl_type::uvec3_type),
                 _uaddCarry(glsl_type::uvec4_type),
                 NULL);
-   add_function("usubBorrow",
+   ADD_FUNCTION("usubBorrow",
                 _usubBorrow(glsl_type::uint_type),
                 _usubBorrow(glsl_type::uvec2_type),
                 _usubBorrow(glsl_type::uvec3_type),
                 _usubBorrow(glsl_type::uvec4_type),
                 NULL);
-   add_function("imulExtended",
+   ADD_FUNCTION("imulExtended",
                 _mulExtended(glsl_type::int_type),
                 _mulExtended(glsl_type::ivec2_type),
                 _mulExtended(glsl_type::ivec3_type),
                 _mulExtended(glsl_type::ivec4_type),
                 NULL);
-   add_function("umulExtended",
+   ADD_FUNCTION("umulExtended",
                 _mulExtended(glsl_type::uint_type),
                 _mulExtended(glsl_type::uvec2_type),
                 _mulExtended(glsl_type::uvec3_type),
                 _mulExtended(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("atomicCounter",
+   ADD_FUNCTION("atomicCounter",
                 _atomic_op("__intrinsic_atomic_read",
                            shader_atomic_counters),
                 NULL);
-   add_function("atomicCounterIncrement",
+   ADD_FUNCTION("atomicCounterIncrement",
                 _atomic_op("__intrinsic_atomic_increment",
                            shader_atomic_counters),
                 NULL);
-   add_function("atomicCounterDecrement",
+   ADD_FUNCTION("atomicCounterDecrement",
                 _atomic_op("__intrinsic_atomic_predecrement",
                            shader_atomic_counters),
                 NULL);
 
-   add_function("min3",
+   ADD_FUNCTION("min3",
                 _min3(glsl_type::float_type),
                 _min3(glsl_type::vec2_type),
                 _min3(glsl_type::vec3_type),
@@ -2133,7 +2180,7 @@ builtin_builder::create_builtins()
                 _min3(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("max3",
+   ADD_FUNCTION("max3",
                 _max3(glsl_type::float_type),
                 _max3(glsl_type::vec2_type),
                 _max3(glsl_type::vec3_type),
@@ -2150,7 +2197,7 @@ builtin_builder::create_builtins()
                 _max3(glsl_type::uvec4_type),
                 NULL);
 
-   add_function("mid3",
+   ADD_FUNCTION("mid3",
                 _mid3(glsl_type::float_type),
                 _mid3(glsl_type::vec2_type),
                 _mid3(glsl_type::vec3_type),
@@ -2172,6 +2219,9 @@ builtin_builder::create_builtins()
 #undef FIU
 #undef FIUB
 #undef FIU2_MIXED
+#undef ADD_FUNCTION
+
+   wanted = NULL;
 }
 
 void
@@ -2179,7 +2229,11 @@ builtin_builder::add_function(const char *name, ...)
 {
    va_list ap;
 
-   ir_function *f = new(mem_ctx) ir_function(name);
+   ir_function *f = shader->symbols->get_function(name);
+   if (f == NULL) {
+      f = new(mem_ctx) ir_function(name);
+      shader->symbols->add_function(f);
+   }
 
    va_start(ap, name);
    while (true) {
@@ -2196,8 +2250,6 @@ builtin_builder::add_function(const char *name, ...)
       f->add_signature(sig);
    }
    va_end(ap);
-
-   shader->symbols->add_function(f);
 }
 
 ir_variable *
@@ -4133,6 +4185,12 @@ _mesa_glsl_find_builtin_function(_mesa_glsl_parse_state *state,
    return s;
 }
 
+/**
+ * Return the shader holding the built-in functions, to link against.
+ *
+ * Only the built-ins a compile has looked up have their signatures; those are
+ * the only ones the shaders can be calling.
+ */
 gl_shader *
 _mesa_glsl_get_builtin_function_shader()
 {
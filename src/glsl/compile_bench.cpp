@@ -0,0 +1,547 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/** @file compile_bench.cpp
+ *
+ * Offline compile-time benchmark of the GLSL compiler.
+ *
+ * The shaders given on the command line, or found in the given directories,
+ * are grouped into programs by file name (foo.vert and foo.frag make up the
+ * program foo), and every program is compiled, and optionally linked, the
+ * requested number of times.  Programs are spread over the GLSL thread pool
+ * when more than one thread is asked for.
+ *
+ * The time spent in and the allocations made by each stage of the compiler
+ * are reported, along with the time taken by each program, as text or as
+ * JSON.  Times of nested stages (the optimization passes run by the linker)
+ * are included in their parent stage.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "ast.h"
+#include "glsl_parser_extras.h"
+#include "glsl_profile.h"
+#include "program.h"
+#include "standalone_scaffolding.h"
+#include "threadpool.h"
+
+struct bench_program {
+   char *name;
+
+   unsigned num_shaders;
+   char **sources;
+   GLenum *types;
+
+   /* results */
+   bool failed;
+   double time;
+   struct glsl_profile profile;
+};
+
+struct bench_options {
+   struct gl_context *ctx;
+   int iterations;
+   int link;
+};
+
+static int glsl_version = 330;
+
+static int link_programs = 0;
+static int iterations = 1;
+static int num_threads = 1;
+static const char *json_file = NULL;
+
+static const struct option bench_opts[] = {
+   { "link",       no_argument,       &link_programs, 1 },
+   { "version",    required_argument, NULL, 'v' },
+   { "iterations", required_argument, NULL, 'i' },
+   { "threads",    required_argument, NULL, 't' },
+   { "json",       required_argument, NULL, 'j' },
+   { NULL, 0, NULL, 0 }
+};
+
+static void
+usage_fail(const char *name)
+{
+   printf("usage: %s [options] <shader files or directories>\n"
+          "\n"
+          "Possible options are:\n"
+          "    --link              link the shaders of each program\n"
+          "    --version <N>       GLSL version of the context (330)\n"
+          "    --iterations <N>    times each program is compiled (1)\n"
+          "    --threads <N>       number of compiler threads (1)\n"
+          "    --json <file>       write the results as JSON to file, "
+          "or - for stdout\n",
+          name);
+   exit(EXIT_FAILURE);
+}
+
+static GLenum
+shader_type_from_name(const char *name)
+{
+   const char *ext = strrchr(name, '.');
+
+   if (!ext)
+      return 0;
+   if (strcmp(ext, ".vert") == 0)
+      return GL_VERTEX_SHADER;
+   if (strcmp(ext, ".geom") == 0)
+      return GL_GEOMETRY_SHADER;
+   if (strcmp(ext, ".frag") == 0)
+      return GL_FRAGMENT_SHADER;
+
+   return 0;
+}
+
+static char *
+load_text_file(void *mem_ctx, const char *file_name)
+{
+   FILE *fp = fopen(file_name, "rb");
+   char *text;
+   long size;
+
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0L, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0L, SEEK_SET);
+
+   text = (char *) ralloc_size(mem_ctx, size + 1);
+   if (fread(text, 1, size, fp) != (size_t) size) {
+      ralloc_free(text);
+      text = NULL;
+   } else {
+      text[size] = '\0';
+   }
+
+   fclose(fp);
+
+   return text;
+}
+
+/**
+ * Append the shader files found at \p path, recursing into directories.
+ */
+static void
+collect_files(void *mem_ctx, const char *path, char ***files,
+              unsigned *num_files)
+{
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "can't access %s\n", path);
+      return;
+   }
+
+   if (S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(path);
+      struct dirent *entry;
+
+      if (!dir)
+         return;
+
+      while ((entry = readdir(dir)) != NULL) {
+         if (entry->d_name[0] == '.')
+            continue;
+
+         char *child = ralloc_asprintf(mem_ctx, "%s/%s", path, entry->d_name);
+         collect_files(mem_ctx, child, files, num_files);
+      }
+
+      closedir(dir);
+      return;
+   }
+
+   if (!shader_type_from_name(path))
+      return;
+
+   *files = reralloc(mem_ctx, *files, char *, *num_files + 1);
+   (*files)[(*num_files)++] = ralloc_strdup(mem_ctx, path);
+}
+
+static int
+compare_strings(const void *a, const void *b)
+{
+   return strcmp(*(const char **) a, *(const char **) b);
+}
+
+/**
+ * Group the files into programs, by name without the extension.
+ */
+static struct bench_program *
+create_programs(void *mem_ctx, char **files, unsigned num_files,
+                unsigned *num_programs)
+{
+   struct bench_program *programs =
+      rzalloc_array(mem_ctx, struct bench_program, num_files);
+   unsigned count = 0;
+
+   qsort(files, num_files, sizeof(*files), compare_strings);
+
+   for (unsigned i = 0; i < num_files; i++) {
+      const char *ext = strrchr(files[i], '.');
+      char *name = ralloc_strndup(mem_ctx, files[i], ext - files[i]);
+      struct bench_program *prog = &programs[count];
+
+      if (count == 0 || strcmp(programs[count - 1].name, name) != 0) {
+         prog->name = name;
+         count++;
+      } else {
+         prog = &programs[count - 1];
+      }
+
+      char *source = load_text_file(mem_ctx, files[i]);
+      if (!source) {
+         fprintf(stderr, "can't read %s\n", files[i]);
+         prog->failed = true;
+         continue;
+      }
+
+      prog->sources = reralloc(mem_ctx, prog->sources, char *,
+                               prog->num_shaders + 1);
+      prog->types = reralloc(mem_ctx, prog->types, GLenum,
+                             prog->num_shaders + 1);
+      prog->sources[prog->num_shaders] = source;
+      prog->types[prog->num_shaders] = shader_type_from_name(files[i]);
+      prog->num_shaders++;
+   }
+
+   *num_programs = count;
+   return programs;
+}
+
+/**
+ * Compile, and link if asked to, \p prog once.
+ */
+static bool
+run_program(struct gl_context *ctx, const struct bench_program *prog,
+            bool link)
+{
+   struct gl_shader_program *whole_program =
+      rzalloc(NULL, struct gl_shader_program);
+   bool ok = true;
+
+   whole_program->InfoLog = ralloc_strdup(whole_program, "");
+   whole_program->Shaders =
+      ralloc_array(whole_program, struct gl_shader *, prog->num_shaders);
+
+   for (unsigned i = 0; i < prog->num_shaders; i++) {
+      struct gl_shader *shader = rzalloc(whole_program, gl_shader);
+
+      shader->Type = prog->types[i];
+      shader->Stage = _mesa_shader_enum_to_shader_stage(shader->Type);
+      shader->Source = prog->sources[i];
+
+      whole_program->Shaders[whole_program->NumShaders++] = shader;
+
+      _mesa_glsl_compile_shader(ctx, shader, false, false);
+      if (!shader->CompileStatus) {
+         ok = false;
+         break;
+      }
+   }
+
+   if (ok && link) {
+      link_shaders(ctx, whole_program);
+      ok = whole_program->LinkStatus;
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      ralloc_free(whole_program->_LinkedShaders[i]);
+   /* link_shaders() allocates a new info log with no parent */
+   ralloc_free(whole_program->InfoLog);
+   ralloc_free(whole_program);
+
+   return ok;
+}
+
+struct bench_task {
+   const struct bench_options *options;
+   struct bench_program *prog;
+};
+
+static void
+run_program_task(void *data)
+{
+   struct bench_task *task = (struct bench_task *) data;
+   struct bench_program *prog = task->prog;
+   double start;
+
+   _mesa_glsl_profile_set_current(&prog->profile);
+
+   start = _mesa_glsl_profile_time();
+   for (int i = 0; i < task->options->iterations && !prog->failed; i++) {
+      if (!run_program(task->options->ctx, prog, task->options->link))
+         prog->failed = true;
+   }
+   prog->time = _mesa_glsl_profile_time() - start;
+
+   _mesa_glsl_profile_set_current(NULL);
+}
+
+static void
+print_json_string(FILE *fp, const char *str)
+{
+   fputc('"', fp);
+   for (; *str; str++) {
+      if (*str == '"' || *str == '\\')
+         fprintf(fp, "\\%c", *str);
+      else if ((unsigned char) *str < 0x20)
+         fprintf(fp, "\\u%04x", *str);
+      else
+         fputc(*str, fp);
+   }
+   fputc('"', fp);
+}
+
+static void
+print_json(FILE *fp, const struct glsl_profile *total,
+           const struct bench_program *programs, unsigned num_programs,
+           double wall_time)
+{
+   fprintf(fp, "{\n");
+   fprintf(fp, "  \"glsl_version\": %d,\n", glsl_version);
+   fprintf(fp, "  \"link\": %s,\n", link_programs ? "true" : "false");
+   fprintf(fp, "  \"iterations\": %d,\n", iterations);
+   fprintf(fp, "  \"threads\": %d,\n", num_threads);
+   fprintf(fp, "  \"wall_time_ms\": %.3f,\n", wall_time * 1000.0);
+   fprintf(fp, "  \"allocations\": %lu,\n", total->allocations);
+
+   fprintf(fp, "  \"stages\": [\n");
+   for (unsigned i = 0; i < total->num_stages; i++) {
+      const struct glsl_profile_stage *stage = &total->stages[i];
+
+      fprintf(fp, "    { \"name\": ");
+      print_json_string(fp, stage->name);
+      fprintf(fp, ", \"calls\": %lu, \"progress\": %lu, \"time_ms\": %.3f, "
+              "\"allocations\": %lu }%s\n",
+              stage->calls, stage->progress, stage->time * 1000.0,
+              stage->allocations, i + 1 < total->num_stages ? "," : "");
+   }
+   fprintf(fp, "  ],\n");
+
+   fprintf(fp, "  \"programs\": [\n");
+   for (unsigned i = 0; i < num_programs; i++) {
+      const struct bench_program *prog = &programs[i];
+
+      fprintf(fp, "    { \"name\": ");
+      print_json_string(fp, prog->name);
+      fprintf(fp, ", \"shaders\": %u, \"status\": \"%s\", "
+              "\"time_ms\": %.3f, \"allocations\": %lu }%s\n",
+              prog->num_shaders, prog->failed ? "fail" : "pass",
+              prog->time * 1000.0 / iterations, prog->profile.allocations,
+              i + 1 < num_programs ? "," : "");
+   }
+   fprintf(fp, "  ]\n");
+   fprintf(fp, "}\n");
+}
+
+static void
+print_text(const struct glsl_profile *total,
+           const struct bench_program *programs, unsigned num_programs,
+           double wall_time)
+{
+   unsigned failures = 0;
+
+   for (unsigned i = 0; i < num_programs; i++) {
+      if (programs[i].failed) {
+         printf("%s: failed\n", programs[i].name);
+         failures++;
+      }
+   }
+
+   printf("%-32s %10s %10s %12s %12s\n",
+          "stage", "calls", "progress", "time (ms)", "allocations");
+   for (unsigned i = 0; i < total->num_stages; i++) {
+      const struct glsl_profile_stage *stage = &total->stages[i];
+
+      printf("%-32s %10lu %10lu %12.3f %12lu\n",
+             stage->name, stage->calls, stage->progress,
+             stage->time * 1000.0, stage->allocations);
+   }
+
+   printf("\n%u programs, %u failed, %d iterations, %d threads: "
+          "%.3f ms, %lu allocations\n",
+          num_programs, failures, iterations, num_threads,
+          wall_time * 1000.0, total->allocations);
+}
+
+int
+main(int argc, char **argv)
+{
+   struct gl_context local_ctx;
+   struct gl_context *ctx = &local_ctx;
+   bool glsl_es = false;
+   int status = EXIT_SUCCESS;
+   int c, idx = 0;
+
+   while ((c = getopt_long(argc, argv, "", bench_opts, &idx)) != -1) {
+      switch (c) {
+      case 'v':
+         glsl_version = strtol(optarg, NULL, 10);
+         switch (glsl_version) {
+         case 100:
+         case 300:
+            glsl_es = true;
+            break;
+         case 110:
+         case 120:
+         case 130:
+         case 140:
+         case 150:
+         case 330:
+            glsl_es = false;
+            break;
+         default:
+            fprintf(stderr, "Unrecognized GLSL version `%s'\n", optarg);
+            usage_fail(argv[0]);
+         }
+         break;
+      case 'i':
+         iterations = strtol(optarg, NULL, 10);
+         if (iterations <= 0)
+            usage_fail(argv[0]);
+         break;
+      case 't':
+         num_threads = strtol(optarg, NULL, 10);
+         if (num_threads <= 0)
+            usage_fail(argv[0]);
+         break;
+      case 'j':
+         json_file = optarg;
+         break;
+      case 0:
+         break;
+      default:
+         usage_fail(argv[0]);
+      }
+   }
+
+   if (argc <= optind)
+      usage_fail(argv[0]);
+
+   gl_api api = glsl_es ? API_OPENGLES2 : API_OPENGL_COMPAT;
+   initialize_context_for_glsl_version(ctx, api, glsl_version);
+
+   void *mem_ctx = ralloc_context(NULL);
+   char **files = NULL;
+   unsigned num_files = 0;
+
+   for (; optind < argc; optind++)
+      collect_files(mem_ctx, argv[optind], &files, &num_files);
+
+   if (!num_files) {
+      fprintf(stderr, "no shaders found\n");
+      ralloc_free(mem_ctx);
+      return EXIT_FAILURE;
+   }
+
+   unsigned num_programs;
+   struct bench_program *programs =
+      create_programs(mem_ctx, files, num_files, &num_programs);
+
+   /* Keep the one-time construction of the built-in functions out of the
+    * measurements.
+    */
+   _mesa_glsl_initialize_builtin_functions();
+
+   struct bench_options options;
+   options.ctx = ctx;
+   options.iterations = iterations;
+   options.link = link_programs;
+
+   struct bench_task *tasks =
+      ralloc_array(mem_ctx, struct bench_task, num_programs);
+   struct _mesa_threadpool *pool = NULL;
+   struct _mesa_threadpool_task **handles = NULL;
+
+   if (num_threads > 1) {
+      pool = _mesa_glsl_get_threadpool(num_threads);
+      handles = rzalloc_array(mem_ctx, struct _mesa_threadpool_task *,
+                              num_programs);
+   }
+
+   double start = _mesa_glsl_profile_time();
+
+   for (unsigned i = 0; i < num_programs; i++) {
+      tasks[i].options = &options;
+      tasks[i].prog = &programs[i];
+
+      if (pool)
+         handles[i] = _mesa_threadpool_queue_task(pool, run_program_task,
+                                                  &tasks[i]);
+      if (!pool || !handles[i])
+         run_program_task(&tasks[i]);
+   }
+
+   if (pool) {
+      for (unsigned i = 0; i < num_programs; i++) {
+         if (handles[i])
+            _mesa_threadpool_complete_task(pool, handles[i]);
+      }
+   }
+
+   double wall_time = _mesa_glsl_profile_time() - start;
+
+   struct glsl_profile total;
+   _mesa_glsl_profile_init(&total);
+   for (unsigned i = 0; i < num_programs; i++) {
+      _mesa_glsl_profile_merge(&total, &programs[i].profile);
+      if (programs[i].failed)
+         status = EXIT_FAILURE;
+   }
+
+   if (json_file) {
+      FILE *fp = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w");
+
+      if (fp) {
+         print_json(fp, &total, programs, num_programs, wall_time);
+         if (fp != stdout)
+            fclose(fp);
+      } else {
+         fprintf(stderr, "can't write %s\n", json_file);
+         status = EXIT_FAILURE;
+      }
+   }
+
+   if (!json_file || strcmp(json_file, "-") != 0)
+      print_text(&total, programs, num_programs, wall_time);
+
+   if (pool)
+      _mesa_threadpool_unref(pool);
+
+   ralloc_free(mem_ctx);
+   _mesa_glsl_destroy_threadpool();
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+
+   return status;
+}
@@ -0,0 +1,713 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c11/threads.h"
+#include "disk_cache.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define CACHE_ENTRY_MAGIC     0x4d455341 /* "MESA" */
+#define CACHE_FORMAT_VERSION  1
+
+#define CACHE_DEFAULT_MAX_SIZE (1024 * 1024 * 1024)
+
+/* Evict at most this many entries for each insertion. */
+#define CACHE_MAX_EVICTIONS   8
+
+/* Temporary files older than this are assumed to be left by a crash. */
+#define CACHE_STALE_TMP_SECONDS 60
+
+/**
+ * Header of an entry file.  The data follows immediately and, since the
+ * header size is a multiple of 8, is suitably aligned when the file is
+ * mapped.
+ */
+struct cache_entry_header {
+   uint32_t magic;
+   uint32_t version;
+   cache_key key;
+   uint32_t size;       /**< Size of the data that follows */
+   uint32_t checksum;   /**< FNV-1a hash of the data */
+   uint32_t reserved;
+};
+
+/**
+ * Contents of the index file, mapped shared by every process using the
+ * cache.
+ */
+struct cache_index {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t size;       /**< Total size of all entry files, updated atomically */
+};
+
+struct _mesa_disk_cache {
+   char *path;
+   uint64_t max_size;
+
+   struct cache_index *index;
+};
+
+static uint32_t
+compute_checksum(const void *data, size_t size)
+{
+   const unsigned char *p = (const unsigned char *) data;
+   uint32_t hash = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= p[i];
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+/* Create a directory, succeeding if it already exists. */
+static bool
+make_dir(const char *path)
+{
+   struct stat st;
+
+   if (mkdir(path, 0755) == 0)
+      return true;
+
+   return errno == EEXIST && stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* Create every missing component of \p path. */
+static bool
+make_dirs(const char *path)
+{
+   char *copy = strdup(path);
+   char *p;
+   bool ok = true;
+
+   if (!copy)
+      return false;
+
+   for (p = copy + 1; ok && *p; p++) {
+      if (*p == '/') {
+         *p = '\0';
+         ok = make_dir(copy);
+         *p = '/';
+      }
+   }
+
+   if (ok)
+      ok = make_dir(copy);
+
+   free(copy);
+
+   return ok;
+}
+
+static char *
+get_default_path(void)
+{
+   const char *xdg = getenv("XDG_CACHE_HOME");
+   const char *home;
+   char *path;
+
+   if (xdg && xdg[0] == '/') {
+      path = malloc(strlen(xdg) + sizeof("/mesa"));
+      if (path)
+         sprintf(path, "%s/mesa", xdg);
+      return path;
+   }
+
+   home = getenv("HOME");
+   if (!home || home[0] != '/')
+      return NULL;
+
+   path = malloc(strlen(home) + sizeof("/.cache/mesa"));
+   if (path)
+      sprintf(path, "%s/.cache/mesa", home);
+
+   return path;
+}
+
+static uint64_t
+parse_size(const char *str)
+{
+   char *end;
+   uint64_t size = strtoull(str, &end, 10);
+
+   switch (*end) {
+   case 'g': case 'G':
+      size *= 1024;
+      /* fallthrough */
+   case 'm': case 'M':
+      size *= 1024;
+      /* fallthrough */
+   case 'k': case 'K':
+      size *= 1024;
+      break;
+   default:
+      break;
+   }
+
+   return size;
+}
+
+static bool
+env_is_true(const char *name)
+{
+   const char *str = getenv(name);
+
+   return str && (strcmp(str, "1") == 0 ||
+                  strcmp(str, "true") == 0 ||
+                  strcmp(str, "yes") == 0);
+}
+
+/* Map the index file, creating it if needed. */
+static struct cache_index *
+map_index(const char *path)
+{
+   struct cache_index *index;
+   struct stat st;
+   char *filename;
+   int fd;
+
+   filename = malloc(strlen(path) + sizeof("/index"));
+   if (!filename)
+      return NULL;
+   sprintf(filename, "%s/index", path);
+
+   fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   free(filename);
+   if (fd < 0)
+      return NULL;
+
+   /* Growing the file zero-fills it, and several processes doing it at
+    * once is harmless.
+    */
+   if (fstat(fd, &st) < 0 ||
+       (st.st_size < (off_t) sizeof(*index) &&
+        ftruncate(fd, sizeof(*index)) < 0)) {
+      close(fd);
+      return NULL;
+   }
+
+   index = mmap(NULL, sizeof(*index), PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+   close(fd);
+   if (index == MAP_FAILED)
+      return NULL;
+
+   if (index->magic != CACHE_ENTRY_MAGIC ||
+       index->version != CACHE_FORMAT_VERSION) {
+      /* A new or incompatible index.  The size starts over; it only has to
+       * be approximately right, so racing with another process doing the
+       * same is harmless.
+       */
+      __sync_lock_test_and_set(&index->size, 0);
+      index->version = CACHE_FORMAT_VERSION;
+      __sync_lock_test_and_set(&index->magic, CACHE_ENTRY_MAGIC);
+   }
+
+   return index;
+}
+
+struct _mesa_disk_cache *
+_mesa_disk_cache_create_with_path(const char *path, uint64_t max_size)
+{
+   struct _mesa_disk_cache *cache;
+
+   if (!path || !make_dirs(path))
+      return NULL;
+
+   cache = calloc(1, sizeof(*cache));
+   if (!cache)
+      return NULL;
+
+   cache->path = strdup(path);
+   cache->max_size = max_size;
+   cache->index = map_index(path);
+   if (!cache->path || !cache->index) {
+      _mesa_disk_cache_destroy(cache);
+      return NULL;
+   }
+
+   return cache;
+}
+
+struct _mesa_disk_cache *
+_mesa_disk_cache_create(void)
+{
+   struct _mesa_disk_cache *cache;
+   const char *str;
+   uint64_t max_size = CACHE_DEFAULT_MAX_SIZE;
+   char *path;
+
+   if (env_is_true("MESA_GLSL_CACHE_DISABLE"))
+      return NULL;
+
+   str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
+   if (str) {
+      max_size = parse_size(str);
+      if (max_size == 0)
+         return NULL;
+   }
+
+   str = getenv("MESA_GLSL_CACHE_DIR");
+   path = (str && str[0]) ? strdup(str) : get_default_path();
+
+   cache = _mesa_disk_cache_create_with_path(path, max_size);
+   free(path);
+
+   return cache;
+}
+
+void
+_mesa_disk_cache_destroy(struct _mesa_disk_cache *cache)
+{
+   if (!cache)
+      return;
+
+   if (cache->index)
+      munmap(cache->index, sizeof(*cache->index));
+   free(cache->path);
+   free(cache);
+}
+
+/* Return the file name of an entry as "<path>/<xx>/<38 hex digits>". */
+static char *
+get_entry_filename(struct _mesa_disk_cache *cache, const cache_key key)
+{
+   char hex[MESA_SHA1_DIGEST_LENGTH * 2 + 1];
+   char *filename;
+
+   _mesa_sha1_format(hex, key);
+
+   filename = malloc(strlen(cache->path) + 1 + 2 + 1 + sizeof(hex) - 2 +
+                     sizeof(".tmp"));
+   if (filename)
+      sprintf(filename, "%s/%c%c/%s", cache->path, hex[0], hex[1], hex + 2);
+
+   return filename;
+}
+
+static bool
+is_entry_name(const char *name)
+{
+   size_t i;
+
+   for (i = 0; i < MESA_SHA1_DIGEST_LENGTH * 2 - 2; i++) {
+      if (!((name[i] >= '0' && name[i] <= '9') ||
+            (name[i] >= 'a' && name[i] <= 'f')))
+         return false;
+   }
+
+   return name[i] == '\0';
+}
+
+static uint64_t
+read_size(struct _mesa_disk_cache *cache)
+{
+   return __sync_fetch_and_add(&cache->index->size, 0);
+}
+
+static void
+update_size(struct _mesa_disk_cache *cache, int64_t delta)
+{
+   uint64_t old_size, new_size;
+
+   /* Never let the counter wrap below zero; entries written before the
+    * index was reset are not accounted.
+    */
+   do {
+      old_size = read_size(cache);
+      if (delta < 0 && old_size < (uint64_t) -delta)
+         new_size = 0;
+      else
+         new_size = old_size + delta;
+   } while (!__sync_bool_compare_and_swap(&cache->index->size,
+                                          old_size, new_size));
+}
+
+/**
+ * Evict the least recently used entry of the directory \p dirname.
+ * Return false if the directory had no entry.
+ */
+static bool
+evict_from_dir(struct _mesa_disk_cache *cache, const char *dirname)
+{
+   char *victim = NULL;
+   time_t victim_time = 0;
+   off_t victim_size = 0;
+   struct dirent *ent;
+   struct stat st;
+   char *filename;
+   DIR *dir;
+   int dfd;
+
+   dir = opendir(dirname);
+   if (!dir)
+      return false;
+
+   dfd = dirfd(dir);
+   while ((ent = readdir(dir)) != NULL) {
+      if (!is_entry_name(ent->d_name))
+         continue;
+
+      if (fstatat(dfd, ent->d_name, &st, 0) < 0 || !S_ISREG(st.st_mode))
+         continue;
+
+      if (!victim || st.st_mtime < victim_time) {
+         free(victim);
+         victim = strdup(ent->d_name);
+         victim_time = st.st_mtime;
+         victim_size = st.st_size;
+      }
+   }
+
+   if (victim) {
+      filename = malloc(strlen(dirname) + 1 + strlen(victim) + 1);
+      if (filename) {
+         sprintf(filename, "%s/%s", dirname, victim);
+         /* Only the process whose unlink succeeds accounts for the entry. */
+         if (unlink(filename) == 0)
+            update_size(cache, -(int64_t) victim_size);
+         free(filename);
+      }
+      free(victim);
+   }
+
+   closedir(dir);
+
+   return victim != NULL;
+}
+
+static void
+evict_entries(struct _mesa_disk_cache *cache, const cache_key key)
+{
+   char *dirname;
+   int evictions;
+
+   dirname = malloc(strlen(cache->path) + sizeof("/xx"));
+   if (!dirname)
+      return;
+
+   for (evictions = 0; evictions < CACHE_MAX_EVICTIONS; evictions++) {
+      /* Pick a pseudo-random subdirectory, derived from the new key, and
+       * walk forward until a non-empty one is found.
+       */
+      unsigned start = key[MESA_SHA1_DIGEST_LENGTH - 1 - evictions];
+      unsigned i;
+
+      if (read_size(cache) <= cache->max_size)
+         break;
+
+      for (i = 0; i < 256; i++) {
+         sprintf(dirname, "%s/%02x", cache->path, (start + i) & 0xff);
+         if (evict_from_dir(cache, dirname))
+            break;
+      }
+
+      /* The cache is empty but the index says otherwise. */
+      if (i == 256) {
+         update_size(cache, -(int64_t) read_size(cache));
+         break;
+      }
+   }
+
+   free(dirname);
+}
+
+static bool
+write_all(int fd, const void *data, size_t size)
+{
+   const char *p = (const char *) data;
+
+   while (size) {
+      ssize_t ret = write(fd, p, size);
+
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+
+      p += ret;
+      size -= ret;
+   }
+
+   return true;
+}
+
+/* Open the temporary file for an entry, exclusively. */
+static int
+open_tmp_file(const char *tmp_filename)
+{
+   struct stat st;
+   int fd;
+
+   fd = open(tmp_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+   if (fd >= 0 || errno != EEXIST)
+      return fd;
+
+   /* Another process is writing the same entry, unless it died while
+    * doing so.
+    */
+   if (stat(tmp_filename, &st) < 0 ||
+       time(NULL) - st.st_mtime < CACHE_STALE_TMP_SECONDS)
+      return -1;
+
+   unlink(tmp_filename);
+
+   return open(tmp_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+}
+
+void
+_mesa_disk_cache_put(struct _mesa_disk_cache *cache, const cache_key key,
+                     const void *data, size_t size)
+{
+   struct cache_entry_header header;
+   char *filename, *tmp_filename, *slash;
+   struct stat st;
+   bool ok;
+   int fd;
+
+   if (!cache || size > UINT32_MAX ||
+       size + sizeof(header) > cache->max_size)
+      return;
+
+   filename = get_entry_filename(cache, key);
+   if (!filename)
+      return;
+
+   if (stat(filename, &st) == 0) {
+      free(filename);
+      return;
+   }
+
+   slash = strrchr(filename, '/');
+   *slash = '\0';
+   ok = make_dir(filename);
+   *slash = '/';
+
+   tmp_filename = malloc(strlen(filename) + sizeof(".tmp"));
+   if (!ok || !tmp_filename) {
+      free(tmp_filename);
+      free(filename);
+      return;
+   }
+   sprintf(tmp_filename, "%s.tmp", filename);
+
+   fd = open_tmp_file(tmp_filename);
+   if (fd < 0) {
+      free(tmp_filename);
+      free(filename);
+      return;
+   }
+
+   memset(&header, 0, sizeof(header));
+   header.magic = CACHE_ENTRY_MAGIC;
+   header.version = CACHE_FORMAT_VERSION;
+   memcpy(header.key, key, sizeof(header.key));
+   header.size = (uint32_t) size;
+   header.checksum = compute_checksum(data, size);
+
+   ok = write_all(fd, &header, sizeof(header)) && write_all(fd, data, size);
+   ok = (close(fd) == 0) && ok;
+
+   /* rename() atomically replaces whatever another process may have
+    * written in the meantime with an identical entry.
+    */
+   if (ok && rename(tmp_filename, filename) == 0) {
+      update_size(cache, sizeof(header) + size);
+      if (read_size(cache) > cache->max_size)
+         evict_entries(cache, key);
+   } else {
+      unlink(tmp_filename);
+   }
+
+   free(tmp_filename);
+   free(filename);
+}
+
+const void *
+_mesa_disk_cache_get(struct _mesa_disk_cache *cache, const cache_key key,
+                     size_t *size)
+{
+   const struct cache_entry_header *header;
+   struct stat st;
+   char *filename;
+   void *map;
+   int fd;
+
+   if (!cache)
+      return NULL;
+
+   filename = get_entry_filename(cache, key);
+   if (!filename)
+      return NULL;
+
+   fd = open(filename, O_RDONLY | O_CLOEXEC);
+   free(filename);
+   if (fd < 0)
+      return NULL;
+
+   if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(*header)) {
+      close(fd);
+      return NULL;
+   }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED) {
+      close(fd);
+      return NULL;
+   }
+
+   header = (const struct cache_entry_header *) map;
+   if (header->magic != CACHE_ENTRY_MAGIC ||
+       header->version != CACHE_FORMAT_VERSION ||
+       memcmp(header->key, key, sizeof(header->key)) != 0 ||
+       (off_t) (sizeof(*header) + header->size) != st.st_size ||
+       compute_checksum(header + 1, header->size) != header->checksum) {
+      munmap(map, st.st_size);
+      close(fd);
+      return NULL;
+   }
+
+   /* Refresh the modification time, which is what eviction looks at. */
+   futimens(fd, NULL);
+   close(fd);
+
+   *size = header->size;
+
+   return header + 1;
+}
+
+void
+_mesa_disk_cache_release(struct _mesa_disk_cache *cache,
+                         const void *data, size_t size)
+{
+   const struct cache_entry_header *header =
+      (const struct cache_entry_header *) data - 1;
+
+   (void) cache;
+
+   munmap((void *) header, sizeof(*header) + size);
+}
+
+uint64_t
+_mesa_disk_cache_get_size(struct _mesa_disk_cache *cache)
+{
+   return cache ? read_size(cache) : 0;
+}
+
+#else /* _WIN32 */
+
+struct _mesa_disk_cache *
+_mesa_disk_cache_create(void)
+{
+   return NULL;
+}
+
+struct _mesa_disk_cache *
+_mesa_disk_cache_create_with_path(const char *path, uint64_t max_size)
+{
+   return NULL;
+}
+
+void
+_mesa_disk_cache_destroy(struct _mesa_disk_cache *cache)
+{
+}
+
+void
+_mesa_disk_cache_put(struct _mesa_disk_cache *cache, const cache_key key,
+                     const void *data, size_t size)
+{
+}
+
+const void *
+_mesa_disk_cache_get(struct _mesa_disk_cache *cache, const cache_key key,
+                     size_t *size)
+{
+   return NULL;
+}
+
+void
+_mesa_disk_cache_release(struct _mesa_disk_cache *cache,
+                         const void *data, size_t size)
+{
+}
+
+uint64_t
+_mesa_disk_cache_get_size(struct _mesa_disk_cache *cache)
+{
+   return 0;
+}
+
+#endif /* _WIN32 */
+
+static mtx_t disk_cache_lock = _MTX_INITIALIZER_NP;
+static struct _mesa_disk_cache *disk_cache;
+static bool disk_cache_initialized;
+
+/**
+ * Get the singleton GLSL disk cache.  The environment is consulted only by
+ * the first call to this function.
+ */
+struct _mesa_disk_cache *
+_mesa_glsl_get_disk_cache(void)
+{
+   mtx_lock(&disk_cache_lock);
+   if (!disk_cache_initialized) {
+      disk_cache = _mesa_disk_cache_create();
+      disk_cache_initialized = true;
+   }
+   mtx_unlock(&disk_cache_lock);
+
+   return disk_cache;
+}
+
+/**
+ * Destroy the GLSL disk cache.
+ */
+void
+_mesa_glsl_destroy_disk_cache(void)
+{
+   mtx_lock(&disk_cache_lock);
+   _mesa_disk_cache_destroy(disk_cache);
+   disk_cache = NULL;
+   disk_cache_initialized = false;
+   mtx_unlock(&disk_cache_lock);
+}
@@ -0,0 +1,118 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \file disk_cache.h
+ *
+ * A persistent cache of opaque blobs, stored as one file per entry under a
+ * local directory and named by a SHA-1 key.
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * concurrent readers, including other processes, only ever see complete
+ * entries.  The total size of the cache is tracked in a small shared index
+ * file and, once it exceeds the configured maximum, the least recently
+ * used entries of a randomly picked subdirectory are evicted.
+ *
+ * The cache is configured with these environment variables:
+ *
+ *  - MESA_GLSL_CACHE_DISABLE: disable the cache when set to true
+ *  - MESA_GLSL_CACHE_DIR: cache directory (default: $XDG_CACHE_HOME/mesa,
+ *    or $HOME/.cache/mesa)
+ *  - MESA_GLSL_CACHE_MAX_SIZE: maximum size, with an optional K, M, or G
+ *    suffix (default: 1G)
+ */
+
+struct _mesa_disk_cache;
+
+typedef unsigned char cache_key[MESA_SHA1_DIGEST_LENGTH];
+
+/**
+ * Create a cache as configured by the environment.  \c NULL is returned
+ * when the cache is disabled or the cache directory is not usable.
+ */
+struct _mesa_disk_cache *
+_mesa_disk_cache_create(void);
+
+/**
+ * Create a cache in \p path with a maximum size of \p max_size bytes.
+ */
+struct _mesa_disk_cache *
+_mesa_disk_cache_create_with_path(const char *path, uint64_t max_size);
+
+void
+_mesa_disk_cache_destroy(struct _mesa_disk_cache *cache);
+
+/**
+ * Store \p size bytes of \p data under \p key.  An entry that already
+ * exists is left alone.  Failures are silently ignored.
+ */
+void
+_mesa_disk_cache_put(struct _mesa_disk_cache *cache, const cache_key key,
+                     const void *data, size_t size);
+
+/**
+ * Look up \p key.  On a hit, the entry is mapped into memory and a pointer
+ * to its data is returned; the data stays valid until it is passed to
+ * \c _mesa_disk_cache_release.  The pointer is aligned to 8 bytes.
+ */
+const void *
+_mesa_disk_cache_get(struct _mesa_disk_cache *cache, const cache_key key,
+                     size_t *size);
+
+void
+_mesa_disk_cache_release(struct _mesa_disk_cache *cache,
+                         const void *data, size_t size);
+
+/**
+ * Return the total size in bytes of all entries, as tracked by the index.
+ */
+uint64_t
+_mesa_disk_cache_get_size(struct _mesa_disk_cache *cache);
+
+/**
+ * Get the disk cache shared by all contexts, or \c NULL if disabled.
+ */
+struct _mesa_disk_cache *
+_mesa_glsl_get_disk_cache(void);
+
+void
+_mesa_glsl_destroy_disk_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_H */
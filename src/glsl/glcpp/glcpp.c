@@ -103,6 +103,7 @@ init_fake_gl_context (struct gl_context *gl_ctx)
 {
 	gl_ctx->API = API_OPENGL_COMPAT;
 	gl_ctx->Const.DisableGLSLLineContinuations = false;
+	gl_ctx->Shader.Flags = 0;
 }
 
 static void
@@ -210,6 +210,12 @@ int
 glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	   const struct gl_extensions *extensions, struct gl_context *g_ctx);
 
+void
+glcpp_release_prologue_cache(void);
+
+unsigned
+glcpp_prologue_cache_hits(void);
+
 /* Functions for writing to the info log */
 
 void
@@ -226,6 +232,9 @@ glcpp_lex_init_extra (glcpp_parser_t *parser, yyscan_t* scanner);
 void
 glcpp_lex_set_source_string(glcpp_parser_t *parser, const char *shader);
 
+int
+glcpp_lex_get_line_number(glcpp_parser_t *parser);
+
 int
 glcpp_lex (YYSTYPE *lvalp, YYLTYPE *llocp, yyscan_t scanner);
 
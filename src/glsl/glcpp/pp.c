@@ -22,8 +22,11 @@
  */
 
 #include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include "c11/threads.h"
 #include "glcpp.h"
 #include "main/core.h" /* for isblank() on MSVC */
 
@@ -134,17 +137,372 @@ remove_line_continuations(glcpp_parser_t *ctx, const char *shader)
 	return clean;
 }
 
+/* Prologue cache
+ *
+ * Applications often prepend the same long header of macros and helper
+ * functions to all of their shaders.  Rather than preprocessing it again for
+ * every shader, we remember the state of the preprocessor at the end of such
+ * a prologue: the macros defined, the output and the info log produced so
+ * far, and the line the rest of the source starts at.  A shader starting with
+ * the same text then only has its remainder preprocessed.
+ *
+ * A prologue is found as the common start of two consecutively preprocessed
+ * shaders, cut after its last newline.  It is preprocessed on its own, which
+ * only differs from preprocessing it as part of a shader by the empty line
+ * the lexer adds at the end of the input.  The rest of a shader is lexed
+ * starting from the last newline of the prologue, which puts the lexer at the
+ * start of the next line; since that newline ends the last line of the
+ * prologue again, the output is restored without that line's newline and the
+ * empty line.  A prologue is only cached if it leaves the preprocessor at the top level,
+ * (not within a comment, a conditional or the arguments of a macro), and
+ * didn't use #line.  Prologues that don't qualify are remembered too, so
+ * they aren't preprocessed again for every shader that starts with them.
+ *
+ * The macros of a cached prologue are shared by all the parsers restored
+ * from it, which only read them.  Each parser gets its own macro_t though,
+ * since #undef frees it.
+ *
+ * The cache is only used with MESA_GLSL=ppcache (GLSL_PP_CACHE).
+ */
+
+#define PROLOGUE_CACHE_SIZE 4
+
+/* Shorter prologues aren't worth the lookups. */
+#define PROLOGUE_MIN_LENGTH 1024
+
+struct prologue {
+	char *text;
+	size_t length;
+
+	/* The built-in macros depend on these. */
+	gl_api api;
+	bool has_extensions;
+	struct gl_extensions extensions;
+
+	/* The parser that preprocessed the text, minus its scanner, or NULL
+	 * if the prologue can't be restored.
+	 */
+	glcpp_parser_t *parser;
+	size_t output_length;
+	int line;
+
+	unsigned refcount;
+	unsigned last_use;
+};
+
+static mtx_t prologue_lock = _MTX_INITIALIZER_NP;
+static struct prologue *prologues[PROLOGUE_CACHE_SIZE];
+static char *previous_shader;
+static unsigned prologue_clock;
+static unsigned prologue_lookups;
+static unsigned prologue_hits;
+
+/* Must be called with prologue_lock held. */
+static void
+prologue_unref(struct prologue *prologue)
+{
+	if (--prologue->refcount)
+		return;
+
+	if (prologue->parser)
+		hash_table_dtor(prologue->parser->defines);
+	ralloc_free(prologue);
+}
+
+/* Return the length of the start of \p shader, at most \p length long, that
+ * ends with a newline outside of a comment.
+ */
+static size_t
+prologue_length(const char *shader, size_t length)
+{
+	bool in_comment = false;
+	size_t i, end = 0;
+
+	for (i = 0; i < length; i++) {
+		if (in_comment) {
+			if (shader[i] == '*' && i + 1 < length &&
+			    shader[i + 1] == '/') {
+				in_comment = false;
+				i++;
+			}
+		} else if (shader[i] == '/' && i + 1 < length &&
+			   shader[i + 1] == '*') {
+			in_comment = true;
+			i++;
+		} else if (shader[i] == '/' && i + 1 < length &&
+			   shader[i + 1] == '/') {
+			while (i + 1 < length && shader[i + 1] != '\n')
+				i++;
+		} else if (shader[i] == '\n') {
+			end = i + 1;
+		}
+	}
+
+	return end;
+}
+
+static struct prologue *
+prologue_create(const char *shader, size_t length,
+		const struct gl_extensions *extensions, gl_api api)
+{
+	struct prologue *prologue = ralloc(NULL, struct prologue);
+	glcpp_parser_t *parser;
+
+	prologue->text = ralloc_strndup(prologue, shader, length);
+	prologue->length = length;
+	prologue->api = api;
+	prologue->has_extensions = extensions != NULL;
+	if (extensions)
+		prologue->extensions = *extensions;
+
+	parser = glcpp_parser_create(extensions, api);
+	ralloc_steal(prologue, parser);
+	prologue->parser = parser;
+	prologue->refcount = 1;
+
+	glcpp_lex_set_source_string(parser, prologue->text);
+	glcpp_parser_parse(parser);
+	prologue->line = glcpp_lex_get_line_number(parser);
+	glcpp_lex_destroy(parser->scanner);
+	parser->scanner = NULL;
+
+	if (parser->error || parser->skip_stack ||
+	    parser->newline_as_space || parser->in_control_line ||
+	    parser->output_length < 2 ||
+	    strcmp(parser->output + parser->output_length - 2, "\n\n") != 0 ||
+	    strstr(parser->output, "#line") != NULL) {
+		hash_table_dtor(parser->defines);
+		ralloc_free(parser);
+		prologue->parser = NULL;
+		return prologue;
+	}
+
+	prologue->output_length = parser->output_length - 2;
+
+	return prologue;
+}
+
+static bool
+prologue_matches(struct prologue *prologue, const char *shader,
+		 const struct gl_extensions *extensions, gl_api api)
+{
+	if (prologue->api != api ||
+	    prologue->has_extensions != (extensions != NULL))
+		return false;
+
+	if (extensions &&
+	    memcmp(&prologue->extensions, extensions,
+		   offsetof(struct gl_extensions, String)) != 0)
+		return false;
+
+	return strncmp(shader, prologue->text, prologue->length) == 0;
+}
+
+static void
+prologue_copy_macro(const void *key, void *data, void *closure)
+{
+	glcpp_parser_t *parser = closure;
+	macro_t *macro = ralloc(parser, macro_t);
+
+	*macro = *(macro_t *) data;
+	hash_table_insert(parser->defines, macro, macro->identifier);
+}
+
+/* Put \p parser in the state it would be in after preprocessing the text of
+ * \p prologue.  Must be called with prologue_lock held.
+ */
+static void
+prologue_restore(struct prologue *prologue, glcpp_parser_t *parser)
+{
+	glcpp_parser_t *from = prologue->parser;
+
+	prologue->refcount++;
+	prologue->last_use = ++prologue_clock;
+
+	hash_table_call_foreach(from->defines, prologue_copy_macro, parser);
+
+	ralloc_free(parser->output);
+	parser->output = ralloc_strndup(parser, from->output,
+					prologue->output_length);
+	parser->output_length = prologue->output_length;
+
+	ralloc_free(parser->info_log);
+	parser->info_log = ralloc_strdup(parser, from->info_log);
+	parser->info_log_length = from->info_log_length;
+
+	parser->space_tokens = from->space_tokens;
+	parser->version_resolved = from->version_resolved;
+	parser->is_gles = from->is_gles;
+
+	/* The line of the last newline of the prologue. */
+	parser->has_new_line_number = 1;
+	parser->new_line_number = prologue->line - 1;
+}
+
+/* Must be called with prologue_lock held. */
+static void
+prologue_insert(struct prologue *prologue)
+{
+	unsigned i, victim = 0;
+
+	for (i = 0; i < PROLOGUE_CACHE_SIZE; i++) {
+		if (prologues[i] == NULL) {
+			victim = i;
+			break;
+		}
+		if (prologues[i]->last_use < prologues[victim]->last_use)
+			victim = i;
+	}
+
+	if (prologues[victim])
+		prologue_unref(prologues[victim]);
+	prologues[victim] = prologue;
+}
+
+/* Find the cached prologue \p shader starts with, or cache the one it shares
+ * with the previous shader, and restore \p parser to its end.
+ *
+ * \return the prologue, to be released with prologue_unref(), or NULL.
+ */
+static struct prologue *
+prologue_lookup(glcpp_parser_t *parser, const char *shader,
+		const struct gl_extensions *extensions, gl_api api,
+		bool report)
+{
+	struct prologue *prologue = NULL;
+	size_t common = 0;
+	bool known;
+	unsigned i;
+
+	mtx_lock(&prologue_lock);
+
+	prologue_lookups++;
+
+	for (i = 0; i < PROLOGUE_CACHE_SIZE; i++) {
+		if (prologues[i] &&
+		    (prologue == NULL ||
+		     prologues[i]->length > prologue->length) &&
+		    prologue_matches(prologues[i], shader, extensions, api))
+			prologue = prologues[i];
+	}
+
+	/* A prologue known not to be restorable is not tried again. */
+	known = prologue != NULL;
+	if (prologue && prologue->parser == NULL) {
+		prologue->last_use = ++prologue_clock;
+		prologue = NULL;
+	}
+
+	if (prologue) {
+		prologue_hits++;
+		prologue_restore(prologue, parser);
+	}
+
+	if (report) {
+		fprintf(stderr, "GLSL preprocessor: prologue cache %s, "
+			"%u hits in %u lookups (%.1f%%)\n",
+			prologue ? "hit" : "miss", prologue_hits,
+			prologue_lookups,
+			100.0 * prologue_hits / prologue_lookups);
+	}
+
+	if (!known && previous_shader) {
+		while (shader[common] && shader[common] == previous_shader[common])
+			common++;
+	}
+
+	ralloc_free(previous_shader);
+	previous_shader = ralloc_strdup(NULL, shader);
+
+	mtx_unlock(&prologue_lock);
+
+	if (known || common < PROLOGUE_MIN_LENGTH)
+		return prologue;
+
+	common = prologue_length(shader, common);
+	if (common < PROLOGUE_MIN_LENGTH)
+		return NULL;
+
+	/* Preprocessing the prologue on its own costs nothing extra, since
+	 * only the rest of this shader is left to do.
+	 */
+	prologue = prologue_create(shader, common, extensions, api);
+
+	mtx_lock(&prologue_lock);
+	prologue_insert(prologue);
+	if (prologue->parser)
+		prologue_restore(prologue, parser);
+	else
+		prologue = NULL;
+	mtx_unlock(&prologue_lock);
+
+	return prologue;
+}
+
+/**
+ * Free the cached prologues.
+ */
+void
+glcpp_release_prologue_cache(void)
+{
+	unsigned i;
+
+	mtx_lock(&prologue_lock);
+
+	for (i = 0; i < PROLOGUE_CACHE_SIZE; i++) {
+		if (prologues[i]) {
+			prologue_unref(prologues[i]);
+			prologues[i] = NULL;
+		}
+	}
+
+	ralloc_free(previous_shader);
+	previous_shader = NULL;
+
+	mtx_unlock(&prologue_lock);
+}
+
+/**
+ * Return the number of shaders restored from a prologue that was cached by an
+ * earlier shader.
+ */
+unsigned
+glcpp_prologue_cache_hits(void)
+{
+	unsigned hits;
+
+	mtx_lock(&prologue_lock);
+	hits = prologue_hits;
+	mtx_unlock(&prologue_lock);
+
+	return hits;
+}
+
 int
 glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	   const struct gl_extensions *extensions, struct gl_context *gl_ctx)
 {
 	int errors;
 	glcpp_parser_t *parser = glcpp_parser_create (extensions, gl_ctx->API);
+	struct prologue *prologue;
 
 	if (! gl_ctx->Const.DisableGLSLLineContinuations)
 		*shader = remove_line_continuations(parser, *shader);
 
-	glcpp_lex_set_source_string (parser, *shader);
+	/* Only used on request until it is tested more widely. */
+	if (gl_ctx->Shader.Flags & GLSL_PP_CACHE)
+		prologue = prologue_lookup(parser, *shader, extensions,
+					   gl_ctx->API,
+					   gl_ctx->Shader.Flags &
+					   GLSL_PP_CACHE_REPORT);
+	else
+		prologue = NULL;
+
+	if (prologue)
+		glcpp_lex_set_source_string (parser,
+					     *shader + prologue->length - 1);
+	else
+		glcpp_lex_set_source_string (parser, *shader);
 
 	glcpp_parser_parse (parser);
 
@@ -160,5 +518,12 @@ glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 
 	errors = parser->error;
 	glcpp_parser_destroy (parser);
+
+	if (prologue) {
+		mtx_lock(&prologue_lock);
+		prologue_unref(prologue);
+		mtx_unlock(&prologue_lock);
+	}
+
 	return errors;
 }
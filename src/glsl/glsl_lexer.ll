@@ -526,8 +526,8 @@ subroutine	KEYWORD(0, 300, 0, 0, SUBROUTINE);
 
 [_a-zA-Z][_a-zA-Z0-9]*	{
 			    struct _mesa_glsl_parse_state *state = yyextra;
-			    void *ctx = state;	
-			    yylval->identifier = ralloc_strdup(ctx, yytext);
+			    void *ctx = state->linalloc;
+			    yylval->identifier = linear_strdup(ctx, yytext);
 			    return classify_identifier(state, yytext);
 			}
 
@@ -36,8 +36,10 @@ extern "C" {
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
 #include "ir_optimization.h"
-#include "loop_analysis.h"
 #include "threadpool.h"
+#include "disk_cache.h"
+#include "shader_cache.h"
+#include "glsl_profile.h"
 
 /**
  * Format a short human-readable description of the given GLSL version.
@@ -66,6 +68,8 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    this->translation_unit.make_empty();
    this->symbols = new(mem_ctx) glsl_symbol_table;
 
+   this->linalloc = linear_alloc_parent(this, 0);
+
    this->num_uniform_blocks = 0;
    this->uniform_block_array_size = 0;
    this->uniform_blocks = NULL;
@@ -1318,7 +1322,8 @@ ast_struct_specifier::print(void) const
 }
 
 
-ast_struct_specifier::ast_struct_specifier(const char *identifier,
+ast_struct_specifier::ast_struct_specifier(void *lin_ctx,
+					   const char *identifier,
 					   ast_declarator_list *declarator_list)
 {
    if (identifier == NULL) {
@@ -1330,7 +1335,7 @@ ast_struct_specifier::ast_struct_specifier(const char *identifier,
       count = anon_count++;
       mtx_unlock(&mutex);
 
-      identifier = ralloc_asprintf(this, "#anon_struct_%04x", count);
+      identifier = linear_asprintf(lin_ctx, "#anon_struct_%04x", count);
    }
    name = identifier;
    this->declarations.push_degenerate_list_at_head(&declarator_list->link);
@@ -1399,13 +1404,17 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
    const char *source = shader->Source;
 
+   _mesa_glsl_profile_begin();
    state->error = glcpp_preprocess(state, &source, &state->info_log,
                              &ctx->Extensions, ctx);
+   _mesa_glsl_profile_end("preprocess", false);
 
    if (!state->error) {
+     _mesa_glsl_profile_begin();
      _mesa_glsl_lexer_ctor(state, source);
      _mesa_glsl_parse(state);
      _mesa_glsl_lexer_dtor(state);
+     _mesa_glsl_profile_end("parse", false);
    }
 
    if (dump_ast) {
@@ -1418,8 +1427,11 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 
    ralloc_free(shader->ir);
    shader->ir = new(shader) exec_list;
-   if (!state->error && !state->translation_unit.is_empty())
+   if (!state->error && !state->translation_unit.is_empty()) {
+      _mesa_glsl_profile_begin();
       _mesa_ast_to_hir(shader->ir, state);
+      _mesa_glsl_profile_end("ast_to_hir", false);
+   }
 
    if (!state->error) {
       validate_ir_tree(shader->ir);
@@ -1438,7 +1450,8 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, 32, options))
+      ir_pass_manager pm;
+      while (pm.run_common_optimization(shader->ir, false, false, 32, options))
          ;
 
       validate_ir_tree(shader->ir);
@@ -1466,9 +1479,22 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
    /* Retain any live IR, but trash the rest. */
    reparent_ir(shader->ir, shader->ir);
 
+   shader->compile_skipped = false;
+
    ralloc_free(state);
 }
 
+void
+_mesa_glsl_compile_shader_cached(struct gl_context *ctx,
+                                 struct gl_shader *shader)
+{
+   if (_mesa_shader_cache_skip_compile(ctx, shader))
+      return;
+
+   _mesa_glsl_compile_shader(ctx, shader, false, false);
+   _mesa_shader_cache_store_shader(ctx, shader);
+}
+
 } /* extern "C" */
 /**
  * Do the set of common optimizations passes
@@ -1494,58 +1520,10 @@ do_common_optimization(exec_list *ir, bool linked,
 		       unsigned max_unroll_iterations,
                        const struct gl_shader_compiler_options *options)
 {
-   GLboolean progress = GL_FALSE;
-
-   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
-
-   if (linked) {
-      progress = do_function_inlining(ir) || progress;
-      progress = do_dead_functions(ir) || progress;
-      progress = do_structure_splitting(ir) || progress;
-   }
-   progress = do_if_simplification(ir) || progress;
-   progress = opt_flatten_nested_if_blocks(ir) || progress;
-   progress = do_copy_propagation(ir) || progress;
-   progress = do_copy_propagation_elements(ir) || progress;
-
-   if (options->OptimizeForAOS && !linked)
-      progress = opt_flip_matrices(ir) || progress;
-
-   if (linked && options->OptimizeForAOS) {
-      progress = do_vectorize(ir) || progress;
-   }
-
-   if (linked)
-      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
-   else
-      progress = do_dead_code_unlinked(ir) || progress;
-   progress = do_dead_code_local(ir) || progress;
-   progress = do_tree_grafting(ir) || progress;
-   progress = do_constant_propagation(ir) || progress;
-   if (linked)
-      progress = do_constant_variable(ir) || progress;
-   else
-      progress = do_constant_variable_unlinked(ir) || progress;
-   progress = do_constant_folding(ir) || progress;
-   progress = do_cse(ir) || progress;
-   progress = do_algebraic(ir) || progress;
-   progress = do_lower_jumps(ir) || progress;
-   progress = do_vec_index_to_swizzle(ir) || progress;
-   progress = lower_vector_insert(ir, false) || progress;
-   progress = do_swizzle_swizzle(ir) || progress;
-   progress = do_noop_swizzle(ir) || progress;
-
-   progress = optimize_split_arrays(ir, linked) || progress;
-   progress = optimize_redundant_jumps(ir) || progress;
-
-   loop_state *ls = analyze_loop_variables(ir);
-   if (ls->loop_found) {
-      progress = set_loop_controls(ir, ls) || progress;
-      progress = unroll_loops(ir, ls, max_unroll_iterations) || progress;
-   }
-   delete ls;
+   ir_pass_manager pm;
 
-   return progress;
+   return pm.run_common_optimization(ir, linked, uniform_locations_assigned,
+                                     max_unroll_iterations, options);
 }
 
 extern "C" {
@@ -1561,6 +1539,7 @@ void
 _mesa_destroy_shader_compiler(void)
 {
    _mesa_glsl_destroy_threadpool();
+   _mesa_glsl_destroy_disk_cache();
 
    _mesa_destroy_shader_compiler_caches();
 
@@ -1577,6 +1556,7 @@ _mesa_destroy_shader_compiler_caches(void)
 {
    _mesa_glsl_wait_threadpool();
    _mesa_glsl_release_builtin_functions();
+   glcpp_release_prologue_cache();
 }
 
 }
@@ -153,6 +153,12 @@ struct _mesa_glsl_parse_state {
    exec_list translation_unit;
    glsl_symbol_table *symbols;
 
+   /**
+    * Linear parent the AST and the identifiers of the lexer are allocated
+    * from, freed along with the parse state.
+    */
+   void *linalloc;
+
    unsigned num_uniform_blocks;
    unsigned uniform_block_array_size;
    struct gl_uniform_block *uniform_blocks;
@@ -459,6 +465,7 @@ _mesa_shader_stage_to_string(unsigned stage);
 
 extern int glcpp_preprocess(void *ctx, const char **shader, char **info_log,
                       const struct gl_extensions *extensions, struct gl_context *gl_ctx);
+extern void glcpp_release_prologue_cache(void);
 
 extern void _mesa_destroy_shader_compiler(void);
 extern void _mesa_destroy_shader_compiler_caches(void);
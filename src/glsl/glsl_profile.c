@@ -0,0 +1,193 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <time.h>
+#include "c11/threads.h"
+#include "main/compiler.h"
+#include "ralloc.h"
+#include "glsl_profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static once_flag profile_once = ONCE_FLAG_INIT;
+static tss_t profile_key;
+
+/* set once any profile has been made current */
+static int profile_used;
+
+static void
+create_profile_key(void)
+{
+   tss_create(&profile_key, NULL);
+}
+
+static struct glsl_profile *
+get_current_profile(void)
+{
+   if (likely(!profile_used))
+      return NULL;
+
+   return (struct glsl_profile *) tss_get(profile_key);
+}
+
+/**
+ * Return a monotonic time in seconds.
+ */
+double
+_mesa_glsl_profile_time(void)
+{
+#ifdef _WIN32
+   LARGE_INTEGER freq, counter;
+
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&counter);
+   return (double) counter.QuadPart / freq.QuadPart;
+#else
+   struct timespec tv;
+
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+#endif
+}
+
+void
+_mesa_glsl_profile_init(struct glsl_profile *profile)
+{
+   memset(profile, 0, sizeof(*profile));
+}
+
+/**
+ * Make \p profile, or nothing if NULL, collect the stages run by the
+ * calling thread.
+ */
+void
+_mesa_glsl_profile_set_current(struct glsl_profile *profile)
+{
+   call_once(&profile_once, create_profile_key);
+
+   if (profile)
+      profile_used = 1;
+
+   tss_set(profile_key, profile);
+   ralloc_set_thread_counter(profile ? &profile->allocations : NULL);
+}
+
+void
+_mesa_glsl_profile_begin(void)
+{
+   struct glsl_profile *profile = get_current_profile();
+
+   if (!profile)
+      return;
+
+   if (profile->depth < GLSL_PROFILE_MAX_DEPTH) {
+      profile->stack[profile->depth].start = _mesa_glsl_profile_time();
+      profile->stack[profile->depth].allocations = profile->allocations;
+   }
+   profile->depth++;
+}
+
+static struct glsl_profile_stage *
+find_stage(struct glsl_profile *profile, const char *name)
+{
+   struct glsl_profile_stage *stage;
+   unsigned i;
+
+   for (i = 0; i < profile->num_stages; i++) {
+      stage = &profile->stages[i];
+      if (stage->name == name || strcmp(stage->name, name) == 0)
+         return stage;
+   }
+
+   if (profile->num_stages == GLSL_PROFILE_MAX_STAGES)
+      return NULL;
+
+   stage = &profile->stages[profile->num_stages++];
+   stage->name = name;
+
+   return stage;
+}
+
+/**
+ * End the stage started by the matching _mesa_glsl_profile_begin().
+ *
+ * \return \p progress
+ */
+bool
+_mesa_glsl_profile_end(const char *name, bool progress)
+{
+   struct glsl_profile *profile = get_current_profile();
+   struct glsl_profile_stage *stage;
+   double end;
+
+   if (!profile || !profile->depth)
+      return progress;
+
+   end = _mesa_glsl_profile_time();
+
+   profile->depth--;
+   if (profile->depth >= GLSL_PROFILE_MAX_DEPTH)
+      return progress;
+
+   stage = find_stage(profile, name);
+   if (stage) {
+      stage->calls++;
+      if (progress)
+         stage->progress++;
+      stage->time += end - profile->stack[profile->depth].start;
+      stage->allocations +=
+         profile->allocations - profile->stack[profile->depth].allocations;
+   }
+
+   return progress;
+}
+
+/**
+ * Add the statistics of \p src to \p dst.
+ */
+void
+_mesa_glsl_profile_merge(struct glsl_profile *dst,
+                         const struct glsl_profile *src)
+{
+   unsigned i;
+
+   for (i = 0; i < src->num_stages; i++) {
+      const struct glsl_profile_stage *s = &src->stages[i];
+      struct glsl_profile_stage *d = find_stage(dst, s->name);
+
+      if (!d)
+         break;
+
+      d->calls += s->calls;
+      d->progress += s->progress;
+      d->time += s->time;
+      d->allocations += s->allocations;
+   }
+
+   dst->allocations += src->allocations;
+}
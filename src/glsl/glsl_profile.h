@@ -0,0 +1,101 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef GLSL_PROFILE_H
+#define GLSL_PROFILE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-stage statistics of the GLSL compiler, for the offline compile
+ * benchmark.
+ *
+ * Stages are bracketed by _mesa_glsl_profile_begin() and
+ * _mesa_glsl_profile_end() and are accounted to the profile current on the
+ * calling thread, if any.  Stages may nest, in which case the time and the
+ * allocations of the inner stages are included in the outer one.  Nothing
+ * is recorded, and the calls are cheap, until a profile is made current.
+ */
+
+#define GLSL_PROFILE_MAX_STAGES 64
+#define GLSL_PROFILE_MAX_DEPTH 8
+
+struct glsl_profile_stage {
+   const char *name;       /* a string literal */
+   unsigned long calls;
+   unsigned long progress; /* calls that reported progress */
+   double time;            /* in seconds */
+   unsigned long allocations;
+};
+
+struct glsl_profile {
+   unsigned num_stages;
+   struct glsl_profile_stage stages[GLSL_PROFILE_MAX_STAGES];
+
+   /* allocations made by the thread, counted by ralloc */
+   unsigned long allocations;
+
+   unsigned depth;
+   struct {
+      double start;
+      unsigned long allocations;
+   } stack[GLSL_PROFILE_MAX_DEPTH];
+};
+
+void
+_mesa_glsl_profile_init(struct glsl_profile *profile);
+
+void
+_mesa_glsl_profile_set_current(struct glsl_profile *profile);
+
+void
+_mesa_glsl_profile_begin(void);
+
+bool
+_mesa_glsl_profile_end(const char *name, bool progress);
+
+void
+_mesa_glsl_profile_merge(struct glsl_profile *dst,
+                         const struct glsl_profile *src);
+
+double
+_mesa_glsl_profile_time(void);
+
+/**
+ * Evaluate \p pass, an expression returning whether it made progress, as
+ * the stage \p name.
+ */
+#define GLSL_PROFILE(name, pass) \
+   (_mesa_glsl_profile_begin(), _mesa_glsl_profile_end(name, (pass)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GLSL_PROFILE_H */
@@ -27,16 +27,166 @@
 #include "glsl_symbol_table.h"
 #include "glsl_parser_extras.h"
 #include "glsl_types.h"
-extern "C" {
-#include "program/hash_table.h"
-}
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+ * The tables of array, record and interface types are read without taking
+ * glsl_type::mutex, as concurrent compiles look types up all the time but
+ * seldom create new ones.
+ *
+ * Each table is a fixed array of buckets, each the head of a list of
+ * entries.  Entries are never removed, except by _mesa_glsl_release_types()
+ * while nothing is being compiled, and are only ever added at the head of
+ * a bucket, with a compare-and-swap once the entry and its type are fully
+ * initialized.  A reader that loads a bucket head therefore sees complete
+ * entries all the way down its list.  If two threads create the same type
+ * at once, the one losing the compare-and-swap finds the winner's entry
+ * and returns its type instead, so each type still has a single instance.
+ */
+#define TYPE_TABLE_BUCKETS 1024
+
+struct glsl_type_table_entry {
+   const glsl_type *type;
+   unsigned hash;
+   glsl_type_table_entry *next;
+};
+
+struct glsl_type_table {
+   glsl_type_table_entry *volatile buckets[TYPE_TABLE_BUCKETS];
+
+   template<typename KEY>
+   const glsl_type *lookup(unsigned hash,
+                           bool (*match)(const glsl_type *, const KEY &),
+                           const KEY &key);
+
+   template<typename KEY>
+   const glsl_type *insert(unsigned hash,
+                           bool (*match)(const glsl_type *, const KEY &),
+                           const KEY &key, const glsl_type *t);
+
+   void clear();
+};
 
 mtx_t glsl_type::mutex = _MTX_INITIALIZER_NP;
-hash_table *glsl_type::array_types = NULL;
-hash_table *glsl_type::record_types = NULL;
-hash_table *glsl_type::interface_types = NULL;
+glsl_type_table glsl_type::array_types;
+glsl_type_table glsl_type::record_types;
+glsl_type_table glsl_type::interface_types;
 void *glsl_type::mem_ctx = NULL;
 
+/**
+ * Atomically replace \p *head by \p entry if it still is \p old, and
+ * return the previous value of \p *head.
+ */
+static inline glsl_type_table_entry *
+type_table_cmpxchg(glsl_type_table_entry *volatile *head,
+                   glsl_type_table_entry *old, glsl_type_table_entry *entry)
+{
+#if defined(_MSC_VER)
+   return (glsl_type_table_entry *)
+      _InterlockedCompareExchangePointer((void *volatile *) head,
+                                         entry, old);
+#else
+   return __sync_val_compare_and_swap(head, old, entry);
+#endif
+}
+
+/**
+ * Walk the entries from \p first up to, but not including, \p last for one
+ * whose type matches the key, according to \p match.
+ */
+template<typename KEY>
+static const glsl_type *
+type_table_find(const glsl_type_table_entry *first,
+                const glsl_type_table_entry *last, unsigned hash,
+                bool (*match)(const glsl_type *, const KEY &), const KEY &key)
+{
+   for (const glsl_type_table_entry *entry = first; entry != last;
+        entry = entry->next) {
+      if (entry->hash == hash && match(entry->type, key))
+         return entry->type;
+   }
+
+   return NULL;
+}
+
+template<typename KEY>
+const glsl_type *
+glsl_type_table::lookup(unsigned hash,
+                        bool (*match)(const glsl_type *, const KEY &),
+                        const KEY &key)
+{
+   return type_table_find(buckets[hash & (TYPE_TABLE_BUCKETS - 1)], NULL,
+                          hash, match, key);
+}
+
+/**
+ * Add \p t, which lookup() didn't find, to the table, unless another thread
+ * added a matching type meanwhile.
+ *
+ * \return the type in the table, \p t or the other thread's.
+ */
+template<typename KEY>
+const glsl_type *
+glsl_type_table::insert(unsigned hash,
+                        bool (*match)(const glsl_type *, const KEY &),
+                        const KEY &key, const glsl_type *t)
+{
+   glsl_type_table_entry *volatile *head =
+      &buckets[hash & (TYPE_TABLE_BUCKETS - 1)];
+
+   mtx_lock(&glsl_type::mutex);
+   glsl_type_table_entry *entry =
+      ralloc(glsl_type::mem_ctx, glsl_type_table_entry);
+   mtx_unlock(&glsl_type::mutex);
+
+   entry->type = t;
+   entry->hash = hash;
+
+   /* Only the entries added since the lookup need to be checked. */
+   glsl_type_table_entry *first = NULL;
+   glsl_type_table_entry *old = *head;
+
+   for (;;) {
+      const glsl_type *other = type_table_find(old, first, hash, match, key);
+      if (other != NULL) {
+         /* The instance created by the caller is left unused in mem_ctx. */
+         mtx_lock(&glsl_type::mutex);
+         ralloc_free(entry);
+         mtx_unlock(&glsl_type::mutex);
+         return other;
+      }
+
+      first = old;
+      entry->next = first;
+      old = type_table_cmpxchg(head, first, entry);
+      if (old == first)
+         return t;
+   }
+}
+
+/**
+ * Empty the table.  The caller must hold glsl_type::mutex, and nothing may
+ * be looking types up.
+ */
+void
+glsl_type_table::clear()
+{
+   for (unsigned i = 0; i < TYPE_TABLE_BUCKETS; i++) {
+      glsl_type_table_entry *entry = buckets[i];
+
+      while (entry != NULL) {
+         glsl_type_table_entry *next = entry->next;
+         ralloc_free(entry);
+         entry = next;
+      }
+
+      buckets[i] = NULL;
+   }
+}
+
 void
 glsl_type::init_ralloc_type_ctx(void)
 {
@@ -287,15 +437,9 @@ _mesa_glsl_release_types(void)
 {
    mtx_lock(&glsl_type::mutex);
 
-   if (glsl_type::array_types != NULL) {
-      hash_table_dtor(glsl_type::array_types);
-      glsl_type::array_types = NULL;
-   }
-
-   if (glsl_type::record_types != NULL) {
-      hash_table_dtor(glsl_type::record_types);
-      glsl_type::record_types = NULL;
-   }
+   glsl_type::array_types.clear();
+   glsl_type::record_types.clear();
+   glsl_type::interface_types.clear();
 
    mtx_unlock(&glsl_type::mutex);
 }
@@ -456,40 +600,45 @@ glsl_type::get_instance(unsigned base_type, unsigned rows, unsigned columns)
 }
 
 
+namespace {
+
+struct array_key {
+   const glsl_type *base;
+   unsigned array_size;
+};
+
+bool
+array_type_matches(const glsl_type *t, const array_key &key)
+{
+   return t->fields.array == key.base && t->length == key.array_size;
+}
+
+} /* anonymous namespace */
+
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
-   /* Generate a name using the base type pointer in the key.  This is
-    * done because the name of the base type may not be unique across
-    * shaders.  For example, two shaders may have different record types
-    * named 'foo'.
+   /* The key is the base type pointer rather than its name, as the name of
+    * the base type may not be unique across shaders.  For example, two
+    * shaders may have different record types named 'foo'.
     */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
+   const array_key key = { base, array_size };
+   const unsigned hash =
+      (unsigned) ((uintptr_t) base >> 4) * 31 + array_size;
 
-   mtx_lock(&glsl_type::mutex);
-
-   if (array_types == NULL) {
-      array_types = hash_table_ctor(64, hash_table_string_hash,
-				    hash_table_string_compare);
-   }
-
-   const glsl_type *t = (glsl_type *) hash_table_find(array_types, key);
+   const glsl_type *t =
+      array_types.lookup(hash, array_type_matches, key);
 
    if (t == NULL) {
-      mtx_unlock(&glsl_type::mutex);
       t = new glsl_type(base, array_size);
-      mtx_lock(&glsl_type::mutex);
-
-      hash_table_insert(array_types, (void *) t, ralloc_strdup(mem_ctx, key));
+      t = array_types.insert(hash, array_type_matches, key, t);
    }
 
    assert(t->base_type == GLSL_TYPE_ARRAY);
    assert(t->length == array_size);
    assert(t->fields.array == base);
 
-   mtx_unlock(&glsl_type::mutex);
-
    return t;
 }
 
@@ -530,71 +679,81 @@ glsl_type::record_compare(const glsl_type *b) const
 }
 
 
-int
-glsl_type::record_key_compare(const void *a, const void *b)
+namespace {
+
+struct record_key {
+   const glsl_struct_field *fields;
+   unsigned num_fields;
+   unsigned packing;
+   const char *name;
+};
+
+/**
+ * Same comparison as glsl_type::record_compare(), plus the name, against
+ * the fields of a type that doesn't exist yet.
+ */
+bool
+record_type_matches(const glsl_type *t, const record_key &key)
 {
-   const glsl_type *const key1 = (glsl_type *) a;
-   const glsl_type *const key2 = (glsl_type *) b;
+   if (t->length != key.num_fields ||
+       t->interface_packing != key.packing ||
+       strcmp(t->name, key.name) != 0)
+      return false;
 
-   /* Return zero is the types match (there is zero difference) or non-zero
-    * otherwise.
-    */
-   if (strcmp(key1->name, key2->name) != 0)
-      return 1;
+   for (unsigned i = 0; i < key.num_fields; i++) {
+      const glsl_struct_field *a = &t->fields.structure[i];
+      const glsl_struct_field *b = &key.fields[i];
+
+      if (a->type != b->type ||
+          strcmp(a->name, b->name) != 0 ||
+          a->row_major != b->row_major ||
+          a->location != b->location ||
+          a->interpolation != b->interpolation ||
+          a->centroid != b->centroid ||
+          a->sample != b->sample)
+         return false;
+   }
 
-   return !key1->record_compare(key2);
+   return true;
 }
 
-
 unsigned
-glsl_type::record_key_hash(const void *a)
+record_key_hash(const record_key &key)
 {
-   const glsl_type *const key = (glsl_type *) a;
-   char hash_key[128];
-   unsigned size = 0;
-
-   size = snprintf(hash_key, sizeof(hash_key), "%08x", key->length);
+   unsigned hash = key.num_fields;
 
-   for (unsigned i = 0; i < key->length; i++) {
-      if (size >= sizeof(hash_key))
-	 break;
+   for (const char *c = key.name; *c; c++)
+      hash = hash * 33 + *c;
 
-      size += snprintf(& hash_key[size], sizeof(hash_key) - size,
-		       "%p", (void *) key->fields.structure[i].type);
-   }
+   for (unsigned i = 0; i < key.num_fields; i++)
+      hash = hash * 31 + (unsigned) ((uintptr_t) key.fields[i].type >> 4);
 
-   return hash_table_string_hash(& hash_key);
+   return hash;
 }
 
+} /* anonymous namespace */
+
 
 const glsl_type *
 glsl_type::get_record_instance(const glsl_struct_field *fields,
 			       unsigned num_fields,
 			       const char *name)
 {
-   const glsl_type key(fields, num_fields, name);
-
-   mtx_lock(&glsl_type::mutex);
+   const record_key key = { fields, num_fields, 0, name };
+   const unsigned hash = record_key_hash(key);
 
-   if (record_types == NULL) {
-      record_types = hash_table_ctor(64, record_key_hash, record_key_compare);
-   }
+   const glsl_type *t =
+      record_types.lookup(hash, record_type_matches, key);
 
-   const glsl_type *t = (glsl_type *) hash_table_find(record_types, & key);
    if (t == NULL) {
-      mtx_unlock(&glsl_type::mutex);
       t = new glsl_type(fields, num_fields, name);
-      mtx_lock(&glsl_type::mutex);
-
-      hash_table_insert(record_types, (void *) t, t);
+      t = record_types.insert(hash, record_type_matches, key, t);
    }
 
    assert(t->base_type == GLSL_TYPE_STRUCT);
    assert(t->length == num_fields);
    assert(strcmp(t->name, name) == 0);
 
-   mtx_unlock(&glsl_type::mutex);
-
    return t;
 }
 
@@ -605,29 +764,22 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
 				  enum glsl_interface_packing packing,
 				  const char *block_name)
 {
-   const glsl_type key(fields, num_fields, packing, block_name);
+   const record_key key = { fields, num_fields, (unsigned) packing,
+                            block_name };
+   const unsigned hash = record_key_hash(key);
 
-   mtx_lock(&glsl_type::mutex);
+   const glsl_type *t =
+      interface_types.lookup(hash, record_type_matches, key);
 
-   if (interface_types == NULL) {
-      interface_types = hash_table_ctor(64, record_key_hash, record_key_compare);
-   }
-
-   const glsl_type *t = (glsl_type *) hash_table_find(interface_types, & key);
    if (t == NULL) {
-      mtx_unlock(&glsl_type::mutex);
       t = new glsl_type(fields, num_fields, packing, block_name);
-      mtx_lock(&glsl_type::mutex);
-
-      hash_table_insert(interface_types, (void *) t, t);
+      t = interface_types.insert(hash, record_type_matches, key, t);
    }
 
    assert(t->base_type == GLSL_TYPE_INTERFACE);
    assert(t->length == num_fields);
    assert(strcmp(t->name, block_name) == 0);
 
-   mtx_unlock(&glsl_type::mutex);
-
    return t;
 }
 
@@ -36,6 +36,7 @@ extern "C" {
 
 struct _mesa_glsl_parse_state;
 struct glsl_symbol_table;
+struct glsl_type_table;
 
 extern void
 _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
@@ -587,17 +588,17 @@ private:
    /** Constructor for array types */
    glsl_type(const glsl_type *array, unsigned length);
 
-   /** Hash table containing the known array types. */
-   static struct hash_table *array_types;
-
-   /** Hash table containing the known record types. */
-   static struct hash_table *record_types;
-
-   /** Hash table containing the known interface types. */
-   static struct hash_table *interface_types;
-
-   static int record_key_compare(const void *a, const void *b);
-   static unsigned record_key_hash(const void *key);
+   /**
+    * \name Tables of the known array, record and interface types
+    *
+    * Looking a type up doesn't take \c mutex, so that concurrent compiles
+    * don't serialize on it.  See glsl_types.cpp.
+    */
+   /*@{*/
+   static struct glsl_type_table array_types;
+   static struct glsl_type_table record_types;
+   static struct glsl_type_table interface_types;
+   /*@}*/
 
    /**
     * \name Built-in type flyweights
@@ -621,6 +622,8 @@ private:
    friend void _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *);
    friend void _mesa_glsl_release_types(void);
    /*@}*/
+
+   friend struct glsl_type_table;
 };
 
 struct glsl_struct_field {
@@ -69,6 +69,66 @@ bool do_common_optimization(exec_list *ir, bool linked,
 			    unsigned max_unroll_iterations,
                             const struct gl_shader_compiler_options *options);
 
+/**
+ * Runs do_common_optimization() to a fixed point without re-running the
+ * passes that can't make progress.
+ *
+ * A pass that made no progress can't make any either as long as nothing
+ * changes the IR, so the manager remembers, for each pass, whether the IR
+ * changed since it last ran without progress and skips it otherwise.  The
+ * resulting IR is the same as with do_common_optimization().
+ *
+ * The manager must be used with a single shader, and the passes run on it
+ * outside of the manager must be reported with record().
+ */
+class ir_pass_manager {
+public:
+   ir_pass_manager();
+
+   /**
+    * Runs one round of the passes of do_common_optimization(), and returns
+    * whether any made progress.
+    */
+   bool run_common_optimization(exec_list *ir, bool linked,
+                                bool uniform_locations_assigned,
+                                unsigned max_unroll_iterations,
+                                const struct gl_shader_compiler_options *options);
+
+   /** Makes every pass run again, after the IR was changed elsewhere. */
+   void invalidate();
+
+   /**
+    * Records the result of a pass run outside of the manager, and returns
+    * \p progress.
+    */
+   bool record(bool progress)
+   {
+      if (progress)
+         invalidate();
+      return progress;
+   }
+
+   /** Number of passes run and skipped, for statistics. */
+   unsigned passes_run;
+   unsigned passes_skipped;
+
+private:
+   bool skip(unsigned pass);
+   bool finish(unsigned pass, bool progress);
+
+   /** Incremented whenever the IR changes. */
+   unsigned generation;
+
+   /** Generation at which each pass last ran without making progress. */
+   unsigned clean_generation[32];
+
+   /* Parameters of the last round, which the passes depend on. */
+   bool linked;
+   bool uniform_locations_assigned;
+   unsigned max_unroll_iterations;
+   bool optimize_for_aos;
+};
+
 bool do_algebraic(exec_list *instructions);
 bool do_constant_folding(exec_list *instructions);
 bool do_constant_variable(exec_list *instructions);
@@ -0,0 +1,230 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_pass_manager.cpp
+ *
+ * Runs the passes of do_common_optimization() to a fixed point, skipping
+ * the passes that are known to make no progress.
+ *
+ * The passes don't report what they changed, so the IR is tracked as a
+ * whole: a generation number is bumped whenever a pass makes progress, and
+ * each pass records the generation at which it last ran without making
+ * progress.  While that is still the current generation the pass would see
+ * the very same IR again and can be skipped.  Skipping only passes that
+ * would have returned false, the manager produces the same IR as running
+ * do_common_optimization() until it returns false.
+ */
+
+#include "ir.h"
+#include "ir_optimization.h"
+#include "loop_analysis.h"
+#include "glsl_profile.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+
+namespace {
+
+enum common_pass {
+   PASS_LOWER_INSTRUCTIONS,
+   PASS_FUNCTION_INLINING,
+   PASS_DEAD_FUNCTIONS,
+   PASS_STRUCTURE_SPLITTING,
+   PASS_IF_SIMPLIFICATION,
+   PASS_FLATTEN_NESTED_IF_BLOCKS,
+   PASS_COPY_PROPAGATION,
+   PASS_COPY_PROPAGATION_ELEMENTS,
+   PASS_FLIP_MATRICES,
+   PASS_VECTORIZE,
+   PASS_DEAD_CODE,
+   PASS_DEAD_CODE_LOCAL,
+   PASS_TREE_GRAFTING,
+   PASS_CONSTANT_PROPAGATION,
+   PASS_CONSTANT_VARIABLE,
+   PASS_CONSTANT_FOLDING,
+   PASS_CSE,
+   PASS_ALGEBRAIC,
+   PASS_LOWER_JUMPS,
+   PASS_VEC_INDEX_TO_SWIZZLE,
+   PASS_LOWER_VECTOR_INSERT,
+   PASS_SWIZZLE_SWIZZLE,
+   PASS_NOOP_SWIZZLE,
+   PASS_SPLIT_ARRAYS,
+   PASS_REDUNDANT_JUMPS,
+   PASS_LOOPS,
+   NUM_COMMON_PASSES
+};
+
+} /* anonymous namespace */
+
+ir_pass_manager::ir_pass_manager()
+   : passes_run(0), passes_skipped(0), generation(1),
+     linked(false), uniform_locations_assigned(false),
+     max_unroll_iterations(0), optimize_for_aos(false)
+{
+   STATIC_ASSERT(NUM_COMMON_PASSES <= ARRAY_SIZE(clean_generation));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(clean_generation); i++)
+      clean_generation[i] = 0;
+}
+
+void
+ir_pass_manager::invalidate()
+{
+   generation++;
+}
+
+/**
+ * Returns whether \p pass is known to make no progress on the current IR.
+ */
+bool
+ir_pass_manager::skip(unsigned pass)
+{
+   if (clean_generation[pass] == generation) {
+      passes_skipped++;
+      return true;
+   }
+
+   passes_run++;
+   return false;
+}
+
+/**
+ * Records the result of running \p pass, and returns \p progress.
+ */
+bool
+ir_pass_manager::finish(unsigned pass, bool progress)
+{
+   if (progress)
+      generation++;
+   else
+      clean_generation[pass] = generation;
+
+   return progress;
+}
+
+bool
+ir_pass_manager::run_common_optimization(exec_list *ir, bool linked,
+                                         bool uniform_locations_assigned,
+                                         unsigned max_unroll_iterations,
+                                         const struct gl_shader_compiler_options *options)
+{
+   bool progress = false;
+
+   /* Which passes run, and what they do, depends on these. */
+   if (linked != this->linked ||
+       uniform_locations_assigned != this->uniform_locations_assigned ||
+       max_unroll_iterations != this->max_unroll_iterations ||
+       bool(options->OptimizeForAOS) != this->optimize_for_aos) {
+      this->linked = linked;
+      this->uniform_locations_assigned = uniform_locations_assigned;
+      this->max_unroll_iterations = max_unroll_iterations;
+      this->optimize_for_aos = options->OptimizeForAOS;
+      invalidate();
+   }
+
+#define OPT(ID, PASS, ...)                                              \
+   (!skip(ID) && finish(ID, GLSL_PROFILE(#PASS, PASS(__VA_ARGS__))))
+
+   progress = OPT(PASS_LOWER_INSTRUCTIONS,
+                  lower_instructions, ir, SUB_TO_ADD_NEG) || progress;
+
+   if (linked) {
+      progress = OPT(PASS_FUNCTION_INLINING,
+                     do_function_inlining, ir) || progress;
+      progress = OPT(PASS_DEAD_FUNCTIONS, do_dead_functions, ir) || progress;
+      progress = OPT(PASS_STRUCTURE_SPLITTING,
+                     do_structure_splitting, ir) || progress;
+   }
+   progress = OPT(PASS_IF_SIMPLIFICATION, do_if_simplification, ir) || progress;
+   progress = OPT(PASS_FLATTEN_NESTED_IF_BLOCKS,
+                  opt_flatten_nested_if_blocks, ir) || progress;
+   progress = OPT(PASS_COPY_PROPAGATION, do_copy_propagation, ir) || progress;
+   progress = OPT(PASS_COPY_PROPAGATION_ELEMENTS,
+                  do_copy_propagation_elements, ir) || progress;
+
+   if (options->OptimizeForAOS && !linked)
+      progress = OPT(PASS_FLIP_MATRICES, opt_flip_matrices, ir) || progress;
+
+   if (linked && options->OptimizeForAOS) {
+      progress = OPT(PASS_VECTORIZE, do_vectorize, ir) || progress;
+   }
+
+   if (linked)
+      progress = OPT(PASS_DEAD_CODE,
+                     do_dead_code, ir, uniform_locations_assigned) || progress;
+   else
+      progress = OPT(PASS_DEAD_CODE, do_dead_code_unlinked, ir) || progress;
+   progress = OPT(PASS_DEAD_CODE_LOCAL, do_dead_code_local, ir) || progress;
+   progress = OPT(PASS_TREE_GRAFTING, do_tree_grafting, ir) || progress;
+   progress = OPT(PASS_CONSTANT_PROPAGATION,
+                  do_constant_propagation, ir) || progress;
+   if (linked)
+      progress = OPT(PASS_CONSTANT_VARIABLE,
+                     do_constant_variable, ir) || progress;
+   else
+      progress = OPT(PASS_CONSTANT_VARIABLE,
+                     do_constant_variable_unlinked, ir) || progress;
+   progress = OPT(PASS_CONSTANT_FOLDING, do_constant_folding, ir) || progress;
+   progress = OPT(PASS_CSE, do_cse, ir) || progress;
+   progress = OPT(PASS_ALGEBRAIC, do_algebraic, ir) || progress;
+   progress = OPT(PASS_LOWER_JUMPS, do_lower_jumps, ir) || progress;
+   progress = OPT(PASS_VEC_INDEX_TO_SWIZZLE,
+                  do_vec_index_to_swizzle, ir) || progress;
+   progress = OPT(PASS_LOWER_VECTOR_INSERT,
+                  lower_vector_insert, ir, false) || progress;
+   progress = OPT(PASS_SWIZZLE_SWIZZLE, do_swizzle_swizzle, ir) || progress;
+   progress = OPT(PASS_NOOP_SWIZZLE, do_noop_swizzle, ir) || progress;
+
+   progress = OPT(PASS_SPLIT_ARRAYS,
+                  optimize_split_arrays, ir, linked) || progress;
+   progress = OPT(PASS_REDUNDANT_JUMPS,
+                  optimize_redundant_jumps, ir) || progress;
+
+#undef OPT
+
+   /* The loop analysis only feeds the two loop passes, so the three are
+    * skipped together.
+    */
+   if (!skip(PASS_LOOPS)) {
+      bool loop_progress = false;
+
+      _mesa_glsl_profile_begin();
+      loop_state *ls = analyze_loop_variables(ir);
+      _mesa_glsl_profile_end("analyze_loop_variables", false);
+      if (ls->loop_found) {
+         loop_progress = GLSL_PROFILE("set_loop_controls",
+                                      set_loop_controls(ir, ls));
+         loop_progress = GLSL_PROFILE("unroll_loops",
+                                      unroll_loops(ir, ls,
+                                                   max_unroll_iterations))
+                         || loop_progress;
+      }
+      delete ls;
+
+      progress = finish(PASS_LOOPS, loop_progress) || progress;
+   }
+
+   return progress;
+}
@@ -74,6 +74,7 @@
 #include "link_varyings.h"
 #include "ir_optimization.h"
 #include "ir_rvalue_visitor.h"
+#include "glsl_profile.h"
 
 extern "C" {
 #include "main/shaderobj.h"
@@ -2110,6 +2111,8 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 
    void *mem_ctx = ralloc_context(NULL); // temporary linker context
 
+   _mesa_glsl_profile_begin();
+
    prog->LinkStatus = true; /* All error paths will set this to false */
    prog->Validated = false;
    prog->_Used = false;
@@ -2308,7 +2311,8 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 
       unsigned max_unroll = ctx->ShaderCompilerOptions[i].MaxUnrollIterations;
 
-      while (do_common_optimization(prog->_LinkedShaders[i]->ir, true, false, max_unroll, &ctx->ShaderCompilerOptions[i]))
+      ir_pass_manager pm;
+      while (pm.run_common_optimization(prog->_LinkedShaders[i]->ir, true, false, max_unroll, &ctx->ShaderCompilerOptions[i]))
 	 ;
    }
 
@@ -2506,5 +2510,7 @@ done:
       prog->_LinkedShaders[i]->symbols = NULL;
    }
 
+   _mesa_glsl_profile_end("link", false);
+
    ralloc_free(mem_ctx);
 }
@@ -21,6 +21,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <getopt.h>
+#include <time.h>
 
 /** @file main.cpp
  *
@@ -37,165 +38,11 @@
 #include "program.h"
 #include "loop_analysis.h"
 #include "standalone_scaffolding.h"
+#include "blob.h"
+#include "shader_cache.h"
 
 static int glsl_version = 330;
 
-static void
-initialize_context(struct gl_context *ctx, gl_api api)
-{
-   initialize_context_to_defaults(ctx, api);
-
-   /* The standalone compiler needs to claim support for almost
-    * everything in order to compile the built-in functions.
-    */
-   ctx->Const.GLSLVersion = glsl_version;
-   ctx->Extensions.ARB_ES3_compatibility = true;
-
-   switch (ctx->Const.GLSLVersion) {
-   case 100:
-      ctx->Const.MaxClipPlanes = 0;
-      ctx->Const.MaxCombinedTextureImageUnits = 8;
-      ctx->Const.MaxDrawBuffers = 2;
-      ctx->Const.MinProgramTexelOffset = 0;
-      ctx->Const.MaxProgramTexelOffset = 0;
-      ctx->Const.MaxLights = 0;
-      ctx->Const.MaxTextureCoordUnits = 0;
-      ctx->Const.MaxTextureUnits = 8;
-
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs = 8;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits = 0;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxUniformComponents = 128 * 4;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxInputComponents = 0; /* not used */
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 32;
-
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits =
-         ctx->Const.MaxCombinedTextureImageUnits;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxUniformComponents = 16 * 4;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents =
-         ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxOutputComponents = 0; /* not used */
-
-      ctx->Const.MaxVarying = ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents / 4;
-      break;
-   case 110:
-   case 120:
-      ctx->Const.MaxClipPlanes = 6;
-      ctx->Const.MaxCombinedTextureImageUnits = 2;
-      ctx->Const.MaxDrawBuffers = 1;
-      ctx->Const.MinProgramTexelOffset = 0;
-      ctx->Const.MaxProgramTexelOffset = 0;
-      ctx->Const.MaxLights = 8;
-      ctx->Const.MaxTextureCoordUnits = 2;
-      ctx->Const.MaxTextureUnits = 2;
-
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits = 0;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxUniformComponents = 512;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxInputComponents = 0; /* not used */
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 32;
-
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits =
-         ctx->Const.MaxCombinedTextureImageUnits;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxUniformComponents = 64;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents =
-         ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxOutputComponents = 0; /* not used */
-
-      ctx->Const.MaxVarying = ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents / 4;
-      break;
-   case 130:
-   case 140:
-      ctx->Const.MaxClipPlanes = 8;
-      ctx->Const.MaxCombinedTextureImageUnits = 16;
-      ctx->Const.MaxDrawBuffers = 8;
-      ctx->Const.MinProgramTexelOffset = -8;
-      ctx->Const.MaxProgramTexelOffset = 7;
-      ctx->Const.MaxLights = 8;
-      ctx->Const.MaxTextureCoordUnits = 8;
-      ctx->Const.MaxTextureUnits = 2;
-
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxInputComponents = 0; /* not used */
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 64;
-
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents =
-         ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxOutputComponents = 0; /* not used */
-
-      ctx->Const.MaxVarying = ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents / 4;
-      break;
-   case 150:
-   case 330:
-      ctx->Const.MaxClipPlanes = 8;
-      ctx->Const.MaxDrawBuffers = 8;
-      ctx->Const.MinProgramTexelOffset = -8;
-      ctx->Const.MaxProgramTexelOffset = 7;
-      ctx->Const.MaxLights = 8;
-      ctx->Const.MaxTextureCoordUnits = 8;
-      ctx->Const.MaxTextureUnits = 2;
-
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxInputComponents = 0; /* not used */
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 64;
-
-      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxInputComponents =
-         ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents;
-      ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxOutputComponents = 128;
-
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents =
-         ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxOutputComponents;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxOutputComponents = 0; /* not used */
-
-      ctx->Const.MaxCombinedTextureImageUnits =
-         ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits
-         + ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxTextureImageUnits
-         + ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits;
-
-      ctx->Const.MaxGeometryOutputVertices = 256;
-      ctx->Const.MaxGeometryTotalOutputComponents = 1024;
-
-//      ctx->Const.MaxGeometryVaryingComponents = 64;
-
-      ctx->Const.MaxVarying = 60 / 4;
-      break;
-   case 300:
-      ctx->Const.MaxClipPlanes = 8;
-      ctx->Const.MaxCombinedTextureImageUnits = 32;
-      ctx->Const.MaxDrawBuffers = 4;
-      ctx->Const.MinProgramTexelOffset = -8;
-      ctx->Const.MaxProgramTexelOffset = 7;
-      ctx->Const.MaxLights = 0;
-      ctx->Const.MaxTextureCoordUnits = 0;
-      ctx->Const.MaxTextureUnits = 0;
-
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxUniformComponents = 1024;
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxInputComponents = 0; /* not used */
-      ctx->Const.Program[MESA_SHADER_VERTEX].MaxOutputComponents = 16 * 4;
-
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits = 16;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxUniformComponents = 224;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents = 15 * 4;
-      ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxOutputComponents = 0; /* not used */
-
-      ctx->Const.MaxVarying = ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxInputComponents / 4;
-      break;
-   }
-
-   ctx->Driver.NewShader = _mesa_new_shader;
-}
-
 /* Returned string will have 'ctx' as its ralloc owner. */
 static char *
 load_text_file(void *ctx, const char *file_name)
@@ -243,6 +90,7 @@ int dump_ast = 0;
 int dump_hir = 0;
 int dump_lir = 0;
 int do_link = 0;
+int benchmark_iterations = 0;
 
 const struct option compiler_opts[] = {
    { "dump-ast", no_argument, &dump_ast, 1 },
@@ -250,6 +98,7 @@ const struct option compiler_opts[] = {
    { "dump-lir", no_argument, &dump_lir, 1 },
    { "link",     no_argument, &do_link,  1 },
    { "version",  required_argument, NULL, 'v' },
+   { "benchmark-binary", required_argument, NULL, 'b' },
    { NULL, 0, NULL, 0 }
 };
 
@@ -288,6 +137,75 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
+static double
+get_time(void)
+{
+   struct timespec tv;
+
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Compare the time it takes to compile and link \p prog with the time it
+ * takes to restore the link results from their serialized form.
+ */
+static int
+benchmark_binary(struct gl_context *ctx, struct gl_shader_program *prog,
+                 int iterations)
+{
+   struct blob *binary = blob_create(NULL);
+   struct blob *check = blob_create(NULL);
+   int status = EXIT_SUCCESS;
+
+   if (!_mesa_glsl_serialize_program(binary, ctx, prog)) {
+      printf("Failed to serialize the program.\n");
+      ralloc_free(binary);
+      ralloc_free(check);
+      return EXIT_FAILURE;
+   }
+
+   double start = get_time();
+   for (int i = 0; i < iterations; i++) {
+      for (unsigned j = 0; j < prog->NumShaders; j++)
+         _mesa_glsl_compile_shader(ctx, prog->Shaders[j], false, false);
+      link_shaders(ctx, prog);
+   }
+   const double compile_time = (get_time() - start) / iterations;
+
+   start = get_time();
+   for (int i = 0; i < iterations; i++) {
+      if (!_mesa_glsl_deserialize_program(ctx, prog, binary->data,
+                                          binary->size)) {
+         printf("Failed to deserialize the program.\n");
+         status = EXIT_FAILURE;
+         break;
+      }
+   }
+   const double load_time = (get_time() - start) / iterations;
+
+   /* The restored program must serialize to the same bytes. */
+   if (status == EXIT_SUCCESS &&
+       (!_mesa_glsl_serialize_program(check, ctx, prog) ||
+        check->size != binary->size ||
+        memcmp(check->data, binary->data, binary->size) != 0)) {
+      printf("The restored program differs from the original.\n");
+      status = EXIT_FAILURE;
+   }
+
+   if (status == EXIT_SUCCESS) {
+      printf("binary size:         %u bytes\n", (unsigned) binary->size);
+      printf("compile and link:    %.3f ms\n", compile_time * 1000.0);
+      printf("restore from binary: %.3f ms\n", load_time * 1000.0);
+      printf("speedup:             %.1fx\n", compile_time / load_time);
+   }
+
+   ralloc_free(binary);
+   ralloc_free(check);
+
+   return status;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -321,6 +239,12 @@ main(int argc, char **argv)
             break;
          }
          break;
+      case 'b':
+         benchmark_iterations = strtol(optarg, NULL, 10);
+         if (benchmark_iterations <= 0)
+            usage_fail(argv[0]);
+         do_link = 1;
+         break;
       default:
          break;
       }
@@ -330,7 +254,8 @@ main(int argc, char **argv)
    if (argc <= optind)
       usage_fail(argv[0]);
 
-   initialize_context(ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL_COMPAT);
+   gl_api api = glsl_es ? API_OPENGLES2 : API_OPENGL_COMPAT;
+   initialize_context_for_glsl_version(ctx, api, glsl_version);
 
    struct gl_shader_program *whole_program;
 
@@ -389,6 +314,9 @@ main(int argc, char **argv)
 	 printf("Info log for linking:\n%s\n", whole_program->InfoLog);
    }
 
+   if ((status == EXIT_SUCCESS) && benchmark_iterations > 0)
+      status = benchmark_binary(ctx, whole_program, benchmark_iterations);
+
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       ralloc_free(whole_program->_LinkedShaders[i]);
 
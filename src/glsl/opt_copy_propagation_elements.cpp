@@ -280,6 +280,7 @@ ir_copy_propagation_elements_visitor::handle_rvalue(ir_rvalue **ir)
 					source_chan[2],
 					source_chan[3],
 					chans);
+   this->progress = true;
 
    if (debug) {
       printf("to:\n");
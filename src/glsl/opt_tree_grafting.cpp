@@ -336,7 +336,7 @@ try_tree_grafting(ir_assignment *start,
 	 return v.progress;
    }
 
-   return false;
+   return v.progress;
 }
 
 static void
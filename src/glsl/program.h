@@ -32,6 +32,14 @@ extern void
 _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 			  bool dump_ast, bool dump_hir);
 
+/**
+ * Compile a shader for glCompileShader, skipping the front end when the
+ * shader cache knows that the shader compiles.
+ */
+extern void
+_mesa_glsl_compile_shader_cached(struct gl_context *ctx,
+                                 struct gl_shader *shader);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -39,6 +39,7 @@
 _CRTIMP int _vscprintf(const char *format, va_list argptr);
 #endif
 
+#include "c11/threads.h"
 #include "ralloc.h"
 
 #ifndef va_copy
@@ -75,6 +76,39 @@ typedef struct ralloc_header ralloc_header;
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
 
+static once_flag counter_once = ONCE_FLAG_INIT;
+static tss_t counter_key;
+
+/* set once any thread has asked for its allocations to be counted */
+static int counter_used;
+
+static void
+create_counter_key(void)
+{
+   tss_create(&counter_key, NULL);
+}
+
+void
+ralloc_set_thread_counter(unsigned long *counter)
+{
+   call_once(&counter_once, create_counter_key);
+
+   if (counter)
+      counter_used = 1;
+
+   tss_set(counter_key, counter);
+}
+
+static inline void
+count_allocation(void)
+{
+   if (unlikely(counter_used)) {
+      unsigned long *counter = (unsigned long *) tss_get(counter_key);
+      if (counter)
+         (*counter)++;
+   }
+}
+
 static ralloc_header *
 get_header(const void *ptr)
 {
@@ -116,6 +150,7 @@ ralloc_size(const void *ctx, size_t size)
 
    if (unlikely(block == NULL))
       return NULL;
+   count_allocation();
    info = (ralloc_header *) block;
    parent = ctx != NULL ? get_header(ctx) : NULL;
 
@@ -148,6 +183,7 @@ resize(void *ptr, size_t size)
 
    if (info == NULL)
       return NULL;
+   count_allocation();
 
    /* Update parent and sibling's links to the reallocated node. */
    if (info != old && info->parent != NULL) {
@@ -490,3 +526,227 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
    *start += new_length;
    return true;
 }
+
+/*
+ * Linear allocator
+ *
+ * A linear parent is a chain of buffers ralloc'd from the ralloc context
+ * owning it.  Each buffer starts with a linear_header; children are carved
+ * out of the latest buffer and a new one is added to the chain when it
+ * runs out.  The parent pointer handed out is the first child of the
+ * first buffer, whose header holds the state of the whole chain.
+ */
+
+#define LINEAR_MAGIC 0x11DEA5
+#define LINEAR_ALIGNMENT 8
+#define LINEAR_BUFFER_SIZE 4096
+
+#define ALIGN_LINEAR(size) \
+   (((size) + LINEAR_ALIGNMENT - 1) & ~(size_t) (LINEAR_ALIGNMENT - 1))
+
+struct linear_header
+{
+#ifdef DEBUG
+   /* Used to check that a pointer is a linear parent. */
+   unsigned magic;
+#endif
+
+   /* Bytes used and available in this buffer, header excluded. */
+   size_t offset;
+   size_t size;
+
+   /* The ralloc context the buffers are allocated from. */
+   void *ralloc_parent;
+
+   /* The next buffer of the chain. */
+   struct linear_header *next;
+
+   /* The buffer children are carved out of; only valid in the first. */
+   struct linear_header *latest;
+};
+
+typedef struct linear_header linear_header;
+
+#define LINEAR_HEADER_SIZE ALIGN_LINEAR(sizeof(linear_header))
+
+static linear_header *
+get_linear_header(const void *parent)
+{
+   linear_header *first = (linear_header *) ((char *) parent -
+                                             LINEAR_HEADER_SIZE);
+#ifdef DEBUG
+   assert(first->magic == LINEAR_MAGIC);
+#endif
+   return first;
+}
+
+/* Buffers are at least LINEAR_BUFFER_SIZE bytes, header included. */
+static linear_header *
+create_linear_buffer(void *ralloc_ctx, size_t size)
+{
+   linear_header *buffer;
+
+   if (size < LINEAR_BUFFER_SIZE - LINEAR_HEADER_SIZE)
+      size = LINEAR_BUFFER_SIZE - LINEAR_HEADER_SIZE;
+
+   buffer = ralloc_size(ralloc_ctx, LINEAR_HEADER_SIZE + size);
+   if (unlikely(buffer == NULL))
+      return NULL;
+
+#ifdef DEBUG
+   buffer->magic = LINEAR_MAGIC;
+#endif
+   buffer->offset = 0;
+   buffer->size = size;
+   buffer->ralloc_parent = ralloc_ctx;
+   buffer->next = NULL;
+   buffer->latest = buffer;
+
+   return buffer;
+}
+
+void *
+linear_alloc_child(void *parent, size_t size)
+{
+   linear_header *first = get_linear_header(parent);
+   linear_header *latest = first->latest;
+   void *ptr;
+
+   size = ALIGN_LINEAR(size);
+
+   if (unlikely(latest->offset + size > latest->size)) {
+      linear_header *buffer = create_linear_buffer(first->ralloc_parent,
+                                                   size);
+      if (unlikely(buffer == NULL))
+         return NULL;
+
+      buffer->next = first->next;
+      first->next = buffer;
+
+      /* Keep carving whichever buffer has the most space left, so that a
+       * large block doesn't waste what is left in the latest one.
+       */
+      if (buffer->size - size < latest->size - latest->offset) {
+         buffer->offset = size;
+         return (char *) buffer + LINEAR_HEADER_SIZE;
+      }
+
+      first->latest = buffer;
+      latest = buffer;
+   }
+
+   ptr = (char *) latest + LINEAR_HEADER_SIZE + latest->offset;
+   latest->offset += size;
+   return ptr;
+}
+
+void *
+linear_zalloc_child(void *parent, size_t size)
+{
+   void *ptr = linear_alloc_child(parent, size);
+
+   if (likely(ptr != NULL))
+      memset(ptr, 0, size);
+   return ptr;
+}
+
+void *
+linear_alloc_parent(const void *ralloc_ctx, size_t size)
+{
+   linear_header *first;
+
+   size = ALIGN_LINEAR(size);
+
+   first = create_linear_buffer((void *) ralloc_ctx, size);
+   if (unlikely(first == NULL))
+      return NULL;
+
+   first->offset = size;
+   return (char *) first + LINEAR_HEADER_SIZE;
+}
+
+void *
+linear_zalloc_parent(const void *ralloc_ctx, size_t size)
+{
+   void *ptr = linear_alloc_parent(ralloc_ctx, size);
+
+   if (likely(ptr != NULL))
+      memset(ptr, 0, size);
+   return ptr;
+}
+
+void
+linear_free_parent(void *parent)
+{
+   linear_header *buffer, *next;
+
+   if (unlikely(parent == NULL))
+      return;
+
+   for (buffer = get_linear_header(parent); buffer != NULL; buffer = next) {
+      next = buffer->next;
+      ralloc_free(buffer);
+   }
+}
+
+void
+ralloc_steal_linear_parent(const void *new_ralloc_ctx, void *parent)
+{
+   linear_header *first, *buffer;
+
+   if (unlikely(parent == NULL))
+      return;
+
+   first = get_linear_header(parent);
+   for (buffer = first; buffer != NULL; buffer = buffer->next) {
+      ralloc_steal(new_ralloc_ctx, buffer);
+      buffer->ralloc_parent = (void *) new_ralloc_ctx;
+   }
+}
+
+void *
+ralloc_parent_of_linear_parent(void *parent)
+{
+   return get_linear_header(parent)->ralloc_parent;
+}
+
+char *
+linear_strdup(void *parent, const char *str)
+{
+   size_t n;
+   char *ptr;
+
+   if (unlikely(str == NULL))
+      return NULL;
+
+   n = strlen(str);
+   ptr = linear_alloc_child(parent, n + 1);
+   if (unlikely(ptr == NULL))
+      return NULL;
+
+   memcpy(ptr, str, n + 1);
+   return ptr;
+}
+
+char *
+linear_asprintf(void *parent, const char *fmt, ...)
+{
+   char *ptr;
+   va_list args;
+   va_start(args, fmt);
+   ptr = linear_vasprintf(parent, fmt, args);
+   va_end(args);
+   return ptr;
+}
+
+char *
+linear_vasprintf(void *parent, const char *fmt, va_list args)
+{
+   size_t size = printf_length(fmt, args) + 1;
+
+   char *ptr = linear_alloc_child(parent, size);
+   if (ptr != NULL)
+      vsnprintf(ptr, size, fmt, args);
+
+   return ptr;
+}
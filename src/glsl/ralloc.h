@@ -253,6 +253,12 @@ void *ralloc_autofree_context(void);
  */
 void ralloc_set_destructor(const void *ptr, void(*destructor)(void *));
 
+/**
+ * Make every later allocation by the calling thread increment \p *counter,
+ * or stop counting if \p counter is NULL.  Used for profiling.
+ */
+void ralloc_set_thread_counter(unsigned long *counter);
+
 /// \defgroup array String Functions @{
 /**
  * Duplicate a string, allocating the memory from the given context.
@@ -400,6 +406,75 @@ bool ralloc_asprintf_append (char **str, const char *fmt, ...)
 bool ralloc_vasprintf_append(char **str, const char *fmt, va_list args);
 /// @}
 
+/**
+ * \name Linear allocator
+ *
+ * A linear parent carves its children out of large ralloc'd buffers by
+ * bumping an offset, which is much cheaper than a ralloc_size() per object
+ * when many small objects share a lifetime, like the nodes of an AST.
+ *
+ * The children of a linear parent can't be freed, reparented, resized or
+ * used as ralloc contexts.  They are released together, when the linear
+ * parent is freed with linear_free_parent() or when the ralloc context
+ * owning it is freed.  Their destructors are never called.
+ * @{
+ */
+
+/**
+ * Allocate a linear parent, owned by the ralloc context \p ralloc_ctx.
+ *
+ * The returned pointer is an uninitialized block of \p size bytes, which
+ * may be 0, and is what the linear_*_child functions take as the parent.
+ */
+void *linear_alloc_parent(const void *ralloc_ctx, size_t size);
+
+/**
+ * Like linear_alloc_parent(), but the block is zeroed.
+ */
+void *linear_zalloc_parent(const void *ralloc_ctx, size_t size);
+
+/**
+ * Allocate \p size uninitialized bytes out of the linear parent \p parent.
+ */
+void *linear_alloc_child(void *parent, size_t size);
+
+/**
+ * Like linear_alloc_child(), but the block is zeroed.
+ */
+void *linear_zalloc_child(void *parent, size_t size);
+
+/**
+ * Free a linear parent and all of its children.
+ */
+void linear_free_parent(void *parent);
+
+/**
+ * Move a linear parent, and all of its children, to the ralloc context
+ * \p new_ralloc_ctx.
+ */
+void ralloc_steal_linear_parent(const void *new_ralloc_ctx, void *parent);
+
+/**
+ * Return the ralloc context owning a linear parent.
+ */
+void *ralloc_parent_of_linear_parent(void *parent);
+
+/**
+ * Duplicate a string, allocating the memory out of a linear parent.
+ */
+char *linear_strdup(void *parent, const char *str);
+
+/**
+ * Print to a string allocated out of a linear parent.
+ */
+char *linear_asprintf(void *parent, const char *fmt, ...) PRINTFLIKE(2, 3);
+
+/**
+ * Print to a string allocated out of a linear parent, given a va_list.
+ */
+char *linear_vasprintf(void *parent, const char *fmt, va_list args);
+/// @}
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
@@ -441,5 +516,30 @@ public:                                                                  \
       ralloc_free(p);                                                    \
    }
 
+/**
+ * Declare a C++ new operator which allocates out of a linear parent.
+ *
+ * Placing this macro in the body of a class makes it possible to do:
+ *
+ * TYPE *var = new(linear_parent) TYPE(...);
+ *
+ * The objects can't be deleted, and their destructors are never called,
+ * so TYPE should have a trivial destructor.
+ */
+#define DECLARE_LINEAR_ALLOC_CXX_OPERATORS(TYPE)                         \
+public:                                                                  \
+   static void* operator new(size_t size, void *linear_parent)           \
+   {                                                                     \
+      void *p = linear_alloc_child(linear_parent, size);                 \
+      assert(p != NULL);                                                 \
+      return p;                                                          \
+   }                                                                     \
+                                                                         \
+   static void operator delete(void *p)                                  \
+   {                                                                     \
+      /* The memory is released with the linear parent. */               \
+      (void) p;                                                          \
+   }
+
 
 #endif
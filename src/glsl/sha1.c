@@ -0,0 +1,172 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * A straightforward implementation of SHA-1 (FIPS 180-1).  It is used to
+ * name entries of the on-disk shader cache, not for anything security
+ * related.
+ */
+
+#include <string.h>
+#include "sha1.h"
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void
+sha1_transform(uint32_t state[5], const unsigned char block[64])
+{
+   uint32_t w[80];
+   uint32_t a, b, c, d, e, t;
+   int i;
+
+   for (i = 0; i < 16; i++) {
+      w[i] = ((uint32_t) block[i * 4] << 24) |
+             ((uint32_t) block[i * 4 + 1] << 16) |
+             ((uint32_t) block[i * 4 + 2] << 8) |
+             ((uint32_t) block[i * 4 + 3]);
+   }
+   for (i = 16; i < 80; i++)
+      w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+   a = state[0];
+   b = state[1];
+   c = state[2];
+   d = state[3];
+   e = state[4];
+
+   for (i = 0; i < 80; i++) {
+      if (i < 20)
+         t = ((b & c) | (~b & d)) + 0x5a827999;
+      else if (i < 40)
+         t = (b ^ c ^ d) + 0x6ed9eba1;
+      else if (i < 60)
+         t = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+      else
+         t = (b ^ c ^ d) + 0xca62c1d6;
+
+      t += ROL32(a, 5) + e + w[i];
+      e = d;
+      d = c;
+      c = ROL32(b, 30);
+      b = a;
+      a = t;
+   }
+
+   state[0] += a;
+   state[1] += b;
+   state[2] += c;
+   state[3] += d;
+   state[4] += e;
+}
+
+void
+_mesa_sha1_init(struct mesa_sha1 *ctx)
+{
+   ctx->state[0] = 0x67452301;
+   ctx->state[1] = 0xefcdab89;
+   ctx->state[2] = 0x98badcfe;
+   ctx->state[3] = 0x10325476;
+   ctx->state[4] = 0xc3d2e1f0;
+   ctx->count = 0;
+}
+
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
+{
+   const unsigned char *p = (const unsigned char *) data;
+   unsigned used = (unsigned) (ctx->count & 63);
+
+   ctx->count += size;
+
+   if (used) {
+      unsigned avail = 64 - used;
+
+      if (size < avail) {
+         memcpy(ctx->buffer + used, p, size);
+         return;
+      }
+
+      memcpy(ctx->buffer + used, p, avail);
+      sha1_transform(ctx->state, ctx->buffer);
+      p += avail;
+      size -= avail;
+   }
+
+   while (size >= 64) {
+      sha1_transform(ctx->state, p);
+      p += 64;
+      size -= 64;
+   }
+
+   memcpy(ctx->buffer, p, size);
+}
+
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx,
+                 unsigned char result[MESA_SHA1_DIGEST_LENGTH])
+{
+   const uint64_t bits = ctx->count * 8;
+   unsigned used = (unsigned) (ctx->count & 63);
+   int i;
+
+   ctx->buffer[used++] = 0x80;
+   if (used > 56) {
+      memset(ctx->buffer + used, 0, 64 - used);
+      sha1_transform(ctx->state, ctx->buffer);
+      used = 0;
+   }
+   memset(ctx->buffer + used, 0, 56 - used);
+
+   for (i = 0; i < 8; i++)
+      ctx->buffer[56 + i] = (unsigned char) (bits >> (56 - i * 8));
+   sha1_transform(ctx->state, ctx->buffer);
+
+   for (i = 0; i < MESA_SHA1_DIGEST_LENGTH; i++)
+      result[i] = (unsigned char) (ctx->state[i / 4] >> (24 - (i % 4) * 8));
+}
+
+void
+_mesa_sha1_compute(const void *data, size_t size,
+                   unsigned char result[MESA_SHA1_DIGEST_LENGTH])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, data, size);
+   _mesa_sha1_final(&ctx, result);
+}
+
+void
+_mesa_sha1_format(char *buf, const unsigned char sha1[MESA_SHA1_DIGEST_LENGTH])
+{
+   static const char hex_digits[] = "0123456789abcdef";
+   int i;
+
+   for (i = 0; i < MESA_SHA1_DIGEST_LENGTH; i++) {
+      buf[i * 2] = hex_digits[sha1[i] >> 4];
+      buf[i * 2 + 1] = hex_digits[sha1[i] & 0x0f];
+   }
+   buf[MESA_SHA1_DIGEST_LENGTH * 2] = '\0';
+}
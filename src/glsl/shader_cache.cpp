@@ -0,0 +1,2157 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.cpp
+ *
+ * Binary serialization of linked GLSL programs, and the glue that uses it
+ * to skip the front end and the linker with the help of the disk cache.
+ *
+ * Shaders are identified by a SHA-1 of their source and of everything in
+ * the context that can change how they compile.  When the disk cache knows
+ * that a shader compiles, glCompileShader only records that fact; the
+ * shader is compiled for real when a program using it misses the cache.
+ * Programs are identified by the SHA-1s of their shaders and their
+ * pre-link state, and map to the serialized output of \c link_shaders.
+ *
+ * The serialized form is tied to the build that wrote it: data structures
+ * such as \c ir_variable::data are written verbatim, and the driver build
+ * is part of every key.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_DLOPEN
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+#include "main/core.h"
+#include "main/shaderobj.h"
+#include "c11/threads.h"
+#include "ir.h"
+#include "ir_uniform.h"
+#include "glsl_types.h"
+#include "program.h"
+#include "program/hash_table.h"
+#include "blob.h"
+#include "disk_cache.h"
+#include "sha1.h"
+#include "shader_cache.h"
+
+#define SHADER_CACHE_PROGRAM_MAGIC   0x4c534c47 /* "GLSL" */
+#define SHADER_CACHE_PROGRAM_VERSION 1
+
+namespace {
+
+/* The node tag used for NULL rvalues. */
+const uint8_t null_node = ir_type_unset;
+
+/* Reference tags.  References are written as (id << 1) | new, where the
+ * definition of a new object follows immediately.
+ */
+const uint32_t null_ref = ~0u;
+
+enum type_kind {
+   type_kind_builtin,
+   type_kind_array,
+   type_kind_record,
+   type_kind_interface
+};
+
+/**
+ * Return the table of built-in types, which are referred to by index.
+ */
+const glsl_type *const *
+get_builtin_types(unsigned *count)
+{
+#undef  DECL_TYPE
+#define DECL_TYPE(NAME, ...) glsl_type::NAME##_type,
+#undef  STRUCT_TYPE
+#define STRUCT_TYPE(NAME) glsl_type::struct_##NAME##_type,
+   static const glsl_type *const builtin_types[] = {
+#include "builtin_type_macros.h"
+   };
+#undef DECL_TYPE
+#undef STRUCT_TYPE
+
+   *count = Elements(builtin_types);
+   return builtin_types;
+}
+
+/**
+ * Predicate given to deserialized built-in signatures.  Availability only
+ * matters while compiling, and linked IR is never compiled against again.
+ */
+bool
+always_available(const _mesa_glsl_parse_state *)
+{
+   return true;
+}
+
+
+/**
+ * Writes IR and the types it uses into a blob.
+ *
+ * Types, variables, functions and signatures are written once, at their
+ * first reference, and referred to by a number afterwards.  This also
+ * takes care of references that precede the declaration in the
+ * instruction stream, such as calls to functions defined further down.
+ */
+class ir_serializer {
+public:
+   ir_serializer(struct blob *blob)
+      : blob(blob), num_types(0), num_vars(0), num_funcs(0), num_sigs(0)
+   {
+      this->types = hash_table_ctor(0, hash_table_pointer_hash,
+                                    hash_table_pointer_compare);
+      this->vars = hash_table_ctor(0, hash_table_pointer_hash,
+                                   hash_table_pointer_compare);
+      this->funcs = hash_table_ctor(0, hash_table_pointer_hash,
+                                    hash_table_pointer_compare);
+      this->sigs = hash_table_ctor(0, hash_table_pointer_hash,
+                                   hash_table_pointer_compare);
+   }
+
+   ~ir_serializer()
+   {
+      hash_table_dtor(this->types);
+      hash_table_dtor(this->vars);
+      hash_table_dtor(this->funcs);
+      hash_table_dtor(this->sigs);
+   }
+
+   void write_type(const glsl_type *type);
+   void write_list(exec_list *list);
+   void write_instruction(ir_instruction *ir);
+   void write_rvalue(ir_rvalue *rv);
+
+private:
+   bool write_ref(struct hash_table *ht, unsigned *count, const void *obj);
+   void write_variable(ir_variable *var);
+   void write_function(ir_function *func);
+   void write_signature(ir_function_signature *sig);
+   void write_constant(ir_constant *c);
+   void write_struct_fields(const glsl_type *type);
+
+   struct blob *blob;
+
+   struct hash_table *types;
+   struct hash_table *vars;
+   struct hash_table *funcs;
+   struct hash_table *sigs;
+   unsigned num_types;
+   unsigned num_vars;
+   unsigned num_funcs;
+   unsigned num_sigs;
+};
+
+/**
+ * Write a reference to \c obj.  Returns true if \c obj is seen for the
+ * first time, and its definition must follow.
+ */
+bool
+ir_serializer::write_ref(struct hash_table *ht, unsigned *count,
+                         const void *obj)
+{
+   const intptr_t id = (intptr_t) hash_table_find(ht, obj);
+
+   if (id != 0) {
+      blob_write_uint32(this->blob, (uint32_t) (id - 1) << 1);
+      return false;
+   }
+
+   hash_table_insert(ht, (void *) (intptr_t) (*count + 1), obj);
+   blob_write_uint32(this->blob, (*count << 1) | 1);
+   (*count)++;
+
+   return true;
+}
+
+void
+ir_serializer::write_struct_fields(const glsl_type *type)
+{
+   blob_write_string(this->blob, type->name);
+   blob_write_uint32(this->blob, type->length);
+
+   for (unsigned i = 0; i < type->length; i++) {
+      const glsl_struct_field *field = &type->fields.structure[i];
+
+      write_type(field->type);
+      blob_write_string(this->blob, field->name);
+      blob_write_uint8(this->blob, field->row_major);
+      blob_write_uint32(this->blob, field->location);
+      blob_write_uint8(this->blob, field->interpolation);
+      blob_write_uint8(this->blob, field->centroid);
+      blob_write_uint8(this->blob, field->sample);
+   }
+}
+
+void
+ir_serializer::write_type(const glsl_type *type)
+{
+   if (type == NULL) {
+      blob_write_uint32(this->blob, null_ref);
+      return;
+   }
+
+   if (!write_ref(this->types, &this->num_types, type))
+      return;
+
+   switch (type->base_type) {
+   case GLSL_TYPE_ARRAY:
+      blob_write_uint8(this->blob, type_kind_array);
+      write_type(type->fields.array);
+      blob_write_uint32(this->blob, type->length);
+      return;
+   case GLSL_TYPE_INTERFACE:
+      blob_write_uint8(this->blob, type_kind_interface);
+      blob_write_uint8(this->blob, type->interface_packing);
+      write_struct_fields(type);
+      return;
+   default:
+      break;
+   }
+
+   unsigned count;
+   const glsl_type *const *builtin_types = get_builtin_types(&count);
+
+   for (unsigned i = 0; i < count; i++) {
+      if (builtin_types[i] == type) {
+         blob_write_uint8(this->blob, type_kind_builtin);
+         blob_write_uint32(this->blob, i);
+         return;
+      }
+   }
+
+   assert(type->base_type == GLSL_TYPE_STRUCT);
+   blob_write_uint8(this->blob, type_kind_record);
+   write_struct_fields(type);
+}
+
+void
+ir_serializer::write_constant(ir_constant *c)
+{
+   write_type(c->type);
+
+   if (c->type->is_array()) {
+      for (unsigned i = 0; i < c->type->length; i++)
+         write_constant(c->array_elements[i]);
+   } else if (c->type->is_record()) {
+      foreach_list(node, &c->components)
+         write_constant((ir_constant *) node);
+   } else {
+      blob_write_bytes(this->blob, &c->value, sizeof(c->value));
+   }
+}
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   if (!write_ref(this->vars, &this->num_vars, var))
+      return;
+
+   write_type(var->type);
+   blob_write_string(this->blob, var->name);
+   blob_write_bytes(this->blob, &var->data, sizeof(var->data));
+
+   blob_write_uint32(this->blob, var->num_state_slots);
+   blob_write_bytes(this->blob, var->state_slots,
+                    var->num_state_slots * sizeof(var->state_slots[0]));
+
+   blob_write_string(this->blob, var->warn_extension);
+   write_rvalue(var->constant_value);
+   write_rvalue(var->constant_initializer);
+
+   const glsl_type *ifc = var->get_interface_type();
+   write_type(ifc);
+   if (ifc != NULL) {
+      blob_write_uint8(this->blob, var->max_ifc_array_access != NULL);
+      if (var->max_ifc_array_access != NULL) {
+         blob_write_bytes(this->blob, var->max_ifc_array_access,
+                          ifc->length * sizeof(unsigned));
+      }
+   }
+}
+
+void
+ir_serializer::write_function(ir_function *func)
+{
+   if (write_ref(this->funcs, &this->num_funcs, func))
+      blob_write_string(this->blob, func->name);
+}
+
+void
+ir_serializer::write_signature(ir_function_signature *sig)
+{
+   if (!write_ref(this->sigs, &this->num_sigs, sig))
+      return;
+
+   write_function((ir_function *) sig->function());
+   write_type(sig->return_type);
+   blob_write_uint8(this->blob, sig->is_defined);
+   blob_write_uint8(this->blob, sig->is_intrinsic);
+   blob_write_uint8(this->blob, sig->is_builtin());
+   write_list(&sig->parameters);
+   write_list(&sig->body);
+}
+
+void
+ir_serializer::write_list(exec_list *list)
+{
+   unsigned count = 0;
+
+   foreach_list(node, list)
+      count++;
+
+   blob_write_uint32(this->blob, count);
+
+   foreach_list(node, list)
+      write_instruction((ir_instruction *) node);
+}
+
+void
+ir_serializer::write_rvalue(ir_rvalue *rv)
+{
+   if (rv == NULL)
+      blob_write_uint8(this->blob, null_node);
+   else
+      write_instruction(rv);
+}
+
+void
+ir_serializer::write_instruction(ir_instruction *ir)
+{
+   blob_write_uint8(this->blob, ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_variable:
+      write_variable((ir_variable *) ir);
+      break;
+
+   case ir_type_function: {
+      ir_function *func = (ir_function *) ir;
+      unsigned count = 0;
+
+      write_function(func);
+
+      foreach_list(node, &func->signatures)
+         count++;
+      blob_write_uint32(this->blob, count);
+      foreach_list(node, &func->signatures)
+         write_signature((ir_function_signature *) node);
+      break;
+   }
+
+   case ir_type_assignment: {
+      ir_assignment *assign = (ir_assignment *) ir;
+
+      write_rvalue(assign->lhs);
+      write_rvalue(assign->rhs);
+      write_rvalue(assign->condition);
+      blob_write_uint32(this->blob, assign->write_mask);
+      break;
+   }
+
+   case ir_type_call: {
+      ir_call *call = (ir_call *) ir;
+
+      write_signature(call->callee);
+      write_rvalue(call->return_deref);
+      write_list(&call->actual_parameters);
+      blob_write_uint8(this->blob, call->use_builtin);
+      break;
+   }
+
+   case ir_type_if: {
+      ir_if *iif = (ir_if *) ir;
+
+      write_rvalue(iif->condition);
+      write_list(&iif->then_instructions);
+      write_list(&iif->else_instructions);
+      break;
+   }
+
+   case ir_type_loop:
+      write_list(&((ir_loop *) ir)->body_instructions);
+      break;
+
+   case ir_type_loop_jump:
+      blob_write_uint8(this->blob, ((ir_loop_jump *) ir)->mode);
+      break;
+
+   case ir_type_return:
+      write_rvalue(((ir_return *) ir)->value);
+      break;
+
+   case ir_type_discard:
+      write_rvalue(((ir_discard *) ir)->condition);
+      break;
+
+   case ir_type_emit_vertex:
+   case ir_type_end_primitive:
+      break;
+
+   case ir_type_expression: {
+      ir_expression *expr = (ir_expression *) ir;
+
+      write_type(expr->type);
+      blob_write_uint32(this->blob, expr->operation);
+      for (unsigned i = 0; i < Elements(expr->operands); i++)
+         write_rvalue(expr->operands[i]);
+      break;
+   }
+
+   case ir_type_texture: {
+      ir_texture *tex = (ir_texture *) ir;
+
+      blob_write_uint32(this->blob, tex->op);
+      write_type(tex->type);
+      write_rvalue(tex->sampler);
+      write_rvalue(tex->coordinate);
+      write_rvalue(tex->projector);
+      write_rvalue(tex->shadow_comparitor);
+      write_rvalue(tex->offset);
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+         break;
+      case ir_txb:
+         write_rvalue(tex->lod_info.bias);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         write_rvalue(tex->lod_info.lod);
+         break;
+      case ir_txf_ms:
+         write_rvalue(tex->lod_info.sample_index);
+         break;
+      case ir_txd:
+         write_rvalue(tex->lod_info.grad.dPdx);
+         write_rvalue(tex->lod_info.grad.dPdy);
+         break;
+      case ir_tg4:
+         write_rvalue(tex->lod_info.component);
+         break;
+      }
+      break;
+   }
+
+   case ir_type_swizzle: {
+      ir_swizzle *swiz = (ir_swizzle *) ir;
+
+      blob_write_bytes(this->blob, &swiz->mask, sizeof(swiz->mask));
+      write_rvalue(swiz->val);
+      break;
+   }
+
+   case ir_type_dereference_variable:
+      write_variable(((ir_dereference_variable *) ir)->var);
+      break;
+
+   case ir_type_dereference_array: {
+      ir_dereference_array *deref = (ir_dereference_array *) ir;
+
+      write_rvalue(deref->array);
+      write_rvalue(deref->array_index);
+      break;
+   }
+
+   case ir_type_dereference_record: {
+      ir_dereference_record *deref = (ir_dereference_record *) ir;
+
+      write_rvalue(deref->record);
+      blob_write_string(this->blob, deref->field);
+      break;
+   }
+
+   case ir_type_constant:
+      write_constant((ir_constant *) ir);
+      break;
+
+   case ir_type_function_signature:
+   case ir_type_unset:
+   case ir_type_max:
+      assert(!"Unexpected IR node");
+      break;
+   }
+}
+
+
+/**
+ * Reads back IR written by \c ir_serializer.
+ *
+ * Nothing read from the blob is trusted: every tag, index and enum is
+ * checked, and any inconsistency sets \c failed.  Nodes created before a
+ * failure are left to be freed with \c mem_ctx.
+ */
+class ir_deserializer {
+public:
+   ir_deserializer(struct blob_reader *blob, void *mem_ctx)
+      : mem_ctx(mem_ctx), blob(blob), failed(false)
+   {
+      memset(this->tables, 0, sizeof(this->tables));
+   }
+
+   ~ir_deserializer()
+   {
+      for (unsigned i = 0; i < Elements(this->tables); i++)
+         free(this->tables[i].objects);
+   }
+
+   bool has_failed() const
+   {
+      return this->failed || this->blob->overrun;
+   }
+
+   const glsl_type *read_type();
+   bool read_list(exec_list *list);
+   ir_instruction *read_instruction();
+   ir_rvalue *read_rvalue();
+
+   void *mem_ctx;
+
+private:
+   enum table_index {
+      table_types,
+      table_vars,
+      table_funcs,
+      table_sigs,
+      num_tables
+   };
+
+   struct object_table {
+      void **objects;
+      unsigned count;
+      unsigned size;
+   };
+
+   ir_instruction *read_instruction(uint8_t type);
+   bool read_ref(enum table_index table, void **obj);
+   bool resolve_ref(enum table_index table, uint32_t ref, void **obj);
+   void add_object(enum table_index table, void *obj);
+   void fail();
+
+   bool read_struct_fields(glsl_struct_field **fields, unsigned *length,
+                           const char **name);
+   const glsl_type *read_new_type();
+   ir_variable *read_variable();
+   ir_function *read_function();
+   ir_function_signature *read_signature();
+   ir_constant *read_constant();
+   ir_dereference *read_dereference();
+
+   struct blob_reader *blob;
+   struct object_table tables[num_tables];
+   bool failed;
+};
+
+void
+ir_deserializer::fail()
+{
+   this->failed = true;
+}
+
+void
+ir_deserializer::add_object(enum table_index table, void *obj)
+{
+   struct object_table *t = &this->tables[table];
+
+   if (t->count == t->size) {
+      const unsigned size = t->size ? t->size * 2 : 64;
+      void **objects = (void **) realloc(t->objects, size * sizeof(void *));
+
+      if (objects == NULL) {
+         fail();
+         return;
+      }
+
+      t->objects = objects;
+      t->size = size;
+   }
+
+   t->objects[t->count++] = obj;
+}
+
+/**
+ * Read a reference.  Returns true if a new object has to be read, which
+ * the caller must register with \c add_object before reading anything
+ * else that might refer to it.
+ */
+bool
+ir_deserializer::read_ref(enum table_index table, void **obj)
+{
+   return resolve_ref(table, blob_read_uint32(this->blob), obj);
+}
+
+bool
+ir_deserializer::resolve_ref(enum table_index table, uint32_t ref, void **obj)
+{
+   const unsigned id = ref >> 1;
+
+   *obj = NULL;
+
+   if (has_failed())
+      return false;
+
+   if (ref & 1) {
+      if (id != this->tables[table].count) {
+         fail();
+         return false;
+      }
+      return true;
+   }
+
+   if (id >= this->tables[table].count) {
+      fail();
+      return false;
+   }
+
+   *obj = this->tables[table].objects[id];
+   return false;
+}
+
+bool
+ir_deserializer::read_struct_fields(glsl_struct_field **fields,
+                                    unsigned *length, const char **name)
+{
+   *name = blob_read_string(this->blob, this->mem_ctx);
+   *length = blob_read_uint32(this->blob);
+
+   if (has_failed() || *name == NULL ||
+       *length > (size_t) (this->blob->end - this->blob->current)) {
+      fail();
+      return false;
+   }
+
+   *fields = ralloc_array(this->mem_ctx, glsl_struct_field, *length);
+
+   for (unsigned i = 0; i < *length; i++) {
+      glsl_struct_field *field = &(*fields)[i];
+
+      field->type = read_type();
+      field->name = blob_read_string(this->blob, this->mem_ctx);
+      field->row_major = blob_read_uint8(this->blob);
+      field->location = blob_read_uint32(this->blob);
+      field->interpolation = blob_read_uint8(this->blob);
+      field->centroid = blob_read_uint8(this->blob);
+      field->sample = blob_read_uint8(this->blob);
+
+      if (has_failed() || field->type == NULL || field->name == NULL) {
+         fail();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+const glsl_type *
+ir_deserializer::read_new_type()
+{
+   const uint8_t kind = blob_read_uint8(this->blob);
+   glsl_struct_field *fields;
+   const char *name;
+   unsigned length;
+
+   switch (kind) {
+   case type_kind_builtin: {
+      const uint32_t index = blob_read_uint32(this->blob);
+      unsigned count;
+      const glsl_type *const *builtin_types = get_builtin_types(&count);
+
+      if (index >= count)
+         break;
+      return builtin_types[index];
+   }
+
+   case type_kind_array: {
+      const glsl_type *element = read_type();
+      const uint32_t elements = blob_read_uint32(this->blob);
+
+      if (element == NULL)
+         break;
+      return glsl_type::get_array_instance(element, elements);
+   }
+
+   case type_kind_interface: {
+      const uint8_t packing = blob_read_uint8(this->blob);
+
+      if (packing > GLSL_INTERFACE_PACKING_PACKED ||
+          !read_struct_fields(&fields, &length, &name))
+         break;
+      return glsl_type::get_interface_instance(fields, length,
+                                               (glsl_interface_packing) packing,
+                                               name);
+   }
+
+   case type_kind_record:
+      if (!read_struct_fields(&fields, &length, &name))
+         break;
+      return glsl_type::get_record_instance(fields, length, name);
+
+   default:
+      break;
+   }
+
+   fail();
+   return NULL;
+}
+
+const glsl_type *
+ir_deserializer::read_type()
+{
+   const uint32_t ref = blob_read_uint32(this->blob);
+   void *obj;
+
+   if (ref == null_ref)
+      return NULL;
+
+   if (!resolve_ref(table_types, ref, &obj))
+      return (const glsl_type *) obj;
+
+   /* The type has to be registered before reading its definition, which
+    * can refer to other new types.  Reserve its slot.
+    */
+   const unsigned id = this->tables[table_types].count;
+   add_object(table_types, NULL);
+
+   const glsl_type *type = read_new_type();
+   if (type != NULL && id < this->tables[table_types].count)
+      this->tables[table_types].objects[id] = (void *) type;
+
+   return type;
+}
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = read_type();
+
+   if (type == NULL || has_failed()) {
+      fail();
+      return NULL;
+   }
+
+   if (type->is_array() || type->is_record()) {
+      const unsigned count = type->length;
+      exec_list values;
+
+      for (unsigned i = 0; i < count; i++) {
+         ir_constant *value = read_constant();
+
+         if (value == NULL)
+            return NULL;
+         values.push_tail(value);
+      }
+
+      return new(this->mem_ctx) ir_constant(type, &values);
+   }
+
+   if (!type->is_scalar() && !type->is_vector() && !type->is_matrix()) {
+      fail();
+      return NULL;
+   }
+
+   ir_constant_data data;
+   blob_copy_bytes(this->blob, &data, sizeof(data));
+
+   return new(this->mem_ctx) ir_constant(type, &data);
+}
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   void *obj;
+
+   if (!read_ref(table_vars, &obj))
+      return (ir_variable *) obj;
+
+   const glsl_type *type = read_type();
+   const char *name = blob_read_string(this->blob, this->mem_ctx);
+
+   if (has_failed() || type == NULL) {
+      fail();
+      return NULL;
+   }
+
+   ir_variable *var =
+      new(this->mem_ctx) ir_variable(type, name, ir_var_temporary);
+   add_object(table_vars, var);
+
+   blob_copy_bytes(this->blob, &var->data, sizeof(var->data));
+
+   var->num_state_slots = blob_read_uint32(this->blob);
+   if (var->num_state_slots > 0) {
+      const size_t size = var->num_state_slots * sizeof(ir_state_slot);
+      const void *slots = blob_read_bytes(this->blob, size);
+
+      if (slots == NULL) {
+         fail();
+         return NULL;
+      }
+
+      var->state_slots = ralloc_array(var, ir_state_slot,
+                                      var->num_state_slots);
+      memcpy(var->state_slots, slots, size);
+   }
+
+   var->warn_extension = blob_read_string(this->blob, var);
+   var->constant_value = (ir_constant *) read_rvalue();
+   var->constant_initializer = (ir_constant *) read_rvalue();
+
+   if ((var->constant_value != NULL &&
+        var->constant_value->ir_type != ir_type_constant) ||
+       (var->constant_initializer != NULL &&
+        var->constant_initializer->ir_type != ir_type_constant)) {
+      fail();
+      return NULL;
+   }
+
+   const glsl_type *ifc = read_type();
+   if (ifc != NULL) {
+      if (var->get_interface_type() == NULL)
+         var->init_interface_type(ifc);
+      else
+         var->change_interface_type(ifc);
+
+      if (blob_read_uint8(this->blob)) {
+         const size_t size = ifc->length * sizeof(unsigned);
+         const void *access = blob_read_bytes(this->blob, size);
+
+         if (access == NULL) {
+            fail();
+            return NULL;
+         }
+
+         if (var->max_ifc_array_access == NULL)
+            var->max_ifc_array_access = rzalloc_array(var, unsigned,
+                                                      ifc->length);
+         memcpy(var->max_ifc_array_access, access, size);
+      }
+   }
+
+   return has_failed() ? NULL : var;
+}
+
+ir_function *
+ir_deserializer::read_function()
+{
+   void *obj;
+
+   if (!read_ref(table_funcs, &obj))
+      return (ir_function *) obj;
+
+   const char *name = blob_read_string(this->blob, this->mem_ctx);
+   if (has_failed() || name == NULL) {
+      fail();
+      return NULL;
+   }
+
+   ir_function *func = new(this->mem_ctx) ir_function(name);
+   add_object(table_funcs, func);
+
+   return func;
+}
+
+ir_function_signature *
+ir_deserializer::read_signature()
+{
+   void *obj;
+
+   if (!read_ref(table_sigs, &obj))
+      return (ir_function_signature *) obj;
+
+   /* Register the signature before reading its body, so that the function
+    * pointer is known in case of (invalid, but harmless) recursion.
+    */
+   const unsigned id = this->tables[table_sigs].count;
+   add_object(table_sigs, NULL);
+
+   ir_function *func = read_function();
+   const glsl_type *return_type = read_type();
+   const bool is_defined = blob_read_uint8(this->blob);
+   const bool is_intrinsic = blob_read_uint8(this->blob);
+   const bool is_builtin = blob_read_uint8(this->blob);
+
+   if (has_failed() || func == NULL || return_type == NULL) {
+      fail();
+      return NULL;
+   }
+
+   ir_function_signature *sig =
+      new(this->mem_ctx) ir_function_signature(return_type,
+                                               is_builtin ? always_available
+                                                          : NULL);
+   this->tables[table_sigs].objects[id] = sig;
+
+   sig->is_defined = is_defined;
+   sig->is_intrinsic = is_intrinsic;
+   func->add_signature(sig);
+
+   if (!read_list(&sig->parameters) || !read_list(&sig->body))
+      return NULL;
+
+   return sig;
+}
+
+bool
+ir_deserializer::read_list(exec_list *list)
+{
+   const uint32_t count = blob_read_uint32(this->blob);
+
+   /* Every node takes at least one byte. */
+   if (has_failed() ||
+       count > (size_t) (this->blob->end - this->blob->current)) {
+      fail();
+      return false;
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      ir_instruction *ir = read_instruction();
+
+      if (ir == NULL) {
+         fail();
+         return false;
+      }
+
+      /* A variable is declared only once; a second appearance in a list
+       * would corrupt the first one.
+       */
+      if (ir->next != NULL) {
+         fail();
+         return false;
+      }
+
+      list->push_tail(ir);
+   }
+
+   return true;
+}
+
+ir_rvalue *
+ir_deserializer::read_rvalue()
+{
+   const uint8_t type = blob_read_uint8(this->blob);
+
+   if (type == null_node)
+      return NULL;
+
+   ir_instruction *ir = read_instruction(type);
+   if (ir == NULL)
+      return NULL;
+
+   ir_rvalue *rv = ir->as_rvalue();
+   if (rv == NULL)
+      fail();
+
+   return rv;
+}
+
+ir_dereference *
+ir_deserializer::read_dereference()
+{
+   ir_rvalue *rv = read_rvalue();
+   ir_dereference *deref = rv ? rv->as_dereference() : NULL;
+
+   if (deref == NULL)
+      fail();
+
+   return deref;
+}
+
+ir_instruction *
+ir_deserializer::read_instruction()
+{
+   return read_instruction(blob_read_uint8(this->blob));
+}
+
+ir_instruction *
+ir_deserializer::read_instruction(uint8_t type)
+{
+   if (has_failed())
+      return NULL;
+
+   switch (type) {
+   case ir_type_variable:
+      return read_variable();
+
+   case ir_type_function: {
+      ir_function *func = read_function();
+      const uint32_t count = blob_read_uint32(this->blob);
+
+      if (func == NULL ||
+          count > (size_t) (this->blob->end - this->blob->current))
+         break;
+
+      for (unsigned i = 0; i < count; i++) {
+         if (read_signature() == NULL)
+            return NULL;
+      }
+
+      /* The function may have been created by an earlier call, but it is
+       * never declared twice.
+       */
+      if (func->next != NULL)
+         break;
+      return func;
+   }
+
+   case ir_type_assignment: {
+      ir_dereference *lhs = read_dereference();
+      ir_rvalue *rhs = read_rvalue();
+      ir_rvalue *condition = read_rvalue();
+      const uint32_t write_mask = blob_read_uint32(this->blob);
+
+      if (has_failed() || lhs == NULL || rhs == NULL)
+         break;
+      return new(this->mem_ctx) ir_assignment(lhs, rhs, condition,
+                                              write_mask);
+   }
+
+   case ir_type_call: {
+      ir_function_signature *callee = read_signature();
+      ir_rvalue *return_value = read_rvalue();
+      exec_list parameters;
+
+      if (callee == NULL || !read_list(&parameters))
+         break;
+
+      ir_dereference_variable *return_deref = NULL;
+      if (return_value != NULL) {
+         return_deref = return_value->as_dereference_variable();
+         if (return_deref == NULL)
+            break;
+      }
+
+      ir_call *call = new(this->mem_ctx) ir_call(callee, return_deref,
+                                                 &parameters);
+      call->use_builtin = blob_read_uint8(this->blob);
+      return call;
+   }
+
+   case ir_type_if: {
+      ir_rvalue *condition = read_rvalue();
+
+      if (condition == NULL)
+         break;
+
+      ir_if *iif = new(this->mem_ctx) ir_if(condition);
+      if (!read_list(&iif->then_instructions) ||
+          !read_list(&iif->else_instructions))
+         break;
+      return iif;
+   }
+
+   case ir_type_loop: {
+      ir_loop *loop = new(this->mem_ctx) ir_loop();
+
+      if (!read_list(&loop->body_instructions))
+         break;
+      return loop;
+   }
+
+   case ir_type_loop_jump: {
+      const uint8_t mode = blob_read_uint8(this->blob);
+
+      if (mode > ir_loop_jump::jump_continue)
+         break;
+      return new(this->mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+
+   case ir_type_return: {
+      ir_rvalue *value = read_rvalue();
+
+      if (has_failed())
+         break;
+      return value ? new(this->mem_ctx) ir_return(value)
+                   : new(this->mem_ctx) ir_return();
+   }
+
+   case ir_type_discard: {
+      ir_rvalue *condition = read_rvalue();
+
+      if (has_failed())
+         break;
+      return new(this->mem_ctx) ir_discard(condition);
+   }
+
+   case ir_type_emit_vertex:
+      return new(this->mem_ctx) ir_emit_vertex();
+
+   case ir_type_end_primitive:
+      return new(this->mem_ctx) ir_end_primitive();
+
+   case ir_type_expression: {
+      const glsl_type *expr_type = read_type();
+      const uint32_t op = blob_read_uint32(this->blob);
+      ir_rvalue *operands[4];
+
+      for (unsigned i = 0; i < Elements(operands); i++)
+         operands[i] = read_rvalue();
+
+      if (has_failed() || expr_type == NULL || op > ir_last_opcode ||
+          operands[0] == NULL)
+         break;
+      return new(this->mem_ctx) ir_expression(op, expr_type,
+                                              operands[0], operands[1],
+                                              operands[2], operands[3]);
+   }
+
+   case ir_type_texture: {
+      const uint32_t op = blob_read_uint32(this->blob);
+
+      if (op > ir_query_levels)
+         break;
+
+      ir_texture *tex = new(this->mem_ctx) ir_texture((ir_texture_opcode) op);
+      tex->type = read_type();
+      tex->sampler = read_dereference();
+      tex->coordinate = read_rvalue();
+      tex->projector = read_rvalue();
+      tex->shadow_comparitor = read_rvalue();
+      tex->offset = read_rvalue();
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+         break;
+      case ir_txb:
+         tex->lod_info.bias = read_rvalue();
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         tex->lod_info.lod = read_rvalue();
+         break;
+      case ir_txf_ms:
+         tex->lod_info.sample_index = read_rvalue();
+         break;
+      case ir_txd:
+         tex->lod_info.grad.dPdx = read_rvalue();
+         tex->lod_info.grad.dPdy = read_rvalue();
+         break;
+      case ir_tg4:
+         tex->lod_info.component = read_rvalue();
+         break;
+      }
+
+      if (has_failed() || tex->type == NULL)
+         break;
+      return tex;
+   }
+
+   case ir_type_swizzle: {
+      ir_swizzle_mask mask;
+
+      blob_copy_bytes(this->blob, &mask, sizeof(mask));
+      ir_rvalue *val = read_rvalue();
+
+      if (has_failed() || val == NULL)
+         break;
+      return new(this->mem_ctx) ir_swizzle(val, mask);
+   }
+
+   case ir_type_dereference_variable: {
+      ir_variable *var = read_variable();
+
+      if (var == NULL)
+         break;
+      return new(this->mem_ctx) ir_dereference_variable(var);
+   }
+
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue();
+      ir_rvalue *index = read_rvalue();
+
+      if (has_failed() || array == NULL || index == NULL)
+         break;
+      return new(this->mem_ctx) ir_dereference_array(array, index);
+   }
+
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue();
+      const char *field = blob_read_string(this->blob, this->mem_ctx);
+
+      if (has_failed() || record == NULL || field == NULL ||
+          record->type->field_index(field) < 0)
+         break;
+      return new(this->mem_ctx) ir_dereference_record(record, field);
+   }
+
+   case ir_type_constant:
+      return read_constant();
+
+   default:
+      break;
+   }
+
+   fail();
+   return NULL;
+}
+
+
+void
+write_uniform_blocks(struct blob *blob, ir_serializer *s,
+                     const struct gl_uniform_block *blocks,
+                     unsigned num_blocks)
+{
+   blob_write_uint32(blob, num_blocks);
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      const struct gl_uniform_block *block = &blocks[i];
+
+      blob_write_string(blob, block->Name);
+      blob_write_uint32(blob, block->Binding);
+      blob_write_uint32(blob, block->UniformBufferSize);
+      blob_write_uint32(blob, block->_Packing);
+      blob_write_uint32(blob, block->NumUniforms);
+
+      for (unsigned j = 0; j < block->NumUniforms; j++) {
+         const struct gl_uniform_buffer_variable *var = &block->Uniforms[j];
+
+         blob_write_string(blob, var->Name);
+         blob_write_uint8(blob, var->IndexName == var->Name);
+         if (var->IndexName != var->Name)
+            blob_write_string(blob, var->IndexName);
+         s->write_type(var->Type);
+         blob_write_uint32(blob, var->Offset);
+         blob_write_uint8(blob, var->RowMajor);
+      }
+   }
+}
+
+bool
+read_uniform_blocks(struct blob_reader *blob, ir_deserializer *d,
+                    void *mem_ctx, struct gl_uniform_block **blocks_ret,
+                    unsigned *num_blocks_ret)
+{
+   const uint32_t num_blocks = blob_read_uint32(blob);
+
+   *blocks_ret = NULL;
+   *num_blocks_ret = 0;
+
+   if (blob->overrun || num_blocks > (size_t) (blob->end - blob->current))
+      return false;
+
+   if (num_blocks == 0)
+      return true;
+
+   struct gl_uniform_block *blocks =
+      rzalloc_array(mem_ctx, struct gl_uniform_block, num_blocks);
+
+   *blocks_ret = blocks;
+   *num_blocks_ret = num_blocks;
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      struct gl_uniform_block *block = &blocks[i];
+
+      block->Name = blob_read_string(blob, blocks);
+      block->Binding = blob_read_uint32(blob);
+      block->UniformBufferSize = blob_read_uint32(blob);
+      block->_Packing = (gl_uniform_block_packing) blob_read_uint32(blob);
+      block->NumUniforms = blob_read_uint32(blob);
+
+      if (blob->overrun || block->Name == NULL ||
+          block->NumUniforms > (size_t) (blob->end - blob->current))
+         return false;
+
+      block->Uniforms = rzalloc_array(blocks, struct gl_uniform_buffer_variable,
+                                      block->NumUniforms);
+
+      for (unsigned j = 0; j < block->NumUniforms; j++) {
+         struct gl_uniform_buffer_variable *var = &block->Uniforms[j];
+
+         var->Name = blob_read_string(blob, blocks);
+         if (blob_read_uint8(blob))
+            var->IndexName = var->Name;
+         else
+            var->IndexName = blob_read_string(blob, blocks);
+         var->Type = d->read_type();
+         var->Offset = blob_read_uint32(blob);
+         var->RowMajor = blob_read_uint8(blob);
+
+         if (d->has_failed() || var->Name == NULL || var->IndexName == NULL ||
+             var->Type == NULL)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+void
+write_uniform_storage(struct blob *blob, ir_serializer *s,
+                      struct gl_shader_program *prog)
+{
+   unsigned num_values = 0;
+
+   blob_write_uint32(blob, prog->NumUserUniformStorage);
+   if (prog->NumUserUniformStorage == 0)
+      return;
+
+   /* All values live in a single array allocated by the linker. */
+   const union gl_constant_value *values = prog->UniformStorage[0].storage;
+
+   for (unsigned i = 0; i < prog->NumUserUniformStorage; i++) {
+      const struct gl_uniform_storage *uni = &prog->UniformStorage[i];
+      const unsigned slots =
+         uni->type->component_slots() * MAX2(uni->array_elements, 1);
+
+      assert(uni->storage >= values);
+      num_values = MAX2(num_values, (unsigned) (uni->storage - values) + slots);
+   }
+
+   blob_write_uint32(blob, num_values);
+   blob_write_bytes(blob, values, num_values * sizeof(values[0]));
+
+   for (unsigned i = 0; i < prog->NumUserUniformStorage; i++) {
+      const struct gl_uniform_storage *uni = &prog->UniformStorage[i];
+
+      blob_write_string(blob, uni->name);
+      s->write_type(uni->type);
+      blob_write_uint32(blob, uni->array_elements);
+      blob_write_uint8(blob, uni->initialized);
+      blob_write_bytes(blob, uni->sampler, sizeof(uni->sampler));
+      blob_write_uint32(blob, uni->storage - values);
+      blob_write_uint32(blob, uni->block_index);
+      blob_write_uint32(blob, uni->offset);
+      blob_write_uint32(blob, uni->matrix_stride);
+      blob_write_uint32(blob, uni->array_stride);
+      blob_write_uint8(blob, uni->row_major);
+      blob_write_uint32(blob, uni->atomic_buffer_index);
+   }
+}
+
+bool
+read_uniform_storage(struct blob_reader *blob, ir_deserializer *d,
+                     struct gl_shader_program *prog)
+{
+   const uint32_t num_uniforms = blob_read_uint32(blob);
+
+   if (blob->overrun || num_uniforms > (size_t) (blob->end - blob->current))
+      return false;
+
+   prog->UniformHash = new string_to_uint_map;
+
+   if (num_uniforms == 0)
+      return true;
+
+   const uint32_t num_values = blob_read_uint32(blob);
+   const void *data = blob_read_bytes(blob,
+                                      num_values * sizeof(gl_constant_value));
+   if (data == NULL || num_values > (size_t) (blob->end - blob->data))
+      return false;
+
+   struct gl_uniform_storage *uniforms =
+      rzalloc_array(prog, struct gl_uniform_storage, num_uniforms);
+   union gl_constant_value *values =
+      rzalloc_array(uniforms, union gl_constant_value, num_values);
+
+   memcpy(values, data, num_values * sizeof(values[0]));
+
+   prog->UniformStorage = uniforms;
+   prog->NumUserUniformStorage = num_uniforms;
+
+   for (unsigned i = 0; i < num_uniforms; i++) {
+      struct gl_uniform_storage *uni = &uniforms[i];
+
+      uni->name = blob_read_string(blob, uniforms);
+      uni->type = d->read_type();
+      uni->array_elements = blob_read_uint32(blob);
+      uni->initialized = blob_read_uint8(blob);
+      blob_copy_bytes(blob, uni->sampler, sizeof(uni->sampler));
+      const uint32_t offset = blob_read_uint32(blob);
+      uni->block_index = blob_read_uint32(blob);
+      uni->offset = blob_read_uint32(blob);
+      uni->matrix_stride = blob_read_uint32(blob);
+      uni->array_stride = blob_read_uint32(blob);
+      uni->row_major = blob_read_uint8(blob);
+      uni->atomic_buffer_index = blob_read_uint32(blob);
+
+      if (d->has_failed() || uni->name == NULL || uni->type == NULL ||
+          offset > num_values ||
+          uni->type->component_slots() * MAX2(uni->array_elements, 1) >
+          num_values - offset)
+         return false;
+
+      uni->storage = &values[offset];
+      prog->UniformHash->put(i, uni->name);
+   }
+
+   return true;
+}
+
+void
+write_linked_shader(struct blob *blob, ir_serializer *s,
+                    struct gl_shader *sh)
+{
+   blob_write_uint32(blob, sh->Type);
+   blob_write_uint8(blob, sh->uses_gl_fragcoord);
+   blob_write_uint8(blob, sh->redeclares_gl_fragcoord);
+   blob_write_uint8(blob, sh->origin_upper_left);
+   blob_write_uint8(blob, sh->pixel_center_integer);
+   blob_write_bytes(blob, &sh->Geom, sizeof(sh->Geom));
+
+   blob_write_uint32(blob, sh->num_samplers);
+   blob_write_uint32(blob, sh->active_samplers);
+   blob_write_uint32(blob, sh->shadow_samplers);
+   blob_write_bytes(blob, sh->SamplerUnits, sizeof(sh->SamplerUnits));
+   blob_write_bytes(blob, sh->SamplerTargets, sizeof(sh->SamplerTargets));
+   blob_write_uint32(blob, sh->num_uniform_components);
+   blob_write_uint32(blob, sh->num_combined_uniform_components);
+
+   write_uniform_blocks(blob, s, sh->UniformBlocks, sh->NumUniformBlocks);
+
+   s->write_list(sh->ir);
+}
+
+struct gl_shader *
+read_linked_shader(struct blob_reader *blob, struct gl_context *ctx,
+                   gl_shader_stage stage)
+{
+   const GLenum type = blob_read_uint32(blob);
+
+   if (blob->overrun || _mesa_shader_enum_to_shader_stage(type) != stage)
+      return NULL;
+
+   struct gl_shader *sh = ctx->Driver.NewShader(NULL, 0, type);
+   if (sh == NULL)
+      return NULL;
+
+   sh->uses_gl_fragcoord = blob_read_uint8(blob);
+   sh->redeclares_gl_fragcoord = blob_read_uint8(blob);
+   sh->origin_upper_left = blob_read_uint8(blob);
+   sh->pixel_center_integer = blob_read_uint8(blob);
+   blob_copy_bytes(blob, &sh->Geom, sizeof(sh->Geom));
+
+   sh->num_samplers = blob_read_uint32(blob);
+   sh->active_samplers = blob_read_uint32(blob);
+   sh->shadow_samplers = blob_read_uint32(blob);
+   blob_copy_bytes(blob, sh->SamplerUnits, sizeof(sh->SamplerUnits));
+   blob_copy_bytes(blob, sh->SamplerTargets, sizeof(sh->SamplerTargets));
+   sh->num_uniform_components = blob_read_uint32(blob);
+   sh->num_combined_uniform_components = blob_read_uint32(blob);
+
+   return sh;
+}
+
+/**
+ * Undo everything \c link_shaders may have left in \p prog, as it does
+ * itself before linking.
+ */
+void
+reset_link_state(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   prog->Validated = false;
+   prog->_Used = false;
+
+   ralloc_free(prog->UniformBlocks);
+   prog->UniformBlocks = NULL;
+   prog->NumUniformBlocks = 0;
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      ralloc_free(prog->UniformBlockStageIndex[i]);
+      prog->UniformBlockStageIndex[i] = NULL;
+   }
+
+   ralloc_free(prog->AtomicBuffers);
+   prog->AtomicBuffers = NULL;
+   prog->NumAtomicBuffers = 0;
+
+   ralloc_free(prog->LinkedTransformFeedback.Varyings);
+   ralloc_free(prog->LinkedTransformFeedback.Outputs);
+   memset(&prog->LinkedTransformFeedback, 0,
+          sizeof(prog->LinkedTransformFeedback));
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] != NULL)
+         ctx->Driver.DeleteShader(ctx, prog->_LinkedShaders[i]);
+
+      prog->_LinkedShaders[i] = NULL;
+   }
+
+   _mesa_clear_shader_program_data(ctx, prog);
+}
+
+bool
+read_program(struct blob_reader *blob, struct gl_context *ctx,
+             struct gl_shader_program *prog)
+{
+   if (blob_read_uint32(blob) != SHADER_CACHE_PROGRAM_MAGIC ||
+       blob_read_uint32(blob) != SHADER_CACHE_PROGRAM_VERSION)
+      return false;
+
+   ir_deserializer d(blob, prog);
+
+   char *info_log = blob_read_string(blob, prog);
+   if (info_log != NULL) {
+      ralloc_free(prog->InfoLog);
+      prog->InfoLog = info_log;
+   }
+
+   prog->Version = blob_read_uint32(blob);
+   prog->IsES = blob_read_uint8(blob);
+   prog->ARB_fragment_coord_conventions_enable = blob_read_uint8(blob);
+   prog->FragDepthLayout = (gl_frag_depth_layout) blob_read_uint32(blob);
+   blob_copy_bytes(blob, &prog->Geom, sizeof(prog->Geom));
+   blob_copy_bytes(blob, &prog->Vert, sizeof(prog->Vert));
+   prog->LastClipDistanceArraySize = blob_read_uint32(blob);
+   prog->UniformLocationBaseScale = blob_read_uint32(blob);
+
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (!blob_read_uint8(blob))
+         continue;
+
+      struct gl_shader *sh = read_linked_shader(blob, ctx, (gl_shader_stage) i);
+      if (sh == NULL)
+         return false;
+
+      _mesa_reference_shader(ctx, &prog->_LinkedShaders[i], sh);
+
+      /* Everything is allocated under the linked shader, as reparent_ir
+       * leaves it at the end of link_shaders.
+       */
+      d.mem_ctx = sh;
+      if (!read_uniform_blocks(blob, &d, sh, &sh->UniformBlocks,
+                               &sh->NumUniformBlocks))
+         return false;
+
+      sh->ir = new(sh) exec_list;
+      if (!d.read_list(sh->ir))
+         return false;
+   }
+
+   d.mem_ctx = prog;
+
+   if (!read_uniform_blocks(blob, &d, prog, &prog->UniformBlocks,
+                            &prog->NumUniformBlocks))
+      return false;
+
+   const uint32_t stage_index_size = blob_read_uint32(blob);
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      const int *indices = (const int *)
+         blob_read_bytes(blob, stage_index_size * sizeof(int));
+
+      if (indices == NULL)
+         return false;
+
+      prog->UniformBlockStageIndex[i] = ralloc_array(prog, int,
+                                                     stage_index_size);
+      memcpy(prog->UniformBlockStageIndex[i], indices,
+             stage_index_size * sizeof(int));
+   }
+
+   if (!read_uniform_storage(blob, &d, prog))
+      return false;
+
+   prog->NumAtomicBuffers = blob_read_uint32(blob);
+   if (blob->overrun ||
+       prog->NumAtomicBuffers > (size_t) (blob->end - blob->current))
+      return false;
+   prog->AtomicBuffers = rzalloc_array(prog, gl_active_atomic_buffer,
+                                       prog->NumAtomicBuffers);
+   for (unsigned i = 0; i < prog->NumAtomicBuffers; i++) {
+      struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      ab->NumUniforms = blob_read_uint32(blob);
+      const void *uniforms =
+         blob_read_bytes(blob, ab->NumUniforms * sizeof(GLuint));
+      if (uniforms == NULL)
+         return false;
+
+      ab->Uniforms = ralloc_array(prog->AtomicBuffers, GLuint,
+                                  ab->NumUniforms);
+      memcpy(ab->Uniforms, uniforms, ab->NumUniforms * sizeof(GLuint));
+      ab->Binding = blob_read_uint32(blob);
+      ab->MinimumSize = blob_read_uint32(blob);
+      blob_copy_bytes(blob, ab->StageReferences, sizeof(ab->StageReferences));
+   }
+
+   struct gl_transform_feedback_info *tfb = &prog->LinkedTransformFeedback;
+
+   tfb->NumOutputs = blob_read_uint32(blob);
+   tfb->NumBuffers = blob_read_uint32(blob);
+   tfb->NumVarying = blob_read_uint32(blob);
+   blob_copy_bytes(blob, tfb->BufferStride, sizeof(tfb->BufferStride));
+
+   const void *outputs =
+      blob_read_bytes(blob, tfb->NumOutputs * sizeof(tfb->Outputs[0]));
+   if (outputs == NULL || tfb->NumVarying < 0 ||
+       (size_t) tfb->NumVarying > (size_t) (blob->end - blob->current))
+      return false;
+
+   tfb->Outputs = rzalloc_array(prog, struct gl_transform_feedback_output,
+                                tfb->NumOutputs);
+   memcpy(tfb->Outputs, outputs, tfb->NumOutputs * sizeof(tfb->Outputs[0]));
+
+   tfb->Varyings = rzalloc_array(prog,
+                                 struct gl_transform_feedback_varying_info,
+                                 tfb->NumVarying);
+   for (int i = 0; i < tfb->NumVarying; i++) {
+      tfb->Varyings[i].Name = blob_read_string(blob, prog);
+      tfb->Varyings[i].Type = blob_read_uint32(blob);
+      tfb->Varyings[i].Size = blob_read_uint32(blob);
+   }
+
+   return !d.has_failed() && blob->current == blob->end;
+}
+
+
+/**
+ * Hash the driver build, so that cache entries written by a different
+ * build are never used.  The file containing this code is identified by
+ * its name, size and modification time.
+ */
+void
+hash_build_id(struct mesa_sha1 *sha)
+{
+   static mtx_t lock = _MTX_INITIALIZER_NP;
+   static unsigned char build_id[MESA_SHA1_DIGEST_LENGTH];
+   static bool initialized;
+
+   mtx_lock(&lock);
+   if (!initialized) {
+      struct mesa_sha1 build_sha;
+
+      _mesa_sha1_init(&build_sha);
+      _mesa_sha1_update(&build_sha, PACKAGE_VERSION, strlen(PACKAGE_VERSION));
+      _mesa_sha1_update(&build_sha, __DATE__ __TIME__,
+                        strlen(__DATE__ __TIME__));
+
+#ifdef HAVE_DLOPEN
+      Dl_info info;
+      struct stat st;
+
+      if (dladdr((void *) hash_build_id, &info) && info.dli_fname &&
+          stat(info.dli_fname, &st) == 0) {
+         const int64_t size = st.st_size;
+         const int64_t mtime = st.st_mtime;
+
+         _mesa_sha1_update(&build_sha, info.dli_fname,
+                           strlen(info.dli_fname));
+         _mesa_sha1_update(&build_sha, &size, sizeof(size));
+         _mesa_sha1_update(&build_sha, &mtime, sizeof(mtime));
+      }
+#endif
+
+      _mesa_sha1_final(&build_sha, build_id);
+      initialized = true;
+   }
+   mtx_unlock(&lock);
+
+   _mesa_sha1_update(sha, build_id, sizeof(build_id));
+}
+
+/**
+ * Hash the context state that affects compiling and linking.
+ */
+void
+hash_context(struct mesa_sha1 *sha, struct gl_context *ctx)
+{
+   const uint32_t api = ctx->API;
+   const uint32_t version = ctx->Version;
+
+   hash_build_id(sha);
+   _mesa_sha1_update(sha, &api, sizeof(api));
+   _mesa_sha1_update(sha, &version, sizeof(version));
+   _mesa_sha1_update(sha, &ctx->Const, sizeof(ctx->Const));
+   /* The extension string is a pointer, which differs between processes.
+    * The extensions it lists are the flags before it.
+    */
+   _mesa_sha1_update(sha, &ctx->Extensions,
+                     offsetof(struct gl_extensions, String));
+   _mesa_sha1_update(sha, ctx->ShaderCompilerOptions,
+                     sizeof(ctx->ShaderCompilerOptions));
+}
+
+void
+hash_string(struct mesa_sha1 *sha, const char *str)
+{
+   /* Include the terminator so that adjacent strings stay distinct. */
+   if (str)
+      _mesa_sha1_update(sha, str, strlen(str) + 1);
+   else
+      _mesa_sha1_update(sha, "", 1);
+}
+
+struct binding {
+   const char *name;
+   intptr_t value;
+};
+
+struct binding_list {
+   struct binding *bindings;
+   unsigned count;
+};
+
+void
+collect_binding(const void *key, void *data, void *closure)
+{
+   struct binding_list *list = (struct binding_list *) closure;
+
+   list->bindings[list->count].name = (const char *) key;
+   list->bindings[list->count].value = (intptr_t) data;
+   list->count++;
+}
+
+void
+count_binding(const void *key, void *data, void *closure)
+{
+   (*(unsigned *) closure)++;
+}
+
+int
+compare_bindings(const void *a, const void *b)
+{
+   return strcmp(((const struct binding *) a)->name,
+                 ((const struct binding *) b)->name);
+}
+
+/**
+ * Hash the contents of a binding map in a well-defined order.
+ */
+void
+hash_bindings(struct mesa_sha1 *sha, struct string_to_uint_map *map)
+{
+   struct binding_list list;
+   unsigned count = 0;
+
+   if (map == NULL) {
+      _mesa_sha1_update(sha, &count, sizeof(count));
+      return;
+   }
+
+   map->iterate(count_binding, &count);
+   _mesa_sha1_update(sha, &count, sizeof(count));
+
+   list.bindings = (struct binding *) malloc(count * sizeof(struct binding));
+   list.count = 0;
+   if (list.bindings == NULL)
+      return;
+
+   map->iterate(collect_binding, &list);
+   qsort(list.bindings, list.count, sizeof(struct binding), compare_bindings);
+
+   for (unsigned i = 0; i < list.count; i++) {
+      const uint32_t value = (uint32_t) list.bindings[i].value;
+
+      hash_string(sha, list.bindings[i].name);
+      _mesa_sha1_update(sha, &value, sizeof(value));
+   }
+
+   free(list.bindings);
+}
+
+/**
+ * Only programs whose shaders all have a cache key are cached, since the
+ * program key is made from the shader keys.  Programs built internally,
+ * such as the fixed-function fragment programs, are never cached.
+ */
+bool
+program_is_cacheable(const struct gl_shader_program *prog)
+{
+   if (prog->Name == 0 || prog->NumShaders == 0)
+      return false;
+
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      if (!prog->Shaders[i]->has_sha1)
+         return false;
+   }
+
+   return true;
+}
+
+void
+compute_program_key(struct gl_context *ctx, struct gl_shader_program *prog,
+                    cache_key key)
+{
+   struct mesa_sha1 sha;
+   const uint32_t num_shaders = prog->NumShaders;
+   const uint32_t buffer_mode = prog->TransformFeedback.BufferMode;
+   const uint32_t num_varyings = prog->TransformFeedback.NumVarying;
+   const uint8_t separate = prog->InternalSeparateShader;
+
+   _mesa_sha1_init(&sha);
+   hash_string(&sha, "program");
+   hash_context(&sha, ctx);
+
+   _mesa_sha1_update(&sha, &num_shaders, sizeof(num_shaders));
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      _mesa_sha1_update(&sha, prog->Shaders[i]->sha1,
+                        sizeof(prog->Shaders[i]->sha1));
+   }
+
+   _mesa_sha1_update(&sha, &separate, sizeof(separate));
+   hash_bindings(&sha, prog->AttributeBindings);
+   hash_bindings(&sha, prog->FragDataBindings);
+   hash_bindings(&sha, prog->FragDataIndexBindings);
+
+   _mesa_sha1_update(&sha, &buffer_mode, sizeof(buffer_mode));
+   _mesa_sha1_update(&sha, &num_varyings, sizeof(num_varyings));
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++)
+      hash_string(&sha, prog->TransformFeedback.VaryingNames[i]);
+
+   _mesa_sha1_final(&sha, key);
+}
+
+/**
+ * The cache is bypassed while debugging shaders, since the debug output
+ * is produced by the stages the cache skips.  The prologue cache doesn't
+ * change the output.
+ */
+struct _mesa_disk_cache *
+get_cache(struct gl_context *ctx)
+{
+   if (ctx->Shader.Flags & ~(GLSL_PP_CACHE | GLSL_PP_CACHE_REPORT))
+      return NULL;
+
+   return _mesa_glsl_get_disk_cache();
+}
+
+/**
+ * Header of the binaries returned by glGetProgramBinary.  Binaries are
+ * only accepted by the build and context configuration that wrote them.
+ */
+struct program_binary_header {
+   unsigned char context_sha1[MESA_SHA1_DIGEST_LENGTH];
+   uint32_t version;
+};
+
+void
+write_binary_header(struct gl_context *ctx,
+                    struct program_binary_header *header)
+{
+   struct mesa_sha1 sha;
+
+   memset(header, 0, sizeof(*header));
+
+   _mesa_sha1_init(&sha);
+   hash_context(&sha, ctx);
+   _mesa_sha1_final(&sha, header->context_sha1);
+   header->version = SHADER_CACHE_PROGRAM_VERSION;
+}
+
+} /* anonymous namespace */
+
+
+extern "C" {
+
+bool
+_mesa_glsl_serialize_program(struct blob *blob, struct gl_context *ctx,
+                             struct gl_shader_program *prog)
+{
+   ir_serializer s(blob);
+
+   (void) ctx;
+
+   blob_write_uint32(blob, SHADER_CACHE_PROGRAM_MAGIC);
+   blob_write_uint32(blob, SHADER_CACHE_PROGRAM_VERSION);
+
+   blob_write_string(blob, prog->InfoLog);
+   blob_write_uint32(blob, prog->Version);
+   blob_write_uint8(blob, prog->IsES);
+   blob_write_uint8(blob, prog->ARB_fragment_coord_conventions_enable);
+   blob_write_uint32(blob, prog->FragDepthLayout);
+   blob_write_bytes(blob, &prog->Geom, sizeof(prog->Geom));
+   blob_write_bytes(blob, &prog->Vert, sizeof(prog->Vert));
+   blob_write_uint32(blob, prog->LastClipDistanceArraySize);
+   blob_write_uint32(blob, prog->UniformLocationBaseScale);
+
+   unsigned stage_index_size = 0;
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_shader *sh = prog->_LinkedShaders[i];
+
+      blob_write_uint8(blob, sh != NULL);
+      if (sh == NULL)
+         continue;
+
+      write_linked_shader(blob, &s, sh);
+      stage_index_size += sh->NumUniformBlocks;
+   }
+
+   write_uniform_blocks(blob, &s, prog->UniformBlocks, prog->NumUniformBlocks);
+
+   /* Each per-stage index array has one entry per block of all stages, see
+    * interstage_cross_validate_uniform_blocks.
+    */
+   blob_write_uint32(blob, stage_index_size);
+   for (int i = 0; i < MESA_SHADER_STAGES; i++) {
+      blob_write_bytes(blob, prog->UniformBlockStageIndex[i],
+                       stage_index_size * sizeof(int));
+   }
+
+   write_uniform_storage(blob, &s, prog);
+
+   blob_write_uint32(blob, prog->NumAtomicBuffers);
+   for (unsigned i = 0; i < prog->NumAtomicBuffers; i++) {
+      const struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      blob_write_uint32(blob, ab->NumUniforms);
+      blob_write_bytes(blob, ab->Uniforms, ab->NumUniforms * sizeof(GLuint));
+      blob_write_uint32(blob, ab->Binding);
+      blob_write_uint32(blob, ab->MinimumSize);
+      blob_write_bytes(blob, ab->StageReferences,
+                       sizeof(ab->StageReferences));
+   }
+
+   const struct gl_transform_feedback_info *tfb =
+      &prog->LinkedTransformFeedback;
+
+   blob_write_uint32(blob, tfb->NumOutputs);
+   blob_write_uint32(blob, tfb->NumBuffers);
+   blob_write_uint32(blob, tfb->NumVarying);
+   blob_write_bytes(blob, tfb->BufferStride, sizeof(tfb->BufferStride));
+   blob_write_bytes(blob, tfb->Outputs,
+                    tfb->NumOutputs * sizeof(tfb->Outputs[0]));
+   for (int i = 0; i < tfb->NumVarying; i++) {
+      blob_write_string(blob, tfb->Varyings[i].Name);
+      blob_write_uint32(blob, tfb->Varyings[i].Type);
+      blob_write_uint32(blob, tfb->Varyings[i].Size);
+   }
+
+   return !blob->out_of_memory;
+}
+
+bool
+_mesa_glsl_deserialize_program(struct gl_context *ctx,
+                               struct gl_shader_program *prog,
+                               const void *data, size_t size)
+{
+   struct blob_reader blob;
+
+   reset_link_state(ctx, prog);
+
+   blob_reader_init(&blob, data, size);
+   if (read_program(&blob, ctx, prog)) {
+      prog->LinkStatus = true;
+      return true;
+   }
+
+   reset_link_state(ctx, prog);
+   prog->LinkStatus = false;
+
+   return false;
+}
+
+bool
+_mesa_shader_cache_skip_compile(struct gl_context *ctx,
+                                struct gl_shader *shader)
+{
+   struct _mesa_disk_cache *cache = _mesa_glsl_get_disk_cache();
+   struct mesa_sha1 sha;
+   const uint32_t stage = shader->Stage;
+
+   shader->compile_skipped = false;
+   shader->has_sha1 = false;
+
+   if (cache == NULL)
+      return false;
+
+   /* The key is computed even when the cache is bypassed, since it is
+    * what identifies the shader in program keys.
+    */
+   _mesa_sha1_init(&sha);
+   hash_string(&sha, "shader");
+   hash_context(&sha, ctx);
+   _mesa_sha1_update(&sha, &stage, sizeof(stage));
+   _mesa_sha1_update(&sha, &shader->Pragmas, sizeof(shader->Pragmas));
+   hash_string(&sha, shader->Source);
+   _mesa_sha1_final(&sha, shader->sha1);
+   shader->has_sha1 = true;
+
+   if (get_cache(ctx) == NULL)
+      return false;
+
+   size_t size;
+   const void *data = _mesa_disk_cache_get(cache, shader->sha1, &size);
+   if (data == NULL)
+      return false;
+
+   struct blob_reader blob;
+   blob_reader_init(&blob, data, size);
+
+   const uint32_t version = blob_read_uint32(&blob);
+   const bool is_es = blob_read_uint8(&blob);
+   char *info_log = blob_read_string(&blob, shader);
+
+   _mesa_disk_cache_release(cache, data, size);
+
+   if (blob.overrun || info_log == NULL) {
+      ralloc_free(info_log);
+      return false;
+   }
+
+   ralloc_free(shader->ir);
+   shader->ir = NULL;
+   ralloc_free(shader->InfoLog);
+   shader->InfoLog = info_log;
+   shader->Version = version;
+   shader->IsES = is_es;
+   shader->CompileStatus = true;
+   shader->compile_skipped = true;
+
+   return true;
+}
+
+void
+_mesa_shader_cache_store_shader(struct gl_context *ctx,
+                                struct gl_shader *shader)
+{
+   struct _mesa_disk_cache *cache = get_cache(ctx);
+
+   if (cache == NULL || !shader->CompileStatus)
+      return;
+
+   struct blob *blob = blob_create(NULL);
+
+   blob_write_uint32(blob, shader->Version);
+   blob_write_uint8(blob, shader->IsES);
+   blob_write_string(blob, shader->InfoLog ? shader->InfoLog : "");
+
+   if (!blob->out_of_memory)
+      _mesa_disk_cache_put(cache, shader->sha1, blob->data, blob->size);
+
+   ralloc_free(blob);
+}
+
+bool
+_mesa_shader_cache_load_program(struct gl_context *ctx,
+                                struct gl_shader_program *prog)
+{
+   struct _mesa_disk_cache *cache = get_cache(ctx);
+   cache_key key;
+
+   if (cache == NULL || !program_is_cacheable(prog))
+      return false;
+
+   compute_program_key(ctx, prog, key);
+
+   size_t size;
+   const void *data = _mesa_disk_cache_get(cache, key, &size);
+   if (data == NULL)
+      return false;
+
+   const bool ok = _mesa_glsl_deserialize_program(ctx, prog, data, size);
+
+   if (ok && prog->BinaryRetreivableHint) {
+      prog->BinaryLength = sizeof(struct program_binary_header) + size;
+      prog->Binary = ralloc_size(prog, prog->BinaryLength);
+      write_binary_header(ctx, (struct program_binary_header *) prog->Binary);
+      memcpy((char *) prog->Binary + sizeof(struct program_binary_header),
+             data, size);
+   }
+
+   _mesa_disk_cache_release(cache, data, size);
+
+   /* A failure leaves the program as if it was never linked, so that it
+    * can be linked the usual way.
+    */
+   if (!ok)
+      prog->LinkStatus = true;
+
+   return ok;
+}
+
+void
+_mesa_shader_cache_store_program(struct gl_context *ctx,
+                                 struct gl_shader_program *prog)
+{
+   struct _mesa_disk_cache *cache = get_cache(ctx);
+   const bool cacheable = cache != NULL && program_is_cacheable(prog);
+   struct program_binary_header header;
+   cache_key key;
+
+   if (!prog->LinkStatus)
+      return;
+
+   /* Serializing costs link time and memory, so it is only done when the
+    * disk cache or the application wants the binary.
+    */
+   if (!cacheable && !prog->BinaryRetreivableHint)
+      return;
+
+   struct blob *blob = blob_create(NULL);
+
+   write_binary_header(ctx, &header);
+   blob_write_bytes(blob, &header, sizeof(header));
+
+   if (_mesa_glsl_serialize_program(blob, ctx, prog)) {
+      if (cacheable) {
+         compute_program_key(ctx, prog, key);
+         _mesa_disk_cache_put(cache, key, blob->data + sizeof(header),
+                              blob->size - sizeof(header));
+      }
+
+      if (prog->BinaryRetreivableHint) {
+         ralloc_steal(prog, blob->data);
+         prog->Binary = blob->data;
+         prog->BinaryLength = blob->size;
+         blob->data = NULL;
+      }
+   }
+
+   ralloc_free(blob);
+}
+
+bool
+_mesa_program_binary(struct gl_context *ctx, struct gl_shader_program *prog,
+                     const void *binary, size_t length)
+{
+   struct program_binary_header header;
+   struct program_binary_header expected;
+
+   if (length < sizeof(header)) {
+      reset_link_state(ctx, prog);
+      prog->LinkStatus = false;
+      return false;
+   }
+
+   /* The binary belongs to the application and may be unaligned. */
+   memcpy(&header, binary, sizeof(header));
+   write_binary_header(ctx, &expected);
+
+   if (memcmp(&header, &expected, sizeof(header)) != 0) {
+      reset_link_state(ctx, prog);
+      prog->LinkStatus = false;
+      return false;
+   }
+
+   const char *data = (const char *) binary + sizeof(header);
+   const size_t size = length - sizeof(header);
+
+   if (!_mesa_glsl_deserialize_program(ctx, prog, data, size))
+      return false;
+
+   prog->BinaryLength = length;
+   prog->Binary = ralloc_size(prog, length);
+   memcpy(prog->Binary, binary, length);
+
+   return true;
+}
+
+} /* extern "C" */
@@ -0,0 +1,106 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct blob;
+struct gl_context;
+struct gl_shader;
+struct gl_shader_program;
+
+/**
+ * Serialize the result of \c link_shaders: the linked IR of each stage and
+ * the uniform, uniform block, atomic buffer and transform feedback tables.
+ * The driver-specific results of \c dd_function_table::LinkShader are not
+ * included.
+ */
+bool
+_mesa_glsl_serialize_program(struct blob *blob, struct gl_context *ctx,
+                             struct gl_shader_program *prog);
+
+/**
+ * Replace the link results of \p prog with those serialized in \p data, as
+ * if \c link_shaders had produced them.  On failure \c false is returned
+ * and the program is left unlinked.
+ */
+bool
+_mesa_glsl_deserialize_program(struct gl_context *ctx,
+                               struct gl_shader_program *prog,
+                               const void *data, size_t size);
+
+/**
+ * Called before the front end runs on \p shader.  Returns true when the
+ * disk cache knows that the shader compiles, in which case the front end
+ * is skipped and \c gl_shader::compile_skipped is set.
+ */
+bool
+_mesa_shader_cache_skip_compile(struct gl_context *ctx,
+                                struct gl_shader *shader);
+
+/**
+ * Record that \p shader compiled successfully.
+ */
+void
+_mesa_shader_cache_store_shader(struct gl_context *ctx,
+                                struct gl_shader *shader);
+
+/**
+ * Try to satisfy the GLSL link of \p prog from the disk cache.
+ */
+bool
+_mesa_shader_cache_load_program(struct gl_context *ctx,
+                                struct gl_shader_program *prog);
+
+/**
+ * Serialize the results of a successful \c link_shaders and store them in
+ * the disk cache.  They are kept in \c gl_shader_program::Binary only if
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT is set.
+ */
+void
+_mesa_shader_cache_store_program(struct gl_context *ctx,
+                                 struct gl_shader_program *prog);
+
+/**
+ * Replace the link results of \p prog with those of a binary returned by
+ * glGetProgramBinary.  Binaries written by another build or for a context
+ * with different limits or extensions are rejected.  On failure \c false
+ * is returned and the program is left unlinked.
+ */
+bool
+_mesa_program_binary(struct gl_context *ctx, struct gl_shader_program *prog,
+                     const void *binary, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHADER_CACHE_H */
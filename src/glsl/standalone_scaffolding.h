@@ -44,6 +44,13 @@ _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
 extern "C" struct gl_shader *
 _mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type);
 
+extern "C" void
+_mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh);
+
+extern "C" void
+_mesa_clear_shader_program_data(struct gl_context *ctx,
+                                struct gl_shader_program *shProg);
+
 extern "C" void
 _mesa_shader_debug(struct gl_context *ctx, GLenum type, GLuint *id,
                    const char *msg, int len);
@@ -74,5 +81,13 @@ _mesa_shader_enum_to_shader_stage(GLenum v)
  */
 void initialize_context_to_defaults(struct gl_context *ctx, gl_api api);
 
+/**
+ * Initialize the given gl_context structure with the limits of
+ * \p glsl_version (one of 100, 110, 120, 130, 140, 150, 300 and 330), as
+ * the standalone compiler tools do.
+ */
+void initialize_context_for_glsl_version(struct gl_context *ctx, gl_api api,
+                                         int glsl_version);
+
 
 #endif /* STANDALONE_SCAFFOLDING_H */
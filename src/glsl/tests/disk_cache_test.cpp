@@ -0,0 +1,268 @@
+/*
+ * Copyright © 2014 LunarG, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "disk_cache.h"
+
+class disk_cache_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   char path[64];
+};
+
+void
+disk_cache_test::SetUp()
+{
+   strcpy(path, "/tmp/mesa-disk-cache-test-XXXXXX");
+   ASSERT_TRUE(mkdtemp(path) != NULL);
+}
+
+static void
+remove_tree(const char *path)
+{
+   DIR *dir = opendir(path);
+   struct dirent *ent;
+   char child[256];
+
+   if (!dir) {
+      unlink(path);
+      return;
+   }
+
+   while ((ent = readdir(dir)) != NULL) {
+      if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+         continue;
+      snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+      remove_tree(child);
+   }
+
+   closedir(dir);
+   rmdir(path);
+}
+
+void
+disk_cache_test::TearDown()
+{
+   remove_tree(path);
+}
+
+static void
+make_key(cache_key key, unsigned i)
+{
+   _mesa_sha1_compute(&i, sizeof(i), key);
+}
+
+TEST_F(disk_cache_test, put_and_get)
+{
+   struct _mesa_disk_cache *cache =
+      _mesa_disk_cache_create_with_path(path, 1024 * 1024);
+   ASSERT_TRUE(cache != NULL);
+
+   static const char data[] = "some cached data";
+   cache_key key, other_key;
+   const void *result;
+   size_t size;
+
+   make_key(key, 1);
+   make_key(other_key, 2);
+
+   EXPECT_TRUE(_mesa_disk_cache_get(cache, key, &size) == NULL);
+
+   _mesa_disk_cache_put(cache, key, data, sizeof(data));
+
+   result = _mesa_disk_cache_get(cache, key, &size);
+   ASSERT_TRUE(result != NULL);
+   EXPECT_EQ(sizeof(data), size);
+   EXPECT_EQ(0, memcmp(result, data, sizeof(data)));
+   EXPECT_EQ(0u, (uintptr_t) result % 8);
+   _mesa_disk_cache_release(cache, result, size);
+
+   EXPECT_TRUE(_mesa_disk_cache_get(cache, other_key, &size) == NULL);
+   EXPECT_GT(_mesa_disk_cache_get_size(cache), sizeof(data));
+
+   _mesa_disk_cache_destroy(cache);
+
+   /* The entry survives the cache object. */
+   cache = _mesa_disk_cache_create_with_path(path, 1024 * 1024);
+   ASSERT_TRUE(cache != NULL);
+   result = _mesa_disk_cache_get(cache, key, &size);
+   ASSERT_TRUE(result != NULL);
+   _mesa_disk_cache_release(cache, result, size);
+   _mesa_disk_cache_destroy(cache);
+}
+
+TEST_F(disk_cache_test, corrupted_entry_is_ignored)
+{
+   struct _mesa_disk_cache *cache =
+      _mesa_disk_cache_create_with_path(path, 1024 * 1024);
+   ASSERT_TRUE(cache != NULL);
+
+   static const char data[] = "data that will be corrupted";
+   char hex[MESA_SHA1_DIGEST_LENGTH * 2 + 1];
+   char filename[256];
+   cache_key key;
+   size_t size;
+
+   make_key(key, 3);
+   _mesa_disk_cache_put(cache, key, data, sizeof(data));
+
+   _mesa_sha1_format(hex, key);
+   snprintf(filename, sizeof(filename), "%s/%c%c/%s",
+            path, hex[0], hex[1], hex + 2);
+
+   FILE *f = fopen(filename, "r+b");
+   ASSERT_TRUE(f != NULL);
+   fseek(f, -2, SEEK_END);
+   fputc('X', f);
+   fclose(f);
+
+   EXPECT_TRUE(_mesa_disk_cache_get(cache, key, &size) == NULL);
+
+   /* Truncated entries are rejected as well. */
+   ASSERT_EQ(0, truncate(filename, 10));
+   EXPECT_TRUE(_mesa_disk_cache_get(cache, key, &size) == NULL);
+
+   _mesa_disk_cache_destroy(cache);
+}
+
+TEST_F(disk_cache_test, eviction)
+{
+   const size_t entry_size = 4096;
+   const uint64_t max_size = 16 * entry_size;
+   struct _mesa_disk_cache *cache =
+      _mesa_disk_cache_create_with_path(path, max_size);
+   ASSERT_TRUE(cache != NULL);
+
+   char *data = (char *) calloc(1, entry_size);
+   cache_key key;
+   unsigned i, hits = 0;
+   size_t size;
+
+   for (i = 0; i < 64; i++) {
+      make_key(key, i);
+      memset(data, i, entry_size);
+      _mesa_disk_cache_put(cache, key, data, entry_size);
+      EXPECT_LE(_mesa_disk_cache_get_size(cache), max_size);
+   }
+
+   for (i = 0; i < 64; i++) {
+      const void *result;
+
+      make_key(key, i);
+      result = _mesa_disk_cache_get(cache, key, &size);
+      if (result) {
+         EXPECT_EQ(i & 0xff, ((const unsigned char *) result)[0]);
+         _mesa_disk_cache_release(cache, result, size);
+         hits++;
+      }
+   }
+
+   EXPECT_GT(hits, 0u);
+   EXPECT_LE(hits, 16u);
+
+   free(data);
+   _mesa_disk_cache_destroy(cache);
+}
+
+TEST_F(disk_cache_test, multiple_processes)
+{
+   const int num_processes = 4;
+   const unsigned num_keys = 32;
+   pid_t pids[num_processes];
+   int i;
+
+   /* Every process writes and reads back the same entries at once. */
+   for (i = 0; i < num_processes; i++) {
+      pids[i] = fork();
+      ASSERT_GE(pids[i], 0);
+
+      if (pids[i] == 0) {
+         struct _mesa_disk_cache *cache =
+            _mesa_disk_cache_create_with_path(path, 1024 * 1024);
+         int failures = 0;
+         unsigned k;
+
+         for (k = 0; k < num_keys; k++) {
+            unsigned data[256];
+            const void *result;
+            cache_key key;
+            size_t size;
+            unsigned j;
+
+            for (j = 0; j < 256; j++)
+               data[j] = k * 256 + j;
+
+            make_key(key, k);
+            _mesa_disk_cache_put(cache, key, data, sizeof(data));
+
+            /* Another process may not have finished writing the entry yet,
+             * but whatever is found must be complete.
+             */
+            result = _mesa_disk_cache_get(cache, key, &size);
+            if (result) {
+               if (size != sizeof(data) || memcmp(result, data, size) != 0)
+                  failures++;
+               _mesa_disk_cache_release(cache, result, size);
+            }
+         }
+
+         _mesa_disk_cache_destroy(cache);
+         _exit(failures ? 1 : 0);
+      }
+   }
+
+   for (i = 0; i < num_processes; i++) {
+      int status;
+
+      ASSERT_EQ(pids[i], waitpid(pids[i], &status, 0));
+      EXPECT_TRUE(WIFEXITED(status));
+      EXPECT_EQ(0, WEXITSTATUS(status));
+   }
+
+   struct _mesa_disk_cache *cache =
+      _mesa_disk_cache_create_with_path(path, 1024 * 1024);
+   ASSERT_TRUE(cache != NULL);
+
+   for (unsigned k = 0; k < num_keys; k++) {
+      const void *result;
+      cache_key key;
+      size_t size;
+
+      make_key(key, k);
+      result = _mesa_disk_cache_get(cache, key, &size);
+      ASSERT_TRUE(result != NULL);
+      EXPECT_EQ(k * 256, ((const unsigned *) result)[0]);
+      _mesa_disk_cache_release(cache, result, size);
+   }
+
+   _mesa_disk_cache_destroy(cache);
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright © 2014 LunarG, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "main/mtypes.h"
+#include "ralloc.h"
+
+extern "C" {
+int glcpp_preprocess(void *ctx, const char **shader, char **info_log,
+                     const struct gl_extensions *extensions,
+                     struct gl_context *gl_ctx);
+void glcpp_release_prologue_cache(void);
+unsigned glcpp_prologue_cache_hits(void);
+}
+
+struct pp_result {
+   std::string output;
+   std::string info_log;
+   int errors;
+};
+
+class glcpp_prologue_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void preprocess(const std::string &source, pp_result *result,
+                   bool use_cache);
+   void expect_same(const pp_result &cached, const pp_result &uncached);
+
+   struct gl_context ctx;
+};
+
+void
+glcpp_prologue_test::SetUp()
+{
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.API = API_OPENGL_COMPAT;
+   ctx.Const.DisableGLSLLineContinuations = false;
+   ctx.Shader.Flags = 0;
+
+   glcpp_release_prologue_cache();
+}
+
+void
+glcpp_prologue_test::TearDown()
+{
+   glcpp_release_prologue_cache();
+}
+
+void
+glcpp_prologue_test::preprocess(const std::string &source, pp_result *result,
+                                bool use_cache)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   const char *shader = ralloc_strdup(mem_ctx, source.c_str());
+   char *info_log = ralloc_strdup(mem_ctx, "");
+
+   ctx.Shader.Flags = use_cache ? GLSL_PP_CACHE : 0;
+   result->errors = glcpp_preprocess(mem_ctx, &shader, &info_log, NULL, &ctx);
+   result->output = shader;
+   result->info_log = info_log;
+
+   ralloc_free(mem_ctx);
+}
+
+void
+glcpp_prologue_test::expect_same(const pp_result &cached,
+                                 const pp_result &uncached)
+{
+   EXPECT_EQ(uncached.output, cached.output);
+   EXPECT_EQ(uncached.info_log, cached.info_log);
+   EXPECT_EQ(uncached.errors, cached.errors);
+}
+
+/**
+ * A header of more than PROLOGUE_MIN_LENGTH bytes that uses macros,
+ * conditionals and a comment spanning lines, and that leaves a warning with
+ * a line number in the info log.  __LINE__ checks the line numbers of the
+ * output.
+ */
+static std::string
+make_prologue()
+{
+   std::string prologue =
+      "#version 130\n"
+      "/* Helpers shared by all the shaders of the test.  The comment spans\n"
+      " * a few lines, which must still be counted when the rest of the\n"
+      " * shader is preprocessed on its own.\n"
+      " */\n"
+      "#define SCALE 2\n"
+      "#if SCALE > 1\n"
+      "#define MUL(x) ((x) * SCALE)\n"
+      "#else\n"
+      "#define MUL(x) (x)\n"
+      "#endif\n"
+      "#ifndef HELPERS_DEFINED extra tokens\n"
+      "#define HELPERS_DEFINED\n"
+      "#endif\n";
+   char line[128];
+
+   for (unsigned i = 0; i < 16; i++) {
+      snprintf(line, sizeof(line),
+               "#define HELPER_%u(x) (MUL(x) + %u.0)\n"
+               "float helper%u(float x) { return HELPER_%u(x) + __LINE__; }\n",
+               i, i, i, i);
+      prologue += line;
+   }
+
+   return prologue;
+}
+
+static const char tail_a[] =
+   "void main()\n"
+   "{\n"
+   "   gl_FragColor = vec4(helper3(1.0), __LINE__, SCALE, 0.0);\n"
+   "}\n"
+   "#undef SCALE\n"
+   "#ifdef SCALE\n"
+   "#error SCALE is still defined\n"
+   "#endif\n"
+   "#error end of the first shader\n";
+
+static const char tail_b[] =
+   "uniform float u;\n"
+   "void main()\n"
+   "{\n"
+   "   gl_FragColor = vec4(MUL(u), helper15(u), __LINE__, 1.0);\n"
+   "}\n"
+   "#endif\n";
+
+TEST_F(glcpp_prologue_test, restored_prologue_matches_uncached)
+{
+   const std::string prologue = make_prologue();
+   const std::string shader_a = prologue + tail_a;
+   const std::string shader_b = prologue + tail_b;
+   pp_result uncached_a, uncached_b, cached;
+   unsigned hits;
+
+   ASSERT_GE(prologue.length(), 1024u);
+
+   /* Without GLSL_PP_CACHE, the cache is neither used nor filled. */
+   preprocess(shader_a, &uncached_a, false);
+   preprocess(shader_b, &uncached_b, false);
+
+   EXPECT_NE(0, uncached_a.errors);
+   EXPECT_NE(std::string::npos, uncached_a.info_log.find("warning"));
+
+   hits = glcpp_prologue_cache_hits();
+
+   /* The second shader finds the prologue and continues from it. */
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+   preprocess(shader_b, &cached, true);
+   expect_same(cached, uncached_b);
+
+   /* Later shaders are restored from the cached prologue. */
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+   preprocess(shader_b, &cached, true);
+   expect_same(cached, uncached_b);
+
+   EXPECT_EQ(hits + 2, glcpp_prologue_cache_hits());
+}
+
+TEST_F(glcpp_prologue_test, prologue_is_cut_before_comment)
+{
+   /* The common start of these shaders ends within a comment, so the
+    * prologue ends before it.
+    */
+   const std::string prologue = make_prologue() +
+      "/* The helpers above\n"
+      " * are used by ";
+   const std::string shader_a = prologue + "the first shader.\n */\n" + tail_a;
+   const std::string shader_b = prologue + "the second shader.\n */\n" + tail_b;
+   pp_result uncached_a, uncached_b, cached;
+   unsigned hits;
+
+   preprocess(shader_a, &uncached_a, false);
+   preprocess(shader_b, &uncached_b, false);
+
+   hits = glcpp_prologue_cache_hits();
+
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+   preprocess(shader_b, &cached, true);
+   expect_same(cached, uncached_b);
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+
+   EXPECT_EQ(hits + 1, glcpp_prologue_cache_hits());
+}
+
+TEST_F(glcpp_prologue_test, prologue_within_conditional_is_not_restored)
+{
+   /* The common start of these shaders ends within #if, which prevents
+    * restoring it.
+    */
+   const std::string prologue = make_prologue() +
+      "#if SCALE > 1\n"
+      "float scaled;\n";
+   const std::string shader_a = prologue + "float first;\n#endif\n" + tail_a;
+   const std::string shader_b = prologue + "float second;\n#endif\n" + tail_b;
+   pp_result uncached_a, uncached_b, cached;
+   unsigned hits;
+
+   preprocess(shader_a, &uncached_a, false);
+   preprocess(shader_b, &uncached_b, false);
+
+   hits = glcpp_prologue_cache_hits();
+
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+   preprocess(shader_b, &cached, true);
+   expect_same(cached, uncached_b);
+   preprocess(shader_a, &cached, true);
+   expect_same(cached, uncached_a);
+
+   EXPECT_EQ(hits, glcpp_prologue_cache_hits());
+}
@@ -0,0 +1,166 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "ralloc.h"
+#include "ir.h"
+#include "ir_optimization.h"
+
+/**
+ * \file pass_manager_test.cpp
+ *
+ * Test that ir_pass_manager only reruns the passes the IR changes affect.
+ */
+
+class pass_manager : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   bool run();
+
+   void *mem_ctx;
+   exec_list ir;
+   ir_pass_manager *pm;
+   struct gl_shader_compiler_options options;
+};
+
+void
+pass_manager::SetUp()
+{
+   this->mem_ctx = ralloc_context(NULL);
+   this->ir.make_empty();
+   this->pm = new ir_pass_manager;
+   memset(&this->options, 0, sizeof(this->options));
+
+   /* out vec4 color;
+    * void main() { float t = 2.0; float u = t * t; color = vec4(u); }
+    */
+   ir_variable *const color =
+      new(mem_ctx) ir_variable(glsl_type::vec4_type, "color",
+                               ir_var_shader_out);
+   ir_variable *const t =
+      new(mem_ctx) ir_variable(glsl_type::float_type, "t", ir_var_auto);
+   ir_variable *const u =
+      new(mem_ctx) ir_variable(glsl_type::float_type, "u", ir_var_auto);
+
+   ir_function *const f = new(mem_ctx) ir_function("main");
+   ir_function_signature *const sig =
+      new(mem_ctx) ir_function_signature(glsl_type::void_type);
+   sig->is_defined = true;
+   f->add_signature(sig);
+
+   sig->body.push_tail(t);
+   sig->body.push_tail(u);
+   sig->body.push_tail(
+      new(mem_ctx) ir_assignment(new(mem_ctx) ir_dereference_variable(t),
+                                 new(mem_ctx) ir_constant(2.0f)));
+   sig->body.push_tail(
+      new(mem_ctx) ir_assignment(new(mem_ctx) ir_dereference_variable(u),
+                                 new(mem_ctx) ir_expression(ir_binop_mul,
+                                    new(mem_ctx) ir_dereference_variable(t),
+                                    new(mem_ctx) ir_dereference_variable(t))));
+   sig->body.push_tail(
+      new(mem_ctx) ir_assignment(new(mem_ctx) ir_dereference_variable(color),
+                                 new(mem_ctx) ir_swizzle(
+                                    new(mem_ctx) ir_dereference_variable(u),
+                                    0, 0, 0, 0, 4)));
+
+   ir.push_tail(color);
+   ir.push_tail(f);
+}
+
+void
+pass_manager::TearDown()
+{
+   delete this->pm;
+   this->pm = NULL;
+
+   ralloc_free(this->mem_ctx);
+   this->mem_ctx = NULL;
+}
+
+bool
+pass_manager::run()
+{
+   return pm->run_common_optimization(&ir, false, false, 32, &options);
+}
+
+TEST_F(pass_manager, first_round_runs_every_pass)
+{
+   EXPECT_TRUE(run());
+   EXPECT_NE(0u, pm->passes_run);
+   EXPECT_EQ(0u, pm->passes_skipped);
+}
+
+TEST_F(pass_manager, skips_passes_after_fixed_point)
+{
+   while (run())
+      ;
+
+   const unsigned passes_run = pm->passes_run;
+   const unsigned passes_skipped = pm->passes_skipped;
+
+   EXPECT_FALSE(run());
+   EXPECT_EQ(passes_run, pm->passes_run);
+   EXPECT_LT(passes_skipped, pm->passes_skipped);
+}
+
+TEST_F(pass_manager, record_without_progress)
+{
+   while (run())
+      ;
+
+   const unsigned passes_run = pm->passes_run;
+
+   EXPECT_FALSE(pm->record(false));
+   EXPECT_FALSE(run());
+   EXPECT_EQ(passes_run, pm->passes_run);
+}
+
+TEST_F(pass_manager, record_progress_reruns_passes)
+{
+   while (run())
+      ;
+
+   const unsigned passes_run = pm->passes_run;
+
+   EXPECT_TRUE(pm->record(true));
+   EXPECT_FALSE(run());
+   EXPECT_LT(passes_run, pm->passes_run);
+}
+
+TEST_F(pass_manager, new_options_rerun_passes)
+{
+   while (run())
+      ;
+
+   const unsigned passes_run = pm->passes_run;
+
+   options.OptimizeForAOS = true;
+   EXPECT_FALSE(run());
+   EXPECT_LT(passes_run, pm->passes_run);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "ralloc.h"
+#include "shader_cache.h"
+#include "standalone_scaffolding.h"
+
+class program_binary_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct gl_shader_program *create_program();
+
+   struct gl_context ctx;
+   void *mem_ctx;
+};
+
+void
+program_binary_test::SetUp()
+{
+   initialize_context_to_defaults(&ctx, API_OPENGL_CORE);
+   mem_ctx = ralloc_context(NULL);
+   ctx.Extensions.String = (const GLubyte *) ralloc_strdup(mem_ctx, "");
+}
+
+void
+program_binary_test::TearDown()
+{
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+}
+
+struct gl_shader_program *
+program_binary_test::create_program()
+{
+   struct gl_shader_program *prog =
+      rzalloc(mem_ctx, struct gl_shader_program);
+
+   prog->InfoLog = ralloc_strdup(prog, "");
+   prog->BinaryRetreivableHint = true;
+   return prog;
+}
+
+/**
+ * A binary is still accepted by a context whose extension string is at
+ * another address, as it is in another process.
+ */
+TEST_F(program_binary_test, extension_string_address)
+{
+   struct gl_shader_program *prog = create_program();
+
+   prog->LinkStatus = true;
+   prog->Version = 150;
+   _mesa_shader_cache_store_program(&ctx, prog);
+   ASSERT_TRUE(prog->Binary != NULL);
+
+   ctx.Extensions.String = (const GLubyte *) ralloc_strdup(mem_ctx, "");
+
+   struct gl_shader_program *loaded = create_program();
+
+   EXPECT_TRUE(_mesa_program_binary(&ctx, loaded, prog->Binary,
+                                    prog->BinaryLength));
+   EXPECT_TRUE(loaded->LinkStatus);
+   EXPECT_EQ(150u, loaded->Version);
+}
+
+/**
+ * A binary is rejected by a context with other extensions.
+ */
+TEST_F(program_binary_test, other_extensions)
+{
+   struct gl_shader_program *prog = create_program();
+
+   prog->LinkStatus = true;
+   _mesa_shader_cache_store_program(&ctx, prog);
+   ASSERT_TRUE(prog->Binary != NULL);
+
+   ctx.Extensions.ARB_gpu_shader5 = !ctx.Extensions.ARB_gpu_shader5;
+
+   struct gl_shader_program *loaded = create_program();
+
+   EXPECT_FALSE(_mesa_program_binary(&ctx, loaded, prog->Binary,
+                                     prog->BinaryLength));
+   EXPECT_FALSE(loaded->LinkStatus);
+}
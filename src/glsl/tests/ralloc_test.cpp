@@ -22,6 +22,8 @@
  */
 #include <gtest/gtest.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
 
 #include "ralloc.h"
 
@@ -36,3 +38,157 @@ TEST(ralloc_test, null_parent)
    EXPECT_EQ(NULL, ralloc_parent(mem_ctx));
 }
 /*@}*/
+
+/**
+ * \name Linear allocator
+ */
+/*@{*/
+TEST(ralloc_test, linear_parent)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *parent = linear_alloc_parent(mem_ctx, 24);
+
+   ASSERT_TRUE(parent != NULL);
+   EXPECT_EQ(mem_ctx, ralloc_parent_of_linear_parent(parent));
+
+   ralloc_free(mem_ctx);
+}
+
+TEST(ralloc_test, linear_children_dont_overlap)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *parent = linear_zalloc_parent(mem_ctx, 8);
+   unsigned char *children[1000];
+
+   /* Enough children of all sizes to need several buffers, with some
+    * larger than a buffer.
+    */
+   for (unsigned i = 0; i < 1000; i++) {
+      size_t size = (i % 37) * 7 + 1 + (i % 100 == 0 ? 10000 : 0);
+
+      children[i] = (unsigned char *) linear_zalloc_child(parent, size);
+      ASSERT_TRUE(children[i] != NULL);
+      EXPECT_EQ(0u, (uintptr_t) children[i] % 8);
+      for (size_t j = 0; j < size; j++)
+         ASSERT_EQ(0, children[i][j]);
+      memset(children[i], i & 0xff, size);
+   }
+
+   for (unsigned i = 0; i < 1000; i++) {
+      size_t size = (i % 37) * 7 + 1 + (i % 100 == 0 ? 10000 : 0);
+
+      for (size_t j = 0; j < size; j++)
+         ASSERT_EQ(i & 0xff, children[i][j]);
+   }
+
+   ralloc_free(mem_ctx);
+}
+
+TEST(ralloc_test, linear_strings)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *parent = linear_alloc_parent(mem_ctx, 0);
+
+   EXPECT_STREQ("gl_Position", linear_strdup(parent, "gl_Position"));
+   EXPECT_STREQ("vec4 main(42)",
+                linear_asprintf(parent, "%s %s(%d)", "vec4", "main", 42));
+   EXPECT_EQ(NULL, linear_strdup(parent, NULL));
+
+   ralloc_free(mem_ctx);
+}
+
+TEST(ralloc_test, linear_steal_and_free)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *other_ctx = ralloc_context(NULL);
+   void *parent = linear_alloc_parent(mem_ctx, 0);
+
+   for (unsigned i = 0; i < 1000; i++)
+      memset(linear_alloc_child(parent, 64), 0xff, 64);
+
+   ralloc_steal_linear_parent(other_ctx, parent);
+   EXPECT_EQ(other_ctx, ralloc_parent_of_linear_parent(parent));
+
+   /* The buffers must all have moved, so this can't free any. */
+   ralloc_free(mem_ctx);
+
+   for (unsigned i = 0; i < 1000; i++)
+      memset(linear_alloc_child(parent, 64), 0xff, 64);
+
+   linear_free_parent(parent);
+   ralloc_free(other_ctx);
+}
+/*@}*/
+
+/**
+ * \name Allocation throughput
+ *
+ * Not correctness tests: print the time taken to allocate, and then free,
+ * many small blocks the way the compiler allocates the nodes of a tree.
+ */
+/*@{*/
+namespace {
+
+const unsigned benchmark_blocks = 200000;
+
+double
+now(void)
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+size_t
+block_size(unsigned i)
+{
+   /* Mostly the sizes of AST and IR nodes, with a few strings. */
+   static const size_t sizes[] = { 48, 72, 16, 96, 40, 8, 136, 56 };
+   return sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+void
+print_throughput(const char *name, double alloc_time, double free_time)
+{
+   printf("%s: %.1f M allocations/s, freed in %.3f ms\n", name,
+          benchmark_blocks / alloc_time * 1e-6, free_time * 1000);
+}
+
+} /* anonymous namespace */
+
+TEST(ralloc_test, benchmark_ralloc)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *node = mem_ctx;
+   double start, alloc_time;
+
+   start = now();
+   for (unsigned i = 0; i < benchmark_blocks; i++) {
+      void *block = ralloc_size(node, block_size(i));
+
+      /* Build a tree a few levels deep, as expressions do. */
+      node = i % 4 == 3 ? mem_ctx : block;
+   }
+   alloc_time = now() - start;
+
+   start = now();
+   ralloc_free(mem_ctx);
+   print_throughput("ralloc_size", alloc_time, now() - start);
+}
+
+TEST(ralloc_test, benchmark_linear)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   void *parent = linear_alloc_parent(mem_ctx, 0);
+   double start, alloc_time;
+
+   start = now();
+   for (unsigned i = 0; i < benchmark_blocks; i++)
+      linear_alloc_child(parent, block_size(i));
+   alloc_time = now() - start;
+
+   start = now();
+   ralloc_free(mem_ctx);
+   print_throughput("linear_alloc_child", alloc_time, now() - start);
+}
+/*@}*/
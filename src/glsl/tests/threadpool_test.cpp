@@ -134,4 +134,21 @@ TEST(threadpool_test, basic)
    _mesa_threadpool_unref(pool);
 }
 
+TEST(threadpool_test, is_task_completed)
+{
+   struct _mesa_threadpool *pool;
+   struct _mesa_threadpool_task *task;
+   int val = 0;
+
+   pool = _mesa_threadpool_create(1);
+
+   task = _mesa_threadpool_queue_task(pool, basic_cb, (void *) &val);
+   while (!_mesa_threadpool_is_task_completed(task))
+      usleep(1000);
+   EXPECT_TRUE(val == 1);
+   EXPECT_TRUE(_mesa_threadpool_complete_task(pool, task));
+
+   _mesa_threadpool_unref(pool);
+}
+
 /*@}*/
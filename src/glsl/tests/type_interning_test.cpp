@@ -0,0 +1,246 @@
+/*
+ * Copyright © 2014 LunarG, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include "c11/threads.h"
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "glsl_types.h"
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 20
+#define TYPES_PER_ROUND 64
+
+TEST(type_interning, array_is_unique)
+{
+   const glsl_type *a = glsl_type::get_array_instance(glsl_type::vec4_type, 7);
+   const glsl_type *b = glsl_type::get_array_instance(glsl_type::vec4_type, 7);
+   const glsl_type *c = glsl_type::get_array_instance(glsl_type::vec4_type, 8);
+   const glsl_type *d = glsl_type::get_array_instance(glsl_type::vec3_type, 7);
+
+   EXPECT_EQ(a, b);
+   EXPECT_NE(a, c);
+   EXPECT_NE(a, d);
+   EXPECT_EQ(glsl_type::vec4_type, a->fields.array);
+   EXPECT_EQ(7u, a->length);
+}
+
+TEST(type_interning, record_is_unique)
+{
+   static const glsl_struct_field f[] = {
+      { glsl_type::vec4_type, "v", false },
+      { glsl_type::float_type, "s", false }
+   };
+   static const glsl_struct_field g[] = {
+      { glsl_type::vec4_type, "v", false },
+      { glsl_type::int_type, "s", false }
+   };
+
+   const glsl_type *a = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "S");
+   const glsl_type *b = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "S");
+   const glsl_type *c = glsl_type::get_record_instance(g, ARRAY_SIZE(g), "S");
+   const glsl_type *d = glsl_type::get_record_instance(f, ARRAY_SIZE(f), "T");
+
+   EXPECT_EQ(a, b);
+   EXPECT_NE(a, c);
+   EXPECT_NE(a, d);
+   EXPECT_STREQ("S", a->name);
+   EXPECT_EQ(2u, a->length);
+}
+
+TEST(type_interning, interface_is_unique)
+{
+   static const glsl_struct_field f[] = {
+      { glsl_type::vec4_type, "v", false }
+   };
+
+   const glsl_type *a =
+      glsl_type::get_interface_instance(f, ARRAY_SIZE(f),
+                                        GLSL_INTERFACE_PACKING_STD140, "I");
+   const glsl_type *b =
+      glsl_type::get_interface_instance(f, ARRAY_SIZE(f),
+                                        GLSL_INTERFACE_PACKING_STD140, "I");
+   const glsl_type *c =
+      glsl_type::get_interface_instance(f, ARRAY_SIZE(f),
+                                        GLSL_INTERFACE_PACKING_SHARED, "I");
+   const glsl_type *r =
+      glsl_type::get_record_instance(f, ARRAY_SIZE(f), "I");
+
+   EXPECT_EQ(a, b);
+   EXPECT_NE(a, c);
+   EXPECT_NE(a, r);
+   EXPECT_TRUE(a->is_interface());
+}
+
+struct stress_thread {
+   thrd_t thrd;
+   unsigned index;
+   unsigned round;
+   const glsl_type *arrays[TYPES_PER_ROUND];
+   const glsl_type *records[TYPES_PER_ROUND];
+   const glsl_type *interfaces[TYPES_PER_ROUND];
+};
+
+static glsl_struct_field stress_fields[2] = {
+   { NULL, "a", false },
+   { NULL, "b", false }
+};
+
+static char stress_names[NUM_ROUNDS][TYPES_PER_ROUND][32];
+
+static int
+stress_lookup(void *data)
+{
+   struct stress_thread *t = (struct stress_thread *) data;
+
+   /* Every thread walks the keys in a different order so that first
+    * insertions of a key race with lookups of it from other threads.
+    */
+   for (unsigned n = 0; n < TYPES_PER_ROUND; n++) {
+      const unsigned i = (n + t->index * 7) % TYPES_PER_ROUND;
+      const char *name = stress_names[t->round][i];
+
+      t->arrays[i] =
+         glsl_type::get_array_instance(glsl_type::vec4_type,
+                                       1000 + t->round * TYPES_PER_ROUND + i);
+      t->records[i] =
+         glsl_type::get_record_instance(stress_fields,
+                                        ARRAY_SIZE(stress_fields), name);
+      t->interfaces[i] =
+         glsl_type::get_interface_instance(stress_fields,
+                                           ARRAY_SIZE(stress_fields),
+                                           GLSL_INTERFACE_PACKING_STD140,
+                                           name);
+   }
+
+   return 0;
+}
+
+TEST(type_interning, concurrent_lookups_agree)
+{
+   struct stress_thread threads[NUM_THREADS];
+
+   stress_fields[0].type = glsl_type::vec4_type;
+   stress_fields[1].type = glsl_type::mat3_type;
+
+   for (unsigned round = 0; round < NUM_ROUNDS; round++) {
+      for (unsigned i = 0; i < TYPES_PER_ROUND; i++) {
+         snprintf(stress_names[round][i], sizeof(stress_names[round][i]),
+                  "stress_%u_%u", round, i);
+      }
+
+      for (unsigned t = 0; t < NUM_THREADS; t++) {
+         threads[t].index = t;
+         threads[t].round = round;
+         ASSERT_EQ(thrd_success,
+                   thrd_create(&threads[t].thrd, stress_lookup, &threads[t]));
+      }
+
+      for (unsigned t = 0; t < NUM_THREADS; t++)
+         thrd_join(threads[t].thrd, NULL);
+
+      for (unsigned i = 0; i < TYPES_PER_ROUND; i++) {
+         const glsl_type *array = threads[0].arrays[i];
+         const glsl_type *record = threads[0].records[i];
+         const glsl_type *iface = threads[0].interfaces[i];
+
+         ASSERT_TRUE(array->is_array());
+         EXPECT_EQ(glsl_type::vec4_type, array->fields.array);
+         EXPECT_EQ(1000 + round * TYPES_PER_ROUND + i, array->length);
+
+         ASSERT_TRUE(record->is_record());
+         EXPECT_STREQ(stress_names[round][i], record->name);
+         EXPECT_EQ(glsl_type::mat3_type, record->fields.structure[1].type);
+
+         ASSERT_TRUE(iface->is_interface());
+         EXPECT_NE(record, iface);
+
+         for (unsigned t = 1; t < NUM_THREADS; t++) {
+            EXPECT_EQ(array, threads[t].arrays[i]);
+            EXPECT_EQ(record, threads[t].records[i]);
+            EXPECT_EQ(iface, threads[t].interfaces[i]);
+         }
+      }
+
+      /* A key seen before the round is still found afterwards. */
+      EXPECT_EQ(threads[0].records[0],
+                glsl_type::get_record_instance(stress_fields,
+                                               ARRAY_SIZE(stress_fields),
+                                               stress_names[round][0]));
+   }
+}
+
+static double
+get_time(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int
+bench_lookup(void *data)
+{
+   unsigned *found = (unsigned *) data;
+
+   for (unsigned n = 0; n < 200000; n++) {
+      const char *name = stress_names[0][n % TYPES_PER_ROUND];
+
+      if (glsl_type::get_record_instance(stress_fields,
+                                         ARRAY_SIZE(stress_fields), name))
+         (*found)++;
+   }
+
+   return 0;
+}
+
+TEST(type_interning, lookup_throughput)
+{
+   thrd_t thrds[NUM_THREADS];
+   unsigned found[NUM_THREADS] = { 0 };
+
+   stress_fields[0].type = glsl_type::vec4_type;
+   stress_fields[1].type = glsl_type::mat3_type;
+   for (unsigned i = 0; i < TYPES_PER_ROUND; i++) {
+      snprintf(stress_names[0][i], sizeof(stress_names[0][i]),
+               "stress_0_%u", i);
+   }
+
+   const double start = get_time();
+
+   for (unsigned t = 0; t < NUM_THREADS; t++)
+      thrd_create(&thrds[t], bench_lookup, &found[t]);
+   for (unsigned t = 0; t < NUM_THREADS; t++)
+      thrd_join(thrds[t], NULL);
+
+   const double elapsed = get_time() - start;
+
+   for (unsigned t = 0; t < NUM_THREADS; t++)
+      EXPECT_EQ(200000u, found[t]);
+
+   printf("%d threads: %.1fM record lookups/s\n", NUM_THREADS,
+          NUM_THREADS * 200000 / elapsed / 1000000.0);
+}
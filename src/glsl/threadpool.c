@@ -22,6 +22,7 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+
 #include <stdio.h>
 #include <stdbool.h>
 #include "c11/threads.h"
@@ -29,6 +30,34 @@
 #include "main/simple_list.h"
 #include "threadpool.h"
 
+/*
+ * Atomic operations on ints.  They all imply a full memory barrier.
+ */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define pool_atomic_read(v) \
+   _InterlockedCompareExchange((volatile long *) (v), 0, 0)
+#define pool_atomic_set(v, i) \
+   ((void) _InterlockedExchange((volatile long *) (v), (i)))
+#define pool_atomic_inc_return(v) \
+   _InterlockedIncrement((volatile long *) (v))
+#define pool_atomic_dec_return(v) \
+   _InterlockedDecrement((volatile long *) (v))
+#define pool_atomic_cmpxchg(v, old, _new) \
+   _InterlockedCompareExchange((volatile long *) (v), (_new), (old))
+#else
+#define pool_atomic_read(v) __sync_add_and_fetch((v), 0)
+#define pool_atomic_set(v, i) \
+   do { __sync_synchronize(); (void) __sync_lock_test_and_set((v), (i)); } while (0)
+#define pool_atomic_inc_return(v) __sync_add_and_fetch((v), 1)
+#define pool_atomic_dec_return(v) __sync_sub_and_fetch((v), 1)
+#define pool_atomic_cmpxchg(v, old, _new) \
+   __sync_val_compare_and_swap((v), (old), (_new))
+#endif
+
+/* number of completed tasks a queue keeps around for reuse */
+#define MAX_FREE_TASKS 32
+
 enum _mesa_threadpool_control {
    MESA_THREADPOOL_NORMAL,    /* threads wait when there is no task */
    MESA_THREADPOOL_QUIT,      /* threads quit when there is no task */
@@ -39,13 +68,34 @@ enum _mesa_threadpool_task_state {
    MESA_THREADPOOL_TASK_PENDING,    /* task is on the pending list */
    MESA_THREADPOOL_TASK_ACTIVE,     /* task is being worked on */
    MESA_THREADPOOL_TASK_COMPLETED,  /* task has been completed */
-   MESA_THREADPOOL_TASK_CANCELLED   /* task is cancelled */
+   MESA_THREADPOOL_TASK_CANCELLED,  /* task is cancelled */
+
+   /* or'ed to the state when someone is waiting on the task */
+   MESA_THREADPOOL_TASK_WAITED = 0x10
+};
+
+/**
+ * The queue of pending tasks, shared by all threads.  It has a mutex of its
+ * own so that queuing and picking up tasks does not contend with spawning
+ * and waking up threads.
+ */
+struct _mesa_threadpool_queue {
+   /* these are protected by the queue's mutex */
+   mtx_t mutex;
+   struct simple_node tasks;
+   struct _mesa_threadpool_task *free_tasks;
+   int num_free_tasks;
 };
 
 struct _mesa_threadpool_task {
-   /* these are protected by the pool's mutex */
+   /* these are protected by the queue's mutex */
    struct simple_node link; /* must be the first */
-   enum _mesa_threadpool_task_state state;
+   struct _mesa_threadpool_task *next_free;
+
+   int state; /* atomic */
+
+   /* for waiting on the task */
+   mtx_t mutex;
    cnd_t completed;
 
    void (*func)(void *);
@@ -55,18 +105,21 @@ struct _mesa_threadpool_task {
 struct _mesa_threadpool {
    mtx_t mutex;
    int refcnt;
-   bool shutdown;
+   int shutdown; /* atomic */
 
-   enum _mesa_threadpool_control thread_control;
+   int thread_control; /* atomic, and changed with the mutex held */
    thrd_t *threads;
-   int num_threads, max_threads;
-   int idle_threads; /* number of threads that are idle */
+   int num_threads; /* atomic, and changed with the mutex held */
+   int max_threads;
+   int idle_threads; /* atomic, number of threads that are idle */
    cnd_t thread_wakeup;
    cnd_t thread_joined;
 
-   struct simple_node pending_tasks;
-   int num_pending_tasks;
-   int num_tasks;
+   struct _mesa_threadpool_queue queue;
+
+   int num_producers; /* atomic, number of threads queuing tasks locklessly */
+   int num_pending_tasks; /* atomic */
+   int num_tasks; /* atomic */
 };
 
 static struct _mesa_threadpool_task *
@@ -78,7 +131,13 @@ task_create(void)
    if (!task)
       return NULL;
 
+   if (mtx_init(&task->mutex, mtx_plain)) {
+      free(task);
+      return NULL;
+   }
+
    if (cnd_init(&task->completed)) {
+      mtx_destroy(&task->mutex);
       free(task);
       return NULL;
    }
@@ -92,55 +151,207 @@ static void
 task_destroy(struct _mesa_threadpool_task *task)
 {
    cnd_destroy(&task->completed);
+   mtx_destroy(&task->mutex);
    free(task);
 }
 
+/**
+ * Get a task from the free list of \p pool, or create one.
+ */
+static struct _mesa_threadpool_task *
+task_get(struct _mesa_threadpool *pool)
+{
+   struct _mesa_threadpool_queue *queue = &pool->queue;
+   struct _mesa_threadpool_task *task;
+
+   mtx_lock(&queue->mutex);
+   task = queue->free_tasks;
+   if (task) {
+      queue->free_tasks = task->next_free;
+      queue->num_free_tasks--;
+   }
+   mtx_unlock(&queue->mutex);
+
+   if (!task) {
+      task = task_create();
+      if (!task)
+         return NULL;
+   }
+
+   task->state = MESA_THREADPOOL_TASK_PENDING;
+
+   return task;
+}
+
+/**
+ * Return a task, that no one else refers to, to \p pool for reuse.
+ */
+static void
+task_put(struct _mesa_threadpool *pool, struct _mesa_threadpool_task *task)
+{
+   struct _mesa_threadpool_queue *queue = &pool->queue;
+
+   mtx_lock(&queue->mutex);
+   if (queue->num_free_tasks < MAX_FREE_TASKS) {
+      task->next_free = queue->free_tasks;
+      queue->free_tasks = task;
+      queue->num_free_tasks++;
+      task = NULL;
+   }
+   mtx_unlock(&queue->mutex);
+
+   if (task)
+      task_destroy(task);
+}
+
+/**
+ * Move \p task from \p from to the final state \p to, and wake up the waiter
+ * if there is one.  This must be the last access to \p task.
+ */
+static void
+task_finish(struct _mesa_threadpool_task *task,
+            enum _mesa_threadpool_task_state from,
+            enum _mesa_threadpool_task_state to)
+{
+   if (pool_atomic_cmpxchg(&task->state, (int) from, (int) to) == (int) from)
+      return;
+
+   /* the waiter is about to or already waits on the condition variable */
+   mtx_lock(&task->mutex);
+   pool_atomic_set(&task->state, to);
+   cnd_broadcast(&task->completed);
+   mtx_unlock(&task->mutex);
+}
+
+/**
+ * Wait until \p task leaves the active state.
+ */
+static void
+task_wait(struct _mesa_threadpool_task *task)
+{
+   mtx_lock(&task->mutex);
+
+   while (true) {
+      const int state = pool_atomic_read(&task->state);
+
+      if (state == MESA_THREADPOOL_TASK_COMPLETED ||
+          state == MESA_THREADPOOL_TASK_CANCELLED)
+         break;
+
+      if (!(state & MESA_THREADPOOL_TASK_WAITED) &&
+          pool_atomic_cmpxchg(&task->state, state,
+                              state | MESA_THREADPOOL_TASK_WAITED) != state)
+         continue;
+
+      cnd_wait(&task->completed, &task->mutex);
+   }
+
+   mtx_unlock(&task->mutex);
+}
+
+static void
+queue_push(struct _mesa_threadpool *pool, struct _mesa_threadpool_task *task)
+{
+   struct _mesa_threadpool_queue *queue = &pool->queue;
+
+   mtx_lock(&queue->mutex);
+   insert_at_tail(&queue->tasks, &task->link);
+   pool_atomic_inc_return(&pool->num_pending_tasks);
+   mtx_unlock(&queue->mutex);
+}
+
+/**
+ * Remove \p task from the queue.  The queue's mutex must be held.
+ */
+static void
+queue_remove_locked(struct _mesa_threadpool *pool,
+                    struct _mesa_threadpool_task *task)
+{
+   remove_from_list(&task->link);
+   pool_atomic_dec_return(&pool->num_pending_tasks);
+}
+
+static struct _mesa_threadpool_task *
+queue_pop(struct _mesa_threadpool *pool)
+{
+   struct _mesa_threadpool_queue *queue = &pool->queue;
+   struct _mesa_threadpool_task *task = NULL;
+
+   mtx_lock(&queue->mutex);
+   if (!is_empty_list(&queue->tasks)) {
+      task = (struct _mesa_threadpool_task *) first_elem(&queue->tasks);
+      queue_remove_locked(pool, task);
+      pool_atomic_set(&task->state, MESA_THREADPOOL_TASK_ACTIVE);
+   }
+   mtx_unlock(&queue->mutex);
+
+   return task;
+}
+
 static int
 _mesa_threadpool_worker(void *arg)
 {
    struct _mesa_threadpool *pool = (struct _mesa_threadpool *) arg;
 
-   mtx_lock(&pool->mutex);
-
    while (true) {
       struct _mesa_threadpool_task *task;
+      int control;
+
+      if (pool_atomic_read(&pool->thread_control) == MESA_THREADPOOL_QUIT_NOW)
+         break;
+
+      task = queue_pop(pool);
+      if (task) {
+         /* do the work! */
+         task->func(task->data);
+         task_finish(task, MESA_THREADPOOL_TASK_ACTIVE,
+               MESA_THREADPOOL_TASK_COMPLETED);
+         continue;
+      }
+
+      mtx_lock(&pool->mutex);
 
       /* wait until there are tasks */
-      while (is_empty_list(&pool->pending_tasks) &&
-             pool->thread_control == MESA_THREADPOOL_NORMAL) {
-         pool->idle_threads++;
+      pool_atomic_inc_return(&pool->idle_threads);
+      while (!pool_atomic_read(&pool->num_pending_tasks) &&
+             pool_atomic_read(&pool->thread_control) ==
+             MESA_THREADPOOL_NORMAL)
          cnd_wait(&pool->thread_wakeup, &pool->mutex);
-         pool->idle_threads--;
-      }
+      pool_atomic_dec_return(&pool->idle_threads);
 
-      if (pool->thread_control != MESA_THREADPOOL_NORMAL) {
-         if (pool->thread_control == MESA_THREADPOOL_QUIT_NOW ||
-             is_empty_list(&pool->pending_tasks))
+      control = pool_atomic_read(&pool->thread_control);
+      if (control != MESA_THREADPOOL_NORMAL) {
+         if (control == MESA_THREADPOOL_QUIT_NOW ||
+             !pool_atomic_read(&pool->num_pending_tasks)) {
+            mtx_unlock(&pool->mutex);
             break;
+         }
       }
 
-      assert(!is_empty_list(&pool->pending_tasks));
-      task = (struct _mesa_threadpool_task *)
-         first_elem(&pool->pending_tasks);
-      remove_from_list(&task->link);
-      pool->num_pending_tasks--;
-
-      task->state = MESA_THREADPOOL_TASK_ACTIVE;
-
-      /* do the work! */
       mtx_unlock(&pool->mutex);
-      task->func(task->data);
-      mtx_lock(&pool->mutex);
-
-      task->state = MESA_THREADPOOL_TASK_COMPLETED;
-      cnd_signal(&task->completed);
    }
 
-   mtx_unlock(&pool->mutex);
-
    return 0;
 }
 
+/**
+ * Spawn a thread if all threads are busy.  The pool's mutex must be held.
+ */
+static void
+pool_spawn_thread_locked(struct _mesa_threadpool *pool)
+{
+   const int num_threads = pool_atomic_read(&pool->num_threads);
+
+   if (pool_atomic_read(&pool->idle_threads) >
+       pool_atomic_read(&pool->num_pending_tasks) ||
+       num_threads >= pool->max_threads)
+      return;
+
+   if (!thrd_create(&pool->threads[num_threads], _mesa_threadpool_worker,
+                    (void *) pool))
+      pool_atomic_inc_return(&pool->num_threads);
+}
+
 /**
  * Queue a new task.
  */
@@ -150,54 +361,86 @@ _mesa_threadpool_queue_task(struct _mesa_threadpool *pool,
 {
    struct _mesa_threadpool_task *task;
 
-   task = task_create();
+   task = task_get(pool);
    if (!task)
       return NULL;
 
    task->func = func;
    task->data = data;
 
-   mtx_lock(&pool->mutex);
-
-   if (unlikely(pool->shutdown)) {
-      mtx_unlock(&pool->mutex);
-      free(task);
-      return NULL;
+   /*
+    * Queue the task without taking the pool's mutex when the pool is in the
+    * normal state and no thread needs to be spawned.  The pool does not
+    * leave the normal state until there is no such producer.
+    */
+   pool_atomic_inc_return(&pool->num_producers);
+   if (likely(pool_atomic_read(&pool->thread_control) ==
+              MESA_THREADPOOL_NORMAL &&
+              !pool_atomic_read(&pool->shutdown) &&
+              (pool_atomic_read(&pool->num_threads) == pool->max_threads ||
+               pool_atomic_read(&pool->idle_threads) >
+               pool_atomic_read(&pool->num_pending_tasks)))) {
+      queue_push(pool, task);
+      pool_atomic_dec_return(&pool->num_producers);
    }
+   else {
+      pool_atomic_dec_return(&pool->num_producers);
 
-   while (unlikely(pool->thread_control != MESA_THREADPOOL_NORMAL))
-      cnd_wait(&pool->thread_joined, &pool->mutex);
+      mtx_lock(&pool->mutex);
 
-   /* spawn threads as needed */
-   if (pool->idle_threads <= pool->num_pending_tasks &&
-       pool->num_threads < pool->max_threads) {
-      int err;
+      while (unlikely(pool_atomic_read(&pool->thread_control) !=
+                      MESA_THREADPOOL_NORMAL))
+         cnd_wait(&pool->thread_joined, &pool->mutex);
 
-      err = thrd_create(&pool->threads[pool->num_threads],
-                        _mesa_threadpool_worker, (void *) pool);
-      if (!err)
-         pool->num_threads++;
+      if (unlikely(pool_atomic_read(&pool->shutdown))) {
+         mtx_unlock(&pool->mutex);
+         task_put(pool, task);
+         return NULL;
+      }
 
-      if (!pool->num_threads) {
+      /* spawn threads as needed */
+      pool_spawn_thread_locked(pool);
+      if (!pool_atomic_read(&pool->num_threads)) {
          mtx_unlock(&pool->mutex);
-         task_destroy(task);
+         task_put(pool, task);
          return NULL;
       }
+
+      queue_push(pool, task);
+
+      mtx_unlock(&pool->mutex);
    }
 
-   insert_at_tail(&pool->pending_tasks, &task->link);
-   pool->num_tasks++;
-   pool->num_pending_tasks++;
-   cnd_signal(&pool->thread_wakeup);
+   pool_atomic_inc_return(&pool->num_tasks);
 
-   mtx_unlock(&pool->mutex);
+   if (pool_atomic_read(&pool->idle_threads)) {
+      mtx_lock(&pool->mutex);
+      cnd_signal(&pool->thread_wakeup);
+      mtx_unlock(&pool->mutex);
+   }
 
    return task;
 }
 
+/**
+ * Return true if \p task has been completed or cancelled, that is, if
+ * _mesa_threadpool_complete_task() will not block.  This does not lock.
+ */
+bool
+_mesa_threadpool_is_task_completed(const struct _mesa_threadpool_task *task)
+{
+   const int state =
+      pool_atomic_read((int *) &task->state) & ~MESA_THREADPOOL_TASK_WAITED;
+
+   return (state == MESA_THREADPOOL_TASK_COMPLETED ||
+           state == MESA_THREADPOOL_TASK_CANCELLED);
+}
+
 /**
  * Wait for \p task to complete, and destroy it.  If \p task cannot not be
  * completed, return false.
+ *
+ * A task that no thread has started working on is run by the caller.
  */
 bool
 _mesa_threadpool_complete_task(struct _mesa_threadpool *pool,
@@ -205,22 +448,32 @@ _mesa_threadpool_complete_task(struct _mesa_threadpool *pool,
 {
    bool completed;
 
-   mtx_lock(&pool->mutex);
+   if (pool_atomic_read(&task->state) == MESA_THREADPOOL_TASK_PENDING) {
+      struct _mesa_threadpool_queue *queue = &pool->queue;
+      bool claimed = false;
 
-   /* make it the next active task */
-   if (task->state == MESA_THREADPOOL_TASK_PENDING)
-      move_to_head(&pool->pending_tasks, &task->link);
+      /* the state can only leave pending with the queue's mutex held */
+      mtx_lock(&queue->mutex);
+      if (pool_atomic_read(&task->state) == MESA_THREADPOOL_TASK_PENDING) {
+         queue_remove_locked(pool, task);
+         pool_atomic_set(&task->state, MESA_THREADPOOL_TASK_ACTIVE);
+         claimed = true;
+      }
+      mtx_unlock(&queue->mutex);
 
-   while (task->state != MESA_THREADPOOL_TASK_COMPLETED &&
-          task->state != MESA_THREADPOOL_TASK_CANCELLED)
-      cnd_wait(&task->completed, &pool->mutex);
+      if (claimed) {
+         task->func(task->data);
+         pool_atomic_set(&task->state, MESA_THREADPOOL_TASK_COMPLETED);
+      }
+   }
 
-   completed = (task->state == MESA_THREADPOOL_TASK_COMPLETED);
-   pool->num_tasks--;
+   task_wait(task);
 
-   mtx_unlock(&pool->mutex);
+   completed = (pool_atomic_read(&task->state) ==
+                MESA_THREADPOOL_TASK_COMPLETED);
+   pool_atomic_dec_return(&pool->num_tasks);
 
-   task_destroy(task);
+   task_put(pool, task);
 
    return completed;
 }
@@ -228,23 +481,23 @@ _mesa_threadpool_complete_task(struct _mesa_threadpool *pool,
 static void
 pool_cancel_pending_tasks(struct _mesa_threadpool *pool)
 {
+   struct _mesa_threadpool_queue *queue = &pool->queue;
    struct simple_node *node, *temp;
 
-   if (is_empty_list(&pool->pending_tasks))
-      return;
+   mtx_lock(&queue->mutex);
 
-   foreach_s(node, temp, &pool->pending_tasks) {
+   foreach_s(node, temp, &queue->tasks) {
       struct _mesa_threadpool_task *task =
          (struct _mesa_threadpool_task *) node;
 
-      remove_from_list(&task->link);
-      task->state = MESA_THREADPOOL_TASK_CANCELLED;
+      queue_remove_locked(pool, task);
 
       /* in case some thread is already waiting */
-      cnd_signal(&task->completed);
+      task_finish(task, MESA_THREADPOOL_TASK_PENDING,
+            MESA_THREADPOOL_TASK_CANCELLED);
    }
 
-   pool->num_pending_tasks = 0;
+   mtx_unlock(&queue->mutex);
 }
 
 static void
@@ -252,14 +505,19 @@ pool_join_threads(struct _mesa_threadpool *pool, bool graceful)
 {
    int joined_threads = 0;
 
-   if (!pool->num_threads)
+   if (!pool_atomic_read(&pool->num_threads))
       return;
 
-   pool->thread_control = (graceful) ?
-      MESA_THREADPOOL_QUIT : MESA_THREADPOOL_QUIT_NOW;
+   pool_atomic_set(&pool->thread_control, (graceful) ?
+         MESA_THREADPOOL_QUIT : MESA_THREADPOOL_QUIT_NOW);
 
-   while (joined_threads < pool->num_threads) {
-      int i = joined_threads, num_threads = pool->num_threads;
+   /* wait for the producers that did not see the control change */
+   while (pool_atomic_read(&pool->num_producers))
+      thrd_yield();
+
+   while (joined_threads < pool_atomic_read(&pool->num_threads)) {
+      const int num_threads = pool_atomic_read(&pool->num_threads);
+      int i = joined_threads;
 
       cnd_broadcast(&pool->thread_wakeup);
       mtx_unlock(&pool->mutex);
@@ -270,9 +528,9 @@ pool_join_threads(struct _mesa_threadpool *pool, bool graceful)
       joined_threads = num_threads;
    }
 
-   pool->thread_control = MESA_THREADPOOL_NORMAL;
-   pool->num_threads = 0;
-   assert(!pool->idle_threads);
+   pool_atomic_set(&pool->thread_control, MESA_THREADPOOL_NORMAL);
+   pool_atomic_set(&pool->num_threads, 0);
+   assert(!pool_atomic_read(&pool->idle_threads));
 }
 
 /**
@@ -285,10 +543,11 @@ _mesa_threadpool_join(struct _mesa_threadpool *pool, bool graceful)
    mtx_lock(&pool->mutex);
 
    /* someone is already joining with the threads */
-   while (unlikely(pool->thread_control != MESA_THREADPOOL_NORMAL))
+   while (unlikely(pool_atomic_read(&pool->thread_control) !=
+                   MESA_THREADPOOL_NORMAL))
       cnd_wait(&pool->thread_joined, &pool->mutex);
 
-   if (pool->num_threads) {
+   if (pool_atomic_read(&pool->num_threads)) {
       pool_join_threads(pool, graceful);
       /* wake up whoever is waiting */
       cnd_broadcast(&pool->thread_joined);
@@ -297,8 +556,8 @@ _mesa_threadpool_join(struct _mesa_threadpool *pool, bool graceful)
    if (!graceful)
       pool_cancel_pending_tasks(pool);
 
-   assert(pool->num_threads == 0);
-   assert(is_empty_list(&pool->pending_tasks) && !pool->num_pending_tasks);
+   assert(pool_atomic_read(&pool->num_threads) == 0);
+   assert(!pool_atomic_read(&pool->num_pending_tasks));
 
    mtx_unlock(&pool->mutex);
 }
@@ -310,10 +569,25 @@ static void
 _mesa_threadpool_set_shutdown(struct _mesa_threadpool *pool)
 {
    mtx_lock(&pool->mutex);
-   pool->shutdown = true;
+   pool_atomic_set(&pool->shutdown, true);
    mtx_unlock(&pool->mutex);
 }
 
+static void
+pool_destroy_queue(struct _mesa_threadpool *pool)
+{
+   struct _mesa_threadpool_queue *queue = &pool->queue;
+
+   while (queue->free_tasks) {
+      struct _mesa_threadpool_task *task = queue->free_tasks;
+
+      queue->free_tasks = task->next_free;
+      task_destroy(task);
+   }
+
+   mtx_destroy(&queue->mutex);
+}
+
 /**
  * Decrease the reference count.  Destroy \p pool when the reference count
  * reaches zero.
@@ -336,6 +610,7 @@ _mesa_threadpool_unref(struct _mesa_threadpool *pool)
                pool->num_tasks);
       }
 
+      pool_destroy_queue(pool);
       free(pool->threads);
       cnd_destroy(&pool->thread_joined);
       cnd_destroy(&pool->thread_wakeup);
@@ -406,7 +681,8 @@ _mesa_threadpool_create(int max_threads)
 
    pool->max_threads = max_threads;
 
-   make_empty_list(&pool->pending_tasks);
+   mtx_init(&pool->queue.mutex, mtx_plain);
+   make_empty_list(&pool->queue.tasks);
 
    return pool;
 }
@@ -55,6 +55,9 @@ bool
 _mesa_threadpool_complete_task(struct _mesa_threadpool *pool,
                                struct _mesa_threadpool_task *task);
 
+bool
+_mesa_threadpool_is_task_completed(const struct _mesa_threadpool_task *task);
+
 struct _mesa_threadpool *
 _mesa_glsl_get_threadpool(int max_threads);
 
@@ -298,6 +298,11 @@ DRI_CONF_OPT_BEGIN(multithread_glsl_compiler, int, def) \
         DRI_CONF_DESC(en,gettext("Enable multithreading in the GLSL compiler")) \
 DRI_CONF_OPT_END
 
+#define DRI_CONF_DEFERRED_GLSL_LINKER(def) \
+DRI_CONF_OPT_BEGIN_B(deferred_glsl_linker, def) \
+        DRI_CONF_DESC(en,gettext("Defer GLSL program linking to the GLSL compiler threads")) \
+DRI_CONF_OPT_END
+
 
 /**
  * \brief Software-fallback options.  To allow using features (like
@@ -556,6 +556,9 @@ brw_process_driconf_options(struct brw_context *brw)
          multithread_glsl_compiler : 2;
 
       _mesa_enable_glsl_threadpool(ctx, max_threads);
+
+      ctx->Const.DeferLinkProgram =
+         driQueryOptionb(options, "deferred_glsl_linker");
    }
 }
 
@@ -85,6 +85,97 @@ public:
     * its children, or just the issue_time if it's a leaf node.
     */
    int delay;
+
+   /**
+    * Whether this node is ordered after everything before it and before
+    * everything after it, so the barrier deps of other nodes can stop here.
+    */
+   bool is_barrier;
+
+   /**
+    * Where this node sits in the list of candidates for scheduling, lower
+    * numbers being nearer the head.  Nodes that become candidates are
+    * pushed on the head of the list.
+    */
+   int ready_order;
+
+   /**
+    * Scratch space for remove_duplicate_deps(): the last node whose
+    * children this node was found among, and at which index.
+    */
+   schedule_node *dup_check_parent;
+   int dup_check_index;
+};
+
+/**
+ * Binary min-heap of candidates for scheduling, ordered by unblocked_time
+ * and then by position in the candidate list.
+ *
+ * This finds the same instruction as scanning the whole candidate list for
+ * the earliest unblocked_time, in logarithmic rather than linear time.
+ */
+class schedule_heap {
+public:
+   void init(void *mem_ctx, int size)
+   {
+      this->nodes = ralloc_array(mem_ctx, schedule_node *, size);
+      this->count = 0;
+   }
+
+   bool is_empty() const
+   {
+      return count == 0;
+   }
+
+   schedule_node *top() const
+   {
+      return count ? nodes[0] : NULL;
+   }
+
+   static bool before(const schedule_node *a, const schedule_node *b)
+   {
+      return (a->unblocked_time < b->unblocked_time ||
+              (a->unblocked_time == b->unblocked_time &&
+               a->ready_order < b->ready_order));
+   }
+
+   void push(schedule_node *n)
+   {
+      int i = count++;
+
+      while (i > 0 && before(n, nodes[(i - 1) / 2])) {
+         nodes[i] = nodes[(i - 1) / 2];
+         i = (i - 1) / 2;
+      }
+      nodes[i] = n;
+   }
+
+   schedule_node *pop()
+   {
+      schedule_node *n = nodes[0];
+      schedule_node *last = nodes[--count];
+      int i = 0;
+
+      for (;;) {
+         int child = 2 * i + 1;
+
+         if (child >= count)
+            break;
+         if (child + 1 < count && before(nodes[child + 1], nodes[child]))
+            child++;
+         if (!before(nodes[child], last))
+            break;
+
+         nodes[i] = nodes[child];
+         i = child;
+      }
+      nodes[i] = last;
+
+      return n;
+   }
+
+   schedule_node **nodes;
+   int count;
 };
 
 void
@@ -404,6 +495,11 @@ public:
       this->post_reg_alloc = (mode == SCHEDULE_POST);
       this->mode = mode;
       this->time = 0;
+      /* The register pressure heuristics look at the whole candidate list
+       * each time, so only the other modes can keep it as a heap.
+       */
+      this->use_ready_heap = (mode != SCHEDULE_PRE_NON_LIFO &&
+                              mode != SCHEDULE_PRE_LIFO);
       if (!post_reg_alloc) {
          this->remaining_grf_uses = rzalloc_array(mem_ctx, int, grf_count);
          this->grf_active = rzalloc_array(mem_ctx, bool, grf_count);
@@ -420,6 +516,13 @@ public:
    void add_barrier_deps(schedule_node *n);
    void add_dep(schedule_node *before, schedule_node *after, int latency);
    void add_dep(schedule_node *before, schedule_node *after);
+   void remove_duplicate_deps();
+
+   schedule_heap *ready_heap(schedule_node *n);
+   void add_ready(schedule_node *n);
+   void remove_ready(schedule_node *n);
+   schedule_node *earliest_ready();
+   void delay_ready_math(int until);
 
    void run(exec_list *instructions);
    void add_inst(backend_instruction *inst);
@@ -453,6 +556,16 @@ public:
 
    instruction_scheduler_mode mode;
 
+   /**
+    * Whether the candidates for scheduling are kept in the ready heaps
+    * rather than in the instructions list, which is then empty.
+    */
+   bool use_ready_heap;
+   schedule_heap ready;
+   /** Candidates using the shared math unit, see delay_ready_math(). */
+   schedule_heap ready_math;
+   int next_ready_order;
+
    /**
     * Number of instructions left to schedule that reference each vgrf.
     *
@@ -611,6 +724,10 @@ schedule_node::schedule_node(backend_instruction *inst,
    this->unblocked_time = 0;
    this->cand_generation = 0;
    this->delay = 0;
+   this->is_barrier = false;
+   this->ready_order = 0;
+   this->dup_check_parent = NULL;
+   this->dup_check_index = 0;
 
    /* We can't measure Gen6 timings directly but expect them to be much
     * closer to Gen7 than Gen4.
@@ -657,6 +774,10 @@ instruction_scheduler::compute_delay(schedule_node *n)
  *
  * The @after node will be scheduled after @before.  We will try to
  * schedule it @latency cycles after @before, but no guarantees there.
+ *
+ * The same dependency may be added several times while calculating deps;
+ * remove_duplicate_deps() merges them afterwards, rather than each call
+ * searching all the children of @before.
  */
 void
 instruction_scheduler::add_dep(schedule_node *before, schedule_node *after,
@@ -667,13 +788,6 @@ instruction_scheduler::add_dep(schedule_node *before, schedule_node *after,
 
    assert(before != after);
 
-   for (int i = 0; i < before->child_count; i++) {
-      if (before->children[i] == after) {
-	 before->child_latency[i] = MAX2(before->child_latency[i], latency);
-	 return;
-      }
-   }
-
    if (before->child_array_size <= before->child_count) {
       if (before->child_array_size < 16)
 	 before->child_array_size = 16;
@@ -702,10 +816,48 @@ instruction_scheduler::add_dep(schedule_node *before, schedule_node *after)
    add_dep(before, after, before->latency);
 }
 
+/**
+ * Merge repeated deps between the same two nodes into one, with the
+ * largest of their latencies, keeping the children in the order they were
+ * first added.
+ */
+void
+instruction_scheduler::remove_duplicate_deps()
+{
+   foreach_list(node, &instructions) {
+      schedule_node *n = (schedule_node *)node;
+      int count = 0;
+
+      for (int i = 0; i < n->child_count; i++) {
+         schedule_node *child = n->children[i];
+
+         if (child->dup_check_parent == n) {
+            int j = child->dup_check_index;
+
+            n->child_latency[j] = MAX2(n->child_latency[j],
+                                       n->child_latency[i]);
+            child->parent_count--;
+            continue;
+         }
+
+         child->dup_check_parent = n;
+         child->dup_check_index = count;
+         n->children[count] = child;
+         n->child_latency[count] = n->child_latency[i];
+         count++;
+      }
+
+      n->child_count = count;
+   }
+}
+
 /**
  * Sometimes we really want this node to execute after everything that
  * was before it and before everything that followed it.  This adds
  * the deps to do so.
+ *
+ * The deps stop at the nearest other barriers in either direction, which
+ * are already ordered against everything beyond them.
  */
 void
 instruction_scheduler::add_barrier_deps(schedule_node *n)
@@ -716,6 +868,8 @@ instruction_scheduler::add_barrier_deps(schedule_node *n)
    if (prev) {
       while (!prev->is_head_sentinel()) {
 	 add_dep(prev, n, 0);
+	 if (prev->is_barrier)
+	    break;
 	 prev = (schedule_node *)prev->prev;
       }
    }
@@ -723,6 +877,8 @@ instruction_scheduler::add_barrier_deps(schedule_node *n)
    if (next) {
       while (!next->is_tail_sentinel()) {
 	 add_dep(n, next, 0);
+	 if (next->is_barrier)
+	    break;
 	 next = (schedule_node *)next->next;
       }
    }
@@ -739,6 +895,35 @@ fs_instruction_scheduler::is_compressed(fs_inst *inst)
 	   !inst->force_sechalf);
 }
 
+/**
+ * Whether calculate_deps() adds barrier deps for \p inst, which is either
+ * an fs_inst or a vec4_instruction.
+ */
+template<class inst_type> static bool
+is_scheduling_barrier(inst_type *inst)
+{
+   if (inst->opcode == FS_OPCODE_PLACEHOLDER_HALT ||
+       inst->is_control_flow() ||
+       inst->has_side_effects())
+      return true;
+
+   for (int i = 0; i < 3; i++) {
+      if (inst->src[i].file != GRF &&
+          !(inst->src[i].file == HW_REG &&
+            inst->src[i].fixed_hw_reg.file == BRW_GENERAL_REGISTER_FILE) &&
+          inst->src[i].file != BAD_FILE &&
+          inst->src[i].file != IMM &&
+          inst->src[i].file != UNIFORM)
+         return true;
+   }
+
+   return (inst->dst.file != GRF &&
+           inst->dst.file != MRF &&
+           !(inst->dst.file == HW_REG &&
+             inst->dst.fixed_hw_reg.file == BRW_GENERAL_REGISTER_FILE) &&
+           inst->dst.file != BAD_FILE);
+}
+
 void
 fs_instruction_scheduler::calculate_deps()
 {
@@ -758,6 +943,11 @@ fs_instruction_scheduler::calculate_deps()
    schedule_node *last_fixed_grf_write = NULL;
    int reg_width = v->dispatch_width / 8;
 
+   foreach_list(node, &instructions) {
+      schedule_node *n = (schedule_node *)node;
+      n->is_barrier = is_scheduling_barrier((fs_inst *)n->inst);
+   }
+
    /* The last instruction always needs to still be the last
     * instruction.  Either it's flow control (IF, ELSE, ENDIF, DO,
     * WHILE) and scheduling other things after it would disturb the
@@ -988,6 +1178,11 @@ vec4_instruction_scheduler::calculate_deps()
     */
    schedule_node *last_fixed_grf_write = NULL;
 
+   foreach_list(node, &instructions) {
+      schedule_node *n = (schedule_node *)node;
+      n->is_barrier = is_scheduling_barrier((vec4_instruction *)n->inst);
+   }
+
    /* The last instruction always needs to still be the last instruction.
     * Either it's flow control (IF, ELSE, ENDIF, DO, WHILE) and scheduling
     * other things after it would disturb the basic block, or it's the EOT
@@ -1141,19 +1336,10 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
    schedule_node *chosen = NULL;
 
    if (mode == SCHEDULE_PRE || mode == SCHEDULE_POST) {
-      int chosen_time = 0;
-
       /* Of the instructions ready to execute or the closest to
        * being ready, choose the oldest one.
        */
-      foreach_list(node, &instructions) {
-         schedule_node *n = (schedule_node *)node;
-
-         if (!chosen || n->unblocked_time < chosen_time) {
-            chosen = n;
-            chosen_time = n->unblocked_time;
-         }
-      }
+      chosen = earliest_ready();
    } else {
       /* Before register allocation, we don't care about the latencies of
        * instructions.  All we care about is reducing live intervals of
@@ -1250,22 +1436,10 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
 schedule_node *
 vec4_instruction_scheduler::choose_instruction_to_schedule()
 {
-   schedule_node *chosen = NULL;
-   int chosen_time = 0;
-
    /* Of the instructions ready to execute or the closest to being ready,
     * choose the oldest one.
     */
-   foreach_list(node, &instructions) {
-      schedule_node *n = (schedule_node *)node;
-
-      if (!chosen || n->unblocked_time < chosen_time) {
-         chosen = n;
-         chosen_time = n->unblocked_time;
-      }
-   }
-
-   return chosen;
+   return earliest_ready();
 }
 
 int
@@ -1284,25 +1458,126 @@ vec4_instruction_scheduler::issue_time(backend_instruction *inst)
    return 2;
 }
 
+schedule_heap *
+instruction_scheduler::ready_heap(schedule_node *n)
+{
+   return n->inst->is_math() ? &ready_math : &ready;
+}
+
+/**
+ * Add \p n to the candidates for scheduling, at the head of the list.
+ */
+void
+instruction_scheduler::add_ready(schedule_node *n)
+{
+   if (use_ready_heap) {
+      n->ready_order = --next_ready_order;
+      ready_heap(n)->push(n);
+   } else {
+      instructions.push_head(n);
+   }
+}
+
+void
+instruction_scheduler::remove_ready(schedule_node *n)
+{
+   if (use_ready_heap) {
+      assert(n == ready_heap(n)->top());
+      ready_heap(n)->pop();
+   } else {
+      n->remove();
+   }
+}
+
+/**
+ * Returns the candidate with the earliest unblocked_time, the first one in
+ * the list if there are several.
+ */
+schedule_node *
+instruction_scheduler::earliest_ready()
+{
+   if (use_ready_heap) {
+      schedule_node *n = ready.top();
+      schedule_node *math = ready_math.top();
+
+      if (!n || (math && schedule_heap::before(math, n)))
+         return math;
+      return n;
+   }
+
+   schedule_node *chosen = NULL;
+
+   foreach_list(node, &instructions) {
+      schedule_node *n = (schedule_node *)node;
+
+      if (!chosen || n->unblocked_time < chosen->unblocked_time)
+         chosen = n;
+   }
+
+   return chosen;
+}
+
+/**
+ * Don't expect the math instructions that are candidates for scheduling to
+ * issue before \p until.
+ */
+void
+instruction_scheduler::delay_ready_math(int until)
+{
+   if (use_ready_heap) {
+      /* Only the candidates unblocked earlier change, and they all move to
+       * the same time, so they keep their order among themselves.
+       */
+      while (!ready_math.is_empty() &&
+             ready_math.top()->unblocked_time < until) {
+         schedule_node *n = ready_math.pop();
+         n->unblocked_time = until;
+         ready_math.push(n);
+      }
+      return;
+   }
+
+   foreach_list(node, &instructions) {
+      schedule_node *n = (schedule_node *)node;
+
+      if (n->inst->is_math())
+         n->unblocked_time = MAX2(n->unblocked_time, until);
+   }
+}
+
 void
 instruction_scheduler::schedule_instructions(backend_instruction *next_block_header)
 {
    time = 0;
 
-   /* Remove non-DAG heads from the list. */
+   if (use_ready_heap) {
+      ready.init(mem_ctx, instructions_to_schedule);
+      ready_math.init(mem_ctx, instructions_to_schedule);
+      next_ready_order = 0;
+   }
+
+   /* Remove non-DAG heads from the list.  When using the ready heaps, move
+    * the DAG heads to them, in order.
+    */
+   int head_order = 0;
    foreach_list_safe(node, &instructions) {
       schedule_node *n = (schedule_node *)node;
-      if (n->parent_count != 0)
+      if (n->parent_count != 0) {
 	 n->remove();
+      } else if (use_ready_heap) {
+         n->remove();
+         n->ready_order = head_order++;
+         ready_heap(n)->push(n);
+      }
    }
 
    unsigned cand_generation = 1;
-   while (!instructions.is_empty()) {
+   while (instructions_to_schedule) {
       schedule_node *chosen = choose_instruction_to_schedule();
 
       /* Schedule this instruction. */
       assert(chosen);
-      chosen->remove();
+      remove_ready(chosen);
       next_block_header->insert_before(chosen->inst);
       instructions_to_schedule--;
       update_register_pressure(chosen->inst);
@@ -1346,7 +1621,7 @@ instruction_scheduler::schedule_instructions(backend_instruction *next_block_hea
             if (debug) {
                printf("\t\tnow available\n");
             }
-	    instructions.push_head(child);
+	    add_ready(child);
 	 }
       }
       cand_generation++;
@@ -1356,18 +1631,14 @@ instruction_scheduler::schedule_instructions(backend_instruction *next_block_hea
        * the next math instruction isn't going to make progress until the first
        * is done.
        */
-      if (chosen->inst->is_math()) {
-	 foreach_list(node, &instructions) {
-	    schedule_node *n = (schedule_node *)node;
-
-	    if (n->inst->is_math())
-	       n->unblocked_time = MAX2(n->unblocked_time,
-					time + chosen->latency);
-	 }
-      }
+      if (chosen->inst->is_math())
+         delay_ready_math(time + chosen->latency);
    }
 
-   assert(instructions_to_schedule == 0);
+   if (use_ready_heap) {
+      ralloc_free(ready.nodes);
+      ralloc_free(ready_math.nodes);
+   }
 }
 
 void
@@ -1401,6 +1672,7 @@ instruction_scheduler::run(exec_list *all_instructions)
 	    break;
       }
       calculate_deps();
+      remove_duplicate_deps();
 
       foreach_list(node, &instructions) {
          schedule_node *n = (schedule_node *)node;
@@ -187,22 +187,24 @@ brw_link_shader(struct gl_context *ctx, struct gl_shader_program *shProg)
       /* FINISHME: Do this before the variable index lowering. */
       lower_ubo_reference(&shader->base, shader->base.ir);
 
+      ir_pass_manager pm;
+
       do {
 	 progress = false;
 
 	 if (stage == MESA_SHADER_FRAGMENT) {
-	    brw_do_channel_expressions(shader->base.ir);
-	    brw_do_vector_splitting(shader->base.ir);
+	    pm.record(brw_do_channel_expressions(shader->base.ir));
+	    pm.record(brw_do_vector_splitting(shader->base.ir));
 	 }
 
-	 progress = do_lower_jumps(shader->base.ir, true, true,
-				   true, /* main return */
-				   false, /* continue */
-				   false /* loops */
-				   ) || progress;
+	 progress = pm.record(do_lower_jumps(shader->base.ir, true, true,
+					     true, /* main return */
+					     false, /* continue */
+					     false /* loops */
+					     )) || progress;
 
-	 progress = do_common_optimization(shader->base.ir, true, true, 32,
-                                           &ctx->ShaderCompilerOptions[stage])
+	 progress = pm.run_common_optimization(shader->base.ir, true, true, 32,
+					       &ctx->ShaderCompilerOptions[stage])
 	   || progress;
       } while (progress);
 
@@ -273,7 +275,11 @@ brw_link_shader(struct gl_context *ctx, struct gl_shader_program *shProg)
       }
    }
 
-   if (!brw_shader_precompile(ctx, shProg))
+   /* Precompiling uploads to the program cache, which belongs to the
+    * context's thread.  When the link is deferred to the GLSL thread pool,
+    * the programs are compiled on first use instead.
+    */
+   if (!shProg->TaskData && !brw_shader_precompile(ctx, shProg))
       return false;
 
    return true;
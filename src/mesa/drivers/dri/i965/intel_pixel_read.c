@@ -45,6 +45,8 @@
 #include "intel_regions.h"
 #include "intel_pixel.h"
 #include "intel_buffer_objects.h"
+#include "intel_batchbuffer.h"
+#include "intel_tiled_memcpy.h"
 
 #define FILE_DEBUG_FLAG DEBUG_PIXEL
 
@@ -162,6 +164,166 @@ do_blit_readpixels(struct gl_context * ctx,
    return true;
 }
 
+/**
+ * \brief A fast path for glReadPixels
+ *
+ * This fast path is taken when the pixels can be copied as is, or with
+ * R and B swapped, and when the texture memory is X- or Y-tiled.  It downloads
+ * the source data by directly mapping the memory without a GTT fence.
+ * This then needs to be de-tiled on the CPU before presenting the data to
+ * the user in the linear fasion.
+ *
+ * This is the inverse of the texture upload fast path in
+ * intel_texsubimage_tiled_memcpy().  Spans are read from the tile with
+ * streaming loads when the CPU supports them, which avoids the cost of
+ * reading uncached memory one cacheline at a time.
+ */
+static bool
+intel_readpixels_tiled_memcpy(struct gl_context * ctx,
+                              GLint xoffset, GLint yoffset,
+                              GLsizei width, GLsizei height,
+                              GLenum format, GLenum type,
+                              GLvoid * pixels,
+                              const struct gl_pixelstore_attrib *pack)
+{
+   struct brw_context *brw = brw_context(ctx);
+   struct gl_renderbuffer *rb = ctx->ReadBuffer->_ColorReadBuffer;
+   struct gl_pixelstore_attrib clippedPack;
+
+   /* This path supports reading from color buffers only */
+   if (rb == NULL)
+      return false;
+
+   struct intel_renderbuffer *irb = intel_renderbuffer(rb);
+   int dst_pitch;
+   GLuint image_x, image_y;
+
+   /* The miptree's buffer. */
+   drm_intel_bo *bo;
+
+   int error = 0;
+
+   uint32_t cpp;
+   mem_copy_fn mem_copy;
+
+   /* This fastpath is restricted to renderbuffers whose format can be
+    * copied directly or by swapping R and B, see intel_get_memcpy().
+    */
+   if (!brw->has_llc ||
+       pixels == NULL ||
+       _mesa_is_bufferobj(pack->BufferObj) ||
+       pack->Alignment > 4 ||
+       pack->SkipPixels > 0 ||
+       pack->SkipRows > 0 ||
+       (pack->RowLength != 0 && pack->RowLength != width) ||
+       pack->SwapBytes ||
+       pack->LsbFirst ||
+       pack->Invert)
+      return false;
+
+   /* Only a simple copy, no scale, bias, clamping or other conversion. */
+   if (_mesa_readpixels_needs_slow_path(ctx, format, type, GL_FALSE))
+      return false;
+
+   /* A multisampled renderbuffer needs to be resolved first. */
+   if (rb->NumSamples > 1)
+      return false;
+
+   if (!irb->mt ||
+       (irb->mt->region->tiling != I915_TILING_X &&
+       irb->mt->region->tiling != I915_TILING_Y)) {
+      /* The algorithm is written only for X- or Y-tiled memory. */
+      return false;
+   }
+
+   /* An RGBX buffer may be stored in an RGBA format, whose alpha channel
+    * would be read back instead of 1.0.
+    */
+   if (rb->_BaseFormat != _mesa_get_format_base_format(irb->mt->format))
+      return false;
+
+   if (!intel_get_memcpy(irb->mt->format, format, type, &mem_copy, &cpp,
+                         INTEL_DOWNLOAD))
+      return false;
+
+   clippedPack = *pack;
+   if (!_mesa_clip_readpixels(ctx, &xoffset, &yoffset, &width, &height,
+                              &clippedPack)) {
+      /* Nothing to read. */
+      return true;
+   }
+
+   /* Since we are going to read raw data from the miptree, we need to
+    * resolve any pending fast color clears before we start.
+    */
+   intel_miptree_resolve_color(brw, irb->mt);
+
+   bo = irb->mt->region->bo;
+
+   if (drm_intel_bo_references(brw->batch.bo, bo)) {
+      perf_debug("Flushing before mapping a referenced bo.\n");
+      intel_batchbuffer_flush(brw);
+   }
+
+   if (unlikely(brw->perf_debug)) {
+      if (drm_intel_bo_busy(bo)) {
+         perf_debug("Mapping a busy BO, causing a stall on the GPU.\n");
+      }
+   }
+
+   error = drm_intel_bo_map(bo, false /*write_enable*/);
+   if (error || bo->virtual == NULL) {
+      DBG("%s: failed to map bo\n", __FUNCTION__);
+      return false;
+   }
+
+   pixels = _mesa_image_address2d(&clippedPack, pixels, width, height,
+                                  format, type, 0, 0);
+   dst_pitch = _mesa_image_row_stride(&clippedPack, width, format, type);
+
+   /* A window-system renderbuffer is stored upside down.  Walk through the
+    * client's rows backwards while walking through the renderbuffer
+    * forwards, by starting at the client's last row with a negative pitch.
+    */
+   if (_mesa_is_winsys_fbo(ctx->ReadBuffer)) {
+      yoffset = rb->Height - yoffset - height;
+      pixels = (char *) pixels + (ptrdiff_t) (height - 1) * dst_pitch;
+      dst_pitch = -dst_pitch;
+   }
+
+   /* We postponed printing this message until having committed to executing
+    * the function.
+    */
+   DBG("%s: x,y=(%d,%d) (w,h)=(%d,%d) format=0x%x type=0x%x "
+       "mesa_format=0x%x tiling=%d "
+       "pack=(alignment=%d row_length=%d skip_pixels=%d skip_rows=%d)\n",
+       __FUNCTION__, xoffset, yoffset, width, height,
+       format, type, irb->mt->format, irb->mt->region->tiling,
+       clippedPack.Alignment, clippedPack.RowLength, clippedPack.SkipPixels,
+       clippedPack.SkipRows);
+
+   /* Adjust x and y offset based on the miplevel and layer. */
+   intel_miptree_get_image_offset(irb->mt, irb->mt_level, irb->mt_layer,
+                                  &image_x, &image_y);
+   xoffset += image_x;
+   yoffset += image_y;
+
+   tiled_to_linear(
+      xoffset * cpp, (xoffset + width) * cpp,
+      yoffset, yoffset + height,
+      (char *) pixels - (ptrdiff_t) yoffset * dst_pitch
+                      - (ptrdiff_t) xoffset * cpp,
+      bo->virtual,
+      dst_pitch, irb->mt->region->pitch,
+      brw->has_swizzling,
+      irb->mt->region->tiling,
+      mem_copy
+   );
+
+   drm_intel_bo_unmap(bo);
+   return true;
+}
+
 void
 intelReadPixels(struct gl_context * ctx,
                 GLint x, GLint y, GLsizei width, GLsizei height,
@@ -197,6 +359,12 @@ intelReadPixels(struct gl_context * ctx,
    if (ctx->NewState)
       _mesa_update_state(ctx);
 
+   if (intel_readpixels_tiled_memcpy(ctx, x, y, width, height,
+                                     format, type, pixels, pack)) {
+      brw->front_buffer_dirty = dirty;
+      return;
+   }
+
    _mesa_readpixels(ctx, x, y, width, height, format, type, pack, pixels);
 
    /* There's an intel_prepare_render() call in intelSpanRenderStart(). */
@@ -48,6 +48,7 @@ DRI_CONF_BEGIN
    DRI_CONF_SECTION_PERFORMANCE
       DRI_CONF_VBLANK_MODE(DRI_CONF_VBLANK_ALWAYS_SYNC)
       DRI_CONF_MULTITHREAD_GLSL_COMPILER(0)
+      DRI_CONF_DEFERRED_GLSL_LINKER("false")
 
       /* Options correspond to DRI_CONF_BO_REUSE_DISABLED,
        * DRI_CONF_BO_REUSE_ALL
@@ -101,6 +102,7 @@ DRI_CONF_END
 #include "intel_mipmap_tree.h"
 #include "intel_screen.h"
 #include "intel_tex.h"
+#include "intel_tiled_memcpy.h"
 #include "intel_regions.h"
 
 #include "brw_context.h"
@@ -949,6 +951,7 @@ intelDestroyScreen(__DRIscreen * sPriv)
 {
    struct intel_screen *intelScreen = sPriv->driverPrivate;
 
+   tiled_memcpy_pool_destroy(intelScreen->tiled_memcpy_pool);
    dri_bufmgr_destroy(intelScreen->bufmgr);
    driDestroyOptionInfo(&intelScreen->optionCache);
 
@@ -1335,6 +1338,12 @@ __DRIconfig **intelInitScreen2(__DRIscreen *psp)
 
    intelScreen->hw_has_swizzling = intel_detect_swizzling(intelScreen);
 
+   const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   if (num_cpus > 1) {
+      intelScreen->tiled_memcpy_pool =
+         tiled_memcpy_pool_create(num_cpus - 1);
+   }
+
    set_max_gl_versions(intelScreen);
 
    /* Notification of GPU resets requires hardware contexts and a kernel new
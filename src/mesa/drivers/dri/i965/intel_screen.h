@@ -66,6 +66,13 @@ struct intel_screen
    * Configuration cache with default values for all contexts
    */
    driOptionCache optionCache;
+
+   /**
+    * Threads helping with large texture uploads, see
+    * linear_to_tiled_parallel().  They are only started by the first such
+    * upload.  NULL on single CPU systems.
+    */
+   struct tiled_memcpy_pool *tiled_memcpy_pool;
 };
 
 extern void intelDestroyContext(__DRIcontext * driContextPriv);
@@ -0,0 +1,1095 @@
+/**************************************************************************
+ *
+ * Copyright 2003 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c11/threads.h"
+
+#include "main/macros.h"
+#include "main/glformats.h"
+#ifdef __SSE4_1__
+#include "main/streaming-load-memcpy.h"
+#endif
+
+#include <i915_drm.h>
+
+#include "intel_tiled_memcpy.h"
+
+#define ALIGN_DOWN(a, b) ROUND_DOWN_TO(a, b)
+#define ALIGN_UP(a, b) ALIGN(a, b)
+
+/* Tile dimensions.
+ * Width and span are in bytes, height is in pixels (i.e. unitless).
+ * A "span" is the most number of bytes we can copy from linear to tiled
+ * without needing to calculate a new destination address.
+ */
+static const uint32_t xtile_width = 512;
+static const uint32_t xtile_height = 8;
+static const uint32_t xtile_span = 64;
+static const uint32_t ytile_width = 128;
+static const uint32_t ytile_height = 32;
+static const uint32_t ytile_span = 16;
+
+/**
+ * Each row from y0 to y1 is copied in three parts: [x0,x1), [x1,x2), [x2,x3).
+ * These ranges are in bytes, i.e. pixels * bytes-per-pixel.
+ * The first and last ranges must be shorter than a "span" (the longest linear
+ * stretch within a tile) and the middle must equal a whole number of spans.
+ * Ranges may be empty.  The region copied must land entirely within one tile.
+ * 'dst' is the start of the tile and 'src' is the corresponding
+ * address to copy from, though copying begins at (x0, y0).
+ * To enable swizzling 'swizzle_bit' must be 1<<6, otherwise zero.
+ * Swizzling flips bit 6 in the copy destination offset, when certain other
+ * bits are set in it.
+ *
+ * When copying from tiled to linear, 'src' is the start of the tile, 'dst'
+ * the corresponding linear address and swizzling applies to the source
+ * offset instead.
+ */
+typedef void (*tile_copy_fn)(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                             uint32_t y0, uint32_t y1,
+                             char *dst, const char *src,
+                             int32_t linear_pitch,
+                             uint32_t swizzle_bit,
+                             mem_copy_fn mem_copy);
+
+#ifdef __SSSE3__
+static const uint8_t rgba8_permutation[16] =
+   { 2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15 };
+
+typedef char v16 __attribute__((vector_size(16)));
+typedef float v4f __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+
+/* NOTE: dst must be 16 byte aligned */
+#define rgba8_copy_16_aligned_dst(dst, src)         \
+   *(v16*)(dst) = __builtin_ia32_pshufb128(         \
+       (v16) __builtin_ia32_loadups((float*)(src)), \
+      *(v16*) rgba8_permutation                     \
+   )
+
+/* Tiled memory may be uncached, so read it with streaming loads when the
+ * CPU has them.
+ */
+#ifdef __SSE4_1__
+#define load_16_aligned(src) ((v16) __builtin_ia32_movntdqa((v2di*)(src)))
+#else
+#define load_16_aligned(src) (*(v16*)(src))
+#endif
+
+/* NOTE: src must be 16 byte aligned */
+#define rgba8_copy_16_aligned_src(dst, src)         \
+   __builtin_ia32_storeups((float*)(dst),           \
+      (v4f) __builtin_ia32_pshufb128(               \
+         load_16_aligned(src),                      \
+         *(v16*) rgba8_permutation                  \
+      )                                             \
+   )
+#endif
+
+/**
+ * Copy RGBA to BGRA - swap R and B.
+ */
+static inline void *
+rgba8_copy(void *dst, const void *src, size_t bytes)
+{
+   uint8_t *d = dst;
+   uint8_t const *s = src;
+
+   while (bytes >= 4) {
+      d[0] = s[2];
+      d[1] = s[1];
+      d[2] = s[0];
+      d[3] = s[3];
+      d += 4;
+      s += 4;
+      bytes -= 4;
+   }
+   return dst;
+}
+
+/**
+ * Copy RGBA to BGRA - swap R and B, with the destination 16-byte aligned.
+ */
+static inline void *
+rgba8_copy_aligned_dst(void *dst, const void *src, size_t bytes)
+{
+   uint8_t *d = dst;
+   uint8_t const *s = src;
+
+#ifdef __SSSE3__
+   /* Fast copying for tile spans.
+    *
+    * As long as the destination texture is 16 aligned,
+    * any 16 or 64 spans we get here should also be 16 aligned.
+    */
+
+   if (bytes == 16) {
+      assert(!(((uintptr_t)dst) & 0xf));
+      rgba8_copy_16_aligned_dst(d+ 0, s+ 0);
+      return dst;
+   }
+
+   if (bytes == 64) {
+      assert(!(((uintptr_t)dst) & 0xf));
+      rgba8_copy_16_aligned_dst(d+ 0, s+ 0);
+      rgba8_copy_16_aligned_dst(d+16, s+16);
+      rgba8_copy_16_aligned_dst(d+32, s+32);
+      rgba8_copy_16_aligned_dst(d+48, s+48);
+      return dst;
+   }
+#endif
+
+   return rgba8_copy(d, s, bytes);
+}
+
+/**
+ * Copy RGBA to BGRA - swap R and B, with the source 16-byte aligned.
+ */
+static inline void *
+rgba8_copy_aligned_src(void *dst, const void *src, size_t bytes)
+{
+   uint8_t *d = dst;
+   uint8_t const *s = src;
+
+#ifdef __SSSE3__
+   /* Same as rgba8_copy_aligned_dst(), for spans read from a tile. */
+
+   if (bytes == 16) {
+      assert(!(((uintptr_t)src) & 0xf));
+      rgba8_copy_16_aligned_src(d+ 0, s+ 0);
+      return dst;
+   }
+
+   if (bytes == 64) {
+      assert(!(((uintptr_t)src) & 0xf));
+      rgba8_copy_16_aligned_src(d+ 0, s+ 0);
+      rgba8_copy_16_aligned_src(d+16, s+16);
+      rgba8_copy_16_aligned_src(d+32, s+32);
+      rgba8_copy_16_aligned_src(d+48, s+48);
+      return dst;
+   }
+#endif
+
+   return rgba8_copy(d, s, bytes);
+}
+
+#ifdef __SSE4_1__
+/**
+ * memcpy() with streaming loads, for reading from tiled memory.
+ */
+static void *
+streaming_load_memcpy(void *dst, const void *src, size_t bytes)
+{
+   char *d = dst;
+   const char *s = src;
+
+   /* Whole spans are 16 byte aligned in the tile, so copy them inline
+    * rather than paying for the alignment checks of the generic version.
+    */
+   if ((bytes == 16 || bytes == 64) && !(((uintptr_t)src) & 0xf)) {
+      for (; bytes; bytes -= 16, d += 16, s += 16)
+         __builtin_ia32_storeups((float*)d, (v4f) load_16_aligned(s));
+      return dst;
+   }
+
+   _mesa_streaming_load_memcpy(dst, (void *) src, bytes);
+   return dst;
+}
+#endif
+
+/**
+ * Copy texture data from linear to X tile layout.
+ *
+ * \copydoc tile_copy_fn
+ */
+static inline void
+linear_to_xtiled(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                 uint32_t y0, uint32_t y1,
+                 char *dst, const char *src,
+                 int32_t src_pitch,
+                 uint32_t swizzle_bit,
+                 mem_copy_fn mem_copy)
+{
+   /* The copy destination offset for each range copied is the sum of
+    * an X offset 'x0' or 'xo' and a Y offset 'yo.'
+    */
+   uint32_t xo, yo;
+
+   src += (ptrdiff_t) y0 * src_pitch;
+
+   for (yo = y0 * xtile_width; yo < y1 * xtile_width; yo += xtile_width) {
+      /* Bits 9 and 10 of the copy destination offset control swizzling.
+       * Only 'yo' contributes to those bits in the total offset,
+       * so calculate 'swizzle' just once per row.
+       * Move bits 9 and 10 three and four places respectively down
+       * to bit 6 and xor them.
+       */
+      uint32_t swizzle = ((yo >> 3) ^ (yo >> 4)) & swizzle_bit;
+
+      mem_copy(dst + ((x0 + yo) ^ swizzle), src + x0, x1 - x0);
+
+      for (xo = x1; xo < x2; xo += xtile_span) {
+         mem_copy(dst + ((xo + yo) ^ swizzle), src + xo, xtile_span);
+      }
+
+      mem_copy(dst + ((xo + yo) ^ swizzle), src + x2, x3 - x2);
+
+      src += src_pitch;
+   }
+}
+
+/**
+ * Copy texture data from linear to Y tile layout.
+ *
+ * \copydoc tile_copy_fn
+ */
+static inline void
+linear_to_ytiled(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                 uint32_t y0, uint32_t y1,
+                 char *dst, const char *src,
+                 int32_t src_pitch,
+                 uint32_t swizzle_bit,
+                 mem_copy_fn mem_copy)
+{
+   /* Y tiles consist of columns that are 'ytile_span' wide (and the same height
+    * as the tile).  Thus the destination offset for (x,y) is the sum of:
+    *   (x % column_width)                    // position within column
+    *   (x / column_width) * bytes_per_column // column number * bytes per column
+    *   y * column_width
+    *
+    * The copy destination offset for each range copied is the sum of
+    * an X offset 'xo0' or 'xo' and a Y offset 'yo.'
+    */
+   const uint32_t column_width = ytile_span;
+   const uint32_t bytes_per_column = column_width * ytile_height;
+
+   uint32_t xo0 = (x0 % ytile_span) + (x0 / ytile_span) * bytes_per_column;
+   uint32_t xo1 = (x1 % ytile_span) + (x1 / ytile_span) * bytes_per_column;
+
+   /* Bit 9 of the destination offset control swizzling.
+    * Only the X offset contributes to bit 9 of the total offset,
+    * so swizzle can be calculated in advance for these X positions.
+    * Move bit 9 three places down to bit 6.
+    */
+   uint32_t swizzle0 = (xo0 >> 3) & swizzle_bit;
+   uint32_t swizzle1 = (xo1 >> 3) & swizzle_bit;
+
+   uint32_t x, yo;
+
+   src += (ptrdiff_t) y0 * src_pitch;
+
+   for (yo = y0 * column_width; yo < y1 * column_width; yo += column_width) {
+      uint32_t xo = xo1;
+      uint32_t swizzle = swizzle1;
+
+      mem_copy(dst + ((xo0 + yo) ^ swizzle0), src + x0, x1 - x0);
+
+      /* Step by spans/columns.  As it happens, the swizzle bit flips
+       * at each step so we don't need to calculate it explicitly.
+       */
+      for (x = x1; x < x2; x += ytile_span) {
+         mem_copy(dst + ((xo + yo) ^ swizzle), src + x, ytile_span);
+         xo += bytes_per_column;
+         swizzle ^= swizzle_bit;
+      }
+
+      mem_copy(dst + ((xo + yo) ^ swizzle), src + x2, x3 - x2);
+
+      src += src_pitch;
+   }
+}
+
+/**
+ * Copy texture data from X tile layout to linear.
+ *
+ * Same as \ref linear_to_xtiled with the direction of the copies reversed.
+ *
+ * \copydoc tile_copy_fn
+ */
+static inline void
+xtiled_to_linear(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                 uint32_t y0, uint32_t y1,
+                 char *dst, const char *src,
+                 int32_t dst_pitch,
+                 uint32_t swizzle_bit,
+                 mem_copy_fn mem_copy)
+{
+   uint32_t xo, yo;
+
+   dst += (ptrdiff_t) y0 * dst_pitch;
+
+   for (yo = y0 * xtile_width; yo < y1 * xtile_width; yo += xtile_width) {
+      uint32_t swizzle = ((yo >> 3) ^ (yo >> 4)) & swizzle_bit;
+
+      mem_copy(dst + x0, src + ((x0 + yo) ^ swizzle), x1 - x0);
+
+      for (xo = x1; xo < x2; xo += xtile_span) {
+         mem_copy(dst + xo, src + ((xo + yo) ^ swizzle), xtile_span);
+      }
+
+      mem_copy(dst + x2, src + ((xo + yo) ^ swizzle), x3 - x2);
+
+      dst += dst_pitch;
+   }
+}
+
+/**
+ * Copy texture data from Y tile layout to linear.
+ *
+ * Same as \ref linear_to_ytiled with the direction of the copies reversed.
+ *
+ * \copydoc tile_copy_fn
+ */
+static inline void
+ytiled_to_linear(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                 uint32_t y0, uint32_t y1,
+                 char *dst, const char *src,
+                 int32_t dst_pitch,
+                 uint32_t swizzle_bit,
+                 mem_copy_fn mem_copy)
+{
+   const uint32_t column_width = ytile_span;
+   const uint32_t bytes_per_column = column_width * ytile_height;
+
+   uint32_t xo0 = (x0 % ytile_span) + (x0 / ytile_span) * bytes_per_column;
+   uint32_t xo1 = (x1 % ytile_span) + (x1 / ytile_span) * bytes_per_column;
+
+   uint32_t swizzle0 = (xo0 >> 3) & swizzle_bit;
+   uint32_t swizzle1 = (xo1 >> 3) & swizzle_bit;
+
+   uint32_t x, yo;
+
+   dst += (ptrdiff_t) y0 * dst_pitch;
+
+   for (yo = y0 * column_width; yo < y1 * column_width; yo += column_width) {
+      uint32_t xo = xo1;
+      uint32_t swizzle = swizzle1;
+
+      mem_copy(dst + x0, src + ((xo0 + yo) ^ swizzle0), x1 - x0);
+
+      for (x = x1; x < x2; x += ytile_span) {
+         mem_copy(dst + x, src + ((xo + yo) ^ swizzle), ytile_span);
+         xo += bytes_per_column;
+         swizzle ^= swizzle_bit;
+      }
+
+      mem_copy(dst + x2, src + ((xo + yo) ^ swizzle), x3 - x2);
+
+      dst += dst_pitch;
+   }
+}
+
+#ifdef __GNUC__
+#define FLATTEN __attribute__((flatten))
+#else
+#define FLATTEN
+#endif
+
+/**
+ * Copy texture data from linear to X tile layout, faster.
+ *
+ * Same as \ref linear_to_xtiled but faster, because it passes constant
+ * parameters for common cases, allowing the compiler to inline code
+ * optimized for those cases.
+ *
+ * \copydoc tile_copy_fn
+ */
+static FLATTEN void
+linear_to_xtiled_faster(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                        uint32_t y0, uint32_t y1,
+                        char *dst, const char *src,
+                        int32_t src_pitch,
+                        uint32_t swizzle_bit,
+                        mem_copy_fn mem_copy)
+{
+   if (x0 == 0 && x3 == xtile_width && y0 == 0 && y1 == xtile_height) {
+      if (mem_copy == memcpy)
+         return linear_to_xtiled(0, 0, xtile_width, xtile_width, 0, xtile_height,
+                                 dst, src, src_pitch, swizzle_bit, memcpy);
+      else if (mem_copy == rgba8_copy_aligned_dst)
+         return linear_to_xtiled(0, 0, xtile_width, xtile_width, 0, xtile_height,
+                                 dst, src, src_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_dst);
+   } else {
+      if (mem_copy == memcpy)
+         return linear_to_xtiled(x0, x1, x2, x3, y0, y1,
+                                 dst, src, src_pitch, swizzle_bit, memcpy);
+      else if (mem_copy == rgba8_copy_aligned_dst)
+         return linear_to_xtiled(x0, x1, x2, x3, y0, y1,
+                                 dst, src, src_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_dst);
+   }
+   linear_to_xtiled(x0, x1, x2, x3, y0, y1,
+                    dst, src, src_pitch, swizzle_bit, mem_copy);
+}
+
+/**
+ * Copy texture data from linear to Y tile layout, faster.
+ *
+ * Same as \ref linear_to_ytiled but faster, because it passes constant
+ * parameters for common cases, allowing the compiler to inline code
+ * optimized for those cases.
+ *
+ * \copydoc tile_copy_fn
+ */
+static FLATTEN void
+linear_to_ytiled_faster(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                        uint32_t y0, uint32_t y1,
+                        char *dst, const char *src,
+                        int32_t src_pitch,
+                        uint32_t swizzle_bit,
+                        mem_copy_fn mem_copy)
+{
+   if (x0 == 0 && x3 == ytile_width && y0 == 0 && y1 == ytile_height) {
+      if (mem_copy == memcpy)
+         return linear_to_ytiled(0, 0, ytile_width, ytile_width, 0, ytile_height,
+                                 dst, src, src_pitch, swizzle_bit, memcpy);
+      else if (mem_copy == rgba8_copy_aligned_dst)
+         return linear_to_ytiled(0, 0, ytile_width, ytile_width, 0, ytile_height,
+                                 dst, src, src_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_dst);
+   } else {
+      if (mem_copy == memcpy)
+         return linear_to_ytiled(x0, x1, x2, x3, y0, y1,
+                                 dst, src, src_pitch, swizzle_bit, memcpy);
+      else if (mem_copy == rgba8_copy_aligned_dst)
+         return linear_to_ytiled(x0, x1, x2, x3, y0, y1,
+                                 dst, src, src_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_dst);
+   }
+   linear_to_ytiled(x0, x1, x2, x3, y0, y1,
+                    dst, src, src_pitch, swizzle_bit, mem_copy);
+}
+
+/**
+ * Copy texture data from X tile layout to linear, faster.
+ *
+ * Same as \ref xtiled_to_linear but faster, because it passes constant
+ * parameters for common cases, allowing the compiler to inline code
+ * optimized for those cases.
+ *
+ * \copydoc tile_copy_fn
+ */
+static FLATTEN void
+xtiled_to_linear_faster(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                        uint32_t y0, uint32_t y1,
+                        char *dst, const char *src,
+                        int32_t dst_pitch,
+                        uint32_t swizzle_bit,
+                        mem_copy_fn mem_copy)
+{
+   if (x0 == 0 && x3 == xtile_width && y0 == 0 && y1 == xtile_height) {
+      if (mem_copy == memcpy)
+         return xtiled_to_linear(0, 0, xtile_width, xtile_width, 0, xtile_height,
+                                 dst, src, dst_pitch, swizzle_bit, memcpy);
+#ifdef __SSE4_1__
+      else if (mem_copy == streaming_load_memcpy)
+         return xtiled_to_linear(0, 0, xtile_width, xtile_width, 0, xtile_height,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 streaming_load_memcpy);
+#endif
+      else if (mem_copy == rgba8_copy_aligned_src)
+         return xtiled_to_linear(0, 0, xtile_width, xtile_width, 0, xtile_height,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_src);
+   } else {
+      if (mem_copy == memcpy)
+         return xtiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit, memcpy);
+#ifdef __SSE4_1__
+      else if (mem_copy == streaming_load_memcpy)
+         return xtiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 streaming_load_memcpy);
+#endif
+      else if (mem_copy == rgba8_copy_aligned_src)
+         return xtiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_src);
+   }
+   xtiled_to_linear(x0, x1, x2, x3, y0, y1,
+                    dst, src, dst_pitch, swizzle_bit, mem_copy);
+}
+
+/**
+ * Copy texture data from Y tile layout to linear, faster.
+ *
+ * Same as \ref ytiled_to_linear but faster, because it passes constant
+ * parameters for common cases, allowing the compiler to inline code
+ * optimized for those cases.
+ *
+ * \copydoc tile_copy_fn
+ */
+static FLATTEN void
+ytiled_to_linear_faster(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3,
+                        uint32_t y0, uint32_t y1,
+                        char *dst, const char *src,
+                        int32_t dst_pitch,
+                        uint32_t swizzle_bit,
+                        mem_copy_fn mem_copy)
+{
+   if (x0 == 0 && x3 == ytile_width && y0 == 0 && y1 == ytile_height) {
+      if (mem_copy == memcpy)
+         return ytiled_to_linear(0, 0, ytile_width, ytile_width, 0, ytile_height,
+                                 dst, src, dst_pitch, swizzle_bit, memcpy);
+#ifdef __SSE4_1__
+      else if (mem_copy == streaming_load_memcpy)
+         return ytiled_to_linear(0, 0, ytile_width, ytile_width, 0, ytile_height,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 streaming_load_memcpy);
+#endif
+      else if (mem_copy == rgba8_copy_aligned_src)
+         return ytiled_to_linear(0, 0, ytile_width, ytile_width, 0, ytile_height,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_src);
+   } else {
+      if (mem_copy == memcpy)
+         return ytiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit, memcpy);
+#ifdef __SSE4_1__
+      else if (mem_copy == streaming_load_memcpy)
+         return ytiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 streaming_load_memcpy);
+#endif
+      else if (mem_copy == rgba8_copy_aligned_src)
+         return ytiled_to_linear(x0, x1, x2, x3, y0, y1,
+                                 dst, src, dst_pitch, swizzle_bit,
+                                 rgba8_copy_aligned_src);
+   }
+   ytiled_to_linear(x0, x1, x2, x3, y0, y1,
+                    dst, src, dst_pitch, swizzle_bit, mem_copy);
+}
+
+/**
+ * Copy from linear to tiled texture.
+ *
+ * Divide the region given by X range [xt1, xt2) and Y range [yt1, yt2) into
+ * pieces that do not cross tile boundaries and copy each piece with a tile
+ * copy function (\ref tile_copy_fn).
+ * The X range is in bytes, i.e. pixels * bytes-per-pixel.
+ * The Y range is in pixels (i.e. unitless).
+ * 'dst' is the start of the texture and 'src' is the corresponding
+ * address to copy from, though copying begins at (xt1, yt1).
+ */
+void
+linear_to_tiled(uint32_t xt1, uint32_t xt2,
+                uint32_t yt1, uint32_t yt2,
+                char *dst, const char *src,
+                uint32_t dst_pitch, int32_t src_pitch,
+                bool has_swizzling,
+                uint32_t tiling,
+                mem_copy_fn mem_copy)
+{
+   tile_copy_fn tile_copy;
+   uint32_t xt0, xt3;
+   uint32_t yt0, yt3;
+   uint32_t xt, yt;
+   uint32_t tw, th, span;
+   uint32_t swizzle_bit = has_swizzling ? 1<<6 : 0;
+
+   if (tiling == I915_TILING_X) {
+      tw = xtile_width;
+      th = xtile_height;
+      span = xtile_span;
+      tile_copy = linear_to_xtiled_faster;
+   } else if (tiling == I915_TILING_Y) {
+      tw = ytile_width;
+      th = ytile_height;
+      span = ytile_span;
+      tile_copy = linear_to_ytiled_faster;
+   } else {
+      assert(!"unsupported tiling");
+      return;
+   }
+
+   /* Round out to tile boundaries. */
+   xt0 = ALIGN_DOWN(xt1, tw);
+   xt3 = ALIGN_UP  (xt2, tw);
+   yt0 = ALIGN_DOWN(yt1, th);
+   yt3 = ALIGN_UP  (yt2, th);
+
+   /* Loop over all tiles to which we have something to copy.
+    * 'xt' and 'yt' are the origin of the destination tile, whether copying
+    * copying a full or partial tile.
+    * tile_copy() copies one tile or partial tile.
+    * Looping x inside y is the faster memory access pattern.
+    */
+   for (yt = yt0; yt < yt3; yt += th) {
+      for (xt = xt0; xt < xt3; xt += tw) {
+         /* The area to update is [x0,x3) x [y0,y1).
+          * May not want the whole tile, hence the min and max.
+          */
+         uint32_t x0 = MAX2(xt1, xt);
+         uint32_t y0 = MAX2(yt1, yt);
+         uint32_t x3 = MIN2(xt2, xt + tw);
+         uint32_t y1 = MIN2(yt2, yt + th);
+
+         /* [x0,x3) is split into [x0,x1), [x1,x2), [x2,x3) such that
+          * the middle interval is the longest span-aligned part.
+          * The sub-ranges could be empty.
+          */
+         uint32_t x1, x2;
+         x1 = ALIGN_UP(x0, span);
+         if (x1 > x3)
+            x1 = x2 = x3;
+         else
+            x2 = ALIGN_DOWN(x3, span);
+
+         assert(x0 <= x1 && x1 <= x2 && x2 <= x3);
+         assert(x1 - x0 < span && x3 - x2 < span);
+         assert(x3 - x0 <= tw);
+         assert((x2 - x1) % span == 0);
+
+         /* Translate by (xt,yt) for single-tile copier. */
+         tile_copy(x0-xt, x1-xt, x2-xt, x3-xt,
+                   y0-yt, y1-yt,
+                   dst + (ptrdiff_t) xt * th + (ptrdiff_t) yt * dst_pitch,
+                   src + (ptrdiff_t) xt      + (ptrdiff_t) yt * src_pitch,
+                   src_pitch,
+                   swizzle_bit,
+                   mem_copy);
+      }
+   }
+}
+
+/**
+ * Copy from tiled to linear texture.
+ *
+ * Divide the region given by X range [xt1, xt2) and Y range [yt1, yt2) into
+ * pieces that do not cross tile boundaries and copy each piece with a tile
+ * copy function (\ref tile_copy_fn).
+ * The X range is in bytes, i.e. pixels * bytes-per-pixel.
+ * The Y range is in pixels (i.e. unitless).
+ * 'dst' is the address that (xt1, yt1) would be copied to, as in
+ * \ref linear_to_tiled, and 'src' is the start of the texture.
+ * 'dst_pitch' may be negative, to flip the image vertically.
+ */
+void
+tiled_to_linear(uint32_t xt1, uint32_t xt2,
+                uint32_t yt1, uint32_t yt2,
+                char *dst, const char *src,
+                int32_t dst_pitch, uint32_t src_pitch,
+                bool has_swizzling,
+                uint32_t tiling,
+                mem_copy_fn mem_copy)
+{
+   tile_copy_fn tile_copy;
+   uint32_t xt0, xt3;
+   uint32_t yt0, yt3;
+   uint32_t xt, yt;
+   uint32_t tw, th, span;
+   uint32_t swizzle_bit = has_swizzling ? 1<<6 : 0;
+
+   if (tiling == I915_TILING_X) {
+      tw = xtile_width;
+      th = xtile_height;
+      span = xtile_span;
+      tile_copy = xtiled_to_linear_faster;
+   } else if (tiling == I915_TILING_Y) {
+      tw = ytile_width;
+      th = ytile_height;
+      span = ytile_span;
+      tile_copy = ytiled_to_linear_faster;
+   } else {
+      assert(!"unsupported tiling");
+      return;
+   }
+
+   /* Round out to tile boundaries. */
+   xt0 = ALIGN_DOWN(xt1, tw);
+   xt3 = ALIGN_UP  (xt2, tw);
+   yt0 = ALIGN_DOWN(yt1, th);
+   yt3 = ALIGN_UP  (yt2, th);
+
+   /* Loop over all tiles from which we have something to copy, in the same
+    * order as linear_to_tiled().
+    */
+   for (yt = yt0; yt < yt3; yt += th) {
+      for (xt = xt0; xt < xt3; xt += tw) {
+         uint32_t x0 = MAX2(xt1, xt);
+         uint32_t y0 = MAX2(yt1, yt);
+         uint32_t x3 = MIN2(xt2, xt + tw);
+         uint32_t y1 = MIN2(yt2, yt + th);
+
+         uint32_t x1, x2;
+         x1 = ALIGN_UP(x0, span);
+         if (x1 > x3)
+            x1 = x2 = x3;
+         else
+            x2 = ALIGN_DOWN(x3, span);
+
+         assert(x0 <= x1 && x1 <= x2 && x2 <= x3);
+         assert(x1 - x0 < span && x3 - x2 < span);
+         assert(x3 - x0 <= tw);
+         assert((x2 - x1) % span == 0);
+
+         /* Translate by (xt,yt) for single-tile copier. */
+         tile_copy(x0-xt, x1-xt, x2-xt, x3-xt,
+                   y0-yt, y1-yt,
+                   dst + (ptrdiff_t) xt      + (ptrdiff_t) yt * dst_pitch,
+                   src + (ptrdiff_t) xt * th + (ptrdiff_t) yt * src_pitch,
+                   dst_pitch,
+                   swizzle_bit,
+                   mem_copy);
+      }
+   }
+}
+
+/**
+ * Determine which copy function to use for the given format combination
+ *
+ * The only two possible copy functions which are ever returned are a
+ * direct memcpy and an RGBA <-> BGRA copy function.  Since RGBA -> BGRA and
+ * BGRA -> RGBA are exactly the same operations (and memcpy is obviously
+ * symmetric), it doesn't matter whether the copy is from the tiled image
+ * to the untiled or vice versa.  The copy function required is the same in
+ * either case so this function can be used.  Only the alignment the fast
+ * paths rely on differs, hence \p direction.
+ *
+ * Any color format of 1, 2, 4, 8 or 16 bytes per pixel whose layout
+ * matches the client's format and type can be copied directly.  Those
+ * sizes divide the 16 byte span of a Y tile, so no pixel ever straddles
+ * two spans.
+ *
+ * \param[in]  tiledFormat The format of the tiled image
+ * \param[in]  format      The GL format of the client data
+ * \param[in]  type        The GL type of the client data
+ * \param[out] mem_copy    Will be set to one of either the standard
+ *                         library's memcpy or a different copy function
+ *                         that performs an RGBA to BGRA conversion
+ * \param[out] cpp         Number of bytes per pixel
+ * \param[in]  direction   Whether the copy is to or from the tiled image
+ *
+ * \return true if the format and type combination are valid
+ */
+bool
+intel_get_memcpy(mesa_format tiledFormat, GLenum format,
+                 GLenum type, mem_copy_fn *mem_copy, uint32_t *cpp,
+                 enum intel_memcpy_direction direction)
+{
+   *cpp = _mesa_get_format_bytes(tiledFormat);
+   *mem_copy = NULL;
+
+   /* Depth and stencil buffers may have auxiliary data, such as HiZ, that
+    * a raw copy would not keep up to date.
+    */
+   if (*cpp > 16 || !_mesa_is_pow_two(*cpp) ||
+       _mesa_is_format_compressed(tiledFormat) ||
+       _mesa_is_depth_or_stencil_format(
+          _mesa_get_format_base_format(tiledFormat)))
+      return false;
+
+   if (_mesa_format_matches_format_and_type(tiledFormat, format, type,
+                                            false)) {
+      *mem_copy = memcpy;
+   } else if (type == GL_UNSIGNED_BYTE ||
+              type == GL_UNSIGNED_INT_8_8_8_8_REV) {
+      /* Reading back the undefined X channel of the RGBX formats would
+       * leave garbage instead of 1.0 in the client's alpha, so those are
+       * only handled for uploads.
+       */
+      const bool rgbx = direction == INTEL_UPLOAD;
+
+      if ((tiledFormat == MESA_FORMAT_B8G8R8A8_UNORM && format == GL_RGBA) ||
+          (tiledFormat == MESA_FORMAT_R8G8B8A8_UNORM && format == GL_BGRA) ||
+          (rgbx && tiledFormat == MESA_FORMAT_B8G8R8X8_UNORM &&
+           format == GL_RGBA) ||
+          (rgbx && tiledFormat == MESA_FORMAT_R8G8B8X8_UNORM &&
+           format == GL_BGRA)) {
+         *mem_copy = direction == INTEL_UPLOAD ? rgba8_copy_aligned_dst
+                                               : rgba8_copy_aligned_src;
+      } else if ((rgbx && tiledFormat == MESA_FORMAT_B8G8R8X8_UNORM &&
+                  format == GL_BGRA) ||
+                 (rgbx && tiledFormat == MESA_FORMAT_R8G8B8X8_UNORM &&
+                  format == GL_RGBA)) {
+         *mem_copy = memcpy;
+      }
+   }
+
+   if (!*mem_copy)
+      return false;
+
+#ifdef __SSE4_1__
+   if (*mem_copy == memcpy && direction == INTEL_DOWNLOAD)
+      *mem_copy = streaming_load_memcpy;
+#endif
+
+   return true;
+}
+
+/**
+ * A band of tile rows copied by one thread of linear_to_tiled_parallel().
+ */
+struct tiled_memcpy_job {
+   uint32_t xt1, xt2;
+   uint32_t yt1, yt2;
+   char *dst;
+   const char *src;
+   uint32_t dst_pitch;
+   int32_t src_pitch;
+   bool has_swizzling;
+   uint32_t tiling;
+   mem_copy_fn mem_copy;
+};
+
+struct tiled_memcpy_pool {
+   /** Held by the thread submitting jobs, so there is one batch at a time */
+   mtx_t submit_mutex;
+
+   mtx_t mutex;
+   cnd_t job_added;
+   cnd_t job_done;
+
+   /** The current batch of jobs, owned by the submitting thread */
+   struct tiled_memcpy_job *jobs;
+   unsigned num_jobs;
+   unsigned next_job;
+   unsigned jobs_done;
+
+   bool exit;
+
+   /** Threads are only started by the first copy worth it */
+   bool threads_started;
+   unsigned max_threads;
+
+   unsigned num_threads;
+   thrd_t threads[];
+};
+
+/**
+ * Copies of fewer bytes than this are not worth handing to other threads.
+ */
+static const size_t parallel_threshold = 1 << 20;
+
+static void
+run_job(const struct tiled_memcpy_job *job)
+{
+   linear_to_tiled(job->xt1, job->xt2, job->yt1, job->yt2,
+                   job->dst, job->src, job->dst_pitch, job->src_pitch,
+                   job->has_swizzling, job->tiling, job->mem_copy);
+}
+
+/**
+ * Run the jobs of the current batch until there are none left.  Called with
+ * pool->mutex held, which is released while copying.
+ */
+static void
+run_jobs(struct tiled_memcpy_pool *pool)
+{
+   while (pool->next_job < pool->num_jobs) {
+      const struct tiled_memcpy_job *job = &pool->jobs[pool->next_job++];
+
+      mtx_unlock(&pool->mutex);
+      run_job(job);
+      mtx_lock(&pool->mutex);
+
+      if (++pool->jobs_done == pool->num_jobs)
+         cnd_signal(&pool->job_done);
+   }
+}
+
+static int
+tiled_memcpy_thread(void *data)
+{
+   struct tiled_memcpy_pool *pool = data;
+
+   mtx_lock(&pool->mutex);
+
+   while (!pool->exit) {
+      run_jobs(pool);
+      cnd_wait(&pool->job_added, &pool->mutex);
+   }
+
+   mtx_unlock(&pool->mutex);
+
+   return 0;
+}
+
+/**
+ * Create a pool of up to \p num_threads threads for
+ * linear_to_tiled_parallel().  The threads are only started by the first
+ * copy large enough to be split, so that processes which never upload big
+ * textures don't pay for them.
+ */
+struct tiled_memcpy_pool *
+tiled_memcpy_pool_create(unsigned num_threads)
+{
+   struct tiled_memcpy_pool *pool;
+
+   num_threads = MIN2(num_threads, TILED_MEMCPY_MAX_THREADS);
+   if (num_threads == 0)
+      return NULL;
+
+   pool = calloc(1, sizeof *pool + num_threads * sizeof pool->threads[0]);
+   if (!pool)
+      return NULL;
+
+   mtx_init(&pool->submit_mutex, mtx_plain);
+   mtx_init(&pool->mutex, mtx_plain);
+   cnd_init(&pool->job_added);
+   cnd_init(&pool->job_done);
+
+   pool->max_threads = num_threads;
+
+   return pool;
+}
+
+/**
+ * Start the threads of \p pool, with pool->submit_mutex held.
+ */
+static void
+start_threads(struct tiled_memcpy_pool *pool)
+{
+   unsigned i;
+
+   for (i = 0; i < pool->max_threads; i++) {
+      if (thrd_create(&pool->threads[i], tiled_memcpy_thread, pool) !=
+          thrd_success)
+         break;
+   }
+   pool->num_threads = i;
+   pool->threads_started = true;
+}
+
+void
+tiled_memcpy_pool_destroy(struct tiled_memcpy_pool *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   mtx_lock(&pool->mutex);
+   pool->exit = true;
+   cnd_broadcast(&pool->job_added);
+   mtx_unlock(&pool->mutex);
+
+   for (i = 0; i < pool->num_threads; i++)
+      thrd_join(pool->threads[i], NULL);
+
+   cnd_destroy(&pool->job_done);
+   cnd_destroy(&pool->job_added);
+   mtx_destroy(&pool->mutex);
+   mtx_destroy(&pool->submit_mutex);
+
+   free(pool);
+}
+
+/**
+ * Same as \ref linear_to_tiled, but for large copies split the region into
+ * bands of whole tile rows, which are copied by the threads of \p pool and
+ * the calling thread.  Returns once the whole region is copied.
+ *
+ * \p pool may be NULL.  If another thread is using the pool, the copy is
+ * done on the calling thread only.
+ */
+void
+linear_to_tiled_parallel(struct tiled_memcpy_pool *pool,
+                         uint32_t xt1, uint32_t xt2,
+                         uint32_t yt1, uint32_t yt2,
+                         char *dst, const char *src,
+                         uint32_t dst_pitch, int32_t src_pitch,
+                         bool has_swizzling,
+                         uint32_t tiling,
+                         mem_copy_fn mem_copy)
+{
+   struct tiled_memcpy_job jobs[TILED_MEMCPY_MAX_THREADS + 1];
+   const uint32_t th = tiling == I915_TILING_X ? xtile_height : ytile_height;
+   uint32_t tile_rows, rows_per_job, y;
+   unsigned num_jobs;
+
+   if (!pool ||
+       (size_t) (xt2 - xt1) * (yt2 - yt1) < parallel_threshold ||
+       (tiling != I915_TILING_X && tiling != I915_TILING_Y) ||
+       mtx_trylock(&pool->submit_mutex) != thrd_success) {
+      linear_to_tiled(xt1, xt2, yt1, yt2, dst, src, dst_pitch, src_pitch,
+                      has_swizzling, tiling, mem_copy);
+      return;
+   }
+
+   if (!pool->threads_started)
+      start_threads(pool);
+
+   if (pool->num_threads == 0) {
+      mtx_unlock(&pool->submit_mutex);
+      linear_to_tiled(xt1, xt2, yt1, yt2, dst, src, dst_pitch, src_pitch,
+                      has_swizzling, tiling, mem_copy);
+      return;
+   }
+
+   /* Each job gets a band of whole tile rows, so that no tile is written by
+    * two threads.
+    */
+   tile_rows = ALIGN_UP(yt2, th) / th - ALIGN_DOWN(yt1, th) / th;
+   num_jobs = MIN2(pool->num_threads + 1, tile_rows);
+   rows_per_job = (tile_rows + num_jobs - 1) / num_jobs * th;
+
+   num_jobs = 0;
+   for (y = yt1; y < yt2; ) {
+      const uint32_t y_end =
+         MIN2(ALIGN_DOWN(y, th) + rows_per_job, yt2);
+      struct tiled_memcpy_job *job = &jobs[num_jobs++];
+
+      job->xt1 = xt1;
+      job->xt2 = xt2;
+      job->yt1 = y;
+      job->yt2 = y_end;
+      job->dst = dst;
+      job->src = src;
+      job->dst_pitch = dst_pitch;
+      job->src_pitch = src_pitch;
+      job->has_swizzling = has_swizzling;
+      job->tiling = tiling;
+      job->mem_copy = mem_copy;
+
+      y = y_end;
+   }
+
+   mtx_lock(&pool->mutex);
+
+   pool->jobs = jobs;
+   pool->num_jobs = num_jobs;
+   pool->next_job = 0;
+   pool->jobs_done = 0;
+   cnd_broadcast(&pool->job_added);
+
+   run_jobs(pool);
+
+   while (pool->jobs_done < pool->num_jobs)
+      cnd_wait(&pool->job_done, &pool->mutex);
+
+   pool->jobs = NULL;
+   pool->num_jobs = 0;
+   pool->next_job = 0;
+
+   mtx_unlock(&pool->mutex);
+
+   mtx_unlock(&pool->submit_mutex);
+}
@@ -0,0 +1,108 @@
+/**************************************************************************
+ *
+ * Copyright 2003 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file intel_tiled_memcpy.h
+ *
+ * Copies between linear memory and the X- and Y-tiled layouts of the
+ * hardware, without going through a GTT fence.
+ */
+
+#ifndef INTEL_TILED_MEMCPY_H
+#define INTEL_TILED_MEMCPY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "main/glheader.h"
+#include "main/formats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *(*mem_copy_fn)(void *dest, const void *src, size_t n);
+
+enum intel_memcpy_direction
+{
+   INTEL_UPLOAD,
+   INTEL_DOWNLOAD
+};
+
+void
+linear_to_tiled(uint32_t xt1, uint32_t xt2,
+                uint32_t yt1, uint32_t yt2,
+                char *dst, const char *src,
+                uint32_t dst_pitch, int32_t src_pitch,
+                bool has_swizzling,
+                uint32_t tiling,
+                mem_copy_fn mem_copy);
+
+void
+tiled_to_linear(uint32_t xt1, uint32_t xt2,
+                uint32_t yt1, uint32_t yt2,
+                char *dst, const char *src,
+                int32_t dst_pitch, uint32_t src_pitch,
+                bool has_swizzling,
+                uint32_t tiling,
+                mem_copy_fn mem_copy);
+
+/**
+ * The most threads a tiled_memcpy_pool has, besides the calling thread.
+ * Copies are limited by memory bandwidth, which a few threads saturate.
+ */
+#define TILED_MEMCPY_MAX_THREADS 3
+
+struct tiled_memcpy_pool;
+
+struct tiled_memcpy_pool *
+tiled_memcpy_pool_create(unsigned num_threads);
+
+void
+tiled_memcpy_pool_destroy(struct tiled_memcpy_pool *pool);
+
+void
+linear_to_tiled_parallel(struct tiled_memcpy_pool *pool,
+                         uint32_t xt1, uint32_t xt2,
+                         uint32_t yt1, uint32_t yt2,
+                         char *dst, const char *src,
+                         uint32_t dst_pitch, int32_t src_pitch,
+                         bool has_swizzling,
+                         uint32_t tiling,
+                         mem_copy_fn mem_copy);
+
+bool
+intel_get_memcpy(mesa_format tiledFormat, GLenum format,
+                 GLenum type, mem_copy_fn *mem_copy, uint32_t *cpp,
+                 enum intel_memcpy_direction direction);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INTEL_TILED_MEMCPY_H */
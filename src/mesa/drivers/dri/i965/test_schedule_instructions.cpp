@@ -0,0 +1,465 @@
+/*
+ * Copyright © 2014 LunarG, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Schedules large synthetic programs with the FS and vec4 instruction
+ * schedulers, checks that the result still honors every register and
+ * barrier dependency, and reports how long scheduling took.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/time.h>
+#include <map>
+#include <vector>
+#include "brw_fs.h"
+#include "brw_vec4.h"
+#include "brw_vs.h"
+
+using namespace brw;
+
+#define NUM_INSTRUCTIONS 10000
+#define NUM_HW_GRFS 128
+
+enum synthetic_op {
+   SYN_ADD,
+   SYN_MUL,
+   SYN_MAD,
+   SYN_MATH,
+   SYN_POW,
+   SYN_CMP,
+   SYN_SEL,
+   SYN_ATOMIC,
+};
+
+/**
+ * An instruction of a synthetic program, with abstract register numbers
+ * that each backend maps onto its own registers.
+ */
+struct synthetic_inst {
+   enum synthetic_op op;
+   int dst;
+   int src[3];
+};
+
+static unsigned
+next_random(unsigned *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ * Generates a single basic block of dependent ALU work, with some math,
+ * flag writes and reads, a few widely read values, and the occasional
+ * instruction with side effects.
+ */
+static std::vector<synthetic_inst>
+generate_program(unsigned seed, int count, int *reg_count)
+{
+   std::vector<synthetic_inst> program;
+   const int num_inputs = 16;
+   const int window = 32;
+   int regs = num_inputs;
+
+   for (int i = 0; (int) program.size() < count; i++) {
+      unsigned r = next_random(&seed) % 100;
+      synthetic_inst inst;
+
+      if (r < 5)
+         inst.op = SYN_MATH;
+      else if (r < 6)
+         inst.op = SYN_POW;
+      else if (r < 9)
+         inst.op = SYN_CMP;
+      else if (r < 10)
+         inst.op = SYN_SEL;
+      else if (r < 11)
+         inst.op = SYN_ATOMIC;
+      else if (r < 40)
+         inst.op = SYN_MAD;
+      else if (r < 70)
+         inst.op = SYN_MUL;
+      else
+         inst.op = SYN_ADD;
+
+      for (int s = 0; s < 3; s++) {
+         unsigned pick = next_random(&seed) % 10;
+
+         if (pick < 2 || regs == num_inputs)
+            inst.src[s] = next_random(&seed) % num_inputs;
+         else if (pick < 9)
+            inst.src[s] = regs - 1 - next_random(&seed) % MIN2(window,
+                                                                 regs - num_inputs);
+         else
+            inst.src[s] = next_random(&seed) % regs;
+      }
+
+      if (next_random(&seed) % 5 == 0 && regs > num_inputs)
+         inst.dst = regs - 1 - next_random(&seed) % MIN2(window,
+                                                         regs - num_inputs);
+      else
+         inst.dst = regs++;
+
+      program.push_back(inst);
+   }
+
+   *reg_count = regs;
+   return program;
+}
+
+static double
+get_time(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Checks that \p instructions is an ordering of \p original that keeps
+ * every read of a register or of the flag between the same two writes, the
+ * writes in order, and the instructions with side effects in place.
+ */
+template<class inst_type> static void
+check_schedule(exec_list *instructions,
+               const std::vector<inst_type *> &original)
+{
+   std::map<inst_type *, int> index;
+   std::map<int, int> writes;
+   std::vector<int> epoch_of_src[3], epoch_of_dst, epoch_of_flag;
+   const int flag = -1;
+
+   /* Number each access by how many writes of its register precede it in
+    * the original order.
+    */
+   for (unsigned i = 0; i < original.size(); i++) {
+      inst_type *inst = original[i];
+
+      index[inst] = i;
+
+      epoch_of_flag.push_back(writes[flag]);
+      for (int s = 0; s < 3; s++) {
+         epoch_of_src[s].push_back(inst->src[s].file == GRF ?
+                                   writes[inst->src[s].reg] : 0);
+      }
+      if (inst->dst.file == GRF)
+         epoch_of_dst.push_back(writes[inst->dst.reg]++);
+      else
+         epoch_of_dst.push_back(0);
+      if (inst->conditional_mod && inst->opcode != BRW_OPCODE_SEL)
+         writes[flag]++;
+   }
+
+   writes.clear();
+
+   int ip = 0;
+   foreach_list(node, instructions) {
+      inst_type *inst = (inst_type *)node;
+
+      ASSERT_EQ(1u, index.count(inst));
+      int i = index[inst];
+
+      if (inst->has_side_effects())
+         EXPECT_EQ(i, ip);
+
+      if (inst->predicate)
+         EXPECT_EQ(epoch_of_flag[i], writes[flag]);
+      for (int s = 0; s < 3; s++) {
+         if (inst->src[s].file == GRF)
+            EXPECT_EQ(epoch_of_src[s][i], writes[inst->src[s].reg]);
+      }
+      if (inst->dst.file == GRF)
+         EXPECT_EQ(epoch_of_dst[i], writes[inst->dst.reg]++);
+      if (inst->conditional_mod && inst->opcode != BRW_OPCODE_SEL) {
+         EXPECT_EQ(epoch_of_flag[i], writes[flag]);
+         writes[flag]++;
+      }
+
+      ip++;
+   }
+
+   EXPECT_EQ((int) original.size(), ip);
+}
+
+class schedule_instructions_test : public ::testing::Test {
+   virtual void SetUp();
+   virtual void TearDown();
+
+public:
+   struct brw_context *brw;
+   struct brw_wm_compile *c;
+   struct gl_fragment_program *fp;
+   fs_visitor *v;
+};
+
+void schedule_instructions_test::SetUp()
+{
+   brw = (struct brw_context *)calloc(1, sizeof(*brw));
+   brw->gen = 7;
+
+   c = rzalloc(NULL, struct brw_wm_compile);
+   fp = rzalloc(NULL, struct gl_fragment_program);
+
+   v = new fs_visitor(brw, c, NULL, fp, 8);
+}
+
+void schedule_instructions_test::TearDown()
+{
+   delete v;
+   ralloc_free(fp);
+   ralloc_free(c);
+   free(brw);
+}
+
+static std::vector<fs_inst *>
+emit_fs_program(fs_visitor *v, const std::vector<synthetic_inst> &program,
+                int reg_count, bool virtual_grfs)
+{
+   std::vector<fs_inst *> emitted;
+   std::vector<fs_reg> regs;
+
+   for (int i = 0; i < reg_count; i++) {
+      if (virtual_grfs)
+         regs.push_back(fs_reg(v, glsl_type::float_type));
+      else
+         regs.push_back(fs_reg(GRF, i % NUM_HW_GRFS, BRW_REGISTER_TYPE_F));
+   }
+
+   for (unsigned i = 0; i < program.size(); i++) {
+      const synthetic_inst &s = program[i];
+      fs_reg dst = regs[s.dst];
+      fs_reg a = regs[s.src[0]], b = regs[s.src[1]], c = regs[s.src[2]];
+      fs_inst *inst;
+
+      switch (s.op) {
+      case SYN_ADD:
+         inst = v->emit(v->ADD(dst, a, b));
+         break;
+      case SYN_MUL:
+         inst = v->emit(v->MUL(dst, a, b));
+         break;
+      case SYN_MAD:
+         inst = v->emit(v->MAD(dst, a, b, c));
+         break;
+      case SYN_MATH:
+         inst = v->emit(SHADER_OPCODE_RSQ, dst, a);
+         break;
+      case SYN_POW:
+         inst = v->emit(SHADER_OPCODE_POW, dst, a, b);
+         break;
+      case SYN_CMP:
+         inst = v->emit(v->CMP(reg_null_f, a, b, BRW_CONDITIONAL_L));
+         break;
+      case SYN_SEL:
+         inst = v->emit(v->SEL(dst, a, b));
+         inst->predicate = BRW_PREDICATE_NORMAL;
+         break;
+      case SYN_ATOMIC:
+      default:
+         inst = v->emit(SHADER_OPCODE_UNTYPED_ATOMIC, dst, a, b);
+         break;
+      }
+
+      emitted.push_back(inst);
+   }
+
+   return emitted;
+}
+
+TEST_F(schedule_instructions_test, fs_pre_reg_alloc)
+{
+   int reg_count;
+   std::vector<synthetic_inst> program =
+      generate_program(1, NUM_INSTRUCTIONS, &reg_count);
+   std::vector<fs_inst *> original =
+      emit_fs_program(v, program, reg_count, true);
+
+   const double start = get_time();
+   v->schedule_instructions(SCHEDULE_PRE);
+   const double elapsed = get_time() - start;
+
+   check_schedule(&v->instructions, original);
+
+   printf("FS pre-RA: %d instructions scheduled in %.1f ms\n",
+          NUM_INSTRUCTIONS, elapsed * 1000.0);
+}
+
+TEST_F(schedule_instructions_test, fs_pre_reg_alloc_lifo)
+{
+   int reg_count;
+   std::vector<synthetic_inst> program =
+      generate_program(2, NUM_INSTRUCTIONS, &reg_count);
+   std::vector<fs_inst *> original =
+      emit_fs_program(v, program, reg_count, true);
+
+   const double start = get_time();
+   v->schedule_instructions(SCHEDULE_PRE_LIFO);
+   const double elapsed = get_time() - start;
+
+   check_schedule(&v->instructions, original);
+
+   printf("FS pre-RA LIFO: %d instructions scheduled in %.1f ms\n",
+          NUM_INSTRUCTIONS, elapsed * 1000.0);
+}
+
+TEST_F(schedule_instructions_test, fs_post_reg_alloc)
+{
+   int reg_count;
+   std::vector<synthetic_inst> program =
+      generate_program(3, NUM_INSTRUCTIONS, &reg_count);
+   std::vector<fs_inst *> original =
+      emit_fs_program(v, program, reg_count, false);
+
+   v->grf_used = NUM_HW_GRFS;
+
+   const double start = get_time();
+   v->schedule_instructions(SCHEDULE_POST);
+   const double elapsed = get_time() - start;
+
+   check_schedule(&v->instructions, original);
+
+   printf("FS post-RA: %d instructions scheduled in %.1f ms\n",
+          NUM_INSTRUCTIONS, elapsed * 1000.0);
+}
+
+class schedule_vec4_visitor : public vec4_visitor
+{
+public:
+   schedule_vec4_visitor(struct brw_context *brw,
+                         struct brw_vec4_prog_data *prog_data,
+                         struct gl_shader_program *shader_prog)
+      : vec4_visitor(brw, NULL, NULL, NULL, prog_data, shader_prog, NULL,
+                     NULL, false, false /* no_spills */,
+                     ST_NONE, ST_NONE, ST_NONE)
+   {
+   }
+
+protected:
+   virtual dst_reg *make_reg_for_system_value(ir_variable *ir)
+   {
+      assert(!"Not reached");
+      return NULL;
+   }
+
+   virtual void setup_payload()
+   {
+      assert(!"Not reached");
+   }
+
+   virtual void emit_prolog()
+   {
+      assert(!"Not reached");
+   }
+
+   virtual void emit_program_code()
+   {
+      assert(!"Not reached");
+   }
+
+   virtual void emit_thread_end()
+   {
+      assert(!"Not reached");
+   }
+
+   virtual void emit_urb_write_header(int mrf)
+   {
+      assert(!"Not reached");
+   }
+
+   virtual vec4_instruction *emit_urb_write_opcode(bool complete)
+   {
+      assert(!"Not reached");
+      unreachable();
+   }
+};
+
+TEST_F(schedule_instructions_test, vec4)
+{
+   struct brw_vec4_prog_data *prog_data =
+      rzalloc(NULL, struct brw_vec4_prog_data);
+   struct gl_shader_program *shader_prog =
+      rzalloc(NULL, struct gl_shader_program);
+   vec4_visitor *vv = new schedule_vec4_visitor(brw, prog_data, shader_prog);
+   std::vector<vec4_instruction *> original;
+   int reg_count;
+
+   prog_data->total_grf = NUM_HW_GRFS;
+
+   std::vector<synthetic_inst> program =
+      generate_program(4, NUM_INSTRUCTIONS, &reg_count);
+
+   for (unsigned i = 0; i < program.size(); i++) {
+      const synthetic_inst &s = program[i];
+      dst_reg dst = dst_reg(GRF, s.dst % NUM_HW_GRFS);
+      src_reg a = src_reg(dst_reg(GRF, s.src[0] % NUM_HW_GRFS));
+      src_reg b = src_reg(dst_reg(GRF, s.src[1] % NUM_HW_GRFS));
+      src_reg c = src_reg(dst_reg(GRF, s.src[2] % NUM_HW_GRFS));
+      vec4_instruction *inst;
+
+      switch (s.op) {
+      case SYN_ADD:
+         inst = vv->emit(vv->ADD(dst, a, b));
+         break;
+      case SYN_MUL:
+         inst = vv->emit(vv->MUL(dst, a, b));
+         break;
+      case SYN_MAD:
+         inst = vv->emit(vv->MAD(dst, a, b, c));
+         break;
+      case SYN_MATH:
+         inst = vv->emit(SHADER_OPCODE_RSQ, dst, a);
+         break;
+      case SYN_POW:
+         inst = vv->emit(SHADER_OPCODE_POW, dst, a, b);
+         break;
+      case SYN_CMP:
+         inst = vv->emit(vv->CMP(dst_reg(brw_null_reg()), a, b,
+                                 BRW_CONDITIONAL_L));
+         break;
+      case SYN_SEL:
+         inst = vv->emit(BRW_OPCODE_SEL, dst, a, b);
+         inst->predicate = BRW_PREDICATE_NORMAL;
+         break;
+      case SYN_ATOMIC:
+      default:
+         inst = vv->emit(SHADER_OPCODE_UNTYPED_ATOMIC, dst, a, b);
+         break;
+      }
+
+      original.push_back(inst);
+   }
+
+   const double start = get_time();
+   vv->opt_schedule_instructions();
+   const double elapsed = get_time() - start;
+
+   check_schedule(&vv->instructions, original);
+
+   printf("vec4: %d instructions scheduled in %.1f ms\n",
+          NUM_INSTRUCTIONS, elapsed * 1000.0);
+
+   delete vv;
+   ralloc_free(shader_prog);
+   ralloc_free(prog_data);
+}
@@ -0,0 +1,460 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file test_tiled_memcpy.cpp
+ *
+ * Compares linear_to_tiled() and tiled_to_linear() byte for byte with a
+ * straightforward per-byte swizzler for each pixel size, and measures their
+ * throughput.  Runs on the CPU only.
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <i915_drm.h>
+
+#include "intel_tiled_memcpy.h"
+
+namespace {
+
+/* Width in bytes and height in rows of each tiling. */
+const uint32_t tile_width[3] = { 0, 512, 128 };
+const uint32_t tile_height[3] = { 0, 8, 32 };
+
+/**
+ * Offset of byte \p x of row \p y of a tiled surface.  Bit 6 swizzling
+ * is based on bits 9 and 10 for X tiling and on bit 9 for Y tiling.
+ */
+uint32_t
+tiled_offset(uint32_t x, uint32_t y, uint32_t pitch, uint32_t tiling,
+             bool swizzle)
+{
+   const uint32_t tw = tile_width[tiling], th = tile_height[tiling];
+   const uint32_t tile = (y / th) * (pitch / tw) + x / tw;
+   uint32_t offset;
+
+   x %= tw;
+   y %= th;
+
+   if (tiling == I915_TILING_X)
+      offset = tile * 4096 + y * tw + x;
+   else
+      offset = tile * 4096 + (x / 16) * (16 * th) + y * 16 + x % 16;
+
+   if (swizzle) {
+      uint32_t bit = (offset >> 9) & 1;
+      if (tiling == I915_TILING_X)
+         bit ^= (offset >> 10) & 1;
+      offset ^= bit << 6;
+   }
+
+   return offset;
+}
+
+/**
+ * Map a byte of client data to the byte of a pixel it comes from.
+ */
+uint32_t
+swap_rb(uint32_t x, bool rgba)
+{
+   if (!rgba)
+      return x;
+
+   switch (x % 4) {
+   case 0: return x + 2;
+   case 2: return x - 2;
+   default: return x;
+   }
+}
+
+struct surface {
+   uint32_t width, height, cpp, tiling;
+   uint32_t pitch;
+   uint8_t *tiled;
+   uint8_t *linear;
+
+   surface(uint32_t width, uint32_t height, uint32_t cpp, uint32_t tiling)
+      : width(width), height(height), cpp(cpp), tiling(tiling)
+   {
+      const uint32_t tw = tile_width[tiling], th = tile_height[tiling];
+      void *ptr;
+
+      pitch = (width * cpp + tw - 1) / tw * tw;
+      size = pitch * ((height + th - 1) / th * th);
+      linear_pitch = width * cpp;
+
+      if (posix_memalign(&ptr, 4096, size) != 0)
+         ptr = NULL;
+      tiled = (uint8_t *) ptr;
+      linear = (uint8_t *) malloc(linear_pitch * height);
+
+      for (uint32_t i = 0; i < size; i++)
+         tiled[i] = rand();
+      for (uint32_t i = 0; i < linear_pitch * height; i++)
+         linear[i] = rand();
+   }
+
+   ~surface()
+   {
+      free(tiled);
+      free(linear);
+   }
+
+   uint32_t size;
+   uint32_t linear_pitch;
+};
+
+/**
+ * A tiled format and the client format and type to copy it from or to.
+ */
+struct copy_format {
+   mesa_format tiled_format;
+   GLenum format, type;
+   uint32_t cpp;
+   bool rgba;        /**< Whether R and B are swapped */
+};
+
+mem_copy_fn
+get_copy(const copy_format &f, enum intel_memcpy_direction direction)
+{
+   mem_copy_fn mem_copy = NULL;
+   uint32_t cpp = 0;
+
+   EXPECT_TRUE(intel_get_memcpy(f.tiled_format, f.format, f.type,
+                                &mem_copy, &cpp, direction));
+   EXPECT_EQ(f.cpp, cpp);
+
+   return mem_copy;
+}
+
+/**
+ * Upload the pixels [x, x + w) x [y, y + h) from the linear copy and check
+ * every byte of the tiled surface, including those that must be untouched.
+ */
+void
+check_upload(surface &s, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+             bool swizzle, const copy_format &f)
+{
+   const bool rgba = f.rgba;
+   uint8_t *before = (uint8_t *) malloc(s.size);
+   const uint32_t cpp = s.cpp;
+
+   memcpy(before, s.tiled, s.size);
+
+   linear_to_tiled(x * cpp, (x + w) * cpp, y, y + h,
+                   (char *) s.tiled,
+                   (const char *) s.linear - y * s.linear_pitch - x * cpp,
+                   s.pitch, s.linear_pitch,
+                   swizzle, s.tiling,
+                   get_copy(f, INTEL_UPLOAD));
+
+   for (uint32_t j = 0; j < h; j++) {
+      for (uint32_t i = 0; i < w * cpp; i++) {
+         const uint32_t offset = tiled_offset((x * cpp) + i, y + j,
+                                              s.pitch, s.tiling, swizzle);
+         ASSERT_EQ(s.linear[j * s.linear_pitch + swap_rb(i, rgba)],
+                   s.tiled[offset])
+            << "byte " << i << " of row " << j;
+         s.tiled[offset] = before[offset];
+      }
+   }
+
+   /* Everything outside of the rectangle was put back above. */
+   ASSERT_EQ(0, memcmp(before, s.tiled, s.size));
+
+   free(before);
+}
+
+/**
+ * Download the pixels [x, x + w) x [y, y + h) to the linear copy and check
+ * every byte of it, optionally with the rows in reverse order.
+ */
+void
+check_download(surface &s, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+               bool swizzle, const copy_format &f, bool flip)
+{
+   const bool rgba = f.rgba;
+   const uint32_t cpp = s.cpp;
+   int32_t dst_pitch = s.linear_pitch;
+   char *dst = (char *) s.linear;
+
+   if (flip) {
+      dst += (ptrdiff_t) (h - 1) * dst_pitch;
+      dst_pitch = -dst_pitch;
+   }
+
+   tiled_to_linear(x * cpp, (x + w) * cpp, y, y + h,
+                   dst - (ptrdiff_t) y * dst_pitch - (ptrdiff_t) x * cpp,
+                   (const char *) s.tiled,
+                   dst_pitch, s.pitch,
+                   swizzle, s.tiling,
+                   get_copy(f, INTEL_DOWNLOAD));
+
+   for (uint32_t j = 0; j < h; j++) {
+      const uint32_t row = flip ? h - 1 - j : j;
+
+      for (uint32_t i = 0; i < w * cpp; i++) {
+         const uint32_t offset = tiled_offset((x * cpp) + swap_rb(i, rgba),
+                                              y + j, s.pitch, s.tiling,
+                                              swizzle);
+         ASSERT_EQ(s.tiled[offset], s.linear[row * s.linear_pitch + i])
+            << "byte " << i << " of row " << j;
+      }
+   }
+}
+
+/* Rectangles covering full tiles, partial spans and single pixels. */
+const struct {
+   uint32_t x, y, w, h;
+} rects[] = {
+   { 0, 0, 256, 128 },
+   { 0, 0, 1, 1 },
+   { 3, 5, 1, 1 },
+   { 1, 1, 200, 70 },
+   { 5, 3, 17, 2 },
+   { 31, 7, 97, 41 },
+   { 127, 31, 129, 97 },
+   { 16, 8, 32, 32 },
+};
+
+void
+check_all(const copy_format &f, uint32_t tiling)
+{
+   srand(tiling * 32 + f.cpp * 2 + f.rgba);
+
+   for (unsigned swizzle = 0; swizzle < 2; swizzle++) {
+      for (unsigned r = 0; r < sizeof(rects) / sizeof(rects[0]); r++) {
+         surface s(256, 128, f.cpp, tiling);
+
+         SCOPED_TRACE(::testing::Message() << "rect " << r
+                      << " swizzle " << swizzle);
+
+         check_upload(s, rects[r].x, rects[r].y, rects[r].w, rects[r].h,
+                      swizzle, f);
+         check_download(s, rects[r].x, rects[r].y, rects[r].w, rects[r].h,
+                        swizzle, f, false);
+         check_download(s, rects[r].x, rects[r].y, rects[r].w, rects[r].h,
+                        swizzle, f, true);
+      }
+   }
+}
+
+const copy_format a8 =
+   { MESA_FORMAT_A_UNORM8, GL_ALPHA, GL_UNSIGNED_BYTE, 1, false };
+const copy_format rgb565 =
+   { MESA_FORMAT_B5G6R5_UNORM, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2, false };
+const copy_format bgra8 =
+   { MESA_FORMAT_B8G8R8A8_UNORM, GL_BGRA, GL_UNSIGNED_BYTE, 4, false };
+const copy_format rgba8 =
+   { MESA_FORMAT_B8G8R8A8_UNORM, GL_RGBA, GL_UNSIGNED_BYTE, 4, true };
+const copy_format rgba16f =
+   { MESA_FORMAT_RGBA_FLOAT16, GL_RGBA, GL_HALF_FLOAT, 8, false };
+const copy_format rgba32f =
+   { MESA_FORMAT_RGBA_FLOAT32, GL_RGBA, GL_FLOAT, 16, false };
+
+double
+now(void)
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+} /* anonymous namespace */
+
+TEST(tiled_memcpy, xtiled_a8)
+{
+   check_all(a8, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_a8)
+{
+   check_all(a8, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xtiled_rgb565)
+{
+   check_all(rgb565, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_rgb565)
+{
+   check_all(rgb565, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xtiled_bgra8)
+{
+   check_all(bgra8, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_bgra8)
+{
+   check_all(bgra8, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xtiled_rgba8)
+{
+   check_all(rgba8, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_rgba8)
+{
+   check_all(rgba8, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xtiled_rgba16f)
+{
+   check_all(rgba16f, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_rgba16f)
+{
+   check_all(rgba16f, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xtiled_rgba32f)
+{
+   check_all(rgba32f, I915_TILING_X);
+}
+
+TEST(tiled_memcpy, ytiled_rgba32f)
+{
+   check_all(rgba32f, I915_TILING_Y);
+}
+
+TEST(tiled_memcpy, xrgb8_download_unsupported)
+{
+   mem_copy_fn mem_copy;
+   uint32_t cpp;
+
+   EXPECT_TRUE(intel_get_memcpy(MESA_FORMAT_B8G8R8X8_UNORM, GL_BGRA,
+                                GL_UNSIGNED_BYTE, &mem_copy, &cpp,
+                                INTEL_UPLOAD));
+   EXPECT_FALSE(intel_get_memcpy(MESA_FORMAT_B8G8R8X8_UNORM, GL_BGRA,
+                                 GL_UNSIGNED_BYTE, &mem_copy, &cpp,
+                                 INTEL_DOWNLOAD));
+}
+
+TEST(tiled_memcpy, depth_unsupported)
+{
+   mem_copy_fn mem_copy;
+   uint32_t cpp;
+
+   EXPECT_FALSE(intel_get_memcpy(MESA_FORMAT_Z_UNORM16, GL_DEPTH_COMPONENT,
+                                 GL_UNSIGNED_SHORT, &mem_copy, &cpp,
+                                 INTEL_UPLOAD));
+}
+
+/**
+ * A copy split across threads must write the same bytes as one done by a
+ * single thread, including for bands that start and end mid-tile.
+ */
+TEST(tiled_memcpy, parallel)
+{
+   struct tiled_memcpy_pool *pool =
+      tiled_memcpy_pool_create(TILED_MEMCPY_MAX_THREADS);
+   ASSERT_TRUE(pool != NULL);
+
+   for (uint32_t tiling = I915_TILING_X; tiling <= I915_TILING_Y; tiling++) {
+      surface s(1024, 1024, 4, tiling);
+      uint8_t *expected = (uint8_t *) malloc(s.size);
+      const uint32_t x = 3, y = 5, w = 1000, h = 1011;
+      const char *src = (const char *) s.linear - y * s.linear_pitch - x * 4;
+
+      memcpy(expected, s.tiled, s.size);
+      linear_to_tiled(x * 4, (x + w) * 4, y, y + h,
+                      (char *) expected, src, s.pitch, s.linear_pitch,
+                      true, tiling, get_copy(rgba8, INTEL_UPLOAD));
+
+      linear_to_tiled_parallel(pool, x * 4, (x + w) * 4, y, y + h,
+                               (char *) s.tiled, src,
+                               s.pitch, s.linear_pitch,
+                               true, tiling, get_copy(rgba8, INTEL_UPLOAD));
+
+      EXPECT_EQ(0, memcmp(expected, s.tiled, s.size));
+
+      free(expected);
+   }
+
+   tiled_memcpy_pool_destroy(pool);
+}
+
+/**
+ * Not a correctness test: prints the throughput of both directions for a
+ * 2048x2048 BGRA image, with and without the R/B swap, and of uploads
+ * split across threads.
+ */
+TEST(tiled_memcpy, benchmark)
+{
+   static const char *tiling_names[3] = { "none", "X", "Y" };
+   const unsigned iterations = 8;
+   struct tiled_memcpy_pool *pool =
+      tiled_memcpy_pool_create(TILED_MEMCPY_MAX_THREADS);
+
+   for (uint32_t tiling = I915_TILING_X; tiling <= I915_TILING_Y; tiling++) {
+      for (unsigned swap = 0; swap < 2; swap++) {
+         const copy_format &f = swap ? rgba8 : bgra8;
+         surface s(2048, 2048, 4, tiling);
+         const double mb = iterations * s.linear_pitch * s.height / 1e6;
+         mem_copy_fn up = get_copy(f, INTEL_UPLOAD);
+         mem_copy_fn down = get_copy(f, INTEL_DOWNLOAD);
+         double start, upload, parallel, download;
+
+         start = now();
+         for (unsigned i = 0; i < iterations; i++)
+            linear_to_tiled(0, s.linear_pitch, 0, s.height,
+                            (char *) s.tiled, (const char *) s.linear,
+                            s.pitch, s.linear_pitch, true, tiling, up);
+         upload = now() - start;
+
+         start = now();
+         for (unsigned i = 0; i < iterations; i++)
+            linear_to_tiled_parallel(pool, 0, s.linear_pitch, 0, s.height,
+                                     (char *) s.tiled,
+                                     (const char *) s.linear,
+                                     s.pitch, s.linear_pitch, true, tiling,
+                                     up);
+         parallel = now() - start;
+
+         start = now();
+         for (unsigned i = 0; i < iterations; i++)
+            tiled_to_linear(0, s.linear_pitch, 0, s.height,
+                            (char *) s.linear, (const char *) s.tiled,
+                            s.linear_pitch, s.pitch, true, tiling, down);
+         download = now() - start;
+
+         printf("%s-tiled %s: linear_to_tiled %.0f MB/s, "
+                "linear_to_tiled_parallel %.0f MB/s, "
+                "tiled_to_linear %.0f MB/s\n",
+                tiling_names[tiling], swap ? "RGBA->BGRA" : "BGRA",
+                mb / upload, mb / parallel, mb / download);
+      }
+   }
+
+   tiled_memcpy_pool_destroy(pool);
+}
@@ -674,6 +674,9 @@ _mesa_init_constants(struct gl_context *ctx)
    /* GL_ARB_robustness */
    ctx->Const.ResetStrategy = GL_NO_RESET_NOTIFICATION_ARB;
 
+   /* GL_ARB_get_program_binary */
+   ctx->Const.NumProgramBinaryFormats = 1;
+
    /* PrimitiveRestart */
    ctx->Const.PrimitiveRestartInSoftware = GL_FALSE;
 
@@ -1171,9 +1174,16 @@ complete_shader_task_cb(GLuint id, void *data, void *userData)
    struct gl_context *ctx = (struct gl_context *) userData;
    struct gl_shader *sh = (struct gl_shader *) data;
 
-   if (_mesa_validate_shader_target(ctx, sh->Type) &&
-       sh->Task && sh->TaskData == (void *) ctx)
+   if (sh->Type == GL_SHADER_PROGRAM_MESA) {
+      struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+
+      if (shProg->Task && shProg->TaskData == (void *) ctx)
+         _mesa_complete_shader_program_task(ctx, shProg);
+   }
+   else if (_mesa_validate_shader_target(ctx, sh->Type) &&
+            sh->Task && sh->TaskData == (void *) ctx) {
       _mesa_complete_shader_task(ctx, sh);
+   }
 }
 
 /**
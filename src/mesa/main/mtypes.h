@@ -2348,6 +2348,21 @@ struct gl_shader
    unsigned Version;       /**< GLSL version used for linking */
    GLboolean IsES;         /**< True if this shader uses GLSL ES */
 
+   /**
+    * Set when the front end was skipped because the shader cache knows that
+    * this shader compiles.  The IR is only built at link time, if the
+    * program is not found in the cache.
+    */
+   bool compile_skipped;
+
+   /**
+    * Shader cache key, only valid if \c has_sha1 is set.  Shaders that
+    * weren't compiled from source by glCompileShader, like the fixed-function
+    * fragment shaders built directly as IR, have none.
+    */
+   bool has_sha1;
+   unsigned char sha1[20];
+
    /**
     * \name Sampler tracking
     *
@@ -2560,6 +2575,14 @@ struct gl_shader_program
     */
    GLboolean BinaryRetreivableHint;
 
+   /**
+    * Serialized results of the GLSL linker, as returned by
+    * glGetProgramBinary.  Only set by successful links of programs with
+    * \c BinaryRetreivableHint set, and by glProgramBinary.
+    */
+   GLvoid *Binary;
+   GLsizei BinaryLength;
+
    /**
     * Flags that the linker should not reject the program if it lacks
     * a vertex or fragment shader.  GLES2 doesn't allow separate
@@ -2714,6 +2737,15 @@ struct gl_shader_program
     * #extension ARB_fragment_coord_conventions: enable
     */
    GLboolean ARB_fragment_coord_conventions_enable;
+
+   /**
+    * Deferred task of glLinkProgram.  \c TaskData is the context that queued
+    * the task, and is non-NULL from the time the task is queued until it is
+    * completed.
+    */
+   mtx_t Mutex;
+   struct _mesa_threadpool_task *Task;
+   void *TaskData;
 };   
 
 
@@ -2727,6 +2759,8 @@ struct gl_shader_program
 #define GLSL_USE_PROG 0x80  /**< Log glUseProgram calls */
 #define GLSL_REPORT_ERRORS 0x100  /**< Print compilation errors */
 #define GLSL_DUMP_ON_ERROR 0x200 /**< Dump shaders to stderr on compile error */
+#define GLSL_PP_CACHE 0x400 /**< Reuse preprocessed shader prologues */
+#define GLSL_PP_CACHE_REPORT 0x800 /**< Report prologue cache hits */
 
 
 /**
@@ -3307,6 +3341,9 @@ struct gl_constants
    /* GL_ARB_blend_func_extended */
    GLuint MaxDualSourceDrawBuffers;
 
+   /* GL_ARB_get_program_binary */
+   GLuint NumProgramBinaryFormats;
+
    /**
     * Whether the implementation strips out and ignores texture borders.
     *
@@ -3371,6 +3408,13 @@ struct gl_constants
     */
    GLboolean DisableGLSLLineContinuations;
 
+   /**
+    * Whether ctx->Driver.LinkShader may be called from a thread of the GLSL
+    * thread pool.  When set, and the thread pool is enabled, glLinkProgram
+    * is deferred until the results of the link are needed.
+    */
+   GLboolean DeferLinkProgram;
+
    /** GL_ARB_texture_multisample */
    GLint MaxColorTextureSamples;
    GLint MaxDepthTextureSamples;
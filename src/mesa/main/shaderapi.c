@@ -58,6 +58,7 @@
 #include "../glsl/ir.h"
 #include "../glsl/ir_uniform.h"
 #include "../glsl/program.h"
+#include "../glsl/shader_cache.h"
 
 /** Define this to enable shader substitution (see below) */
 #define SHADER_SUBST 0
@@ -93,6 +94,10 @@ get_shader_flags(void)
          flags |= GLSL_USE_PROG;
       if (strstr(env, "errors"))
          flags |= GLSL_REPORT_ERRORS;
+      if (strstr(env, "ppcache_report"))
+         flags |= GLSL_PP_CACHE | GLSL_PP_CACHE_REPORT;
+      else if (strstr(env, "ppcache"))
+         flags |= GLSL_PP_CACHE;
    }
 
    return flags;
@@ -528,6 +533,8 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname, GLint *param
       return;
    }
 
+   _mesa_complete_shader_program_task(ctx, shProg);
+
    switch (pname) {
    case GL_DELETE_STATUS:
       *params = shProg->DeletePending;
@@ -655,7 +662,10 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname, GLint *param
       *params = shProg->BinaryRetreivableHint;
       return;
    case GL_PROGRAM_BINARY_LENGTH:
-      *params = 0;
+      /* Binaries are only kept for programs linked with
+       * GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, the length is 0 otherwise.
+       */
+      *params = shProg->LinkStatus ? shProg->BinaryLength : 0;
       return;
    case GL_ACTIVE_ATOMIC_COUNTER_BUFFERS:
       if (!ctx->Extensions.ARB_shader_atomic_counters)
@@ -720,6 +730,7 @@ get_program_info_log(struct gl_context *ctx, GLuint program, GLsizei bufSize,
       _mesa_error(ctx, GL_INVALID_VALUE, "glGetProgramInfoLog(program)");
       return;
    }
+   _mesa_complete_shader_program_task(ctx, shProg);
    _mesa_copy_string(infoLog, bufSize, length, shProg->InfoLog);
 }
 
@@ -767,6 +778,7 @@ shader_source(struct gl_context *ctx, GLuint shader, const GLchar *source)
    if (!sh)
       return;
 
+   _mesa_complete_links_using_shader(ctx, sh);
    _mesa_complete_shader_task(ctx, sh);
 
    /* free old shader source string and install new one */
@@ -784,7 +796,7 @@ deferred_compile_shader(void *data)
    struct gl_shader *sh = (struct gl_shader *) data;
    struct gl_context *ctx = (struct gl_context *) sh->TaskData;
 
-   _mesa_glsl_compile_shader(ctx, sh, false, false);
+   _mesa_glsl_compile_shader_cached(ctx, sh);
 }
 
 static bool
@@ -793,8 +805,8 @@ queue_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    if (!ctx->ThreadPool)
       return false;
 
-   /* MESA_GLSL is set */
-   if (ctx->Shader.Flags)
+   /* MESA_GLSL is set, other than to use the prologue cache */
+   if (ctx->Shader.Flags & ~(GLSL_PP_CACHE | GLSL_PP_CACHE_REPORT))
       return false;
 
    /* context requires synchronized compiler warnings and errors */
@@ -823,6 +835,9 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
    if (!sh)
       return;
 
+   /* pending links must not see the recompiled shader */
+   _mesa_complete_links_using_shader(ctx, sh);
+
    options = &ctx->ShaderCompilerOptions[sh->Stage];
 
    /* set default pragma state for shader */
@@ -846,7 +861,7 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
        * compilation was successful.
        */
       if (!queue_compile_shader(ctx, sh))
-         _mesa_glsl_compile_shader(ctx, sh, false, false);
+         _mesa_glsl_compile_shader_cached(ctx, sh);
 
       if (ctx->Shader.Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
@@ -885,6 +900,97 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
 }
 
 
+static int
+compare_shader_ptr(const void *a, const void *b)
+{
+   const uintptr_t sa = (uintptr_t) *(struct gl_shader * const *) a;
+   const uintptr_t sb = (uintptr_t) *(struct gl_shader * const *) b;
+
+   return (sa > sb) - (sa < sb);
+}
+
+static void
+deferred_link_program(void *data)
+{
+   struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+   struct gl_context *ctx = (struct gl_context *) shProg->TaskData;
+   struct gl_shader **shaders;
+   int i;
+
+   /*
+    * Shaders are not changed while this task is pending, see
+    * _mesa_complete_links_using_shader().  Their mutexes are held only
+    * because linking compiles shaders whose front end the shader cache
+    * skipped, which two programs sharing a shader could otherwise do
+    * concurrently.  They are locked in a fixed order as a shader may be
+    * attached to several programs being linked concurrently.
+    */
+   shaders = malloc(sizeof(*shaders) * shProg->NumShaders);
+   if (shaders) {
+      memcpy(shaders, shProg->Shaders, sizeof(*shaders) * shProg->NumShaders);
+      qsort(shaders, shProg->NumShaders, sizeof(*shaders), compare_shader_ptr);
+      for (i = 0; i < shProg->NumShaders; i++)
+         mtx_lock(&shaders[i]->Mutex);
+   }
+
+   _mesa_glsl_link_shader(ctx, shProg);
+
+   if (shaders) {
+      for (i = shProg->NumShaders - 1; i >= 0; i--)
+         mtx_unlock(&shaders[i]->Mutex);
+      free(shaders);
+   }
+}
+
+static bool
+program_is_current(const struct gl_context *ctx,
+                   const struct gl_shader_program *shProg)
+{
+   int i;
+
+   if (ctx->Shader.ActiveProgram == shProg ||
+       ctx->Shader._CurrentFragmentProgram == shProg)
+      return true;
+
+   for (i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (ctx->Shader.CurrentProgram[i] == shProg)
+         return true;
+   }
+
+   return false;
+}
+
+static bool
+queue_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   if (!ctx->ThreadPool || !ctx->Const.DeferLinkProgram)
+      return false;
+
+   /* MESA_GLSL is set, other than to use the prologue cache */
+   if (ctx->Shader.Flags & ~(GLSL_PP_CACHE | GLSL_PP_CACHE_REPORT))
+      return false;
+
+   /* context requires synchronized compiler warnings and errors */
+   if (_mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB))
+      return false;
+
+   /* the next draw needs the new executable anyway */
+   if (program_is_current(ctx, shProg))
+      return false;
+
+   /* linking an empty program is trivial */
+   if (!shProg->NumShaders)
+      return false;
+
+   shProg->TaskData = (void *) ctx;
+   shProg->Task = _mesa_threadpool_queue_task(ctx->ThreadPool,
+         deferred_link_program, (void *) shProg);
+   if (!shProg->Task)
+      shProg->TaskData = NULL;
+
+   return (shProg->Task != NULL);
+}
+
 /**
  * Link a program's shaders.
  */
@@ -914,6 +1020,10 @@ link_program(struct gl_context *ctx, GLuint program)
    for (i = 0; i < shProg->NumShaders; i++)
       _mesa_complete_shader_task(ctx, shProg->Shaders[i]);
 
+   /* the link status is examined only when the task is completed */
+   if (queue_link_program(ctx, shProg))
+      return;
+
    _mesa_glsl_link_shader(ctx, shProg);
 
    if (shProg->LinkStatus == GL_FALSE && 
@@ -1656,15 +1766,25 @@ _mesa_GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length,
       return;
    }
 
+   /* The binary cannot be partially returned. */
+   if (bufSize < shProg->BinaryLength) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glGetProgramBinary(bufSize too small)");
+      if (length != NULL)
+         *length = 0;
+      return;
+   }
+
    /* The ARB_get_program_binary spec says:
     *
     *     "If <length> is NULL, then no length is returned."
     */
    if (length != NULL)
-      *length = 0;
+      *length = shProg->BinaryLength;
 
-   (void) binaryFormat;
-   (void) binary;
+   *binaryFormat = GL_PROGRAM_BINARY_FORMAT_MESA;
+   if (shProg->BinaryLength)
+      memcpy(binary, shProg->Binary, shProg->BinaryLength);
 }
 
 void GLAPIENTRY
@@ -1678,10 +1798,32 @@ _mesa_ProgramBinary(GLuint program, GLenum binaryFormat,
    if (!shProg)
       return;
 
-   (void) binaryFormat;
-   (void) binary;
-   (void) length;
-   _mesa_error(ctx, GL_INVALID_OPERATION, __FUNCTION__);
+   if (binaryFormat != GL_PROGRAM_BINARY_FORMAT_MESA) {
+      _mesa_error(ctx, GL_INVALID_ENUM, "glProgramBinary(binaryFormat)");
+      return;
+   }
+
+   if (length < 0) {
+      _mesa_error(ctx, GL_INVALID_VALUE, "glProgramBinary(length < 0)");
+      return;
+   }
+
+   if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glProgramBinary(transform feedback is using the program)");
+      return;
+   }
+
+   FLUSH_VERTICES(ctx, _NEW_PROGRAM);
+
+   /* A binary that cannot be loaded is not an error, it only leaves the
+    * program unlinked.  Otherwise the GLSL link results are restored from the
+    * binary, and the driver generates its code from them as in glLinkProgram.
+    */
+   if (_mesa_program_binary(ctx, shProg, binary, length)) {
+      if (!ctx->Driver.LinkShader(ctx, shProg))
+         shProg->LinkStatus = GL_FALSE;
+   }
 }
 
 
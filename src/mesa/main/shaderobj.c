@@ -272,6 +272,8 @@ _mesa_init_shader_program(struct gl_context *ctx, struct gl_shader_program *prog
    prog->TransformFeedback.BufferMode = GL_INTERLEAVED_ATTRIBS;
 
    prog->InfoLog = ralloc_strdup(prog, "");
+
+   mtx_init(&prog->Mutex, mtx_plain);
 }
 
 /**
@@ -313,6 +315,10 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
       shProg->UniformHash = NULL;
    }
 
+   ralloc_free(shProg->Binary);
+   shProg->Binary = NULL;
+   shProg->BinaryLength = 0;
+
    assert(shProg->InfoLog != NULL);
    ralloc_free(shProg->InfoLog);
    shProg->InfoLog = ralloc_strdup(shProg, "");
@@ -386,8 +392,11 @@ _mesa_free_shader_program_data(struct gl_context *ctx,
 static void
 _mesa_delete_shader_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
+   _mesa_complete_shader_program_task(ctx, shProg);
+
    _mesa_free_shader_program_data(ctx, shProg);
 
+   mtx_destroy(&shProg->Mutex);
    ralloc_free(shProg);
 }
 
@@ -437,11 +446,81 @@ _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
          _mesa_error(ctx, GL_INVALID_OPERATION, "%s", caller);
          return NULL;
       }
+
+      /* every caller either reads or modifies the program */
+      _mesa_complete_shader_program_task(ctx, shProg);
+
       return shProg;
    }
 }
 
 
+/**
+ * Wait for the deferred glLinkProgram of \p shProg, if any, to complete.
+ */
+void
+_mesa_complete_shader_program_task(struct gl_context *ctx,
+                                   struct gl_shader_program *shProg)
+{
+   mtx_lock(&shProg->Mutex);
+
+   if (shProg->Task) {
+      struct gl_context *task_ctx = (struct gl_context *) shProg->TaskData;
+
+      _mesa_threadpool_complete_task(task_ctx->ThreadPool, shProg->Task);
+      shProg->Task = NULL;
+      shProg->TaskData = NULL;
+   }
+
+   mtx_unlock(&shProg->Mutex);
+}
+
+
+struct complete_links_data
+{
+   struct gl_context *ctx;
+   const struct gl_shader *sh;
+};
+
+static void
+complete_link_using_shader_cb(GLuint id, void *data, void *userData)
+{
+   struct complete_links_data *d = (struct complete_links_data *) userData;
+   struct gl_shader_program *shProg = (struct gl_shader_program *) data;
+   GLuint i;
+
+   if (shProg->Type != GL_SHADER_PROGRAM_MESA || !shProg->Task)
+      return;
+
+   for (i = 0; i < shProg->NumShaders; i++) {
+      if (shProg->Shaders[i] == d->sh) {
+         _mesa_complete_shader_program_task(d->ctx, shProg);
+         return;
+      }
+   }
+}
+
+/**
+ * Wait for the deferred glLinkProgram of every program \p sh is attached
+ * to.  Called before the source or the IR of \p sh is replaced, as those
+ * links must see the shader as it was when glLinkProgram was called.
+ */
+void
+_mesa_complete_links_using_shader(struct gl_context *ctx,
+                                  const struct gl_shader *sh)
+{
+   struct complete_links_data d;
+
+   if (!ctx->Const.DeferLinkProgram || !ctx->ThreadPool)
+      return;
+
+   d.ctx = ctx;
+   d.sh = sh;
+   _mesa_HashWalk(ctx->Shared->ShaderObjects,
+                  complete_link_using_shader_cb, &d);
+}
+
+
 void
 _mesa_init_shader_object_functions(struct dd_function_table *driver)
 {
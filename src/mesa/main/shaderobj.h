@@ -91,6 +91,14 @@ extern void
 _mesa_free_shader_program_data(struct gl_context *ctx,
                                struct gl_shader_program *shProg);
 
+extern void
+_mesa_complete_shader_program_task(struct gl_context *ctx,
+                                   struct gl_shader_program *shProg);
+
+extern void
+_mesa_complete_links_using_shader(struct gl_context *ctx,
+                                  const struct gl_shader *sh);
+
 
 
 extern void
@@ -0,0 +1,486 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2014  LunarG, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "main/macros.h"
+#include "program/register_allocate.h"
+#include "ralloc.h"
+}
+
+namespace {
+
+/**
+ * A register set along with the conflicts between its registers, which
+ * the allocator doesn't expose, to check the result of an allocation.
+ */
+struct reg_set {
+   void *mem_ctx;
+   struct ra_regs *regs;
+   unsigned count;
+   std::vector<std::vector<bool> > conflicts;
+   std::vector<std::vector<unsigned> > class_regs;
+
+   reg_set(unsigned count) : count(count),
+      conflicts(count, std::vector<bool>(count))
+   {
+      mem_ctx = ralloc_context(NULL);
+      regs = ra_alloc_reg_set(mem_ctx, count);
+      for (unsigned i = 0; i < count; i++)
+         conflicts[i][i] = true;
+   }
+
+   ~reg_set()
+   {
+      ralloc_free(mem_ctx);
+   }
+
+   unsigned add_class(void)
+   {
+      class_regs.push_back(std::vector<unsigned>());
+      return ra_alloc_reg_class(regs);
+   }
+
+   void add_reg(unsigned c, unsigned r)
+   {
+      class_regs[c].push_back(r);
+      ra_class_add_reg(regs, c, r);
+   }
+
+   void add_conflict(unsigned r1, unsigned r2)
+   {
+      conflicts[r1][r2] = conflicts[r2][r1] = true;
+      ra_add_reg_conflict(regs, r1, r2);
+   }
+};
+
+/**
+ * Builds a set like the i965 FS backend's: \p base_count hardware
+ * registers, and a class for each of the sizes 1, 2 and 4 whose registers
+ * are made of contiguous hardware registers.
+ */
+reg_set *
+create_aligned_reg_set(unsigned base_count)
+{
+   static const unsigned sizes[] = { 1, 2, 4 };
+   unsigned count = 0;
+
+   for (unsigned s = 0; s < Elements(sizes); s++)
+      count += base_count - sizes[s] + 1;
+
+   reg_set *set = new reg_set(count);
+   unsigned reg = 0;
+
+   for (unsigned s = 0; s < Elements(sizes); s++) {
+      unsigned c = set->add_class();
+
+      for (unsigned base = 0; base + sizes[s] <= base_count; base++) {
+         set->add_reg(c, reg);
+         for (unsigned i = 0; i < sizes[s]; i++) {
+            if (reg != base + i)
+               set->add_conflict(reg, base + i);
+         }
+         reg++;
+      }
+   }
+
+   /* Registers covering a common hardware register conflict too. */
+   for (unsigned r1 = 0; r1 < count; r1++) {
+      for (unsigned r2 = r1 + 1; r2 < count; r2++) {
+         if (set->conflicts[r1][r2])
+            continue;
+         for (unsigned h = 0; h < base_count; h++) {
+            if (set->conflicts[r1][h] && set->conflicts[r2][h]) {
+               set->add_conflict(r1, r2);
+               break;
+            }
+         }
+      }
+   }
+
+   ra_set_finalize(set->regs, NULL);
+   return set;
+}
+
+/** An interference graph, kept aside to check the result of ra_select(). */
+struct graph {
+   unsigned count;
+   std::vector<unsigned> classes;
+   std::vector<int> fixed;
+   std::vector<float> spill_costs;
+   std::vector<std::pair<unsigned, unsigned> > edges;
+
+   graph() : count(0) {}
+
+   void add_node(unsigned c, int reg = -1, float spill_cost = 1.0)
+   {
+      classes.push_back(c);
+      fixed.push_back(reg);
+      spill_costs.push_back(spill_cost);
+      count++;
+   }
+
+   struct ra_graph *
+   create(const reg_set &set) const
+   {
+      struct ra_graph *g = ra_alloc_interference_graph(set.regs, count);
+
+      for (unsigned n = 0; n < count; n++) {
+         if (fixed[n] >= 0)
+            ra_set_node_reg(g, n, fixed[n]);
+         else
+            ra_set_node_class(g, n, classes[n]);
+         ra_set_node_spill_cost(g, n, spill_costs[n]);
+      }
+      for (unsigned i = 0; i < edges.size(); i++)
+         ra_add_node_interference(g, edges[i].first, edges[i].second);
+
+      return g;
+   }
+
+   void
+   check(const reg_set &set, struct ra_graph *g) const
+   {
+      for (unsigned n = 0; n < count; n++) {
+         unsigned r = ra_get_node_reg(g, n);
+
+         ASSERT_LT(r, set.count) << "node " << n;
+         if (fixed[n] >= 0) {
+            EXPECT_EQ((unsigned) fixed[n], r) << "node " << n;
+         } else {
+            const std::vector<unsigned> &regs = set.class_regs[classes[n]];
+            EXPECT_NE(std::find(regs.begin(), regs.end(), r), regs.end())
+               << "node " << n << " got reg " << r << " outside its class";
+         }
+      }
+
+      for (unsigned i = 0; i < edges.size(); i++) {
+         unsigned r1 = ra_get_node_reg(g, edges[i].first);
+         unsigned r2 = ra_get_node_reg(g, edges[i].second);
+
+         EXPECT_FALSE(set.conflicts[r1][r2])
+            << "interfering nodes " << edges[i].first << " and "
+            << edges[i].second << " got conflicting regs " << r1 << " and "
+            << r2;
+      }
+   }
+};
+
+/** A small LCG, so that the graphs are the same on every platform. */
+struct lcg {
+   uint32_t state;
+
+   lcg(uint32_t seed) : state(seed) {}
+
+   unsigned next(unsigned range)
+   {
+      state = state * 1103515245u + 12345u;
+      return (state >> 8) % range;
+   }
+};
+
+/**
+ * Builds the interference graph of \p count live ranges of random start
+ * and length, which is what a long straight-line shader looks like.
+ */
+graph
+create_interval_graph(const reg_set &set, unsigned count, unsigned length,
+                      uint32_t seed)
+{
+   std::vector<unsigned> start(count), end(count);
+   lcg rand(seed);
+   graph g;
+
+   for (unsigned n = 0; n < count; n++) {
+      start[n] = rand.next(length);
+      end[n] = start[n] + 1 + rand.next(length / 40);
+      g.add_node(rand.next(set.class_regs.size()));
+   }
+
+   for (unsigned n1 = 0; n1 < count; n1++) {
+      for (unsigned n2 = n1 + 1; n2 < count; n2++) {
+         if (start[n1] < end[n2] && start[n2] < end[n1])
+            g.edges.push_back(std::make_pair(n1, n2));
+      }
+   }
+
+   return g;
+}
+
+/**
+ * Reads a graph written by ra_dump_graph() when MESA_RA_DUMP_DIR is set.
+ */
+bool
+load_graph(const char *path, reg_set **set_out, graph *g)
+{
+   FILE *f = fopen(path, "r");
+   reg_set *set = NULL;
+   static char line[65536];
+
+   if (!f)
+      return false;
+
+   while (fgets(line, sizeof(line), f)) {
+      unsigned a, b, c;
+      int reg;
+      float cost;
+
+      if (sscanf(line, "regs %u", &a) == 1) {
+         set = new reg_set(a);
+      } else if (sscanf(line, "round_robin %u", &a) == 1) {
+         if (a)
+            ra_set_allocate_round_robin(set->regs);
+      } else if (sscanf(line, "conflict %u %u", &a, &b) == 2) {
+         set->add_conflict(a, b);
+      } else if (sscanf(line, "class %u", &c) == 1) {
+         char *tok = strtok(line + strlen("class "), " \n");
+
+         set->add_class();
+         while ((tok = strtok(NULL, " \n")))
+            set->add_reg(c, atoi(tok));
+      } else if (sscanf(line, "node %u %u %d %f", &a, &c, &reg, &cost) == 4) {
+         g->add_node(c, reg, cost);
+      } else if (sscanf(line, "edge %u %u", &a, &b) == 2) {
+         g->edges.push_back(std::make_pair(a, b));
+      }
+   }
+
+   fclose(f);
+
+   if (!set)
+      return false;
+
+   ra_set_finalize(set->regs, NULL);
+   *set_out = set;
+   return true;
+}
+
+double
+now(void)
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+} /* anonymous namespace */
+
+TEST(register_allocate, complete_graph)
+{
+   const unsigned n = 16;
+   reg_set set(n);
+   unsigned c = set.add_class();
+   graph g;
+
+   for (unsigned r = 0; r < n; r++)
+      set.add_reg(c, r);
+   ra_set_finalize(set.regs, NULL);
+
+   for (unsigned i = 0; i < n; i++) {
+      g.add_node(c);
+      for (unsigned j = 0; j < i; j++)
+         g.edges.push_back(std::make_pair(j, i));
+   }
+
+   struct ra_graph *rg = g.create(set);
+   EXPECT_TRUE(ra_simplify(rg));
+   EXPECT_TRUE(ra_select(rg));
+   g.check(set, rg);
+}
+
+TEST(register_allocate, spill)
+{
+   const unsigned n = 8;
+   reg_set set(n);
+   unsigned c = set.add_class();
+   graph g;
+
+   for (unsigned r = 0; r < n; r++)
+      set.add_reg(c, r);
+   ra_set_finalize(set.regs, NULL);
+
+   /* One node too many, and node 5 is the cheapest to spill. */
+   for (unsigned i = 0; i <= n; i++) {
+      g.add_node(c, -1, i == 5 ? 1.0 : 10.0);
+      for (unsigned j = 0; j < i; j++)
+         g.edges.push_back(std::make_pair(j, i));
+   }
+
+   struct ra_graph *rg = g.create(set);
+   EXPECT_FALSE(ra_allocate_no_spills(rg));
+   EXPECT_EQ(5, ra_get_best_spill_node(rg));
+}
+
+TEST(register_allocate, precolored)
+{
+   const unsigned n = 4;
+   reg_set set(n);
+   unsigned c = set.add_class();
+   graph g;
+
+   for (unsigned r = 0; r < n; r++)
+      set.add_reg(c, r);
+   ra_set_finalize(set.regs, NULL);
+
+   /* A chain of nodes between two fixed registers. */
+   g.add_node(c, 2);
+   for (unsigned i = 1; i < 8; i++) {
+      g.add_node(c);
+      g.edges.push_back(std::make_pair(i - 1, i));
+      g.edges.push_back(std::make_pair(0, i));
+   }
+   g.add_node(c, 1);
+   g.edges.push_back(std::make_pair(7u, 8u));
+
+   struct ra_graph *rg = g.create(set);
+   EXPECT_TRUE(ra_allocate_no_spills(rg));
+   g.check(set, rg);
+}
+
+TEST(register_allocate, aligned_classes)
+{
+   reg_set *set = create_aligned_reg_set(16);
+   graph g;
+
+   /* Two quads and four singles fill the 16 registers exactly. */
+   for (unsigned i = 0; i < 2; i++)
+      g.add_node(2);
+   for (unsigned i = 0; i < 4; i++)
+      g.add_node(1);
+   for (unsigned i = 0; i < g.count; i++) {
+      for (unsigned j = 0; j < i; j++)
+         g.edges.push_back(std::make_pair(j, i));
+   }
+
+   struct ra_graph *rg = g.create(*set);
+   EXPECT_TRUE(ra_allocate_no_spills(rg));
+   g.check(*set, rg);
+
+   delete set;
+}
+
+TEST(register_allocate, random_graphs)
+{
+   reg_set *set = create_aligned_reg_set(32);
+
+   for (uint32_t seed = 1; seed <= 50; seed++) {
+      graph g = create_interval_graph(*set, 200, 400, seed);
+      struct ra_graph *rg = g.create(*set);
+
+      if (ra_allocate_no_spills(rg)) {
+         g.check(*set, rg);
+      } else {
+         int n = ra_get_best_spill_node(rg);
+         EXPECT_GE(n, 0);
+         EXPECT_LT(n, (int) g.count);
+      }
+   }
+
+   delete set;
+}
+
+/**
+ * Not a correctness test: prints the time taken by ra_allocate_no_spills(),
+ * and by ra_get_best_spill_node() when it fails, on each graph dumped to the
+ * directory named by MESA_RA_BENCH_DIR, or on a large synthetic graph if it
+ * isn't set.  Graphs of real shaders are written by running them with
+ * MESA_RA_DUMP_DIR=<dir>.
+ */
+TEST(register_allocate, benchmark)
+{
+   const char *dir = getenv("MESA_RA_BENCH_DIR");
+   const unsigned iterations = 10;
+   std::vector<std::string> names;
+   std::vector<reg_set *> sets;
+   std::vector<graph> graphs;
+
+   if (dir) {
+      DIR *d = opendir(dir);
+      struct dirent *entry;
+
+      ASSERT_TRUE(d != NULL) << "can't open " << dir;
+      while ((entry = readdir(d))) {
+         std::string path = std::string(dir) + "/" + entry->d_name;
+         reg_set *set;
+         graph g;
+
+         if (strncmp(entry->d_name, "ra-", 3) != 0)
+            continue;
+
+         if (!load_graph(path.c_str(), &set, &g)) {
+            ADD_FAILURE() << "can't read " << path;
+            continue;
+         }
+
+         names.push_back(path);
+         sets.push_back(set);
+         graphs.push_back(g);
+      }
+      closedir(d);
+   } else {
+      reg_set *set = create_aligned_reg_set(128);
+
+      names.push_back("synthetic");
+      sets.push_back(set);
+      graphs.push_back(create_interval_graph(*set, 3000, 6000, 1));
+   }
+
+   for (unsigned i = 0; i < graphs.size(); i++) {
+      const graph &g = graphs[i];
+      struct ra_graph *rg[iterations];
+      double start, elapsed;
+      bool colored = true;
+
+      for (unsigned j = 0; j < iterations; j++)
+         rg[j] = g.create(*sets[i]);
+
+      start = now();
+      for (unsigned j = 0; j < iterations; j++) {
+         colored = ra_allocate_no_spills(rg[j]);
+         if (!colored)
+            ra_get_best_spill_node(rg[j]);
+      }
+      elapsed = now() - start;
+
+      if (colored)
+         g.check(*sets[i], rg[0]);
+
+      printf("%s: %u nodes, %u edges, %s: %.3f ms\n", names[i].c_str(),
+             g.count, (unsigned) g.edges.size(),
+             colored ? "colored" : "spilled", elapsed * 1000 / iterations);
+
+      for (unsigned j = 0; j < iterations; j++)
+         ralloc_free(rg[j]);
+      delete sets[i];
+   }
+}
@@ -250,6 +250,17 @@ public:
       return true;
    }
 
+   /**
+    * Call \c func for every mapping in the map
+    *
+    * \c func receives the key, the value biased by +1 (see \c ::put), and
+    * \c closure.  The order of the mappings is unspecified.
+    */
+   void iterate(void (*func)(const void *, void *, void *), void *closure)
+   {
+      hash_table_call_foreach(this->ht, func, closure);
+   }
+
    void put(unsigned value, const char *key)
    {
       /* The low-level hash table structure returns NULL if key is not in the
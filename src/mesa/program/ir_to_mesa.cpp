@@ -38,6 +38,7 @@
 #include "glsl_types.h"
 #include "glsl_parser_extras.h"
 #include "../glsl/program.h"
+#include "../glsl/shader_cache.h"
 #include "ir_optimization.h"
 #include "ast.h"
 #include "linker.h"
@@ -2993,31 +2994,33 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       const struct gl_shader_compiler_options *options =
             &ctx->ShaderCompilerOptions[prog->_LinkedShaders[i]->Stage];
 
+      ir_pass_manager pm;
+
       do {
 	 progress = false;
 
 	 /* Lowering */
-	 do_mat_op_to_vec(ir);
-	 lower_instructions(ir, (MOD_TO_FRACT | DIV_TO_MUL_RCP | EXP_TO_EXP2
-				 | LOG_TO_LOG2 | INT_DIV_TO_MUL_RCP
-				 | ((options->EmitNoPow) ? POW_TO_EXP2 : 0)));
+	 pm.record(do_mat_op_to_vec(ir));
+	 pm.record(lower_instructions(ir, (MOD_TO_FRACT | DIV_TO_MUL_RCP | EXP_TO_EXP2
+					   | LOG_TO_LOG2 | INT_DIV_TO_MUL_RCP
+					   | ((options->EmitNoPow) ? POW_TO_EXP2 : 0))));
 
-	 progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
+	 progress = pm.record(do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops)) || progress;
 
-	 progress = do_common_optimization(ir, true, true,
-					   options->MaxUnrollIterations,
-                                           options)
+	 progress = pm.run_common_optimization(ir, true, true,
+					       options->MaxUnrollIterations,
+					       options)
 	   || progress;
 
-	 progress = lower_quadop_vector(ir, true) || progress;
+	 progress = pm.record(lower_quadop_vector(ir, true)) || progress;
 
 	 if (options->MaxIfDepth == 0)
-	    progress = lower_discard(ir) || progress;
+	    progress = pm.record(lower_discard(ir)) || progress;
 
-	 progress = lower_if_to_cond_assign(ir, options->MaxIfDepth) || progress;
+	 progress = pm.record(lower_if_to_cond_assign(ir, options->MaxIfDepth)) || progress;
 
 	 if (options->EmitNoNoise)
-	    progress = lower_noise(ir) || progress;
+	    progress = pm.record(lower_noise(ir)) || progress;
 
 	 /* If there are forms of indirect addressing that the driver
 	  * cannot handle, perform the lowering pass.
@@ -3025,15 +3028,15 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 	 if (options->EmitNoIndirectInput || options->EmitNoIndirectOutput
 	     || options->EmitNoIndirectTemp || options->EmitNoIndirectUniform)
 	   progress =
-	     lower_variable_index_to_cond_assign(ir,
-						 options->EmitNoIndirectInput,
-						 options->EmitNoIndirectOutput,
-						 options->EmitNoIndirectTemp,
-						 options->EmitNoIndirectUniform)
+	     pm.record(lower_variable_index_to_cond_assign(ir,
+							   options->EmitNoIndirectInput,
+							   options->EmitNoIndirectOutput,
+							   options->EmitNoIndirectTemp,
+							   options->EmitNoIndirectUniform))
 	     || progress;
 
-	 progress = do_vec_index_to_cond_assign(ir) || progress;
-         progress = lower_vector_insert(ir, true) || progress;
+	 progress = pm.record(do_vec_index_to_cond_assign(ir)) || progress;
+         progress = pm.record(lower_vector_insert(ir, true)) || progress;
       } while (progress);
 
       validate_ir_tree(ir);
@@ -3083,8 +3086,24 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       }
    }
 
-   if (prog->LinkStatus) {
-      link_shaders(ctx, prog);
+   if (prog->LinkStatus && !_mesa_shader_cache_load_program(ctx, prog)) {
+      /* Shaders whose front end was skipped are compiled now that their
+       * IR is needed.
+       */
+      for (i = 0; i < prog->NumShaders; i++) {
+         struct gl_shader *sh = prog->Shaders[i];
+
+         if (sh->compile_skipped) {
+            _mesa_glsl_compile_shader(ctx, sh, false, false);
+            if (!sh->CompileStatus)
+               linker_error(prog, "linking with uncompiled shader");
+         }
+      }
+
+      if (prog->LinkStatus) {
+         link_shaders(ctx, prog);
+         _mesa_shader_cache_store_program(ctx, prog);
+      }
    }
 
    if (prog->LinkStatus) {
@@ -68,9 +68,20 @@
  * up front and stored in a 2-dimensional array, so that the cost of
  * coloring a node is constant with the number of registers.  We do
  * this during ra_set_finalize().
+ *
+ * Each node keeps the sum of q(B,C) over its neighbors still in the
+ * graph, which is updated as neighbors are pushed on the stack, so
+ * simplification is linear in the size of the graph: a node is pushed as
+ * soon as its sum drops below p(B), and only the neighbors of pushed nodes
+ * are ever looked at again.  Register conflicts and class membership are
+ * bitsets, so that ra_select() can rule out the registers used by all of a
+ * node's neighbors a word at a time.
  */
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ralloc.h>
 
 #include "main/imports.h"
@@ -82,7 +93,7 @@
 #define NO_REG ~0
 
 struct ra_reg {
-   GLboolean *conflicts;
+   BITSET_WORD *conflicts;
    unsigned int *conflict_list;
    unsigned int conflict_list_size;
    unsigned int num_conflicts;
@@ -99,7 +110,7 @@ struct ra_regs {
 };
 
 struct ra_class {
-   GLboolean *regs;
+   BITSET_WORD *regs;
 
    /**
     * p(B) in Runeson/Nyström paper.
@@ -145,6 +156,16 @@ struct ra_node {
     * approximate cost of spilling this node.
     */
    float spill_cost;
+
+   /**
+    * Sum of q(B,C) over the neighbors that are not in the stack, B being
+    * the class of this node.  The node is trivially colorable once this is
+    * less than p(B).
+    */
+   unsigned int q_total;
+
+   /** Sum of q(B,C) over all neighbors, for the spill benefit. */
+   unsigned int q_total_all;
 };
 
 struct ra_graph {
@@ -167,6 +188,9 @@ struct ra_graph {
     * spilling.
     */
    unsigned int stack_optimistic_start;
+
+   /** Whether the q_total fields of the nodes have been computed. */
+   bool q_totals_valid;
 };
 
 /**
@@ -186,8 +210,9 @@ ra_alloc_reg_set(void *mem_ctx, unsigned int count)
    regs->regs = rzalloc_array(regs, struct ra_reg, count);
 
    for (i = 0; i < count; i++) {
-      regs->regs[i].conflicts = rzalloc_array(regs->regs, GLboolean, count);
-      regs->regs[i].conflicts[i] = GL_TRUE;
+      regs->regs[i].conflicts = rzalloc_array(regs->regs, BITSET_WORD,
+                                              BITSET_WORDS(count));
+      BITSET_SET(regs->regs[i].conflicts, i);
 
       regs->regs[i].conflict_list = ralloc_array(regs->regs, unsigned int, 4);
       regs->regs[i].conflict_list_size = 4;
@@ -225,13 +250,13 @@ ra_add_conflict_list(struct ra_regs *regs, unsigned int r1, unsigned int r2)
 				     unsigned int, reg1->conflict_list_size);
    }
    reg1->conflict_list[reg1->num_conflicts++] = r2;
-   reg1->conflicts[r2] = GL_TRUE;
+   BITSET_SET(reg1->conflicts, r2);
 }
 
 void
 ra_add_reg_conflict(struct ra_regs *regs, unsigned int r1, unsigned int r2)
 {
-   if (!regs->regs[r1].conflicts[r2]) {
+   if (!BITSET_TEST(regs->regs[r1].conflicts, r2)) {
       ra_add_conflict_list(regs, r1, r2);
       ra_add_conflict_list(regs, r2, r1);
    }
@@ -269,7 +294,7 @@ ra_alloc_reg_class(struct ra_regs *regs)
    class = rzalloc(regs, struct ra_class);
    regs->classes[regs->class_count] = class;
 
-   class->regs = rzalloc_array(class, GLboolean, regs->count);
+   class->regs = rzalloc_array(class, BITSET_WORD, BITSET_WORDS(regs->count));
 
    return regs->class_count++;
 }
@@ -279,7 +304,7 @@ ra_class_add_reg(struct ra_regs *regs, unsigned int c, unsigned int r)
 {
    struct ra_class *class = regs->classes[c];
 
-   class->regs[r] = GL_TRUE;
+   BITSET_SET(class->regs, r);
    class->p++;
 }
 
@@ -319,12 +344,12 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
 	    int conflicts = 0;
 	    int i;
 
-	    if (!regs->classes[c]->regs[rc])
+	    if (!BITSET_TEST(regs->classes[c]->regs, rc))
 	       continue;
 
 	    for (i = 0; i < regs->regs[rc].num_conflicts; i++) {
 	       unsigned int rb = regs->regs[rc].conflict_list[i];
-	       if (regs->classes[b]->regs[rb])
+	       if (BITSET_TEST(regs->classes[b]->regs, rb))
 		  conflicts++;
 	    }
 	    max_conflicts = MAX2(max_conflicts, conflicts);
@@ -397,22 +422,52 @@ ra_add_node_interference(struct ra_graph *g,
    }
 }
 
-static GLboolean pq_test(struct ra_graph *g, unsigned int n)
+/**
+ * Computes the q_total and q_total_all of every node, from the neighbors
+ * that are not in the stack yet.
+ */
+static void
+ra_compute_q_totals(struct ra_graph *g)
 {
-   unsigned int j;
-   unsigned int q = 0;
-   int n_class = g->nodes[n].class;
+   unsigned int n, j;
 
-   for (j = 0; j < g->nodes[n].adjacency_count; j++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[j];
-      unsigned int n2_class = g->nodes[n2].class;
+   for (n = 0; n < g->count; n++) {
+      struct ra_node *node = &g->nodes[n];
+      const unsigned int *q = g->regs->classes[node->class]->q;
+
+      node->q_total = 0;
+      node->q_total_all = 0;
+
+      for (j = 0; j < node->adjacency_count; j++) {
+         unsigned int n2 = node->adjacency_list[j];
+         unsigned int n2_q = q[g->nodes[n2].class];
 
-      if (n != n2 && !g->nodes[n2].in_stack) {
-	 q += g->regs->classes[n_class]->q[n2_class];
+         if (n2 == n)
+            continue;
+
+         node->q_total_all += n2_q;
+         if (!g->nodes[n2].in_stack)
+            node->q_total += n2_q;
       }
    }
 
-   return q < g->regs->classes[n_class]->p;
+   g->q_totals_valid = true;
+}
+
+static inline GLboolean
+pq_test(struct ra_graph *g, unsigned int n)
+{
+   int n_class = g->nodes[n].class;
+
+   return g->nodes[n].q_total < g->regs->classes[n_class]->p;
+}
+
+static inline void
+ra_push_node(struct ra_graph *g, unsigned int n)
+{
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = GL_TRUE;
 }
 
 /**
@@ -420,6 +475,9 @@ static GLboolean pq_test(struct ra_graph *g, unsigned int n)
  * trivially-colorable nodes into a stack of nodes to be colored,
  * removing them from the graph, and rinsing and repeating.
  *
+ * The stack doubles as the worklist: pushing a node lowers the q_total of
+ * its neighbors, which are pushed in turn once they pass the pq test.
+ *
  * Returns GL_TRUE if all nodes were removed from the graph.  GL_FALSE
  * means that either spilling will be required, or optimistic coloring
  * should be applied.
@@ -427,31 +485,78 @@ static GLboolean pq_test(struct ra_graph *g, unsigned int n)
 GLboolean
 ra_simplify(struct ra_graph *g)
 {
-   GLboolean progress = GL_TRUE;
-   int i;
+   unsigned int worklist_start = g->stack_count;
+   unsigned int remaining = 0;
+   unsigned int i, j;
+
+   ra_compute_q_totals(g);
 
-   while (progress) {
-      progress = GL_FALSE;
+   for (i = g->count; i-- > 0; ) {
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
+	 continue;
 
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
+      if (pq_test(g, i))
+         ra_push_node(g, i);
+      else
+         remaining++;
+   }
 
-	 if (pq_test(g, i)) {
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = GL_TRUE;
-	    progress = GL_TRUE;
-	 }
+   for (i = worklist_start; i < g->stack_count && remaining; i++) {
+      unsigned int n = g->stack[i];
+      struct ra_node *node = &g->nodes[n];
+
+      for (j = 0; j < node->adjacency_count; j++) {
+         unsigned int n2 = node->adjacency_list[j];
+         struct ra_node *node2 = &g->nodes[n2];
+
+         if (node2->in_stack || node2->reg != NO_REG)
+            continue;
+
+         node2->q_total -= g->regs->classes[node2->class]->q[node->class];
+
+         if (pq_test(g, n2)) {
+            ra_push_node(g, n2);
+            remaining--;
+         }
       }
    }
 
-   for (i = 0; i < g->count; i++) {
-      if (!g->nodes[i].in_stack && g->nodes[i].reg == -1)
-	 return GL_FALSE;
+   return remaining == 0;
+}
+
+/**
+ * Returns the first register of \p class_regs, starting the search at
+ * \p start and wrapping around, which isn't in \p forbidden, or NO_REG.
+ */
+static unsigned int
+ra_find_reg(const BITSET_WORD *class_regs, const BITSET_WORD *forbidden,
+            unsigned int count, unsigned int start)
+{
+   const unsigned int words = BITSET_WORDS(count);
+   unsigned int pass;
+
+   for (pass = 0; pass < 2; pass++) {
+      unsigned int first = pass == 0 ? start : 0;
+      unsigned int last = pass == 0 ? count : start;
+      unsigned int w;
+
+      for (w = BITSET_BITWORD(first); w < words && w * BITSET_WORDBITS < last;
+           w++) {
+         BITSET_WORD avail = class_regs[w] & ~forbidden[w];
+
+         if (w == BITSET_BITWORD(first))
+            avail &= ~0u << (first % BITSET_WORDBITS);
+
+         if (avail) {
+            unsigned int r = w * BITSET_WORDBITS + ffs(avail) - 1;
+            if (r < last)
+               return r;
+            break;
+         }
+      }
    }
 
-   return GL_TRUE;
+   return NO_REG;
 }
 
 /**
@@ -464,46 +569,48 @@ ra_simplify(struct ra_graph *g)
 GLboolean
 ra_select(struct ra_graph *g)
 {
-   int i;
+   const unsigned int words = BITSET_WORDS(g->regs->count);
+   BITSET_WORD *forbidden = ralloc_array(g, BITSET_WORD, words);
+   unsigned int i, w;
    int start_search_reg = 0;
 
    while (g->stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->stack[g->stack_count - 1];
       struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
+      /* Collect the registers conflicting with those of our neighbors. */
+      memset(forbidden, 0, words * sizeof(BITSET_WORD));
+      for (i = 0; i < g->nodes[n].adjacency_count; i++) {
+	 unsigned int n2 = g->nodes[n].adjacency_list[i];
+         const BITSET_WORD *conflicts;
+
+	 if (g->nodes[n2].in_stack || g->nodes[n2].reg == NO_REG)
+            continue;
+
+         conflicts = g->regs->regs[g->nodes[n2].reg].conflicts;
+         for (w = 0; w < words; w++)
+            forbidden[w] |= conflicts[w];
+      }
+
       /* Find the lowest-numbered reg which is not used by a member
        * of the graph adjacent to us.
        */
-      for (ri = 0; ri < g->regs->count; ri++) {
-         r = (start_search_reg + ri) % g->regs->count;
-	 if (!c->regs[r])
-	    continue;
-
-	 /* Check if any of our neighbors conflict with this register choice. */
-	 for (i = 0; i < g->nodes[n].adjacency_count; i++) {
-	    unsigned int n2 = g->nodes[n].adjacency_list[i];
-
-	    if (!g->nodes[n2].in_stack &&
-		g->regs->regs[r].conflicts[g->nodes[n2].reg]) {
-	       break;
-	    }
-	 }
-	 if (i == g->nodes[n].adjacency_count)
-	    break;
-      }
-      if (ri == g->regs->count)
+      r = ra_find_reg(c->regs, forbidden, g->regs->count, start_search_reg);
+      if (r == NO_REG) {
+         ralloc_free(forbidden);
 	 return GL_FALSE;
+      }
 
       g->nodes[n].reg = r;
       g->nodes[n].in_stack = GL_FALSE;
       g->stack_count--;
 
       if (g->regs->round_robin)
-         start_search_reg = r + 1;
+         start_search_reg = (r + 1) % g->regs->count;
    }
 
+   ralloc_free(forbidden);
    return GL_TRUE;
 }
 
@@ -530,9 +637,81 @@ ra_optimistic_color(struct ra_graph *g)
    }
 }
 
+/**
+ * Writes the register set and the graph to a new file in the directory
+ * named by MESA_RA_DUMP_DIR, so that allocations from real shaders can be
+ * replayed by the register allocator benchmark.  The file is named after a
+ * hash of the graph, so a graph seen several times is only kept once.
+ */
+static void
+ra_dump_graph(struct ra_graph *g, const char *dir)
+{
+   struct ra_regs *regs = g->regs;
+   uint32_t hash = 2166136261u;
+   unsigned int i, j;
+   char *path;
+   FILE *f;
+
+#define RA_HASH(x) hash = (hash ^ (uint32_t) (x)) * 16777619u
+   RA_HASH(regs->count);
+   RA_HASH(regs->class_count);
+   RA_HASH(g->count);
+   for (i = 0; i < g->count; i++) {
+      RA_HASH(g->nodes[i].class);
+      RA_HASH(g->nodes[i].reg);
+      for (j = 0; j < g->nodes[i].adjacency_count; j++)
+         RA_HASH(g->nodes[i].adjacency_list[j]);
+   }
+#undef RA_HASH
+
+   path = ralloc_size(g, strlen(dir) + sizeof("/ra-01234567.txt"));
+   sprintf(path, "%s/ra-%08x.txt", dir, hash);
+   f = fopen(path, "w");
+   ralloc_free(path);
+   if (!f)
+      return;
+
+   fprintf(f, "regs %u\n", regs->count);
+   fprintf(f, "round_robin %d\n", regs->round_robin ? 1 : 0);
+   for (i = 0; i < regs->count; i++) {
+      for (j = 0; j < regs->regs[i].num_conflicts; j++) {
+         if (regs->regs[i].conflict_list[j] > i)
+            fprintf(f, "conflict %u %u\n", i, regs->regs[i].conflict_list[j]);
+      }
+   }
+   for (i = 0; i < regs->class_count; i++) {
+      fprintf(f, "class %u", i);
+      for (j = 0; j < regs->count; j++) {
+         if (BITSET_TEST(regs->classes[i]->regs, j))
+            fprintf(f, " %u", j);
+      }
+      fprintf(f, "\n");
+   }
+
+   fprintf(f, "nodes %u\n", g->count);
+   for (i = 0; i < g->count; i++) {
+      fprintf(f, "node %u %u %d %f\n", i, g->nodes[i].class,
+              g->nodes[i].reg == NO_REG ? -1 : (int) g->nodes[i].reg,
+              g->nodes[i].spill_cost);
+   }
+   for (i = 0; i < g->count; i++) {
+      for (j = 0; j < g->nodes[i].adjacency_count; j++) {
+         if (g->nodes[i].adjacency_list[j] > i)
+            fprintf(f, "edge %u %u\n", i, g->nodes[i].adjacency_list[j]);
+      }
+   }
+
+   fclose(f);
+}
+
 GLboolean
 ra_allocate_no_spills(struct ra_graph *g)
 {
+   const char *dump_dir = getenv("MESA_RA_DUMP_DIR");
+
+   if (dump_dir)
+      ra_dump_graph(g, dump_dir);
+
    if (!ra_simplify(g)) {
       ra_optimistic_color(g);
    }
@@ -568,25 +747,15 @@ ra_set_node_reg(struct ra_graph *g, unsigned int n, unsigned int reg)
 static float
 ra_get_spill_benefit(struct ra_graph *g, unsigned int n)
 {
-   int j;
-   float benefit = 0;
    int n_class = g->nodes[n].class;
 
    /* Define the benefit of eliminating an interference between n, n2
     * through spilling as q(C, B) / p(C).  This is similar to the
     * "count number of edges" approach of traditional graph coloring,
-    * but takes classes into account.
+    * but takes classes into account.  The sum of q(C, B) over the
+    * neighbors was computed by ra_simplify().
     */
-   for (j = 0; j < g->nodes[n].adjacency_count; j++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[j];
-      if (n != n2) {
-	 unsigned int n2_class = g->nodes[n2].class;
-	 benefit += ((float)g->regs->classes[n_class]->q[n2_class] /
-		     g->regs->classes[n_class]->p);
-      }
-   }
-
-   return benefit;
+   return (float)g->nodes[n].q_total_all / g->regs->classes[n_class]->p;
 }
 
 /**
@@ -600,6 +769,9 @@ ra_get_best_spill_node(struct ra_graph *g)
    float best_benefit = 0.0;
    unsigned int n, i;
 
+   if (!g->q_totals_valid)
+      ra_compute_q_totals(g);
+
    /* For any registers not in the stack to be colored, consider them for
     * spilling.  This will mostly collect nodes that were being optimistally
     * colored as part of ra_allocate_no_spills() if we didn't successfully
@@ -5284,16 +5284,19 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_discard(ir);
       }
 
+      ir_pass_manager pm;
+
       do {
          progress = false;
 
-         progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
+         progress = pm.record(do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops)) || progress;
 
-         progress = do_common_optimization(ir, true, true,
-					   options->MaxUnrollIterations, options)
+         progress = pm.run_common_optimization(ir, true, true,
+                                               options->MaxUnrollIterations,
+                                               options)
 	   || progress;
 
-         progress = lower_if_to_cond_assign(ir, options->MaxIfDepth) || progress;
+         progress = pm.record(lower_if_to_cond_assign(ir, options->MaxIfDepth)) || progress;
 
       } while (progress);
 